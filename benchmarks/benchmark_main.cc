@@ -0,0 +1,48 @@
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+
+// Shared main() for the benchmarks in this package.
+//
+// Results are always reported on the console. Unless an output file is
+// explicitly requested with --benchmark_out, when run under bazel test the
+// results are also written as JSON to
+// $TEST_UNDECLARED_OUTPUTS_DIR/<benchmark binary name>.json so that they can
+// be collected and tracked over time.
+int main(int argc, char** argv) {
+  std::vector<char*> args(argv, argv + argc);
+
+  bool has_out = false;
+  for (int i = 1; i < argc; i++) {
+    if (absl::StartsWith(argv[i], "--benchmark_out=")) {
+      has_out = true;
+    }
+  }
+
+  std::string out_flag;
+  std::string format_flag = "--benchmark_out_format=json";
+  const char* outputs_dir = std::getenv("TEST_UNDECLARED_OUTPUTS_DIR");
+  if (!has_out && outputs_dir != nullptr && outputs_dir[0] != '\0') {
+    std::string name = std::filesystem::path(argv[0]).filename().string();
+    out_flag =
+        absl::StrCat("--benchmark_out=", outputs_dir, "/", name, ".json");
+    args.push_back(out_flag.data());
+    args.push_back(format_flag.data());
+  }
+
+  int new_argc = args.size();
+  args.push_back(nullptr);
+
+  benchmark::Initialize(&new_argc, args.data());
+  if (benchmark::ReportUnrecognizedArguments(new_argc, args.data())) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
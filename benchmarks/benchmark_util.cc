@@ -0,0 +1,88 @@
+#include "benchmarks/benchmark_util.h"
+
+#include <cstdlib>
+#include <iostream>
+
+#include "ift/common/bazel_data_file_resolver.h"
+#include "ift/common/font_helper.h"
+#include "ift/common/test_font_loader.h"
+
+using ift::common::BazelDataFileResolver;
+using ift::common::CodepointSet;
+using ift::common::DataFileResolver;
+using ift::common::FontData;
+using ift::common::FontHelper;
+using ift::common::hb_face_unique_ptr;
+using ift::common::TestFontLoader;
+using ift::encoder::SubsetDefinition;
+
+namespace ift::benchmarks {
+
+static const TestFontLoader& Loader() {
+  static const TestFontLoader* loader = [] {
+    auto loader = TestFontLoader::Default();
+    if (!loader.ok()) {
+      std::cerr << "Failed to create font loader: " << loader.status()
+                << std::endl;
+      std::abort();
+    }
+    return loader->release();
+  }();
+  return *loader;
+}
+
+FontData LoadFontData(const std::string& path) {
+  auto font = Loader().LoadFontData(path);
+  if (!font.ok()) {
+    std::cerr << "Failed to load " << path << ": " << font.status()
+              << std::endl;
+    std::abort();
+  }
+  return std::move(*font);
+}
+
+hb_face_unique_ptr LoadFace(const std::string& path) {
+  return LoadFontData(path).face();
+}
+
+std::shared_ptr<DataFileResolver> Resolver() {
+  static const std::shared_ptr<DataFileResolver>* resolver = [] {
+    auto resolver = BazelDataFileResolver::CreateForTest();
+    if (!resolver.ok()) {
+      std::cerr << "Failed to create data file resolver: "
+                << resolver.status() << std::endl;
+      std::abort();
+    }
+    return new std::shared_ptr<DataFileResolver>(std::move(*resolver));
+  }();
+  return *resolver;
+}
+
+CodepointSet SampleCodepoints(hb_face_t* face, uint32_t stride,
+                              uint32_t limit) {
+  CodepointSet result;
+  uint32_t i = 0;
+  for (uint32_t cp : FontHelper::ToCodepointsSet(face)) {
+    if (result.size() >= limit) {
+      break;
+    }
+    if (i++ % stride == 0) {
+      result.insert(cp);
+    }
+  }
+  return result;
+}
+
+std::vector<SubsetDefinition> SplitIntoSegments(const CodepointSet& codepoints,
+                                                uint32_t segment_size) {
+  std::vector<SubsetDefinition> segments;
+  for (uint32_t cp : codepoints) {
+    if (segments.empty() || segments.back().codepoints.size() >= segment_size) {
+      segments.emplace_back();
+    }
+    segments.back().codepoints.insert(cp);
+  }
+  return segments;
+}
+
+}  // namespace ift::benchmarks
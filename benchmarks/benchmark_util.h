@@ -0,0 +1,48 @@
+#ifndef BENCHMARKS_BENCHMARK_UTIL_H_
+#define BENCHMARKS_BENCHMARK_UTIL_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hb.h"
+#include "ift/common/data_file_resolver.h"
+#include "ift/common/font_data.h"
+#include "ift/common/int_set.h"
+#include "ift/encoder/subset_definition.h"
+
+namespace ift::benchmarks {
+
+// The checked in test fonts that benchmarks are run against.
+inline constexpr char kRoboto[] = "ift/common/testdata/Roboto-Regular.ttf";
+inline constexpr char kNotoSansJp[] =
+    "ift/common/testdata/NotoSansJP-Regular.ttf";
+inline constexpr char kNotoNastaliqUrdu[] =
+    "ift/common/testdata/NotoNastaliqUrdu.subset.ttf";
+
+// Loads a font (path relative to the project root) from the runfiles. Aborts
+// if the font can't be loaded since no benchmark can run without it.
+ift::common::hb_face_unique_ptr LoadFace(const std::string& path);
+
+// Loads the font (path relative to the project root) from the runfiles as
+// FontData. Aborts if the font can't be loaded.
+ift::common::FontData LoadFontData(const std::string& path);
+
+// Resolver for the unicode and frequency data files, shared by all
+// benchmarks.
+std::shared_ptr<ift::common::DataFileResolver> Resolver();
+
+// Returns every stride'th codepoint mapped by face, stopping after limit
+// codepoints have been collected.
+ift::common::CodepointSet SampleCodepoints(hb_face_t* face, uint32_t stride,
+                                           uint32_t limit);
+
+// Splits codepoints (in order) into definitions of segment_size codepoints
+// each.
+std::vector<ift::encoder::SubsetDefinition> SplitIntoSegments(
+    const ift::common::CodepointSet& codepoints, uint32_t segment_size);
+
+}  // namespace ift::benchmarks
+
+#endif  // BENCHMARKS_BENCHMARK_UTIL_H_
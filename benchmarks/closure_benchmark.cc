@@ -0,0 +1,109 @@
+#include "benchmark/benchmark.h"
+#include "benchmarks/benchmark_util.h"
+#include "ift/encoder/glyph_closure_cache.h"
+#include "ift/encoder/subset_definition.h"
+
+using ift::encoder::GlyphClosureCache;
+using ift::encoder::SubsetDefinition;
+
+namespace ift::benchmarks {
+
+// Closure of a single large subset definition on a freshly created cache (ie.
+// always a cache miss).
+static void BM_GlyphClosure_Cold(benchmark::State& state, const char* font) {
+  auto face = LoadFace(font);
+  SubsetDefinition def;
+  def.codepoints = SampleCodepoints(face.get(), 2, 2000);
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto cache = GlyphClosureCache::Create(face.get(), *Resolver());
+    if (!cache.ok()) {
+      state.SkipWithError(cache.status().ToString().c_str());
+      break;
+    }
+    state.ResumeTiming();
+
+    auto gids = (*cache)->GlyphClosure(def);
+    if (!gids.ok()) {
+      state.SkipWithError(gids.status().ToString().c_str());
+      break;
+    }
+    benchmark::DoNotOptimize(gids);
+  }
+}
+BENCHMARK_CAPTURE(BM_GlyphClosure_Cold, roboto, kRoboto)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_GlyphClosure_Cold, noto_sans_jp, kNotoSansJp)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_GlyphClosure_Cold, noto_nastaliq_urdu, kNotoNastaliqUrdu)
+    ->Unit(benchmark::kMicrosecond);
+
+// Closure of many small segments, as done when the segmenter computes the
+// initial per segment closures. Each segment is a cache miss.
+static void BM_GlyphClosure_Segments(benchmark::State& state,
+                                     const char* font) {
+  auto face = LoadFace(font);
+  auto segments =
+      SplitIntoSegments(SampleCodepoints(face.get(), 1, 2000), state.range(0));
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto cache = GlyphClosureCache::Create(face.get(), *Resolver());
+    if (!cache.ok()) {
+      state.SkipWithError(cache.status().ToString().c_str());
+      break;
+    }
+    state.ResumeTiming();
+
+    for (const auto& def : segments) {
+      auto gids = (*cache)->GlyphClosure(def);
+      if (!gids.ok()) {
+        state.SkipWithError(gids.status().ToString().c_str());
+        return;
+      }
+      benchmark::DoNotOptimize(gids);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * segments.size());
+}
+BENCHMARK_CAPTURE(BM_GlyphClosure_Segments, roboto, kRoboto)
+    ->Arg(1)
+    ->Arg(16)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_GlyphClosure_Segments, noto_sans_jp, kNotoSansJp)
+    ->Arg(1)
+    ->Arg(16)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_GlyphClosure_Segments, noto_nastaliq_urdu,
+                  kNotoNastaliqUrdu)
+    ->Arg(1)
+    ->Arg(16)
+    ->Unit(benchmark::kMillisecond);
+
+// Repeated closure of the same definition, measures the cache hit path.
+static void BM_GlyphClosure_Warm(benchmark::State& state, const char* font) {
+  auto face = LoadFace(font);
+  SubsetDefinition def;
+  def.codepoints = SampleCodepoints(face.get(), 2, 2000);
+
+  auto cache = GlyphClosureCache::Create(face.get(), *Resolver());
+  if (!cache.ok()) {
+    state.SkipWithError(cache.status().ToString().c_str());
+    return;
+  }
+  if (!(*cache)->GlyphClosure(def).ok()) {
+    state.SkipWithError("Initial closure failed.");
+    return;
+  }
+
+  for (auto _ : state) {
+    auto gids = (*cache)->GlyphClosure(def);
+    benchmark::DoNotOptimize(gids);
+  }
+}
+BENCHMARK_CAPTURE(BM_GlyphClosure_Warm, roboto, kRoboto);
+BENCHMARK_CAPTURE(BM_GlyphClosure_Warm, noto_sans_jp, kNotoSansJp);
+BENCHMARK_CAPTURE(BM_GlyphClosure_Warm, noto_nastaliq_urdu, kNotoNastaliqUrdu);
+
+}  // namespace ift::benchmarks
@@ -0,0 +1,77 @@
+#include <utility>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "benchmarks/benchmark_util.h"
+#include "ift/common/int_set.h"
+#include "ift/dep_graph/dependency_graph.h"
+#include "ift/encoder/glyph_closure_cache.h"
+#include "ift/encoder/init_subset_defaults.h"
+#include "ift/encoder/requested_segmentation_information.h"
+#include "ift/encoder/segment.h"
+#include "ift/encoder/subset_definition.h"
+#include "ift/freq/probability_bound.h"
+
+using ift::common::SegmentSet;
+using ift::config::PATCH;
+using ift::dep_graph::DependencyGraph;
+using ift::encoder::GlyphClosureCache;
+using ift::encoder::RequestedSegmentationInformation;
+using ift::encoder::Segment;
+using ift::encoder::SubsetDefinition;
+using ift::freq::ProbabilityBound;
+
+namespace ift::benchmarks {
+
+// Dependency graph traversal from each segment in turn, as done during
+// condition analysis.
+static void BM_ClosureTraversal(benchmark::State& state, const char* font) {
+  auto face = LoadFace(font);
+  auto cache = GlyphClosureCache::Create(face.get(), *Resolver());
+  if (!cache.ok()) {
+    state.SkipWithError(cache.status().ToString().c_str());
+    return;
+  }
+
+  std::vector<Segment> segments;
+  for (auto& def :
+       SplitIntoSegments(SampleCodepoints(face.get(), 1, 2000), 4)) {
+    segments.emplace_back(std::move(def), ProbabilityBound::Zero());
+  }
+  const size_t num_segments = segments.size();
+
+  SubsetDefinition init;
+  ift::encoder::AddInitSubsetDefaults(init);
+  auto info = RequestedSegmentationInformation::Create(
+      std::move(segments), std::move(init), **cache, PATCH);
+  if (!info.ok()) {
+    state.SkipWithError(info.status().ToString().c_str());
+    return;
+  }
+
+  auto graph = DependencyGraph::Create(info->get(), face.get(), *Resolver());
+  if (!graph.ok()) {
+    state.SkipWithError(graph.status().ToString().c_str());
+    return;
+  }
+
+  for (auto _ : state) {
+    for (uint32_t s = 0; s < num_segments; s++) {
+      auto traversal = graph->ClosureTraversal(SegmentSet{s});
+      if (!traversal.ok()) {
+        state.SkipWithError(traversal.status().ToString().c_str());
+        return;
+      }
+      benchmark::DoNotOptimize(traversal);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_segments);
+}
+BENCHMARK_CAPTURE(BM_ClosureTraversal, roboto, kRoboto)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_ClosureTraversal, noto_sans_jp, kNotoSansJp)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_ClosureTraversal, noto_nastaliq_urdu, kNotoNastaliqUrdu)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace ift::benchmarks
@@ -0,0 +1,105 @@
+#include <optional>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "benchmarks/benchmark_util.h"
+#include "ift/common/font_helper.h"
+#include "ift/common/int_set.h"
+#include "ift/common/sparse_bit_set.h"
+#include "ift/proto/format_2_patch_map.h"
+#include "ift/proto/ift_table.h"
+#include "ift/proto/patch_encoding.h"
+#include "ift/proto/patch_map.h"
+
+using ift::common::CodepointSet;
+using ift::common::FontHelper;
+using ift::common::IntSet;
+using ift::common::SparseBitSet;
+using ift::proto::Format2PatchMap;
+using ift::proto::GLYPH_KEYED;
+using ift::proto::IFTTable;
+using ift::proto::PatchMap;
+
+namespace ift::benchmarks {
+
+// Encoding of a font's full codepoint coverage (with automatic branch factor
+// selection).
+static void BM_SparseBitSetEncode_Font(benchmark::State& state,
+                                       const char* font) {
+  auto face = LoadFace(font);
+  CodepointSet codepoints = FontHelper::ToCodepointsSet(face.get());
+
+  for (auto _ : state) {
+    auto encoded = SparseBitSet::Encode(codepoints);
+    benchmark::DoNotOptimize(encoded);
+  }
+  state.SetItemsProcessed(state.iterations() * codepoints.size());
+}
+BENCHMARK_CAPTURE(BM_SparseBitSetEncode_Font, roboto, kRoboto);
+BENCHMARK_CAPTURE(BM_SparseBitSetEncode_Font, noto_sans_jp, kNotoSansJp);
+BENCHMARK_CAPTURE(BM_SparseBitSetEncode_Font, noto_nastaliq_urdu,
+                  kNotoNastaliqUrdu);
+
+// Encoding of synthetic sets: range(0) values spaced range(1) apart.
+static void BM_SparseBitSetEncode_Synthetic(benchmark::State& state) {
+  IntSet set;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    set.insert(i * state.range(1));
+  }
+
+  for (auto _ : state) {
+    auto encoded = SparseBitSet::Encode(set);
+    benchmark::DoNotOptimize(encoded);
+  }
+  state.SetItemsProcessed(state.iterations() * set.size());
+}
+BENCHMARK(BM_SparseBitSetEncode_Synthetic)
+    ->ArgsProduct({{64, 4096, 65536}, {1, 7, 113}});
+
+// Serialization of a patch map with one entry per range(0) codepoints of the
+// font, similar to the mapping produced for a glyph keyed segmentation.
+static void BM_Format2PatchMapSerialize(benchmark::State& state,
+                                        const char* font) {
+  auto face = LoadFace(font);
+  auto segments = SplitIntoSegments(FontHelper::ToCodepointsSet(face.get()),
+                                    state.range(0));
+
+  IFTTable table;
+  table.SetUrlTemplate(std::vector<uint8_t>{4, 'f', 'o', 'o', '/', 128});
+  PatchMap& map = table.GetPatchMap();
+  uint32_t patch_index = 1;
+  for (const auto& segment : segments) {
+    auto sc = map.AddEntry(PatchMap::Coverage(segment.codepoints),
+                           patch_index++, GLYPH_KEYED);
+    if (!sc.ok()) {
+      state.SkipWithError(sc.ToString().c_str());
+      return;
+    }
+  }
+
+  for (auto _ : state) {
+    auto encoded =
+        Format2PatchMap::Serialize(table, std::nullopt, std::nullopt);
+    if (!encoded.ok()) {
+      state.SkipWithError(encoded.status().ToString().c_str());
+      break;
+    }
+    benchmark::DoNotOptimize(encoded);
+  }
+  state.SetItemsProcessed(state.iterations() * segments.size());
+}
+BENCHMARK_CAPTURE(BM_Format2PatchMapSerialize, roboto, kRoboto)
+    ->Arg(4)
+    ->Arg(64)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Format2PatchMapSerialize, noto_sans_jp, kNotoSansJp)
+    ->Arg(4)
+    ->Arg(64)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Format2PatchMapSerialize, noto_nastaliq_urdu,
+                  kNotoNastaliqUrdu)
+    ->Arg(4)
+    ->Arg(64)
+    ->Unit(benchmark::kMicrosecond);
+
+}  // namespace ift::benchmarks
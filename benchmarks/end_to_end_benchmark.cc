@@ -0,0 +1,173 @@
+#include <cstdint>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "benchmarks/benchmark_util.h"
+#include "ift/config/config_compiler.h"
+#include "ift/config/segmentation_plan.pb.h"
+#include "ift/encoder/closure_glyph_segmenter.h"
+#include "ift/encoder/compiler.h"
+#include "ift/encoder/glyph_segmentation.h"
+#include "ift/encoder/merge_strategy.h"
+#include "ift/encoder/subset_definition.h"
+
+using ift::config::CLOSURE_ONLY;
+using ift::config::ConfigCompiler;
+using ift::config::PATCH;
+using ift::config::SegmentationPlan;
+using ift::encoder::ClosureGlyphSegmenter;
+using ift::encoder::Compiler;
+using ift::encoder::GlyphSegmentation;
+using ift::encoder::MergeStrategy;
+using ift::encoder::SubsetDefinition;
+
+namespace ift::benchmarks {
+
+// Number of codepoints (sampled from the font) that are segmented.
+static constexpr uint32_t kNumCodepoints = 400;
+
+// Input codepoints per segment before merging.
+static constexpr uint32_t kSegmentSize = 4;
+
+// Merge target for the heuristic merger.
+static constexpr uint32_t kMinPatchSize = 2000;
+
+static std::vector<SubsetDefinition> Segments(hb_face_t* face) {
+  return SplitIntoSegments(SampleCodepoints(face, 2, kNumCodepoints),
+                           kSegmentSize);
+}
+
+static SubsetDefinition InitSegment(hb_face_t* face) {
+  SubsetDefinition init;
+  init.codepoints = SampleCodepoints(face, 1, 32);
+  return init;
+}
+
+// Segments a font with heuristic merging. range(0) is the number of threads.
+static void BM_Segment(benchmark::State& state, const char* font) {
+  auto face = LoadFace(font);
+  auto segments = Segments(face.get());
+  auto init = InitSegment(face.get());
+
+  ClosureGlyphSegmenter segmenter(8, 8, PATCH, CLOSURE_ONLY, Resolver());
+  segmenter.SetNumThreads(state.range(0));
+
+  for (auto _ : state) {
+    auto segmentation = segmenter.CodepointToGlyphSegments(
+        face.get(), init, segments, MergeStrategy::Heuristic(kMinPatchSize));
+    if (!segmentation.ok()) {
+      state.SkipWithError(segmentation.status().ToString().c_str());
+      break;
+    }
+    benchmark::DoNotOptimize(segmentation);
+  }
+}
+BENCHMARK_CAPTURE(BM_Segment, roboto, kRoboto)
+    ->Arg(1)
+    ->Arg(4)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_Segment, noto_sans_jp, kNotoSansJp)
+    ->Arg(1)
+    ->Arg(4)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_Segment, noto_nastaliq_urdu, kNotoNastaliqUrdu)
+    ->Arg(1)
+    ->Arg(4)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Compiles a segmentation of the font into an IFT font and patches.
+// range(0) is the number of threads.
+static void BM_Compile(benchmark::State& state, const char* font) {
+  auto face = LoadFace(font);
+
+  ClosureGlyphSegmenter segmenter(8, 8, PATCH, CLOSURE_ONLY, Resolver());
+  auto segmentation = segmenter.CodepointToGlyphSegments(
+      face.get(), InitSegment(face.get()), Segments(face.get()),
+      MergeStrategy::Heuristic(kMinPatchSize));
+  if (!segmentation.ok()) {
+    state.SkipWithError(segmentation.status().ToString().c_str());
+    return;
+  }
+  SegmentationPlan plan = segmentation->ToSegmentationPlanProto();
+
+  uint64_t total_bytes = 0;
+  for (auto _ : state) {
+    Compiler compiler;
+    compiler.SetFace(face.get());
+    compiler.SetNumThreads(state.range(0));
+    auto sc = ConfigCompiler::Configure(plan, compiler);
+    if (!sc.ok()) {
+      state.SkipWithError(sc.ToString().c_str());
+      break;
+    }
+
+    auto encoding = compiler.Compile();
+    if (!encoding.ok()) {
+      state.SkipWithError(encoding.status().ToString().c_str());
+      break;
+    }
+    total_bytes += encoding->init_font.size();
+    for (const auto& [url, patch] : encoding->patches) {
+      total_bytes += patch.size();
+    }
+  }
+  state.SetBytesProcessed(total_bytes);
+}
+BENCHMARK_CAPTURE(BM_Compile, roboto, kRoboto)
+    ->Arg(1)
+    ->Arg(4)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_Compile, noto_sans_jp, kNotoSansJp)
+    ->Arg(1)
+    ->Arg(4)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_Compile, noto_nastaliq_urdu, kNotoNastaliqUrdu)
+    ->Arg(1)
+    ->Arg(4)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Full pipeline: segmentation followed by compilation, single threaded.
+static void BM_SegmentAndCompile(benchmark::State& state, const char* font) {
+  auto face = LoadFace(font);
+  auto segments = Segments(face.get());
+  auto init = InitSegment(face.get());
+  ClosureGlyphSegmenter segmenter(8, 8, PATCH, CLOSURE_ONLY, Resolver());
+
+  for (auto _ : state) {
+    auto segmentation = segmenter.CodepointToGlyphSegments(
+        face.get(), init, segments, MergeStrategy::Heuristic(kMinPatchSize));
+    if (!segmentation.ok()) {
+      state.SkipWithError(segmentation.status().ToString().c_str());
+      break;
+    }
+
+    Compiler compiler;
+    compiler.SetFace(face.get());
+    auto sc = ConfigCompiler::Configure(
+        segmentation->ToSegmentationPlanProto(), compiler);
+    if (!sc.ok()) {
+      state.SkipWithError(sc.ToString().c_str());
+      break;
+    }
+    auto encoding = compiler.Compile();
+    if (!encoding.ok()) {
+      state.SkipWithError(encoding.status().ToString().c_str());
+      break;
+    }
+    benchmark::DoNotOptimize(encoding);
+  }
+}
+BENCHMARK_CAPTURE(BM_SegmentAndCompile, roboto, kRoboto)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_SegmentAndCompile, noto_sans_jp, kNotoSansJp)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_SegmentAndCompile, noto_nastaliq_urdu, kNotoNastaliqUrdu)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace ift::benchmarks
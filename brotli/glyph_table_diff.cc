@@ -0,0 +1,241 @@
+#include "brotli/glyph_table_diff.h"
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "brotli/brotli_stream.h"
+#include "ift/common/font_data.h"
+#include "ift/common/font_helper.h"
+#include "ift/common/try.h"
+
+namespace brotli {
+
+using absl::flat_hash_map;
+using absl::Status;
+using absl::StatusOr;
+using absl::string_view;
+using ift::common::FontData;
+using ift::common::FontHelper;
+
+namespace {
+
+constexpr hb_tag_t kHmtx = HB_TAG('h', 'm', 't', 'x');
+constexpr hb_tag_t kVmtx = HB_TAG('v', 'm', 't', 'x');
+constexpr hb_tag_t kHhea = HB_TAG('h', 'h', 'e', 'a');
+constexpr hb_tag_t kVhea = HB_TAG('v', 'h', 'e', 'a');
+
+// Copies shorter than this are cheaper to encode as part of the surrounding
+// new data than as a separate dictionary reference meta-block.
+constexpr unsigned kMinCopyLength = 32;
+
+// A byte range [start, end) of a table.
+struct Record {
+  unsigned start;
+  unsigned end;
+};
+
+StatusOr<std::vector<Record>> GlyfRecords(hb_face_t* face,
+                                          unsigned table_size) {
+  bool long_loca = TRY(FontHelper::HasLongLoca(face));
+  string_view loca = TRY(FontHelper::Loca(face));
+  unsigned width = long_loca ? 4 : 2;
+  unsigned count = loca.size() / width;
+
+  std::vector<Record> records;
+  records.reserve(count);
+  unsigned prev = 0;
+  for (unsigned i = 0; i < count; i++) {
+    unsigned offset =
+        long_loca ? TRY(FontHelper::ReadUInt32(loca.substr(i * width)))
+                  : 2 * TRY(FontHelper::ReadUInt16(loca.substr(i * width)));
+    if (i > 0) {
+      if (offset < prev || offset > table_size) {
+        return absl::InvalidArgumentError("Invalid loca offsets.");
+      }
+      records.push_back(Record{prev, offset});
+    }
+    prev = offset;
+  }
+  return records;
+}
+
+std::vector<Record> FixedWidthRecords(unsigned table_size, unsigned width,
+                                      unsigned start = 0) {
+  std::vector<Record> records;
+  for (unsigned offset = start; offset + width <= table_size;
+       offset += width) {
+    records.push_back(Record{offset, offset + width});
+  }
+  return records;
+}
+
+StatusOr<std::vector<Record>> MetricsRecords(hb_face_t* face,
+                                             hb_tag_t header_tag,
+                                             unsigned table_size) {
+  // numberOfHMetrics (hhea) and numOfLongVerMetrics (vhea) are both at offset
+  // 34.
+  constexpr unsigned num_metrics_offset = 34;
+  FontData header = FontHelper::TableData(face, header_tag);
+  unsigned num_metrics =
+      TRY(FontHelper::ReadUInt16(header.str(num_metrics_offset)));
+
+  // Long metrics are 4 bytes, followed by 2 byte side bearings.
+  unsigned long_metrics_size = std::min(num_metrics * 4, table_size);
+  std::vector<Record> records = FixedWidthRecords(long_metrics_size, 4);
+  for (const Record& r : FixedWidthRecords(table_size, 2, long_metrics_size)) {
+    records.push_back(r);
+  }
+  return records;
+}
+
+StatusOr<std::vector<Record>> Records(hb_face_t* face, hb_tag_t tag,
+                                      unsigned table_size) {
+  switch (tag) {
+    case FontHelper::kGlyf:
+      return GlyfRecords(face, table_size);
+    case FontHelper::kLoca:
+      return FixedWidthRecords(table_size,
+                               TRY(FontHelper::HasLongLoca(face)) ? 4 : 2);
+    case kHmtx:
+      return MetricsRecords(face, kHhea, table_size);
+    case kVmtx:
+      return MetricsRecords(face, kVhea, table_size);
+    default:
+      return absl::InvalidArgumentError("Unsupported table for glyph diff.");
+  }
+}
+
+}  // namespace
+
+bool GlyphTableDiff::Supports(hb_tag_t tag) {
+  return tag == FontHelper::kGlyf || tag == FontHelper::kLoca ||
+         tag == kHmtx || tag == kVmtx;
+}
+
+bool GlyphTableDiff::FitsInWindow(unsigned base_size, unsigned derived_size) {
+  constexpr unsigned max_window_size = (1 << 24) - 16;
+  return base_size + derived_size < max_window_size;
+}
+
+Status GlyphTableDiff::Diff(hb_face_t* base_face, hb_face_t* derived_face,
+                            hb_tag_t tag, FontData* patch) {
+  FontData base = FontHelper::TableData(base_face, tag);
+  FontData derived = FontHelper::TableData(derived_face, tag);
+  if (base.empty() || derived.empty()) {
+    return absl::InvalidArgumentError(
+        "Both base and derived must have a non-empty table.");
+  }
+  if (!FitsInWindow(base.size(), derived.size())) {
+    return absl::InvalidArgumentError("Tables are too large for the window.");
+  }
+
+  // Empty records (eg. empty glyphs) contribute no bytes so are dropped, this
+  // keeps them from breaking up runs of copied records.
+  std::vector<Record> base_records;
+  for (const Record& r : TRY(Records(base_face, tag, base.size()))) {
+    if (r.start < r.end) {
+      base_records.push_back(r);
+    }
+  }
+  std::vector<Record> derived_records =
+      TRY(Records(derived_face, tag, derived.size()));
+
+  auto base_content = [&](size_t index) {
+    const Record& r = base_records[index];
+    return base.str().substr(r.start, r.end - r.start);
+  };
+
+  // Maps record content to the first base record with that content.
+  flat_hash_map<string_view, size_t> base_index;
+  for (size_t i = 0; i < base_records.size(); i++) {
+    base_index.insert(std::pair(base_content(i), i));
+  }
+
+  BrotliStream out(BrotliStream::WindowBitsFor(base.size(), derived.size()),
+                   base.size());
+
+  // A sequence of derived records which are present, in the same order and
+  // contiguous, in base.
+  struct Run {
+    unsigned derived_start;
+    unsigned derived_end;
+    unsigned base_start;
+    size_t next_base_index;
+  };
+  std::optional<Run> run;
+
+  // Start of the derived bytes not yet written to the stream. Everything
+  // between this and the start of the next emitted copy is new data.
+  unsigned pending_start = 0;
+
+  auto flush_run = [&]() -> Status {
+    if (!run.has_value()) {
+      return absl::OkStatus();
+    }
+
+    unsigned length = run->derived_end - run->derived_start;
+    if (length >= kMinCopyLength) {
+      TRYV(out.insert_compressed(derived.span().subspan(
+          pending_start, run->derived_start - pending_start)));
+      if (!out.insert_from_dictionary(run->base_start, length)) {
+        return absl::InternalError("Failed to insert dictionary reference.");
+      }
+      pending_start = run->derived_end;
+    }
+    // Otherwise the run is left as part of the pending new data.
+
+    run.reset();
+    return absl::OkStatus();
+  };
+
+  for (const Record& r : derived_records) {
+    if (r.start == r.end) {
+      continue;
+    }
+
+    string_view content = derived.str().substr(r.start, r.end - r.start);
+    if (run.has_value() && run->derived_end == r.start &&
+        run->next_base_index < base_records.size()) {
+      const Record& next_base = base_records[run->next_base_index];
+      unsigned base_end =
+          run->base_start + (run->derived_end - run->derived_start);
+      if (next_base.start == base_end &&
+          base_content(run->next_base_index) == content) {
+        run->derived_end = r.end;
+        run->next_base_index++;
+        continue;
+      }
+    }
+
+    TRYV(flush_run());
+
+    auto it = base_index.find(content);
+    if (it == base_index.end()) {
+      // New data, remains pending.
+      continue;
+    }
+
+    run = Run{
+        .derived_start = r.start,
+        .derived_end = r.end,
+        .base_start = base_records[it->second].start,
+        .next_base_index = it->second + 1,
+    };
+  }
+  TRYV(flush_run());
+
+  // Anything remaining, including any bytes not covered by records, is new.
+  TRYV(out.insert_compressed(derived.span().subspan(pending_start)));
+  out.end_stream();
+
+  patch->copy(reinterpret_cast<const char*>(out.compressed_data().data()),
+              out.compressed_data().size());
+  return absl::OkStatus();
+}
+
+}  // namespace brotli
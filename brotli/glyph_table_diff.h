@@ -0,0 +1,39 @@
+#ifndef BROTLI_GLYPH_TABLE_DIFF_H_
+#define BROTLI_GLYPH_TABLE_DIFF_H_
+
+#include "absl/status/status.h"
+#include "hb.h"
+#include "ift/common/font_data.h"
+
+namespace brotli {
+
+/*
+ * Produces a brotli patch for a single glyph indexed table (glyf, loca, hmtx,
+ * vmtx) which uses the base table as a shared dictionary. Applying the patch to
+ * the base table produces the derived table.
+ *
+ * Rather than running the brotli compressor search over the whole table the
+ * table is split into per glyph records. Each run of records in derived which
+ * also appears byte for byte in base is encoded directly as a dictionary
+ * reference (via BrotliStream). Only the remaining new bytes are passed through
+ * the compressor.
+ */
+class GlyphTableDiff {
+ public:
+  // Returns true if tag is one of the tables supported by this differ.
+  static bool Supports(hb_tag_t tag);
+
+  // Returns true if tables of the given sizes fit within a single brotli
+  // window. Tables which don't must be diffed with a regular brotli diff.
+  static bool FitsInWindow(unsigned base_size, unsigned derived_size);
+
+  // Diffs table 'tag' from base_face to derived_face. Both faces must contain
+  // a non-empty copy of the table.
+  static absl::Status Diff(hb_face_t* base_face, hb_face_t* derived_face,
+                           hb_tag_t tag,
+                           ift::common::FontData* patch /* OUT */);
+};
+
+}  // namespace brotli
+
+#endif  // BROTLI_GLYPH_TABLE_DIFF_H_
@@ -0,0 +1,120 @@
+#include "brotli/glyph_table_diff.h"
+
+#include "gtest/gtest.h"
+#include "hb-subset.h"
+#include "ift/common/brotli_binary_patch.h"
+#include "ift/common/font_data.h"
+#include "ift/common/font_helper.h"
+#include "ift/common/test_font_loader.h"
+
+namespace brotli {
+
+using ift::common::BrotliBinaryPatch;
+using ift::common::FontData;
+using ift::common::FontHelper;
+using ift::common::hb_face_unique_ptr;
+using ift::common::make_hb_face;
+
+class GlyphTableDiffTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    auto loader = ift::common::TestFontLoader::Default().value();
+    roboto = loader->LoadFontData("ift/common/testdata/Roboto-Regular.ttf")
+                 .value()
+                 .face();
+  }
+
+  hb_face_unique_ptr Subset(hb_codepoint_t start, hb_codepoint_t end,
+                            bool retain_gids = false) {
+    hb_subset_input_t* input = hb_subset_input_create_or_fail();
+    hb_set_add_range(hb_subset_input_unicode_set(input), start, end);
+    if (retain_gids) {
+      hb_subset_input_set_flags(input, HB_SUBSET_FLAGS_RETAIN_GIDS);
+    }
+    hb_face_t* result = hb_subset_or_fail(roboto.get(), input);
+    hb_subset_input_destroy(input);
+    return make_hb_face(result);
+  }
+
+  void CheckRoundTrip(hb_face_t* base, hb_face_t* derived, hb_tag_t tag) {
+    FontData patch;
+    ASSERT_EQ(GlyphTableDiff::Diff(base, derived, tag, &patch),
+              absl::OkStatus());
+
+    FontData base_table = FontHelper::TableData(base, tag);
+    FontData derived_table = FontHelper::TableData(derived, tag);
+
+    BrotliBinaryPatch patcher;
+    FontData patched;
+    ASSERT_EQ(patcher.Patch(base_table, patch, &patched), absl::OkStatus());
+    ASSERT_EQ(patched.str(), derived_table.str());
+  }
+
+  hb_face_unique_ptr roboto = make_hb_face(nullptr);
+};
+
+TEST_F(GlyphTableDiffTest, Supports) {
+  ASSERT_TRUE(GlyphTableDiff::Supports(HB_TAG('g', 'l', 'y', 'f')));
+  ASSERT_TRUE(GlyphTableDiff::Supports(HB_TAG('l', 'o', 'c', 'a')));
+  ASSERT_TRUE(GlyphTableDiff::Supports(HB_TAG('h', 'm', 't', 'x')));
+  ASSERT_TRUE(GlyphTableDiff::Supports(HB_TAG('v', 'm', 't', 'x')));
+  ASSERT_FALSE(GlyphTableDiff::Supports(HB_TAG('c', 'm', 'a', 'p')));
+  ASSERT_FALSE(GlyphTableDiff::Supports(HB_TAG('g', 'v', 'a', 'r')));
+}
+
+TEST_F(GlyphTableDiffTest, FitsInWindow) {
+  ASSERT_TRUE(GlyphTableDiff::FitsInWindow(1000, 2000));
+  ASSERT_FALSE(GlyphTableDiff::FitsInWindow(1 << 23, 1 << 23));
+}
+
+TEST_F(GlyphTableDiffTest, AddGlyphs) {
+  hb_face_unique_ptr base = Subset(0x41, 0x5A);
+  hb_face_unique_ptr derived = Subset(0x41, 0x7A);
+
+  CheckRoundTrip(base.get(), derived.get(), HB_TAG('g', 'l', 'y', 'f'));
+  CheckRoundTrip(base.get(), derived.get(), HB_TAG('l', 'o', 'c', 'a'));
+  CheckRoundTrip(base.get(), derived.get(), HB_TAG('h', 'm', 't', 'x'));
+}
+
+TEST_F(GlyphTableDiffTest, AddGlyphs_RetainGids) {
+  hb_face_unique_ptr base = Subset(0x41, 0x45, true);
+  hb_face_unique_ptr derived = Subset(0x41, 0x5A, true);
+
+  CheckRoundTrip(base.get(), derived.get(), HB_TAG('g', 'l', 'y', 'f'));
+  CheckRoundTrip(base.get(), derived.get(), HB_TAG('l', 'o', 'c', 'a'));
+  CheckRoundTrip(base.get(), derived.get(), HB_TAG('h', 'm', 't', 'x'));
+}
+
+TEST_F(GlyphTableDiffTest, RemoveGlyphs) {
+  hb_face_unique_ptr base = Subset(0x41, 0x7A);
+  hb_face_unique_ptr derived = Subset(0x61, 0x7A);
+
+  CheckRoundTrip(base.get(), derived.get(), HB_TAG('g', 'l', 'y', 'f'));
+  CheckRoundTrip(base.get(), derived.get(), HB_TAG('l', 'o', 'c', 'a'));
+  CheckRoundTrip(base.get(), derived.get(), HB_TAG('h', 'm', 't', 'x'));
+}
+
+TEST_F(GlyphTableDiffTest, CopiedGlyphsAreNotRecompressed) {
+  hb_face_unique_ptr base = Subset(0x41, 0x7A);
+  hb_face_unique_ptr derived = Subset(0x41, 0x7A);
+
+  hb_tag_t glyf = HB_TAG('g', 'l', 'y', 'f');
+  FontData patch;
+  ASSERT_EQ(GlyphTableDiff::Diff(base.get(), derived.get(), glyf, &patch),
+            absl::OkStatus());
+
+  // Identical tables should reduce to a handful of dictionary references.
+  ASSERT_LT(patch.size(), 64);
+  CheckRoundTrip(base.get(), derived.get(), glyf);
+}
+
+TEST_F(GlyphTableDiffTest, MissingTable) {
+  hb_face_unique_ptr base = Subset(0x41, 0x5A);
+  hb_face_unique_ptr derived = Subset(0x41, 0x7A);
+
+  FontData patch;
+  ASSERT_TRUE(absl::IsInvalidArgument(GlyphTableDiff::Diff(
+      base.get(), derived.get(), HB_TAG('v', 'm', 't', 'x'), &patch)));
+}
+
+}  // namespace brotli
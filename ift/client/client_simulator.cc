@@ -0,0 +1,332 @@
+#include "ift/client/client_simulator.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/btree_set.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "hb.h"
+#include "ift/common/font_data.h"
+#include "ift/common/font_helper.h"
+#include "ift/common/int_set.h"
+#include "ift/common/thread_pool.h"
+#include "ift/common/try.h"
+#include "ift/common/woff2.h"
+#include "ift/proto/format_2_patch_map.h"
+#include "ift/proto/patch_encoding.h"
+#include "ift/proto/patch_map.h"
+#include "ift/url_template.h"
+
+using absl::btree_set;
+using absl::flat_hash_set;
+using absl::Span;
+using absl::Status;
+using absl::StatusOr;
+using absl::StrCat;
+using absl::string_view;
+using ift::common::FontData;
+using ift::common::FontHelper;
+using ift::common::ThreadPool;
+using ift::common::Woff2;
+using ift::encoder::Compiler;
+using ift::encoder::SubsetDefinition;
+using ift::proto::Format2PatchMap;
+using ift::proto::IFTTable;
+using ift::proto::PatchEncoding;
+using ift::proto::PatchMap;
+using ift::proto::TABLE_KEYED_FULL;
+using ift::proto::TABLE_KEYED_PARTIAL;
+
+namespace ift::client {
+
+namespace {
+
+// A matched entry which is a candidate for being fetched.
+struct Candidate {
+  // 0 for the 'IFT ' table, 1 for 'IFTX'.
+  uint32_t table;
+  const PatchMap::Entry* entry;
+  std::vector<std::string> urls;
+  // How much of the target the entry covers, used to pick between
+  // invalidating candidates.
+  uint64_t score;
+};
+
+}  // namespace
+
+static bool CoverageIntersects(const PatchMap::Coverage& coverage,
+                               const SubsetDefinition& target) {
+  if (!coverage.codepoints.empty() &&
+      !coverage.codepoints.intersects(target.codepoints)) {
+    return false;
+  }
+
+  if (!coverage.features.empty()) {
+    bool found = false;
+    for (hb_tag_t tag : coverage.features) {
+      if (target.feature_tags.contains(tag)) {
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      return false;
+    }
+  }
+
+  if (!coverage.design_space.empty()) {
+    bool found = false;
+    for (const auto& [tag, range] : coverage.design_space) {
+      auto it = target.design_space.find(tag);
+      if (it != target.design_space.end() && it->second.Intersects(range)) {
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static uint64_t CoverageScore(const PatchMap::Coverage& coverage,
+                              const SubsetDefinition& target) {
+  uint64_t score = 0;
+  for (uint32_t cp : coverage.codepoints) {
+    score += target.codepoints.contains(cp);
+  }
+  for (hb_tag_t tag : coverage.features) {
+    score += target.feature_tags.contains(tag);
+  }
+  for (const auto& [tag, range] : coverage.design_space) {
+    score += target.design_space.contains(tag);
+  }
+  return score;
+}
+
+// Finds the entries of table which match target and have not yet been
+// fetched. Entries are matched in order so that child entries (which always
+// precede the entries that reference them) are resolved first.
+static Status MatchEntries(const IFTTable& table, uint32_t table_index,
+                           const SubsetDefinition& target,
+                           const flat_hash_set<std::string>& fetched,
+                           std::vector<Candidate>& out) {
+  Span<const PatchMap::Entry> entries = table.GetPatchMap().GetEntries();
+  std::vector<bool> matched(entries.size());
+  std::vector<uint64_t> scores(entries.size());
+  for (size_t i = 0; i < entries.size(); i++) {
+    const PatchMap::Entry& entry = entries[i];
+    const PatchMap::Coverage& coverage = entry.coverage;
+    if (!CoverageIntersects(coverage, target)) {
+      continue;
+    }
+
+    uint64_t score = CoverageScore(coverage, target);
+    if (!coverage.child_indices.empty()) {
+      bool any = false;
+      bool all = true;
+      for (uint32_t child : coverage.child_indices) {
+        if (child >= i) {
+          return absl::InvalidArgumentError(
+              StrCat("Child index ", child, " does not precede entry ", i));
+        }
+        any = any || matched[child];
+        all = all && matched[child];
+        score += matched[child] ? scores[child] : 0;
+      }
+      if (coverage.conjunctive ? !all : !any) {
+        continue;
+      }
+    }
+
+    matched[i] = true;
+    scores[i] = score;
+    if (entry.ignored) {
+      continue;
+    }
+
+    Candidate candidate{
+        .table = table_index, .entry = &entry, .urls = {}, .score = score};
+    for (uint32_t patch_index : entry.patch_indices) {
+      candidate.urls.push_back(
+          TRY(URLTemplate::PatchToUrl(table.GetUrlTemplate(), patch_index)));
+    }
+    // Once the activated patch has been fetched the entry is satisfied.
+    if (!fetched.contains(candidate.urls.front())) {
+      out.push_back(std::move(candidate));
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Returns the index of the highest scoring candidate with encoding in
+// table (or any table if table is nullopt), ties go to the first candidate.
+static std::optional<size_t> BestCandidate(
+    const std::vector<Candidate>& candidates, PatchEncoding encoding,
+    std::optional<uint32_t> table) {
+  std::optional<size_t> best;
+  for (size_t i = 0; i < candidates.size(); i++) {
+    const Candidate& c = candidates[i];
+    if (c.entry->encoding != encoding ||
+        (table.has_value() && c.table != *table)) {
+      continue;
+    }
+    if (!best.has_value() || c.score > candidates[*best].score) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+// Picks the candidates to fetch in the next round trip: a single full
+// invalidation patch if there are any, otherwise for each table a single
+// partial invalidation patch if there are any, or else all of the table's
+// glyph keyed patches.
+static std::vector<size_t> SelectCandidates(
+    const std::vector<Candidate>& candidates) {
+  auto full = BestCandidate(candidates, TABLE_KEYED_FULL, std::nullopt);
+  if (full.has_value()) {
+    return {*full};
+  }
+
+  std::vector<size_t> selected;
+  for (uint32_t table = 0; table < 2; table++) {
+    auto partial = BestCandidate(candidates, TABLE_KEYED_PARTIAL, table);
+    if (partial.has_value()) {
+      selected.push_back(*partial);
+      continue;
+    }
+    for (size_t i = 0; i < candidates.size(); i++) {
+      if (candidates[i].table == table &&
+          !PatchMap::IsInvalidating(candidates[i].entry->encoding)) {
+        selected.push_back(i);
+      }
+    }
+  }
+  return selected;
+}
+
+StatusOr<ClientSimulator::PatchMaps> ClientSimulator::ParsePatchMaps(
+    string_view ift_table, string_view iftx_table) {
+  PatchMaps maps;
+  if (!ift_table.empty()) {
+    maps.ift = TRY(Format2PatchMap::Deserialize(ift_table));
+  }
+  if (!iftx_table.empty()) {
+    maps.iftx = TRY(Format2PatchMap::Deserialize(iftx_table));
+  }
+  return maps;
+}
+
+void ClientSimulator::ConfigureCompiler(Compiler& compiler) {
+  compiler.SetRecordPatchMaps(true);
+}
+
+StatusOr<ClientSimulator> ClientSimulator::Create(
+    const Compiler::Encoding& encoding) {
+  ClientSimulator simulator;
+  simulator.init_font_size_ = encoding.init_font.size();
+
+  FontData init_font;
+  if (encoding.init_font.str().substr(0, 4) == "wOF2") {
+    init_font = TRY(Woff2::DecodeWoff2(encoding.init_font.str()));
+  } else {
+    init_font.shallow_copy(encoding.init_font);
+  }
+  auto face = init_font.face();
+  simulator.init_maps_ = TRY(ParsePatchMaps(
+      FontHelper::TableData(face.get(), FontHelper::kIFT).str(),
+      FontHelper::TableData(face.get(), FontHelper::kIFTX).str()));
+
+  for (const auto& [url, metadata] : encoding.patch_metadata) {
+    simulator.patch_sizes_[url] = metadata.size;
+    if (!metadata.ift_table.empty() || !metadata.iftx_table.empty()) {
+      simulator.table_keyed_maps_[url] =
+          TRY(ParsePatchMaps(metadata.ift_table, metadata.iftx_table));
+    }
+  }
+
+  return simulator;
+}
+
+StatusOr<ClientSimulator::Stats> ClientSimulator::Simulate(
+    const SubsetDefinition& target, btree_set<std::string>* fetched_urls,
+    uint32_t max_round_trips) const {
+  static const PatchMaps kNoPatchMaps;
+
+  Stats stats;
+  stats.pages = 1;
+  stats.init_font_bytes = init_font_size_;
+
+  const PatchMaps* current = &init_maps_;
+  flat_hash_set<std::string> fetched;
+  while (stats.round_trips < max_round_trips) {
+    std::vector<Candidate> candidates;
+    if (current->ift.has_value()) {
+      TRYV(MatchEntries(*current->ift, 0, target, fetched, candidates));
+    }
+    if (current->iftx.has_value()) {
+      TRYV(MatchEntries(*current->iftx, 1, target, fetched, candidates));
+    }
+    if (candidates.empty()) {
+      break;
+    }
+
+    stats.round_trips++;
+    const PatchMaps* next = current;
+    for (size_t i : SelectCandidates(candidates)) {
+      const Candidate& candidate = candidates[i];
+      for (const std::string& url : candidate.urls) {
+        if (!fetched.insert(url).second) {
+          continue;
+        }
+        auto size = patch_sizes_.find(url);
+        if (size == patch_sizes_.end()) {
+          return absl::NotFoundError(StrCat("No patch metadata for ", url));
+        }
+        stats.patches++;
+        stats.patch_bytes += size->second;
+        if (fetched_urls != nullptr) {
+          fetched_urls->insert(url);
+        }
+
+        if (candidate.entry->IsInvalidating()) {
+          // A table keyed patch replaces the patch maps, when several are
+          // listed they form a chain so the last one determines the result.
+          auto maps = table_keyed_maps_.find(url);
+          next = maps != table_keyed_maps_.end() ? &maps->second
+                                                 : &kNoPatchMaps;
+        }
+      }
+    }
+    current = next;
+  }
+
+  return stats;
+}
+
+StatusOr<ClientSimulator::Stats> ClientSimulator::SimulateAll(
+    Span<const SubsetDefinition> pages, uint32_t num_threads) const {
+  ThreadPool pool(num_threads);
+  absl::Mutex mutex;
+  Stats total;
+  TRYV(pool.ParallelFor(pages.size(), [&](size_t i) -> Status {
+    Stats stats = TRY(Simulate(pages[i]));
+    absl::MutexLock lock(&mutex);
+    total += stats;
+    return absl::OkStatus();
+  }));
+  return total;
+}
+
+}  // namespace ift::client
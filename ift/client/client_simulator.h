@@ -0,0 +1,104 @@
+#ifndef IFT_CLIENT_CLIENT_SIMULATOR_H_
+#define IFT_CLIENT_CLIENT_SIMULATOR_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "absl/container/btree_set.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "ift/encoder/compiler.h"
+#include "ift/encoder/subset_definition.h"
+#include "ift/proto/ift_table.h"
+
+namespace ift::client {
+
+/*
+ * An in process simulation of an IFT client extending a font produced by
+ * ift::encoder::Compiler, for evaluating the cost of an encoding over large
+ * numbers of page loads.
+ *
+ * Implements the patch selection portion of the client algorithm
+ * (https://w3c.github.io/IFT/Overview.html#extending-font-subset) against the
+ * parsed patch maps of the fonts in the encoding. Patches are never actually
+ * fetched or applied: the patch maps produced by table keyed patches and the
+ * size of every patch are taken from Compiler::Encoding::patch_metadata. Unlike
+ * fontations_client.h nothing is written to disk and no processes are
+ * spawned.
+ */
+class ClientSimulator {
+ public:
+  struct Stats {
+    // Number of page loads these stats cover.
+    uint64_t pages = 0;
+    // Bytes of the init font, counted once per page load.
+    uint64_t init_font_bytes = 0;
+    uint64_t patch_bytes = 0;
+    uint64_t patches = 0;
+    // Round trips needed to fetch patches, excluding loading the init font.
+    uint64_t round_trips = 0;
+
+    uint64_t TotalBytes() const { return init_font_bytes + patch_bytes; }
+
+    Stats& operator+=(const Stats& other) {
+      pages += other.pages;
+      init_font_bytes += other.init_font_bytes;
+      patch_bytes += other.patch_bytes;
+      patches += other.patches;
+      round_trips += other.round_trips;
+      return *this;
+    }
+  };
+
+  // Enables recording of the patch metadata that Create() needs, must be called
+  // on the compiler before it produces the encoding.
+  static void ConfigureCompiler(ift::encoder::Compiler& compiler);
+
+  // Parses the patch maps of encoding. The encoding must have been produced
+  // by Compiler::Compile() with a compiler set up by ConfigureCompiler(), its
+  // patches are not needed.
+  static absl::StatusOr<ClientSimulator> Create(
+      const ift::encoder::Compiler::Encoding& encoding);
+
+  // Simulates a client starting from the init font and extending it until
+  // target is covered, or max_round_trips have been made.
+  //
+  // If non null, fetched_urls will be populated with the urls of all patches
+  // the client fetched.
+  absl::StatusOr<Stats> Simulate(
+      const ift::encoder::SubsetDefinition& target,
+      absl::btree_set<std::string>* fetched_urls = nullptr,
+      uint32_t max_round_trips = UINT32_MAX) const;
+
+  // Simulates each page independently (each starting from the init font)
+  // using num_threads threads, and returns the totals over all pages.
+  absl::StatusOr<Stats> SimulateAll(
+      absl::Span<const ift::encoder::SubsetDefinition> pages,
+      uint32_t num_threads) const;
+
+ private:
+  // The patch maps of a font, either may be absent.
+  struct PatchMaps {
+    std::optional<ift::proto::IFTTable> ift;
+    std::optional<ift::proto::IFTTable> iftx;
+  };
+
+  static absl::StatusOr<PatchMaps> ParsePatchMaps(
+      absl::string_view ift_table, absl::string_view iftx_table);
+
+  ClientSimulator() = default;
+
+  uint32_t init_font_size_ = 0;
+  PatchMaps init_maps_;
+  // Keyed by url, the patch maps of the font produced by each table keyed
+  // patch.
+  absl::flat_hash_map<std::string, PatchMaps> table_keyed_maps_;
+  absl::flat_hash_map<std::string, uint32_t> patch_sizes_;
+};
+
+}  // namespace ift::client
+
+#endif  // IFT_CLIENT_CLIENT_SIMULATOR_H_
@@ -0,0 +1,251 @@
+#include "ift/client/client_simulator.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/btree_set.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "gtest/gtest.h"
+#include "hb.h"
+#include "ift/client/fontations_client.h"
+#include "ift/common/axis_range.h"
+#include "ift/common/font_data.h"
+#include "ift/common/int_set.h"
+#include "ift/common/test_font_loader.h"
+#include "ift/common/try.h"
+#include "ift/encoder/compiler.h"
+#include "ift/encoder/subset_definition.h"
+#include "ift/proto/patch_encoding.h"
+#include "ift/proto/patch_map.h"
+
+using absl::btree_set;
+using absl::flat_hash_map;
+using absl::Status;
+using absl::StatusOr;
+using ift::common::AxisRange;
+using ift::common::CodepointSet;
+using ift::common::FontData;
+using ift::common::GlyphSet;
+using ift::common::IntSet;
+using ift::encoder::Compiler;
+using ift::encoder::SubsetDefinition;
+using ift::proto::PatchEncoding;
+using ift::proto::PatchMap;
+
+namespace ift::client {
+
+class ClientSimulatorTest : public ::testing::Test {
+ protected:
+  ClientSimulatorTest() {
+    auto loader = ift::common::TestFontLoader::Default().value();
+    font =
+        loader->LoadFontData("ift/common/testdata/Roboto-Regular.abcd.ttf")
+            .value();
+  }
+
+  uint32_t Gid(uint32_t codepoint) {
+    auto face = font.face();
+    hb_font_t* hb_font = hb_font_create(face.get());
+    hb_codepoint_t gid = 0;
+    hb_font_get_nominal_glyph(hb_font, codepoint, &gid);
+    hb_font_destroy(hb_font);
+    return gid;
+  }
+
+  StatusOr<Compiler::Encoding> TableKeyed(bool jump_ahead) {
+    Compiler compiler;
+    ClientSimulator::ConfigureCompiler(compiler);
+    auto face = font.face();
+    compiler.SetFace(face.get());
+    TRYV(compiler.SetInitSubset(IntSet{'a'}));
+    compiler.AddNonGlyphDataSegment(IntSet{'b'});
+    compiler.AddNonGlyphDataSegment(IntSet{'c'});
+    compiler.AddNonGlyphDataSegment(IntSet{'d'});
+    if (jump_ahead) {
+      compiler.SetJumpAhead(2);
+    }
+    return compiler.Compile();
+  }
+
+  StatusOr<Compiler::Encoding> Mixed() {
+    Compiler compiler;
+    ClientSimulator::ConfigureCompiler(compiler);
+    auto face = font.face();
+    compiler.SetFace(face.get());
+    TRYV(compiler.AddGlyphDataPatch(1, GlyphSet{Gid('b')}));
+    TRYV(compiler.AddGlyphDataPatch(2, GlyphSet{Gid('c')}));
+    TRYV(compiler.AddGlyphDataPatch(3, GlyphSet{Gid('d')}));
+    TRYV(compiler.AddGlyphDataPatchCondition(
+        PatchMap::Entry({'b'}, 1, PatchEncoding::GLYPH_KEYED)));
+    TRYV(compiler.AddGlyphDataPatchCondition(
+        PatchMap::Entry({'c'}, 2, PatchEncoding::GLYPH_KEYED)));
+    TRYV(compiler.AddGlyphDataPatchCondition(
+        PatchMap::Entry({'d'}, 3, PatchEncoding::GLYPH_KEYED)));
+    TRYV(compiler.SetInitSubset(IntSet{'a'}));
+    compiler.AddNonGlyphDataSegment(IntSet{'b', 'c'});
+    compiler.AddNonGlyphDataSegment(IntSet{'d'});
+    return compiler.Compile();
+  }
+
+  // Checks that the simulator fetches the same patches as the fontations
+  // client for each target, and that the reported sizes are correct.
+  static void CheckMatchesFontations(
+      const Compiler::Encoding& encoding,
+      const std::vector<CodepointSet>& targets) {
+    auto simulator = ClientSimulator::Create(encoding);
+    ASSERT_TRUE(simulator.ok()) << simulator.status();
+
+    for (const CodepointSet& target : targets) {
+      btree_set<std::string> expected;
+      flat_hash_map<hb_tag_t, AxisRange> design_space;
+      auto extended = ExtendWithDesignSpace(encoding, target, {},
+                                            design_space, &expected);
+      ASSERT_TRUE(extended.ok()) << extended.status();
+
+      btree_set<std::string> actual;
+      auto stats =
+          simulator->Simulate(SubsetDefinition::Codepoints(target), &actual);
+      ASSERT_TRUE(stats.ok()) << stats.status();
+      ASSERT_EQ(actual, expected);
+
+      uint64_t expected_bytes = 0;
+      for (const auto& url : expected) {
+        expected_bytes += encoding.patches.at(url).size();
+      }
+      ASSERT_EQ(stats->pages, 1);
+      ASSERT_EQ(stats->init_font_bytes, encoding.init_font.size());
+      ASSERT_EQ(stats->patch_bytes, expected_bytes);
+      ASSERT_EQ(stats->patches, expected.size());
+    }
+  }
+
+  FontData font;
+};
+
+TEST_F(ClientSimulatorTest, TableKeyed) {
+  auto encoding = TableKeyed(false);
+  ASSERT_TRUE(encoding.ok()) << encoding.status();
+  CheckMatchesFontations(*encoding, {
+                                        {'a'},
+                                        {'b'},
+                                        {'b', 'c'},
+                                        {'b', 'c', 'd'},
+                                        {'z'},
+                                    });
+
+  auto simulator = ClientSimulator::Create(*encoding);
+  ASSERT_TRUE(simulator.ok()) << simulator.status();
+
+  // One table keyed patch per round trip.
+  auto stats = simulator->Simulate(SubsetDefinition{'b', 'c', 'd'});
+  ASSERT_TRUE(stats.ok()) << stats.status();
+  ASSERT_EQ(stats->round_trips, 3);
+  ASSERT_EQ(stats->patches, 3);
+
+  stats = simulator->Simulate(SubsetDefinition{'a'});
+  ASSERT_TRUE(stats.ok()) << stats.status();
+  ASSERT_EQ(stats->round_trips, 0);
+  ASSERT_EQ(stats->patch_bytes, 0);
+
+  stats = simulator->Simulate(SubsetDefinition{'b', 'c', 'd'}, nullptr, 1);
+  ASSERT_TRUE(stats.ok()) << stats.status();
+  ASSERT_EQ(stats->round_trips, 1);
+}
+
+TEST_F(ClientSimulatorTest, TableKeyed_JumpAhead) {
+  auto encoding = TableKeyed(true);
+  ASSERT_TRUE(encoding.ok()) << encoding.status();
+  CheckMatchesFontations(*encoding, {
+                                        {'b'},
+                                        {'b', 'c'},
+                                        {'b', 'c', 'd'},
+                                    });
+
+  auto simulator = ClientSimulator::Create(*encoding);
+  ASSERT_TRUE(simulator.ok()) << simulator.status();
+  auto stats = simulator->Simulate(SubsetDefinition{'b', 'c'});
+  ASSERT_TRUE(stats.ok()) << stats.status();
+  ASSERT_EQ(stats->round_trips, 1);
+}
+
+TEST_F(ClientSimulatorTest, Mixed) {
+  auto encoding = Mixed();
+  ASSERT_TRUE(encoding.ok()) << encoding.status();
+  CheckMatchesFontations(*encoding, {
+                                        {'a'},
+                                        {'b'},
+                                        {'c', 'd'},
+                                        {'b', 'c', 'd'},
+                                    });
+}
+
+TEST_F(ClientSimulatorTest, SimulateAll) {
+  auto encoding = Mixed();
+  ASSERT_TRUE(encoding.ok()) << encoding.status();
+  auto simulator = ClientSimulator::Create(*encoding);
+  ASSERT_TRUE(simulator.ok()) << simulator.status();
+
+  std::vector<SubsetDefinition> pages = {
+      {'a'}, {'b'}, {'c', 'd'}, {'b', 'c', 'd'}, {'b'}, {'d'},
+  };
+
+  ClientSimulator::Stats expected;
+  for (const auto& page : pages) {
+    auto stats = simulator->Simulate(page);
+    ASSERT_TRUE(stats.ok()) << stats.status();
+    expected += *stats;
+  }
+
+  for (uint32_t num_threads : {1, 4}) {
+    auto total = simulator->SimulateAll(pages, num_threads);
+    ASSERT_TRUE(total.ok()) << total.status();
+    ASSERT_EQ(total->pages, pages.size());
+    ASSERT_EQ(total->TotalBytes(), expected.TotalBytes());
+    ASSERT_EQ(total->patches, expected.patches);
+    ASSERT_EQ(total->round_trips, expected.round_trips);
+  }
+}
+
+TEST_F(ClientSimulatorTest, PatchMapsOnlyRecordedWhenConfigured) {
+  Compiler compiler;
+  auto face = font.face();
+  compiler.SetFace(face.get());
+  ASSERT_TRUE(compiler.SetInitSubset(IntSet{'a'}).ok());
+  compiler.AddNonGlyphDataSegment(IntSet{'b'});
+  compiler.AddNonGlyphDataSegment(IntSet{'c'});
+
+  auto encoding = compiler.Compile();
+  ASSERT_TRUE(encoding.ok()) << encoding.status();
+  ASSERT_FALSE(encoding->patch_metadata.empty());
+  for (const auto& [url, metadata] : encoding->patch_metadata) {
+    ASSERT_GT(metadata.size, 0) << url;
+    ASSERT_TRUE(metadata.ift_table.empty()) << url;
+    ASSERT_TRUE(metadata.iftx_table.empty()) << url;
+  }
+
+  ClientSimulator::ConfigureCompiler(compiler);
+  encoding = compiler.Compile();
+  ASSERT_TRUE(encoding.ok()) << encoding.status();
+  bool has_maps = false;
+  for (const auto& [url, metadata] : encoding->patch_metadata) {
+    has_maps = has_maps || !metadata.ift_table.empty();
+  }
+  ASSERT_TRUE(has_maps);
+}
+
+TEST_F(ClientSimulatorTest, MissingMetadata) {
+  auto encoding = TableKeyed(false);
+  ASSERT_TRUE(encoding.ok()) << encoding.status();
+  encoding->patch_metadata.clear();
+
+  auto simulator = ClientSimulator::Create(*encoding);
+  ASSERT_TRUE(simulator.ok()) << simulator.status();
+  auto stats = simulator->Simulate(SubsetDefinition{'b'});
+  ASSERT_TRUE(absl::IsNotFound(stats.status())) << stats.status();
+}
+
+}  // namespace ift::client
@@ -0,0 +1,168 @@
+#include "ift/common/fingerprint.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ift::common {
+
+static inline uint64_t Rotl64(uint64_t x, int8_t r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t Fmix64(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdull;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ull;
+  k ^= k >> 33;
+  return k;
+}
+
+static inline uint64_t LoadLE64(const uint8_t* p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; i--) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+static constexpr uint64_t kC1 = 0x87c37b91114253d5ull;
+static constexpr uint64_t kC2 = 0x4cf5ad432745937full;
+
+// MurmurHash3_x64_128 (public domain, Austin Appleby) with a zero seed. Blocks
+// are always read little endian so the result is platform independent.
+Fingerprint Fingerprint::Of(absl::string_view data) {
+  FingerprintHasher hasher;
+  hasher.Update(data);
+  return hasher.Finish();
+}
+
+void FingerprintHasher::ProcessBlock(const uint8_t* block) {
+  uint64_t k1 = LoadLE64(block);
+  uint64_t k2 = LoadLE64(block + 8);
+
+  k1 *= kC1;
+  k1 = Rotl64(k1, 31);
+  k1 *= kC2;
+  h1_ ^= k1;
+
+  h1_ = Rotl64(h1_, 27);
+  h1_ += h2_;
+  h1_ = h1_ * 5 + 0x52dce729;
+
+  k2 *= kC2;
+  k2 = Rotl64(k2, 33);
+  k2 *= kC1;
+  h2_ ^= k2;
+
+  h2_ = Rotl64(h2_, 31);
+  h2_ += h1_;
+  h2_ = h2_ * 5 + 0x38495ab5;
+}
+
+void FingerprintHasher::Update(absl::string_view data) {
+  if (data.empty()) {
+    return;
+  }
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+  size_t len = data.size();
+  length_ += len;
+
+  if (pending_size_) {
+    size_t n = std::min(len, sizeof(pending_) - pending_size_);
+    std::memcpy(pending_ + pending_size_, bytes, n);
+    pending_size_ += n;
+    bytes += n;
+    len -= n;
+    if (pending_size_ < sizeof(pending_)) {
+      return;
+    }
+    ProcessBlock(pending_);
+    pending_size_ = 0;
+  }
+
+  for (; len >= 16; bytes += 16, len -= 16) {
+    ProcessBlock(bytes);
+  }
+  std::memcpy(pending_, bytes, len);
+  pending_size_ = len;
+}
+
+Fingerprint FingerprintHasher::Finish() const {
+  uint64_t h1 = h1_;
+  uint64_t h2 = h2_;
+
+  const uint8_t* tail = pending_;
+  uint64_t k1 = 0;
+  uint64_t k2 = 0;
+  switch (pending_size_) {
+    case 15:
+      k2 ^= ((uint64_t)tail[14]) << 48;
+      [[fallthrough]];
+    case 14:
+      k2 ^= ((uint64_t)tail[13]) << 40;
+      [[fallthrough]];
+    case 13:
+      k2 ^= ((uint64_t)tail[12]) << 32;
+      [[fallthrough]];
+    case 12:
+      k2 ^= ((uint64_t)tail[11]) << 24;
+      [[fallthrough]];
+    case 11:
+      k2 ^= ((uint64_t)tail[10]) << 16;
+      [[fallthrough]];
+    case 10:
+      k2 ^= ((uint64_t)tail[9]) << 8;
+      [[fallthrough]];
+    case 9:
+      k2 ^= ((uint64_t)tail[8]);
+      k2 *= kC2;
+      k2 = Rotl64(k2, 33);
+      k2 *= kC1;
+      h2 ^= k2;
+      [[fallthrough]];
+    case 8:
+      k1 ^= ((uint64_t)tail[7]) << 56;
+      [[fallthrough]];
+    case 7:
+      k1 ^= ((uint64_t)tail[6]) << 48;
+      [[fallthrough]];
+    case 6:
+      k1 ^= ((uint64_t)tail[5]) << 40;
+      [[fallthrough]];
+    case 5:
+      k1 ^= ((uint64_t)tail[4]) << 32;
+      [[fallthrough]];
+    case 4:
+      k1 ^= ((uint64_t)tail[3]) << 24;
+      [[fallthrough]];
+    case 3:
+      k1 ^= ((uint64_t)tail[2]) << 16;
+      [[fallthrough]];
+    case 2:
+      k1 ^= ((uint64_t)tail[1]) << 8;
+      [[fallthrough]];
+    case 1:
+      k1 ^= ((uint64_t)tail[0]);
+      k1 *= kC1;
+      k1 = Rotl64(k1, 31);
+      k1 *= kC2;
+      h1 ^= k1;
+  }
+
+  h1 ^= length_;
+  h2 ^= length_;
+
+  h1 += h2;
+  h2 += h1;
+
+  h1 = Fmix64(h1);
+  h2 = Fmix64(h2);
+
+  h1 += h2;
+  h2 += h1;
+
+  return Fingerprint{.high = h2, .low = h1};
+}
+
+}  // namespace ift::common
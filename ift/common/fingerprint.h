@@ -0,0 +1,66 @@
+#ifndef COMMON_FINGERPRINT_H_
+#define COMMON_FINGERPRINT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "absl/strings/string_view.h"
+
+namespace ift::common {
+
+/*
+ * A 128 bit content fingerprint of a byte string.
+ *
+ * Used to key caches by content without retaining the content itself. The
+ * fingerprint is stable across runs and platforms (MurmurHash3 x64_128 with a
+ * zero seed) but is not a cryptographic hash.
+ */
+struct Fingerprint {
+  uint64_t high = 0;
+  uint64_t low = 0;
+
+  static Fingerprint Of(absl::string_view data);
+
+  bool operator==(const Fingerprint& other) const {
+    return high == other.high && low == other.low;
+  }
+
+  bool operator!=(const Fingerprint& other) const { return !(*this == other); }
+
+  bool operator<(const Fingerprint& other) const {
+    return std::pair(high, low) < std::pair(other.high, other.low);
+  }
+
+  template <typename H>
+  friend H AbslHashValue(H h, const Fingerprint& fingerprint) {
+    return H::combine(std::move(h), fingerprint.high, fingerprint.low);
+  }
+};
+
+/*
+ * Computes a Fingerprint incrementally, the result is the same as
+ * Fingerprint::Of() on the concatenation of everything passed to Update().
+ * Lets callers fingerprint structured data without first serializing it into
+ * a buffer.
+ */
+class FingerprintHasher {
+ public:
+  void Update(absl::string_view data);
+
+  Fingerprint Finish() const;
+
+ private:
+  void ProcessBlock(const uint8_t* block);
+
+  uint64_t h1_ = 0;
+  uint64_t h2_ = 0;
+  uint64_t length_ = 0;
+  // Bytes not yet forming a complete 16 byte block.
+  uint8_t pending_[16];
+  size_t pending_size_ = 0;
+};
+
+}  // namespace ift::common
+
+#endif  // COMMON_FINGERPRINT_H_
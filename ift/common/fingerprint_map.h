@@ -0,0 +1,113 @@
+#ifndef COMMON_FINGERPRINT_MAP_H_
+#define COMMON_FINGERPRINT_MAP_H_
+
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/log/log.h"
+#include "ift/common/fingerprint.h"
+
+namespace ift::common {
+
+/*
+ * In debug builds (NDEBUG not defined) holds a copy of the key an entry was
+ * stored under so that lookups by fingerprint can be checked against the
+ * full key. Empty in release builds.
+ */
+template <typename Key>
+class FingerprintKeyCheck {
+ public:
+  FingerprintKeyCheck() = default;
+
+  explicit FingerprintKeyCheck([[maybe_unused]] const Key& key)
+#ifndef NDEBUG
+      : key_(key)
+#endif
+  {
+  }
+
+  // Fails if this was created for a key which is not equal to key.
+  void Check([[maybe_unused]] const Key& key) const {
+#ifndef NDEBUG
+    if (key_.has_value() && !(*key_ == key)) {
+      LOG(FATAL) << "Fingerprint collision between two different keys.";
+    }
+#endif
+  }
+
+ private:
+#ifndef NDEBUG
+  std::optional<Key> key_;
+#endif
+};
+
+/*
+ * A hash map which is keyed by the fingerprint() of Key instead of by Key
+ * itself.
+ *
+ * Only the 128 bit fingerprint is stored per entry, so large keys (glyph
+ * sets, subset definitions) are neither copied into the map nor rehashed in
+ * full on every lookup. Key must provide "Fingerprint fingerprint() const".
+ *
+ * Two different keys with the same fingerprint would share an entry, the
+ * chance of which is negligible. In debug builds every lookup is checked
+ * against the full key (see FingerprintKeyCheck).
+ */
+template <typename Key, typename Value>
+class FingerprintMap {
+ public:
+  // Returns the value stored for key, or nullptr if there isn't one.
+  const Value* find(const Key& key) const {
+    return find(key.fingerprint(), key);
+  }
+
+  Value* find(const Key& key) {
+    return const_cast<Value*>(std::as_const(*this).find(key));
+  }
+
+  // As above, for callers that already have the fingerprint of key.
+  const Value* find(const Fingerprint& fingerprint, const Key& key) const {
+    auto it = entries_.find(fingerprint);
+    if (it == entries_.end()) {
+      return nullptr;
+    }
+    it->second.key.Check(key);
+    return &it->second.value;
+  }
+
+  // Stores value for key, replacing any existing value. Returns a reference
+  // to the stored value.
+  Value& insert_or_assign(const Key& key, Value value) {
+    return insert_or_assign(key.fingerprint(), key, std::move(value));
+  }
+
+  Value& insert_or_assign(const Fingerprint& fingerprint, const Key& key,
+                          Value value) {
+    Entry& entry = entries_[fingerprint];
+    entry.value = std::move(value);
+    entry.key = FingerprintKeyCheck<Key>(key);
+    return entry.value;
+  }
+
+  void erase(const Fingerprint& fingerprint) { entries_.erase(fingerprint); }
+
+  size_t size() const { return entries_.size(); }
+
+  bool empty() const { return entries_.empty(); }
+
+  void clear() { entries_.clear(); }
+
+ private:
+  struct Entry {
+    Value value;
+    [[no_unique_address]] FingerprintKeyCheck<Key> key;
+  };
+
+  absl::flat_hash_map<Fingerprint, Entry> entries_;
+};
+
+}  // namespace ift::common
+
+#endif  // COMMON_FINGERPRINT_MAP_H_
@@ -0,0 +1,111 @@
+#include "ift/common/fingerprint.h"
+
+#include <string>
+
+#include "absl/hash/hash_testing.h"
+#include "gtest/gtest.h"
+#include "ift/common/fingerprint_map.h"
+#include "ift/common/int_set.h"
+
+namespace ift::common {
+
+class FingerprintTest : public ::testing::Test {};
+
+TEST_F(FingerprintTest, KnownValues) {
+  // Reference values from MurmurHash3_x64_128 with seed 0.
+  ASSERT_EQ(Fingerprint::Of(""), (Fingerprint{.high = 0, .low = 0}));
+  ASSERT_EQ(Fingerprint::Of("hello"),
+            (Fingerprint{.high = 0x5b1e906a48ae1d19ull,
+                         .low = 0xcbd8a7b341bd9b02ull}));
+  ASSERT_EQ(Fingerprint::Of("The quick brown fox jumps over the lazy dog"),
+            (Fingerprint{.high = 0x7a433ca9c49a9347ull,
+                         .low = 0xe34bbc7bbc071b6cull}));
+}
+
+TEST_F(FingerprintTest, DistinguishesContent) {
+  std::string a(1000, 'a');
+  std::string b = a;
+  b[999] = 'b';
+  ASSERT_NE(Fingerprint::Of(a), Fingerprint::Of(b));
+  ASSERT_NE(Fingerprint::Of(a), Fingerprint::Of(a.substr(0, 999)));
+  ASSERT_EQ(Fingerprint::Of(a), Fingerprint::Of(std::string(1000, 'a')));
+
+  // Embedded nulls are part of the content.
+  ASSERT_NE(Fingerprint::Of(std::string("\0", 1)),
+            Fingerprint::Of(std::string("\0\0", 2)));
+}
+
+TEST_F(FingerprintTest, Hasher) {
+  std::string data = "The quick brown fox jumps over the lazy dog";
+  ASSERT_EQ(FingerprintHasher().Finish(), Fingerprint::Of(""));
+
+  // Any split of the input gives the same result as hashing it whole.
+  for (size_t a = 0; a <= data.size(); a++) {
+    for (size_t b = a; b <= data.size(); b++) {
+      FingerprintHasher hasher;
+      hasher.Update(data.substr(0, a));
+      hasher.Update("");
+      hasher.Update(data.substr(a, b - a));
+      hasher.Update(data.substr(b));
+      ASSERT_EQ(hasher.Finish(), Fingerprint::Of(data)) << a << ", " << b;
+    }
+  }
+}
+
+TEST_F(FingerprintTest, Hash) {
+  ASSERT_TRUE(absl::VerifyTypeImplementsAbslHashCorrectly({
+      Fingerprint::Of(""),
+      Fingerprint::Of("a"),
+      Fingerprint::Of("b"),
+      Fingerprint{.high = 1, .low = 2},
+      Fingerprint{.high = 2, .low = 1},
+  }));
+}
+
+// A key whose fingerprint can be chosen, to simulate collisions.
+struct FakeKey {
+  std::string value;
+  Fingerprint fake_fingerprint;
+
+  Fingerprint fingerprint() const { return fake_fingerprint; }
+  bool operator==(const FakeKey& other) const { return value == other.value; }
+};
+
+TEST_F(FingerprintTest, FingerprintMap) {
+  FingerprintMap<IntSet, int> map;
+  ASSERT_TRUE(map.empty());
+  ASSERT_EQ(map.find(IntSet{1, 2}), nullptr);
+
+  map.insert_or_assign(IntSet{1, 2}, 12);
+  map.insert_or_assign(IntSet{3}, 3);
+  ASSERT_EQ(map.size(), 2);
+
+  IntSet key{2};
+  key.insert(1);
+  ASSERT_NE(map.find(key), nullptr);
+  ASSERT_EQ(*map.find(key), 12);
+  ASSERT_EQ(map.find(IntSet{1}), nullptr);
+
+  map.insert_or_assign(key, 21);
+  ASSERT_EQ(*map.find(IntSet{1, 2}), 21);
+  ASSERT_EQ(map.size(), 2);
+
+  map.erase(key.fingerprint());
+  ASSERT_EQ(map.find(IntSet{1, 2}), nullptr);
+  ASSERT_EQ(*map.find(IntSet{3}), 3);
+
+  map.clear();
+  ASSERT_TRUE(map.empty());
+}
+
+#ifndef NDEBUG
+TEST_F(FingerprintTest, FingerprintMapDetectsCollisions) {
+  FingerprintMap<FakeKey, int> map;
+  Fingerprint f{.high = 1, .low = 2};
+  map.insert_or_assign(FakeKey{"a", f}, 1);
+  ASSERT_EQ(*map.find(FakeKey{"a", f}), 1);
+  ASSERT_DEATH(map.find(FakeKey{"b", f}), "Fingerprint collision");
+}
+#endif
+
+}  // namespace ift::common
@@ -0,0 +1,970 @@
+#include "ift/common/int_set.h"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+namespace ift::common {
+
+// Number of values fetched per hb_set_next_many() call when copying out of an
+// hb_set_t.
+static constexpr unsigned kHbBatchSize = 256;
+
+// Calls f on each value of set, in increasing order.
+template <typename F>
+static void ForEachHbValue(const hb_set_t* set, F f) {
+  hb_codepoint_t batch[kHbBatchSize];
+  hb_codepoint_t next = HB_SET_VALUE_INVALID;
+  unsigned count;
+  while ((count = hb_set_next_many(set, next, batch, kHbBatchSize)) > 0) {
+    for (unsigned i = 0; i < count; i++) {
+      f(batch[i]);
+    }
+    next = batch[count - 1];
+  }
+}
+
+template <typename F>
+static void ForEachValue(const IntSet& set, F f) {
+  for (hb_codepoint_t v : set) {
+    f(v);
+  }
+}
+
+template <typename F>
+static void ForEachValue(const hb_set_t* set, F f) {
+  ForEachHbValue(set, f);
+}
+
+static uint64_t Population(const IntSet& set) { return set.size(); }
+
+static uint64_t Population(const hb_set_t* set) {
+  return hb_set_get_population(set);
+}
+
+// Sets this large are most likely inverted (eg. GlyphSet::all()).
+static bool IsLikelyInverted(uint64_t population) {
+  return population > UINT32_MAX / 2;
+}
+
+IntSet& IntSet::operator=(const IntSet& other) {
+  if (this == &other) {
+    return *this;
+  }
+
+  clear();
+  switch (other.mode_) {
+    case Mode::INLINE:
+      std::copy(other.inline_, other.inline_ + other.size_, inline_);
+      size_ = other.size_;
+      break;
+    case Mode::BITMAP: {
+      if (other.size_ == 0) {
+        break;
+      }
+      // Don't carry over empty words at either end.
+      size_t first = 0;
+      while (!other.words_[first]) {
+        first++;
+      }
+      size_t last = other.words_.size() - 1;
+      while (!other.words_[last]) {
+        last--;
+      }
+      words_.assign(other.words_.begin() + first,
+                    other.words_.begin() + last + 1);
+      word_base_ = other.word_base_ + first;
+      size_ = other.size_;
+      mode_ = Mode::BITMAP;
+      break;
+    }
+    case Mode::HB:
+      hb_ = make_hb_set();
+      hb_set_set(hb_.get(), other.hb_.get());
+      mode_ = Mode::HB;
+      break;
+  }
+  fingerprint_ = other.fingerprint_;
+  return *this;
+}
+
+void IntSet::Swap(IntSet& other) {
+  std::swap(mode_, other.mode_);
+  std::swap(size_, other.size_);
+  std::swap(inline_, other.inline_);
+  std::swap(word_base_, other.word_base_);
+  words_.swap(other.words_);
+  hb_.swap(other.hb_);
+  std::swap(fingerprint_, other.fingerprint_);
+}
+
+void IntSet::AssignFromHbSet(const hb_set_t* set) {
+  clear();
+  unsigned population = hb_set_get_population(set);
+  if (population == 0) {
+    return;
+  }
+
+  if (population <= kInlineCapacity) {
+    size_ = hb_set_next_many(set, HB_SET_VALUE_INVALID, inline_,
+                             kInlineCapacity);
+    RefreshFingerprint();
+    return;
+  }
+
+  hb_codepoint_t first = hb_set_get_min(set);
+  hb_codepoint_t last = hb_set_get_max(set);
+  if (!FitsBitmap(first / 64, last / 64, population)) {
+    hb_ = make_hb_set();
+    hb_set_set(hb_.get(), set);
+    mode_ = Mode::HB;
+    RefreshFingerprint();
+    return;
+  }
+
+  mode_ = Mode::BITMAP;
+  word_base_ = first / 64;
+  words_.assign(last / 64 - word_base_ + 1, 0);
+  hb_codepoint_t batch[kHbBatchSize];
+  hb_codepoint_t next = HB_SET_VALUE_INVALID;
+  unsigned count;
+  while ((count = hb_set_next_many(set, next, batch, kHbBatchSize)) > 0) {
+    for (unsigned i = 0; i < count; i++) {
+      words_[batch[i] / 64 - word_base_] |= 1ull << (batch[i] % 64);
+    }
+    next = batch[count - 1];
+  }
+  size_ = population;
+  RefreshFingerprint();
+}
+
+bool IntSet::FitsBitmap(uint32_t first_word, uint32_t last_word,
+                        uint64_t population) {
+  uint64_t words = (uint64_t)last_word - first_word + 1;
+  return words <= kMaxBitmapWords &&
+         words <= std::max<uint64_t>(kMinBitmapWords,
+                                     kMaxWordsPerValue * population);
+}
+
+bool IntSet::SpanFitsBitmap() const {
+  auto first = min();
+  if (!first.has_value()) {
+    return true;
+  }
+  return *max() / 64 - *first / 64 + 1 <= kMaxBitmapWords;
+}
+
+void IntSet::Reserve(hb_codepoint_t first, hb_codepoint_t last,
+                     uint64_t population) {
+  if (mode_ == Mode::HB) {
+    return;
+  }
+
+  uint32_t first_word = first / 64;
+  uint32_t last_word = last / 64;
+  if (mode_ == Mode::BITMAP) {
+    if (first_word >= word_base_ && last_word < word_base_ + words_.size()) {
+      // Already covered.
+      return;
+    }
+    first_word = std::min(first_word, word_base_);
+    last_word =
+        std::max(last_word, (uint32_t)(word_base_ + words_.size() - 1));
+  } else {
+    if (population <= kInlineCapacity) {
+      return;
+    }
+    if (size_ > 0) {
+      first_word = std::min(first_word, inline_[0] / 64);
+      last_word = std::max(last_word, inline_[size_ - 1] / 64);
+    }
+  }
+
+  if (!FitsBitmap(first_word, last_word, population)) {
+    ToHbSet();
+    return;
+  }
+  ToBitmap(first_word, last_word);
+}
+
+void IntSet::ToBitmap(uint32_t first_word, uint32_t last_word) {
+  if (mode_ == Mode::BITMAP) {
+    if (first_word < word_base_) {
+      words_.insert(words_.begin(), word_base_ - first_word, 0);
+      word_base_ = first_word;
+    }
+    if (last_word - word_base_ + 1 > words_.size()) {
+      words_.resize(last_word - word_base_ + 1, 0);
+    }
+    return;
+  }
+
+  // From INLINE.
+  words_.assign(last_word - first_word + 1, 0);
+  word_base_ = first_word;
+  for (uint32_t i = 0; i < size_; i++) {
+    words_[inline_[i] / 64 - word_base_] |= 1ull << (inline_[i] % 64);
+  }
+  mode_ = Mode::BITMAP;
+}
+
+void IntSet::ToHbSet() {
+  if (mode_ == Mode::HB) {
+    return;
+  }
+
+  auto values = to_vector();
+  hb_ = make_hb_set();
+  hb_set_add_sorted_array(hb_.get(), values.data(), values.size());
+  words_.clear();
+  word_base_ = 0;
+  size_ = 0;
+  mode_ = Mode::HB;
+}
+
+void IntSet::Compact() {
+  if (mode_ != Mode::BITMAP || size_ > kInlineCapacity) {
+    return;
+  }
+
+  hb_codepoint_t values[kInlineCapacity];
+  uint32_t count = 0;
+  hb_codepoint_t v = HB_SET_VALUE_INVALID;
+  while (NextValue(&v)) {
+    values[count++] = v;
+  }
+  Fingerprint fingerprint = fingerprint_;
+  clear();
+  std::copy(values, values + count, inline_);
+  size_ = count;
+  fingerprint_ = fingerprint;
+}
+
+template <typename F>
+void IntSet::RetainIf(F keep) {
+  if (mode_ == Mode::INLINE) {
+    uint32_t out = 0;
+    for (uint32_t i = 0; i < size_; i++) {
+      if (keep(inline_[i])) {
+        inline_[out++] = inline_[i];
+      } else {
+        RemoveFromFingerprint(inline_[i]);
+      }
+    }
+    size_ = out;
+    return;
+  }
+
+  for (size_t i = 0; i < words_.size(); i++) {
+    uint64_t bits = words_[i];
+    while (bits) {
+      int bit = std::countr_zero(bits);
+      bits &= bits - 1;
+      hb_codepoint_t value = (word_base_ + i) * 64 + bit;
+      if (!keep(value)) {
+        words_[i] &= ~(1ull << bit);
+        size_--;
+        RemoveFromFingerprint(value);
+      }
+    }
+  }
+}
+
+IntSet::WordOverlap IntSet::OverlapWith(const IntSet& other) const {
+  uint64_t start = std::max(word_base_, other.word_base_);
+  uint64_t end = std::min<uint64_t>(word_base_ + words_.size(),
+                                    other.word_base_ + other.words_.size());
+  if (end <= start) {
+    return WordOverlap{0, 0, 0};
+  }
+  return WordOverlap{start - word_base_, start - other.word_base_,
+                     end - start};
+}
+
+bool IntSet::HasBitsOutside(size_t start, size_t length) const {
+  for (size_t i = 0; i < start; i++) {
+    if (words_[i]) {
+      return true;
+    }
+  }
+  for (size_t i = start + length; i < words_.size(); i++) {
+    if (words_[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void IntSet::SetWord(size_t i, uint64_t word) {
+  uint64_t old_word = words_[i];
+  uint64_t changed = old_word ^ word;
+  if (!changed) {
+    return;
+  }
+  words_[i] = word;
+
+  hb_codepoint_t base = (word_base_ + i) * 64;
+  uint64_t added = changed & word;
+  uint64_t removed = changed & old_word;
+  size_ += std::popcount(added);
+  size_ -= std::popcount(removed);
+  while (added) {
+    AddToFingerprint(base + std::countr_zero(added));
+    added &= added - 1;
+  }
+  while (removed) {
+    RemoveFromFingerprint(base + std::countr_zero(removed));
+    removed &= removed - 1;
+  }
+}
+
+template <typename Values, typename InResult, typename Op>
+void IntSet::UpdateHb(const Values& values, InResult in_result, Op op) {
+  uint64_t population = Population(values);
+  bool was_inverted = IsLikelyInverted(hb_set_get_population(hb_.get()));
+  if (IsLikelyInverted(population)) {
+    // Too many values to visit.
+    op();
+    RefreshFingerprint();
+    return;
+  }
+
+  ForEachValue(values, [&](hb_codepoint_t v) {
+    bool was_present = hb_set_has(hb_.get(), v);
+    bool present = in_result(v, was_present);
+    if (present && !was_present) {
+      AddToFingerprint(v);
+    } else if (!present && was_present) {
+      RemoveFromFingerprint(v);
+    }
+  });
+  op();
+
+  if (IsLikelyInverted(hb_set_get_population(hb_.get())) != was_inverted) {
+    // Inverted sets are fingerprinted by their complement.
+    RefreshFingerprint();
+  }
+}
+
+Fingerprint IntSet::ComputeFingerprint() const {
+  Fingerprint result;
+  auto add = [&result](hb_codepoint_t value) {
+    Fingerprint f = ValueFingerprint(value);
+    result.high += f.high;
+    result.low += f.low;
+  };
+
+  switch (mode_) {
+    case Mode::INLINE:
+      for (uint32_t i = 0; i < size_; i++) {
+        add(inline_[i]);
+      }
+      return result;
+    case Mode::BITMAP:
+      for (size_t i = 0; i < words_.size(); i++) {
+        uint64_t bits = words_[i];
+        while (bits) {
+          add((word_base_ + i) * 64 + std::countr_zero(bits));
+          bits &= bits - 1;
+        }
+      }
+      return result;
+    case Mode::HB:
+      break;
+  }
+
+  const hb_set_t* values = hb_.get();
+  hb_set_unique_ptr complement = hb_set_unique_ptr(nullptr, &hb_set_destroy);
+  bool inverted = IsLikelyInverted(hb_set_get_population(values));
+  if (inverted) {
+    // It's much cheaper to visit the values which are not in the set.
+    complement = make_hb_set();
+    hb_set_set(complement.get(), values);
+    hb_set_invert(complement.get());
+    values = complement.get();
+  }
+
+  ForEachHbValue(values, add);
+
+  if (inverted) {
+    // Keep these distinct from the fingerprint of the complement itself.
+    result.high = ~result.high;
+    result.low = ~result.low;
+  }
+  return result;
+}
+
+bool IntSet::NextValue(hb_codepoint_t* value) const {
+  switch (mode_) {
+    case Mode::INLINE:
+      for (uint32_t i = 0; i < size_; i++) {
+        if (*value == HB_SET_VALUE_INVALID || inline_[i] > *value) {
+          *value = inline_[i];
+          return true;
+        }
+      }
+      break;
+    case Mode::BITMAP: {
+      uint64_t start =
+          *value == HB_SET_VALUE_INVALID ? 0 : (uint64_t)*value + 1;
+      start = std::max<uint64_t>(start, (uint64_t)word_base_ * 64);
+      size_t i = start / 64 - word_base_;
+      if (i >= words_.size()) {
+        break;
+      }
+      uint64_t bits = words_[i] & (~0ull << (start % 64));
+      while (true) {
+        if (bits) {
+          *value = (word_base_ + i) * 64 + std::countr_zero(bits);
+          return true;
+        }
+        if (++i >= words_.size()) {
+          break;
+        }
+        bits = words_[i];
+      }
+      break;
+    }
+    case Mode::HB:
+      return hb_set_next(hb_.get(), value);
+  }
+
+  *value = HB_SET_VALUE_INVALID;
+  return false;
+}
+
+bool IntSet::PreviousValue(hb_codepoint_t* value) const {
+  switch (mode_) {
+    case Mode::INLINE:
+      for (uint32_t i = size_; i > 0; i--) {
+        if (*value == HB_SET_VALUE_INVALID || inline_[i - 1] < *value) {
+          *value = inline_[i - 1];
+          return true;
+        }
+      }
+      break;
+    case Mode::BITMAP: {
+      if (*value == 0 || (*value != HB_SET_VALUE_INVALID &&
+                          *value - 1 < (uint64_t)word_base_ * 64)) {
+        break;
+      }
+      size_t i = words_.size() - 1;
+      uint64_t bits = words_[i];
+      if (*value != HB_SET_VALUE_INVALID) {
+        hb_codepoint_t target = *value - 1;
+        if (target / 64 - word_base_ < words_.size()) {
+          i = target / 64 - word_base_;
+          uint32_t bit = target % 64;
+          bits = words_[i] & (bit == 63 ? ~0ull : (1ull << (bit + 1)) - 1);
+        }
+      }
+      while (true) {
+        if (bits) {
+          *value = (word_base_ + i) * 64 + 63 - std::countl_zero(bits);
+          return true;
+        }
+        if (i-- == 0) {
+          break;
+        }
+        bits = words_[i];
+      }
+      break;
+    }
+    case Mode::HB:
+      return hb_set_previous(hb_.get(), value);
+  }
+
+  *value = HB_SET_VALUE_INVALID;
+  return false;
+}
+
+void IntSet::InsertSlow(hb_codepoint_t codepoint) {
+  if (mode_ == Mode::INLINE) {
+    uint32_t i = 0;
+    while (i < size_ && inline_[i] < codepoint) {
+      i++;
+    }
+    if (i < size_ && inline_[i] == codepoint) {
+      return;
+    }
+    if (size_ < kInlineCapacity) {
+      std::copy_backward(inline_ + i, inline_ + size_, inline_ + size_ + 1);
+      inline_[i] = codepoint;
+      size_++;
+      AddToFingerprint(codepoint);
+      return;
+    }
+  }
+
+  Reserve(codepoint, codepoint, (uint64_t)size() + 1);
+  if (mode_ == Mode::HB) {
+    if (!hb_set_has(hb_.get(), codepoint)) {
+      AddToFingerprint(codepoint);
+    }
+    hb_set_add(hb_.get(), codepoint);
+    return;
+  }
+  // Now covered by the bitmap.
+  insert(codepoint);
+}
+
+void IntSet::insert_range(hb_codepoint_t start, hb_codepoint_t end) {
+  if (start > end) {
+    return;
+  }
+
+  Reserve(start, end, (uint64_t)size() + (end - start) + 1);
+  switch (mode_) {
+    case Mode::INLINE:
+      for (uint64_t v = start; v <= end; v++) {
+        InsertSlow(v);
+      }
+      return;
+    case Mode::BITMAP:
+      for (uint32_t w = start / 64; w <= end / 64; w++) {
+        uint64_t mask = ~0ull;
+        if (w == start / 64) {
+          mask &= ~0ull << (start % 64);
+        }
+        if (w == end / 64 && end % 64 != 63) {
+          mask &= (1ull << (end % 64 + 1)) - 1;
+        }
+        SetWord(w - word_base_, words_[w - word_base_] | mask);
+      }
+      return;
+    case Mode::HB:
+      hb_set_add_range(hb_.get(), start, end);
+      RefreshFingerprint();
+      return;
+  }
+}
+
+void IntSet::insert_sorted_array(
+    absl::Span<const hb_codepoint_t> sorted_values) {
+  if (sorted_values.empty()) {
+    return;
+  }
+
+  Reserve(sorted_values.front(), sorted_values.back(),
+          (uint64_t)size() + sorted_values.size());
+  if (mode_ == Mode::HB) {
+    hb_set_add_sorted_array(hb_.get(), sorted_values.data(),
+                            sorted_values.size());
+    RefreshFingerprint();
+    return;
+  }
+  for (hb_codepoint_t v : sorted_values) {
+    insert(v);
+  }
+}
+
+std::vector<hb_codepoint_t> IntSet::to_vector() const {
+  std::vector<hb_codepoint_t> values;
+  switch (mode_) {
+    case Mode::INLINE:
+      values.assign(inline_, inline_ + size_);
+      break;
+    case Mode::BITMAP:
+      values.reserve(size_);
+      for (size_t i = 0; i < words_.size(); i++) {
+        uint64_t bits = words_[i];
+        while (bits) {
+          values.push_back((word_base_ + i) * 64 + std::countr_zero(bits));
+          bits &= bits - 1;
+        }
+      }
+      break;
+    case Mode::HB: {
+      auto size = this->size();
+      values.resize(size);
+      hb_set_next_many(hb_.get(), HB_SET_VALUE_INVALID, values.data(), size);
+      break;
+    }
+  }
+  return values;
+}
+
+std::optional<hb_codepoint_t> IntSet::min() const {
+  hb_codepoint_t value = HB_SET_VALUE_INVALID;
+  if (mode_ == Mode::HB) {
+    value = hb_set_get_min(hb_.get());
+  } else {
+    NextValue(&value);
+  }
+  if (value == HB_SET_VALUE_INVALID) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+std::optional<hb_codepoint_t> IntSet::max() const {
+  hb_codepoint_t value = HB_SET_VALUE_INVALID;
+  if (mode_ == Mode::HB) {
+    value = hb_set_get_max(hb_.get());
+  } else {
+    PreviousValue(&value);
+  }
+  if (value == HB_SET_VALUE_INVALID) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+size_t IntSet::erase(hb_codepoint_t codepoint) {
+  if (!contains(codepoint)) {
+    return 0;
+  }
+
+  switch (mode_) {
+    case Mode::INLINE: {
+      auto* it = std::find(inline_, inline_ + size_, codepoint);
+      std::copy(it + 1, inline_ + size_, it);
+      size_--;
+      break;
+    }
+    case Mode::BITMAP:
+      words_[codepoint / 64 - word_base_] &= ~(1ull << (codepoint % 64));
+      size_--;
+      break;
+    case Mode::HB:
+      hb_set_del(hb_.get(), codepoint);
+      break;
+  }
+  RemoveFromFingerprint(codepoint);
+  return 1;
+}
+
+bool IntSet::operator==(const IntSet& other) const {
+  if (this == &other) {
+    return true;
+  }
+
+  if (mode_ == Mode::HB && other.mode_ == Mode::HB) {
+    return hb_set_is_equal(hb_.get(), other.hb_.get());
+  }
+
+  if (size() != other.size()) {
+    return false;
+  }
+
+  if (mode_ == Mode::BITMAP && other.mode_ == Mode::BITMAP) {
+    WordOverlap overlap = OverlapWith(other);
+    if (HasBitsOutside(overlap.this_start, overlap.length) ||
+        other.HasBitsOutside(overlap.other_start, overlap.length)) {
+      return false;
+    }
+    const uint64_t* a = words_.data() + overlap.this_start;
+    const uint64_t* b = other.words_.data() + overlap.other_start;
+    return std::equal(a, a + overlap.length, b);
+  }
+
+  auto a = begin();
+  auto b = other.begin();
+  while (a != end()) {
+    if (*a != *b) {
+      return false;
+    }
+    ++a;
+    ++b;
+  }
+  return true;
+}
+
+bool IntSet::is_subset_of(const IntSet& other) const {
+  if (mode_ == Mode::HB && other.mode_ == Mode::HB) {
+    return hb_set_is_subset(hb_.get(), other.hb_.get());
+  }
+
+  if (size() > other.size()) {
+    return false;
+  }
+
+  if (mode_ == Mode::BITMAP && other.mode_ == Mode::BITMAP) {
+    WordOverlap overlap = OverlapWith(other);
+    if (HasBitsOutside(overlap.this_start, overlap.length)) {
+      return false;
+    }
+    const uint64_t* a = words_.data() + overlap.this_start;
+    const uint64_t* b = other.words_.data() + overlap.other_start;
+    uint64_t extra = 0;
+    for (size_t i = 0; i < overlap.length; i++) {
+      extra |= a[i] & ~b[i];
+    }
+    return !extra;
+  }
+
+  for (hb_codepoint_t v : *this) {
+    if (!other.contains(v)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool IntSet::is_subset_of(const hb_set_t* small, const IntSet& large) {
+  if (large.mode_ == Mode::HB) {
+    return hb_set_is_subset(small, large.hb_.get());
+  }
+
+  if (hb_set_get_population(small) > large.size()) {
+    return false;
+  }
+  hb_codepoint_t value = HB_SET_VALUE_INVALID;
+  while (hb_set_next(small, &value)) {
+    if (!large.contains(value)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool IntSet::intersects(const hb_set_t* other) const {
+  if (mode_ == Mode::HB) {
+    return intersects(hb_.get(), other);
+  }
+
+  if (hb_set_get_population(other) < size()) {
+    hb_codepoint_t value = HB_SET_VALUE_INVALID;
+    while (hb_set_next(other, &value)) {
+      if (contains(value)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  for (hb_codepoint_t v : *this) {
+    if (hb_set_has(other, v)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool IntSet::intersects(const IntSet& other) const {
+  if (mode_ == Mode::HB && other.mode_ == Mode::HB) {
+    return intersects(hb_.get(), other.hb_.get());
+  }
+
+  if (mode_ == Mode::BITMAP && other.mode_ == Mode::BITMAP) {
+    WordOverlap overlap = OverlapWith(other);
+    const uint64_t* a = words_.data() + overlap.this_start;
+    const uint64_t* b = other.words_.data() + overlap.other_start;
+    uint64_t common = 0;
+    for (size_t i = 0; i < overlap.length; i++) {
+      common |= a[i] & b[i];
+    }
+    return common;
+  }
+
+  const IntSet& smaller = size() <= other.size() ? *this : other;
+  const IntSet& larger = size() <= other.size() ? other : *this;
+  for (hb_codepoint_t v : smaller) {
+    if (larger.contains(v)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void IntSet::union_set(const IntSet& other) {
+  if (this == &other || other.empty()) {
+    return;
+  }
+
+  Reserve(*other.min(), *other.max(), (uint64_t)size() + other.size());
+  switch (mode_) {
+    case Mode::INLINE:
+      for (hb_codepoint_t v : other) {
+        insert(v);
+      }
+      return;
+    case Mode::BITMAP:
+      if (other.mode_ == Mode::BITMAP) {
+        // other's non-empty words are all within our range after Reserve().
+        WordOverlap overlap = OverlapWith(other);
+        const uint64_t* a = words_.data() + overlap.this_start;
+        const uint64_t* b = other.words_.data() + overlap.other_start;
+        for (size_t i = 0; i < overlap.length; i++) {
+          SetWord(overlap.this_start + i, a[i] | b[i]);
+        }
+        return;
+      }
+      for (hb_codepoint_t v : other) {
+        insert(v);
+      }
+      return;
+    case Mode::HB:
+      UpdateHb(
+          other, [](hb_codepoint_t, bool) { return true; },
+          [&] { other.union_into(hb_.get()); });
+      return;
+  }
+}
+
+void IntSet::union_into(hb_set_t* other) const {
+  switch (mode_) {
+    case Mode::INLINE:
+      hb_set_add_sorted_array(other, inline_, size_);
+      return;
+    case Mode::BITMAP: {
+      auto values = to_vector();
+      hb_set_add_sorted_array(other, values.data(), values.size());
+      return;
+    }
+    case Mode::HB:
+      hb_set_union(other, hb_.get());
+      return;
+  }
+}
+
+void IntSet::union_from(hb_set_t* other) {
+  if (hb_set_is_empty(other)) {
+    return;
+  }
+
+  Reserve(hb_set_get_min(other), hb_set_get_max(other),
+          (uint64_t)size() + hb_set_get_population(other));
+  if (mode_ == Mode::HB) {
+    UpdateHb(
+        other, [](hb_codepoint_t, bool) { return true; },
+        [&] { hb_set_union(hb_.get(), other); });
+    return;
+  }
+
+  ForEachHbValue(other, [this](hb_codepoint_t v) { insert(v); });
+}
+
+void IntSet::intersect(const IntSet& other) {
+  if (this == &other) {
+    return;
+  }
+
+  if (mode_ == Mode::HB && other.mode_ == Mode::HB) {
+    // Only values currently in this set can be removed.
+    UpdateHb(
+        *this,
+        [&other](hb_codepoint_t v, bool) {
+          return hb_set_has(other.hb_.get(), v);
+        },
+        [&] { hb_set_intersect(hb_.get(), other.hb_.get()); });
+    return;
+  }
+
+  if (mode_ == Mode::HB ||
+      (other.mode_ == Mode::INLINE && mode_ != Mode::INLINE)) {
+    // The result is a subset of other, which is the more compact of the two.
+    IntSet result(other);
+    result.RetainIf([this](hb_codepoint_t v) { return contains(v); });
+    *this = std::move(result);
+    return;
+  }
+
+  if (mode_ == Mode::BITMAP && other.mode_ == Mode::BITMAP) {
+    WordOverlap overlap = OverlapWith(other);
+    for (size_t i = 0; i < overlap.this_start; i++) {
+      SetWord(i, 0);
+    }
+    for (size_t i = overlap.this_start + overlap.length; i < words_.size();
+         i++) {
+      SetWord(i, 0);
+    }
+    const uint64_t* a = words_.data() + overlap.this_start;
+    const uint64_t* b = other.words_.data() + overlap.other_start;
+    for (size_t i = 0; i < overlap.length; i++) {
+      SetWord(overlap.this_start + i, a[i] & b[i]);
+    }
+    Compact();
+    return;
+  }
+
+  RetainIf([&other](hb_codepoint_t v) { return other.contains(v); });
+  Compact();
+}
+
+void IntSet::subtract(const IntSet& other) {
+  if (this == &other) {
+    clear();
+    return;
+  }
+
+  if (empty() || other.empty()) {
+    return;
+  }
+
+  if (mode_ == Mode::HB) {
+    UpdateHb(
+        other, [](hb_codepoint_t, bool) { return false; },
+        [&] {
+          if (other.mode_ == Mode::HB) {
+            hb_set_subtract(hb_.get(), other.hb_.get());
+          } else {
+            for (hb_codepoint_t v : other) {
+              hb_set_del(hb_.get(), v);
+            }
+          }
+        });
+    return;
+  }
+
+  if (mode_ == Mode::BITMAP && other.mode_ == Mode::BITMAP) {
+    WordOverlap overlap = OverlapWith(other);
+    const uint64_t* a = words_.data() + overlap.this_start;
+    const uint64_t* b = other.words_.data() + overlap.other_start;
+    for (size_t i = 0; i < overlap.length; i++) {
+      SetWord(overlap.this_start + i, a[i] & ~b[i]);
+    }
+    Compact();
+    return;
+  }
+
+  if (other.mode_ == Mode::INLINE) {
+    for (hb_codepoint_t v : other) {
+      erase(v);
+    }
+  } else {
+    RetainIf([&other](hb_codepoint_t v) { return !other.contains(v); });
+  }
+  Compact();
+}
+
+void IntSet::symmetric_difference(const IntSet& other) {
+  if (this == &other) {
+    clear();
+    return;
+  }
+
+  if (other.empty()) {
+    return;
+  }
+
+  if (other.mode_ == Mode::HB) {
+    ToHbSet();
+    UpdateHb(
+        other, [](hb_codepoint_t, bool was_present) { return !was_present; },
+        [&] { hb_set_symmetric_difference(hb_.get(), other.hb_.get()); });
+    return;
+  }
+
+  Reserve(*other.min(), *other.max(), (uint64_t)size() + other.size());
+  if (mode_ == Mode::BITMAP && other.mode_ == Mode::BITMAP) {
+    // other's non-empty words are all within our range after Reserve().
+    WordOverlap overlap = OverlapWith(other);
+    const uint64_t* a = words_.data() + overlap.this_start;
+    const uint64_t* b = other.words_.data() + overlap.other_start;
+    for (size_t i = 0; i < overlap.length; i++) {
+      SetWord(overlap.this_start + i, a[i] ^ b[i]);
+    }
+    Compact();
+    return;
+  }
+
+  for (hb_codepoint_t v : other) {
+    if (!erase(v)) {
+      insert(v);
+    }
+  }
+  Compact();
+}
+
+}  // namespace ift::common
@@ -2,11 +2,13 @@
 #define COMMON_INT_SET
 
 #include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <sstream>
 #include <vector>
 
 #include "absl/types/span.h"
+#include "ift/common/fingerprint.h"
 #include "ift/common/hb_set_unique_ptr.h"
 namespace ift::common {
 
@@ -24,10 +26,10 @@ class IntSetIterator {
  private:
   friend class IntSet;
 
-  const hb_set_t* set_ = nullptr;  // nullptr signals we are at the end.
+  const IntSet* set_ = nullptr;  // nullptr signals we are at the end.
   hb_codepoint_t current_codepoint_ = HB_SET_VALUE_INVALID;
 
-  IntSetIterator(const hb_set_t* set,
+  IntSetIterator(const IntSet* set,
                  hb_codepoint_t current_codepoint = HB_SET_VALUE_INVALID)
       : set_(set), current_codepoint_(current_codepoint) {
     // c++ iterators start on the first element, so advance the iterator one
@@ -40,17 +42,7 @@ class IntSetIterator {
 
   reference operator*() const { return current_codepoint_; }
 
-  IntSetIterator& operator++() {
-    if (set_) {
-      if (!(!reverse ? hb_set_next(set_, &current_codepoint_)
-                     : hb_set_previous(set_, &current_codepoint_))) {
-        // Reached the end
-        set_ = nullptr;
-        current_codepoint_ = HB_CODEPOINT_INVALID;
-      }
-    }
-    return *this;
-  }
+  IntSetIterator& operator++();
 
   IntSetIterator operator++(int) {
     IntSetIterator temp = *this;
@@ -68,10 +60,27 @@ class IntSetIterator {
 };
 
 /**
- * Wrapper around a harfbuzz hb_set_t*.
+ * A set of unsigned integers.
+ *
+ * Acts like a typical c++ container class and provides hashing/comparison
+ * needed to store the set inside of other container types.
+ *
+ * One of three representations is used depending on the contents:
+ * - Small sets (up to kInlineCapacity values) are stored inline as a sorted
+ *   array, so creating and copying them never allocates.
+ * - Sets whose values span a limited range (for example glyph ids) are stored
+ *   as a flat bitmap of 64 bit words. Operations between two bitmaps are
+ *   simple loops over the words which the compiler vectorizes.
+ * - Everything else (sparse sets over a large range, inverted sets) is stored
+ *   in a harfbuzz hb_set_t.
  *
- * Makes it act like a more typical c++ container class and provides
- * hashing/comparison needed to store the set inside of other container types.
+ * The representation only affects performance: equality, ordering, and
+ * hashing depend on the contents alone. Conversion to and from hb_set_t is
+ * only done where harfbuzz needs one.
+ *
+ * A 128 bit fingerprint of the contents (see fingerprint()) is kept up to
+ * date by every modification, so sets can be used to key large caches without
+ * copying them into the cache.
  */
 class IntSet {
  public:
@@ -81,50 +90,38 @@ class IntSet {
   using const_iterator = IntSetIterator<false>;
   using const_rev_iterator = IntSetIterator<true>;
 
-  IntSet() : set_(make_hb_set()) {}
+  // Maximum number of values stored inline.
+  static constexpr uint32_t kInlineCapacity = 8;
+
+  IntSet() = default;
 
-  IntSet(std::initializer_list<hb_codepoint_t> values) : set_(make_hb_set()) {
+  IntSet(std::initializer_list<hb_codepoint_t> values) {
     for (auto v : values) {
       this->insert(v);
     }
   }
 
-  explicit IntSet(const hb_set_t* set) : set_(make_hb_set()) {
-    // We always keep exclusive ownership of the internal set, so copy the
-    // contents of the input set instead of referencing it.
-    hb_set_set(set_.get(), set);
-  }
+  // The contents of set are copied, no reference to it is kept.
+  explicit IntSet(const hb_set_t* set) { AssignFromHbSet(set); }
 
-  explicit IntSet(const hb_set_unique_ptr& set) : set_(make_hb_set()) {
-    // We always keep exclusive ownership of the internal set, so copy the
-    // contents of the input set instead of referencing it.
-    hb_set_union(set_.get(), set.get());
-  }
+  explicit IntSet(const hb_set_unique_ptr& set) { AssignFromHbSet(set.get()); }
 
-  IntSet(const IntSet& other) : set_(make_hb_set()) {
-    hb_set_union(set_.get(), other.set_.get());
-  }
+  IntSet(const IntSet& other) { *this = other; }
 
-  IntSet& operator=(const IntSet& other) {
-    hb_set_clear(set_.get());
-    hb_set_union(set_.get(), other.set_.get());
-    return *this;
-  }
+  IntSet& operator=(const IntSet& other);
 
-  IntSet(IntSet&& other) noexcept : set_(make_hb_set()) {
-    // swap pointers so that the moved set is still in a valid state.
-    this->set_.swap(other.set_);
+  IntSet(IntSet&& other) noexcept {
+    // swap so that the moved set is still in a valid state.
+    Swap(other);
   }
 
   IntSet& operator=(IntSet&& other) noexcept {
-    // swap pointers so that the moved set is still in a valid state.
-    this->set_.swap(other.set_);
+    // swap so that the moved set is still in a valid state.
+    Swap(other);
     return *this;
   }
 
-  bool operator==(const IntSet& other) const {
-    return hb_set_is_equal(this->set_.get(), other.set_.get());
-  }
+  bool operator==(const IntSet& other) const;
 
   bool operator!=(const IntSet& other) const { return !(*this == other); }
 
@@ -154,17 +151,58 @@ class IntSet {
 
   template <typename H>
   friend H AbslHashValue(H h, const IntSet& set) {
-    // Utilize the existing harfbuzz hashing function.
-    unsigned harfbuzz_hash = hb_set_hash(set.set_.get());
-    return H::combine(std::move(h), harfbuzz_hash);
+    // Must only depend on the contents, so every representation of the same
+    // contents follows the same path here.
+    size_t size = set.size();
+    if (size <= kInlineCapacity) {
+      hb_codepoint_t values[kInlineCapacity];
+      size_t i = 0;
+      for (hb_codepoint_t v : set) {
+        values[i++] = v;
+      }
+      return H::combine(H::combine_contiguous(std::move(h), values, size),
+                        size);
+    }
+
+    if (set.mode_ == Mode::BITMAP) {
+      for (size_t i = 0; i < set.words_.size(); i++) {
+        if (set.words_[i]) {
+          h = H::combine(std::move(h), set.word_base_ + i, set.words_[i]);
+        }
+      }
+      return H::combine(std::move(h), size);
+    }
+
+    if (!set.SpanFitsBitmap()) {
+      // Only reachable by hb_set_t backed sets.
+      return H::combine(std::move(h), hb_set_hash(set.hb_.get()), size);
+    }
+
+    // hb_set_t backed, but could have been a bitmap: hash as if it was one.
+    size_t word = SIZE_MAX;
+    uint64_t bits = 0;
+    for (hb_codepoint_t v : set) {
+      if (v / 64 != word) {
+        if (bits) {
+          h = H::combine(std::move(h), word, bits);
+        }
+        word = v / 64;
+        bits = 0;
+      }
+      bits |= 1ull << (v % 64);
+    }
+    if (bits) {
+      h = H::combine(std::move(h), word, bits);
+    }
+    return H::combine(std::move(h), size);
   }
 
-  iterator begin() { return iterator(set_.get()); }
+  iterator begin() { return iterator(this); }
 
   iterator end() { return iterator(); }
 
   // const versions simply return the same iterator type
-  const_iterator begin() const { return const_iterator(set_.get()); }
+  const_iterator begin() const { return const_iterator(this); }
 
   const_iterator end() const { return const_iterator(); }
 
@@ -178,12 +216,12 @@ class IntSet {
   }
 
   // Reverse iterators
-  rev_iterator rbegin() { return rev_iterator(set_.get()); }
+  rev_iterator rbegin() { return rev_iterator(this); }
 
   rev_iterator rend() { return rev_iterator(); }
 
   // const versions simply return the same iterator type
-  const_rev_iterator rbegin() const { return const_rev_iterator(set_.get()); }
+  const_rev_iterator rbegin() const { return const_rev_iterator(this); }
 
   const_rev_iterator rend() const { return const_rev_iterator(); }
 
@@ -194,28 +232,32 @@ class IntSet {
     } else {
       start = HB_SET_VALUE_INVALID;
     }
-    return const_iterator(set_.get(), start);
+    return const_iterator(this, start);
+  }
+
+  void insert(hb_codepoint_t codepoint) {
+    if (mode_ == Mode::BITMAP) {
+      uint32_t word = codepoint / 64;
+      if (word >= word_base_ && word - word_base_ < words_.size()) {
+        uint64_t& bits = words_[word - word_base_];
+        uint64_t mask = 1ull << (codepoint % 64);
+        if (!(bits & mask)) {
+          bits |= mask;
+          size_++;
+          AddToFingerprint(codepoint);
+        }
+        return;
+      }
+    }
+    InsertSlow(codepoint);
   }
 
-  void insert(hb_codepoint_t codepoint) { hb_set_add(set_.get(), codepoint); }
-
-  void insert_range(hb_codepoint_t start, hb_codepoint_t end) {
-    hb_set_add_range(set_.get(), start, end);
-  }
+  void insert_range(hb_codepoint_t start, hb_codepoint_t end);
 
   // Optimized insert that takes an array of sorted values
-  void insert_sorted_array(absl::Span<const hb_codepoint_t> sorted_values) {
-    hb_set_add_sorted_array(set_.get(), sorted_values.data(),
-                            sorted_values.size());
-  }
+  void insert_sorted_array(absl::Span<const hb_codepoint_t> sorted_values);
 
-  std::vector<hb_codepoint_t> to_vector() const {
-    std::vector<hb_codepoint_t> values;
-    auto size = this->size();
-    values.resize(size);
-    hb_set_next_many(set_.get(), HB_SET_VALUE_INVALID, values.data(), size);
-    return values;
-  }
+  std::vector<hb_codepoint_t> to_vector() const;
 
   template <typename It>
   void insert(It start, It end) {
@@ -226,83 +268,96 @@ class IntSet {
   }
 
   bool contains(hb_codepoint_t codepoint) const {
-    return hb_set_has(set_.get(), codepoint);
+    switch (mode_) {
+      case Mode::INLINE:
+        for (uint32_t i = 0; i < size_; i++) {
+          if (inline_[i] >= codepoint) {
+            return inline_[i] == codepoint;
+          }
+        }
+        return false;
+      case Mode::BITMAP: {
+        uint32_t word = codepoint / 64;
+        if (word < word_base_ || word - word_base_ >= words_.size()) {
+          return false;
+        }
+        return (words_[word - word_base_] >> (codepoint % 64)) & 1;
+      }
+      case Mode::HB:
+        return hb_set_has(hb_.get(), codepoint);
+    }
+    return false;
   }
 
-  bool is_subset_of(const IntSet& other) const {
-    return hb_set_is_subset(set_.get(), other.set_.get());
-  }
+  bool is_subset_of(const IntSet& other) const;
 
-  static bool is_subset_of(const hb_set_t* small, const IntSet& large) {
-    return hb_set_is_subset(small, large.set_.get());
-  }
+  static bool is_subset_of(const hb_set_t* small, const IntSet& large);
 
-  bool intersects(const hb_set_t* other) const {
-    return intersects(set_.get(), other);
-  }
+  bool intersects(const hb_set_t* other) const;
 
-  bool intersects(const IntSet& other) const {
-    return intersects(set_.get(), other.set_.get());
-  }
+  bool intersects(const IntSet& other) const;
 
-  std::optional<hb_codepoint_t> min() const {
-    hb_codepoint_t value = hb_set_get_min(set_.get());
-    if (value == HB_SET_VALUE_INVALID) {
-      return std::nullopt;
-    }
-    return value;
-  }
+  std::optional<hb_codepoint_t> min() const;
 
-  std::optional<hb_codepoint_t> max() const {
-    hb_codepoint_t value = hb_set_get_max(set_.get());
-    if (value == HB_SET_VALUE_INVALID) {
-      return std::nullopt;
+  std::optional<hb_codepoint_t> max() const;
+
+  size_t erase(hb_codepoint_t codepoint);
+
+  size_t size() const {
+    if (mode_ == Mode::HB) {
+      return hb_set_get_population(hb_.get());
     }
-    return value;
+    return size_;
   }
 
-  size_t erase(hb_codepoint_t codepoint) {
-    bool has = contains(codepoint);
-    if (has) {
-      hb_set_del(set_.get(), codepoint);
-      return 1;
+  bool empty() const {
+    if (mode_ == Mode::HB) {
+      return hb_set_is_empty(hb_.get());
     }
-    return 0;
+    return size_ == 0;
   }
 
-  size_t size() const { return hb_set_get_population(set_.get()); }
-
-  bool empty() const { return hb_set_is_empty(set_.get()); }
-
   // Removes all elements
-  void clear() { hb_set_clear(set_.get()); }
+  void clear() {
+    mode_ = Mode::INLINE;
+    size_ = 0;
+    word_base_ = 0;
+    words_.clear();
+    hb_.reset();
+    fingerprint_ = Fingerprint();
+  }
+
+  // An order independent 128 bit fingerprint of the contents: the sum of a
+  // per value mix over all values. Equal sets always have equal fingerprints,
+  // different sets collide with negligible probability.
+  //
+  // O(1), inserts, erases, and bulk operations update the fingerprint with
+  // just the values they add or remove. Only invert() (and a few operations
+  // on inverted sets) recompute it from the contents.
+  Fingerprint fingerprint() const { return fingerprint_; }
 
   // Compute the union of this and other, store the result in this set.
-  void union_set(const IntSet& other) {
-    hb_set_union(set_.get(), other.set_.get());
-  }
+  void union_set(const IntSet& other);
 
-  void union_into(hb_set_t* other) const { hb_set_union(other, set_.get()); }
+  void union_into(hb_set_t* other) const;
 
-  void union_from(hb_set_t* other) const { hb_set_union(set_.get(), other); }
+  void union_from(hb_set_t* other);
 
   // Compute the intersection of this and other, store the result in this set.
-  void intersect(const IntSet& other) {
-    hb_set_intersect(set_.get(), other.set_.get());
-  }
+  void intersect(const IntSet& other);
 
   // Subtract other from this set.
-  void subtract(const IntSet& other) {
-    hb_set_subtract(set_.get(), other.set_.get());
-  }
+  void subtract(const IntSet& other);
 
   // Compute the symmetric difference of this and other, store the result in
   // this set.
-  void symmetric_difference(const IntSet& other) {
-    hb_set_symmetric_difference(set_.get(), other.set_.get());
-  }
+  void symmetric_difference(const IntSet& other);
 
-  void invert() { hb_set_invert(set_.get()); }
+  void invert() {
+    ToHbSet();
+    hb_set_invert(hb_.get());
+    RefreshFingerprint();
+  }
 
   std::string ToString() const {
     std::stringstream out;
@@ -341,6 +396,113 @@ class IntSet {
   }
 
  private:
+  template <bool reverse>
+  friend class IntSetIterator;
+
+  enum class Mode : uint8_t {
+    INLINE,
+    BITMAP,
+    HB,
+  };
+
+  // A bitmap is only used if it needs at most this many words...
+  static constexpr uint32_t kMaxBitmapWords = 1024;
+  // ... and at most max(kMinBitmapWords, kMaxWordsPerValue * size) words, so
+  // that a few far apart values don't get a large mostly empty bitmap.
+  static constexpr uint32_t kMinBitmapWords = 16;
+  static constexpr uint32_t kMaxWordsPerValue = 2;
+
+  // Same semantics as hb_set_next()/hb_set_previous(): pass
+  // HB_SET_VALUE_INVALID to start, returns false once there are no more
+  // values.
+  bool NextValue(hb_codepoint_t* value) const;
+  bool PreviousValue(hb_codepoint_t* value) const;
+
+  void InsertSlow(hb_codepoint_t codepoint);
+
+  static uint64_t MixValue(uint64_t value) {
+    // MurmurHash3 fmix64.
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdull;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ull;
+    value ^= value >> 33;
+    return value;
+  }
+
+  // Contribution of a single value to the fingerprint.
+  static Fingerprint ValueFingerprint(hb_codepoint_t value) {
+    return Fingerprint{.high = MixValue(value ^ 0x9e3779b97f4a7c15ull),
+                       .low = MixValue(value + 0x632be59bd9b4e019ull)};
+  }
+
+  // Must be called for each value newly added to/removed from the set.
+  void AddToFingerprint(hb_codepoint_t value) {
+    Fingerprint f = ValueFingerprint(value);
+    fingerprint_.high += f.high;
+    fingerprint_.low += f.low;
+  }
+  void RemoveFromFingerprint(hb_codepoint_t value) {
+    Fingerprint f = ValueFingerprint(value);
+    fingerprint_.high -= f.high;
+    fingerprint_.low -= f.low;
+  }
+
+  Fingerprint ComputeFingerprint() const;
+
+  // Recomputes the fingerprint from the contents, for operations where the
+  // changed values can't be cheaply enumerated.
+  void RefreshFingerprint() { fingerprint_ = ComputeFingerprint(); }
+
+  // Sets bitmap word i to word, updating size_ and the fingerprint for the
+  // bits which changed.
+  void SetWord(size_t i, uint64_t word);
+
+  // Runs op, a bulk operation on hb_ which can only change the membership of
+  // values in values. Before op runs the fingerprint is updated for each of
+  // them using in_result(value, was_present), which returns whether value is
+  // in the result.
+  template <typename Values, typename InResult, typename Op>
+  void UpdateHb(const Values& values, InResult in_result, Op op);
+
+  // Switches to a representation which can hold values in [first, last] with
+  // an expected total population of population.
+  void Reserve(hb_codepoint_t first, hb_codepoint_t last, uint64_t population);
+
+  static bool FitsBitmap(uint32_t first_word, uint32_t last_word,
+                         uint64_t population);
+
+  // True if all values lie within kMaxBitmapWords words.
+  bool SpanFitsBitmap() const;
+
+  // Converts to (or grows) a bitmap covering [first_word, last_word].
+  void ToBitmap(uint32_t first_word, uint32_t last_word);
+
+  void ToHbSet();
+
+  // Converts a small bitmap back to inline storage.
+  void Compact();
+
+  void AssignFromHbSet(const hb_set_t* set);
+
+  void Swap(IntSet& other);
+
+  // Removes all values for which keep returns false. Not for HB mode.
+  template <typename F>
+  void RetainIf(F keep);
+
+  // The range where the words of this and other (both bitmaps) overlap.
+  struct WordOverlap {
+    size_t this_start;
+    size_t other_start;
+    size_t length;
+  };
+  WordOverlap OverlapWith(const IntSet& other) const;
+
+  // True if any word in words_ outside of [start, start + length) is non
+  // zero.
+  bool HasBitsOutside(size_t start, size_t length) const;
+
   static bool intersects(const hb_set_t* a, const hb_set_t* b) {
     if (hb_set_get_population(a) > hb_set_get_population(b)) {
       return intersects(b, a);
@@ -354,16 +516,41 @@ class IntSet {
     return false;
   }
 
-  // Note: set_ must always point to a valid set object. nullptr is not allowed.
-  // Note: we always retain exclusive ownership over set_. Normally hb_set_t*
-  // can be
-  //       shared (via hb_set_reference()), but for this container we don't ever
-  //       expose the underlying hb_set_t* pointer so that we know we're always
-  //       the only owner. This prevents the sets contents from being changed
-  //       outside of this class.
-  hb_set_unique_ptr set_;
+  Mode mode_ = Mode::INLINE;
+
+  // Always up to date with the contents, see fingerprint().
+  Fingerprint fingerprint_;
+
+  // Number of values, for INLINE and BITMAP.
+  uint32_t size_ = 0;
+
+  // INLINE: sorted values, the first size_ are in use.
+  hb_codepoint_t inline_[kInlineCapacity] = {};
+
+  // BITMAP: words_[i] holds values [64 * (word_base_ + i), 64 * (word_base_ +
+  // i + 1)). Always non empty in BITMAP mode, empty otherwise.
+  uint32_t word_base_ = 0;
+  std::vector<uint64_t> words_;
+
+  // HB: the set. We always retain exclusive ownership over it, it's never
+  // exposed outside of this class so the contents can't be changed from
+  // elsewhere. nullptr in other modes.
+  hb_set_unique_ptr hb_ = hb_set_unique_ptr(nullptr, &hb_set_destroy);
 };
 
+template <bool reverse>
+IntSetIterator<reverse>& IntSetIterator<reverse>::operator++() {
+  if (set_) {
+    if (!(!reverse ? set_->NextValue(&current_codepoint_)
+                   : set_->PreviousValue(&current_codepoint_))) {
+      // Reached the end
+      set_ = nullptr;
+      current_codepoint_ = HB_CODEPOINT_INVALID;
+    }
+  }
+  return *this;
+}
+
 // Typed variants
 class GlyphSet : public IntSet {
  public:
@@ -1,11 +1,15 @@
 #include "ift/common/int_set.h"
 
+#include <algorithm>
 #include <optional>
+#include <random>
+#include <vector>
 
 #include "absl/container/btree_set.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/hash/hash_testing.h"
 #include "gtest/gtest.h"
+#include "ift/common/fingerprint.h"
 #include "ift/common/hb_set_unique_ptr.h"
 
 namespace ift::common {
@@ -472,4 +476,287 @@ TEST_F(IntSetTest, Invert) {
   ASSERT_EQ(set, (IntSet{2, 9, 20}));
 }
 
+// Builds sets with a mix of contents so that every internal representation
+// (inline, bitmap, hb_set_t) is exercised.
+class IntSetRepresentationTest : public ::testing::Test {
+ protected:
+  using Reference = absl::btree_set<uint32_t>;
+
+  Reference RandomValues(uint32_t count, uint32_t start, uint32_t end) {
+    std::uniform_int_distribution<uint32_t> dist(start, end);
+    Reference values;
+    while (values.size() < count) {
+      values.insert(dist(rng_));
+    }
+    return values;
+  }
+
+  std::vector<Reference> Contents() {
+    return {
+        {},
+        RandomValues(3, 0, 3000),
+        RandomValues(8, 0, 3000),
+        RandomValues(9, 100, 600),
+        RandomValues(200, 0, 4000),
+        RandomValues(500, 2000, 6000),
+        RandomValues(40, 0, 0x10FFFF),
+        RandomValues(300, 0, 70000),
+    };
+  }
+
+  static IntSet ToIntSet(const Reference& values) {
+    IntSet set;
+    for (uint32_t v : values) {
+      set.insert(v);
+    }
+    return set;
+  }
+
+  static void CheckMatches(const IntSet& set, const Reference& expected) {
+    ASSERT_EQ(set.size(), expected.size());
+    ASSERT_EQ(set.empty(), expected.empty());
+    ASSERT_EQ(set.to_vector(),
+              std::vector<uint32_t>(expected.begin(), expected.end()));
+
+    std::vector<uint32_t> reversed(set.rbegin(), set.rend());
+    ASSERT_EQ(reversed,
+              std::vector<uint32_t>(expected.rbegin(), expected.rend()));
+
+    if (expected.empty()) {
+      ASSERT_EQ(set.min(), std::nullopt);
+      ASSERT_EQ(set.max(), std::nullopt);
+    } else {
+      ASSERT_EQ(set.min(), *expected.begin());
+      ASSERT_EQ(set.max(), *expected.rbegin());
+    }
+
+    for (uint32_t v : expected) {
+      ASSERT_TRUE(set.contains(v));
+      ASSERT_FALSE(set.contains(v + 1) && !expected.contains(v + 1));
+      auto it = set.lower_bound(v + 1);
+      auto expected_it = expected.lower_bound(v + 1);
+      if (expected_it == expected.end()) {
+        ASSERT_EQ(it, set.end());
+      } else {
+        ASSERT_EQ(*it, *expected_it);
+      }
+    }
+
+    // Same hash and equality as a set built directly from the values.
+    IntSet direct = ToIntSet(expected);
+    ASSERT_EQ(set, direct);
+    ASSERT_EQ(absl::HashOf(set), absl::HashOf(direct));
+    ASSERT_EQ(set.fingerprint(), direct.fingerprint());
+  }
+
+  std::mt19937 rng_{42};
+};
+
+TEST_F(IntSetRepresentationTest, MatchesReference) {
+  auto contents = Contents();
+  for (const auto& a_values : contents) {
+    IntSet a = ToIntSet(a_values);
+    CheckMatches(a, a_values);
+
+    for (const auto& b_values : contents) {
+      IntSet b = ToIntSet(b_values);
+
+      Reference expected_union = a_values;
+      expected_union.insert(b_values.begin(), b_values.end());
+      Reference expected_intersection;
+      Reference expected_difference;
+      Reference expected_symmetric = expected_union;
+      for (uint32_t v : a_values) {
+        if (b_values.contains(v)) {
+          expected_intersection.insert(v);
+          expected_symmetric.erase(v);
+        } else {
+          expected_difference.insert(v);
+        }
+      }
+
+      IntSet result = a;
+      result.union_set(b);
+      CheckMatches(result, expected_union);
+
+      result = a;
+      result.intersect(b);
+      CheckMatches(result, expected_intersection);
+
+      result = a;
+      result.subtract(b);
+      CheckMatches(result, expected_difference);
+
+      result = a;
+      result.symmetric_difference(b);
+      CheckMatches(result, expected_symmetric);
+
+      ASSERT_EQ(a == b, a_values == b_values);
+      ASSERT_EQ(a.intersects(b), !expected_intersection.empty());
+      ASSERT_EQ(a.is_subset_of(b), expected_difference.empty());
+
+      hb_set_unique_ptr hb_b = make_hb_set();
+      b.union_into(hb_b.get());
+      ASSERT_EQ(a.intersects(hb_b.get()), !expected_intersection.empty());
+      ASSERT_EQ(IntSet(hb_b), b);
+
+      result = a;
+      result.union_from(hb_b.get());
+      CheckMatches(result, expected_union);
+    }
+  }
+}
+
+TEST_F(IntSetRepresentationTest, EraseAndInsertRange) {
+  for (auto values : Contents()) {
+    IntSet set = ToIntSet(values);
+
+    // Erase every other value.
+    bool erase = true;
+    for (uint32_t v : Reference(values)) {
+      if (erase) {
+        ASSERT_EQ(set.erase(v), 1);
+        values.erase(v);
+      }
+      erase = !erase;
+    }
+    ASSERT_EQ(set.erase(0xFFFFF0), 0);
+    CheckMatches(set, values);
+
+    set.insert_range(1000, 1300);
+    for (uint32_t v = 1000; v <= 1300; v++) {
+      values.insert(v);
+    }
+    CheckMatches(set, values);
+
+    set.clear();
+    CheckMatches(set, {});
+  }
+}
+
+TEST_F(IntSetRepresentationTest, HashIndependentOfHistory) {
+  // A set that was large and sparse, then reduced to a few values, should
+  // behave identically to a set that only ever held those values.
+  IntSet sparse{5,       70000,   0x10000, 0x20000, 0x30000,
+                0x40000, 0x50000, 0x60000, 0x70000, 0x80000};
+  IntSet keep{5,       70000,   0x10000, 0x20000, 0x30000,
+              0x40000, 0x50000, 0x60000, 0x90000, 0xA0000};
+  sparse.intersect(keep);
+
+  // Far apart values force the hb_set_t representation, the intersection
+  // then only has a small range of values left.
+  IntSet wide;
+  wide.insert_range(0, 100);
+  wide.insert(0x100000);
+  IntSet other_wide;
+  other_wide.insert_range(50, 60);
+  other_wide.insert(0x200000);
+  wide.intersect(other_wide);
+  IntSet narrow;
+  narrow.insert_range(50, 60);
+
+  IntSet dense;
+  dense.insert_range(0, 500);
+  dense.intersect(IntSet{5, 400});
+
+  EXPECT_TRUE(absl::VerifyTypeImplementsAbslHashCorrectly({
+      sparse,
+      IntSet{5, 70000, 0x10000, 0x20000, 0x30000, 0x40000, 0x50000, 0x60000},
+      wide,
+      narrow,
+      dense,
+      IntSet{5, 400},
+      IntSet{},
+  }));
+}
+
+TEST_F(IntSetRepresentationTest, Fingerprint) {
+  auto contents = Contents();
+  for (const auto& values : contents) {
+    // Insertion order doesn't matter.
+    std::vector<uint32_t> shuffled(values.begin(), values.end());
+    std::shuffle(shuffled.begin(), shuffled.end(), rng_);
+    IntSet set;
+    set.insert(shuffled.begin(), shuffled.end());
+    ASSERT_EQ(set.fingerprint(), ToIntSet(values).fingerprint());
+
+    // Nor does the path taken to reach the contents.
+    hb_set_unique_ptr hb = make_hb_set();
+    for (uint32_t v : values) {
+      hb_set_add(hb.get(), v);
+    }
+    ASSERT_EQ(IntSet(hb).fingerprint(), set.fingerprint());
+
+    set.insert(0xFFFF00);
+    set.insert_range(10, 20);
+    set.erase(0xFFFF00);
+    set.subtract(IntSet{10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20});
+    Reference expected = values;
+    for (uint32_t v = 10; v <= 20; v++) {
+      expected.erase(v);
+    }
+    ASSERT_EQ(set.fingerprint(), ToIntSet(expected).fingerprint());
+  }
+
+  // Different contents give different fingerprints.
+  absl::flat_hash_set<Fingerprint> seen;
+  for (const auto& values : contents) {
+    seen.insert(ToIntSet(values).fingerprint());
+  }
+  for (uint32_t v = 0; v < 1000; v++) {
+    seen.insert(IntSet{v}.fingerprint());
+    seen.insert(IntSet{v, v + 1}.fingerprint());
+  }
+  ASSERT_EQ(seen.size(), contents.size() + 2000);
+
+  // Inverted sets.
+  IntSet all = GlyphSet::all();
+  IntSet all_but_five = GlyphSet::all();
+  all_but_five.erase(5);
+  IntSet five{5};
+  ASSERT_EQ(all.fingerprint(), GlyphSet::all().fingerprint());
+  ASSERT_NE(all.fingerprint(), all_but_five.fingerprint());
+  ASSERT_NE(all.fingerprint(), IntSet{}.fingerprint());
+  ASSERT_NE(all_but_five.fingerprint(), five.fingerprint());
+
+  // Bulk operations on inverted sets.
+  IntSet result = all;
+  result.subtract(five);
+  ASSERT_EQ(result.fingerprint(), all_but_five.fingerprint());
+  result.union_set(five);
+  ASSERT_EQ(result.fingerprint(), all.fingerprint());
+  result.symmetric_difference(five);
+  ASSERT_EQ(result.fingerprint(), all_but_five.fingerprint());
+  result.intersect(five);
+  ASSERT_EQ(result.fingerprint(), IntSet{}.fingerprint());
+  result = all_but_five;
+  result.symmetric_difference(all);
+  ASSERT_EQ(result.fingerprint(), five.fingerprint());
+}
+
+TEST_F(IntSetRepresentationTest, InvertedSets) {
+  IntSet all = GlyphSet::all();
+  IntSet dense;
+  dense.insert_range(10, 300);
+
+  ASSERT_TRUE(dense.is_subset_of(all));
+  ASSERT_FALSE(all.is_subset_of(dense));
+  ASSERT_TRUE(dense.intersects(all));
+  ASSERT_NE(dense, all);
+
+  IntSet result = dense;
+  result.intersect(all);
+  ASSERT_EQ(result, dense);
+
+  result = dense;
+  result.union_set(all);
+  ASSERT_EQ(result, all);
+
+  result = all;
+  result.subtract(dense);
+  ASSERT_FALSE(result.contains(10));
+  ASSERT_TRUE(result.contains(9));
+  ASSERT_TRUE(result.contains(301));
+}
+
 }  // namespace ift::common
@@ -0,0 +1,148 @@
+#include "ift/common/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+
+using absl::Status;
+
+namespace ift::common {
+
+ThreadPool::ThreadPool(uint32_t num_threads) {
+  if (num_threads <= 1) {
+    return;
+  }
+
+  // The thread which calls ParallelFor() also does work, so one less worker is
+  // needed.
+  workers_.reserve(num_threads - 1);
+  for (uint32_t i = 0; i < num_threads - 1; i++) {
+    workers_.emplace_back([this]() { WorkerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    absl::MutexLock lock(&mutex_);
+    shutdown_ = true;
+  }
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::Schedule(absl::AnyInvocable<void() &&> task) {
+  if (workers_.empty()) {
+    std::move(task)();
+    return;
+  }
+
+  absl::MutexLock lock(&mutex_);
+  tasks_.push_back(std::move(task));
+}
+
+void ThreadPool::WorkerLoop() {
+  while (true) {
+    absl::AnyInvocable<void() &&> task;
+    {
+      absl::MutexLock lock(&mutex_);
+      mutex_.Await(absl::Condition(
+          +[](ThreadPool* pool) ABSL_EXCLUSIVE_LOCKS_REQUIRED(pool->mutex_) {
+            return pool->shutdown_ || !pool->tasks_.empty();
+          },
+          this));
+      if (tasks_.empty()) {
+        // Only reachable on shutdown, pending tasks are always drained first.
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    std::move(task)();
+  }
+}
+
+namespace {
+
+// State shared between the caller of ParallelFor() and any helper tasks. Held
+// by a shared_ptr since helper tasks may not start running until after the
+// ParallelFor() call has returned.
+struct ParallelForState {
+  explicit ParallelForState(size_t count_) : count(count_), statuses(count_) {}
+
+  const size_t count;
+  std::atomic<size_t> next = 0;
+  std::vector<Status> statuses;
+
+  absl::Mutex mutex;
+  // Once closed no new helpers will pick up work.
+  bool closed ABSL_GUARDED_BY(mutex) = false;
+  uint32_t active ABSL_GUARDED_BY(mutex) = 0;
+};
+
+void RunAll(ParallelForState& state,
+            absl::FunctionRef<Status(size_t)>& fn) {
+  for (size_t i = state.next.fetch_add(1); i < state.count;
+       i = state.next.fetch_add(1)) {
+    state.statuses[i] = fn(i);
+  }
+}
+
+}  // namespace
+
+Status ThreadPool::ParallelFor(size_t count,
+                               absl::FunctionRef<Status(size_t)> fn) {
+  if (workers_.empty() || count <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      Status sc = fn(i);
+      if (!sc.ok()) {
+        return sc;
+      }
+    }
+    return absl::OkStatus();
+  }
+
+  auto state = std::make_shared<ParallelForState>(count);
+  size_t helpers = std::min(workers_.size(), count - 1);
+  for (size_t i = 0; i < helpers; i++) {
+    Schedule([state, fn]() mutable {
+      {
+        absl::MutexLock lock(&state->mutex);
+        if (state->closed) {
+          return;
+        }
+        state->active++;
+      }
+      RunAll(*state, fn);
+      absl::MutexLock lock(&state->mutex);
+      state->active--;
+    });
+  }
+
+  RunAll(*state, fn);
+
+  {
+    // All indices have been claimed at this point, so only need to wait for any
+    // helpers which are still processing their final item.
+    absl::MutexLock lock(&state->mutex);
+    state->closed = true;
+    state->mutex.Await(absl::Condition(
+        +[](ParallelForState* s) ABSL_EXCLUSIVE_LOCKS_REQUIRED(s->mutex) {
+          return s->active == 0;
+        },
+        state.get()));
+  }
+
+  for (Status& sc : state->statuses) {
+    if (!sc.ok()) {
+      return sc;
+    }
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace ift::common
@@ -0,0 +1,71 @@
+#ifndef COMMON_THREAD_POOL_H_
+#define COMMON_THREAD_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/functional/any_invocable.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+
+namespace ift::common {
+
+/*
+ * A fixed size pool of worker threads.
+ *
+ * A pool configured with zero or one threads does not start any workers,
+ * instead all work is executed inline on the calling thread. This allows
+ * callers to use the same code path for both serial and parallel execution.
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(uint32_t num_threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ThreadPool& operator=(ThreadPool&&) = delete;
+
+  // Total number of threads that will execute work, including the caller of
+  // ParallelFor().
+  uint32_t NumThreads() const { return workers_.size() + 1; }
+
+  bool IsParallel() const { return !workers_.empty(); }
+
+  /*
+   * Schedules task to be run on one of the worker threads. If the pool has no
+   * workers the task is run immediately on the calling thread.
+   */
+  void Schedule(absl::AnyInvocable<void() &&> task);
+
+  /*
+   * Invokes fn(i) for each i in [0, count) using the workers in this pool plus
+   * the calling thread. Blocks until all invocations have completed.
+   *
+   * The calling thread participates in the work so it's safe to call this
+   * from inside of a task running on this pool.
+   *
+   * If any invocations fail the error from the lowest failing index is
+   * returned, which keeps the result independent of scheduling order.
+   */
+  absl::Status ParallelFor(size_t count,
+                           absl::FunctionRef<absl::Status(size_t)> fn);
+
+ private:
+  void WorkerLoop();
+
+  absl::Mutex mutex_;
+  std::deque<absl::AnyInvocable<void() &&>> tasks_ ABSL_GUARDED_BY(mutex_);
+  bool shutdown_ ABSL_GUARDED_BY(mutex_) = false;
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace ift::common
+
+#endif  // COMMON_THREAD_POOL_H_
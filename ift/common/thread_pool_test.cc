@@ -0,0 +1,87 @@
+#include "ift/common/thread_pool.h"
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+using absl::Status;
+using absl::StrCat;
+
+namespace ift::common {
+
+class ThreadPoolTest : public ::testing::Test {};
+
+TEST_F(ThreadPoolTest, ParallelFor_Serial) {
+  ThreadPool pool(1);
+  ASSERT_FALSE(pool.IsParallel());
+  ASSERT_EQ(pool.NumThreads(), 1);
+
+  std::vector<size_t> order;
+  auto sc = pool.ParallelFor(5, [&](size_t i) {
+    order.push_back(i);
+    return absl::OkStatus();
+  });
+  ASSERT_TRUE(sc.ok()) << sc;
+
+  std::vector<size_t> expected = {0, 1, 2, 3, 4};
+  ASSERT_EQ(order, expected);
+}
+
+TEST_F(ThreadPoolTest, ParallelFor_VisitsEachIndexOnce) {
+  ThreadPool pool(4);
+  ASSERT_TRUE(pool.IsParallel());
+  ASSERT_EQ(pool.NumThreads(), 4);
+
+  std::vector<std::atomic<uint32_t>> counts(1000);
+  auto sc = pool.ParallelFor(counts.size(), [&](size_t i) {
+    counts[i]++;
+    return absl::OkStatus();
+  });
+  ASSERT_TRUE(sc.ok()) << sc;
+
+  for (const auto& c : counts) {
+    ASSERT_EQ(c.load(), 1);
+  }
+}
+
+TEST_F(ThreadPoolTest, ParallelFor_ReturnsLowestIndexError) {
+  ThreadPool pool(4);
+  auto sc = pool.ParallelFor(100, [&](size_t i) {
+    if (i % 10 == 7) {
+      return absl::InternalError(StrCat("failed ", i));
+    }
+    return absl::OkStatus();
+  });
+  ASSERT_EQ(sc, absl::InternalError("failed 7"));
+}
+
+TEST_F(ThreadPoolTest, ParallelFor_Nested) {
+  ThreadPool pool(3);
+  std::atomic<uint32_t> total = 0;
+  auto sc = pool.ParallelFor(10, [&](size_t i) {
+    return pool.ParallelFor(10, [&](size_t j) {
+      total++;
+      return absl::OkStatus();
+    });
+  });
+  ASSERT_TRUE(sc.ok()) << sc;
+  ASSERT_EQ(total.load(), 100);
+}
+
+TEST_F(ThreadPoolTest, Schedule) {
+  std::atomic<uint32_t> total = 0;
+  {
+    ThreadPool pool(4);
+    for (uint32_t i = 0; i < 50; i++) {
+      pool.Schedule([&]() { total++; });
+    }
+    // Destruction drains all pending tasks.
+  }
+  ASSERT_EQ(total.load(), 50);
+}
+
+}  // namespace ift::common
@@ -6,7 +6,9 @@
 #include <optional>
 #include <regex>
 #include <sstream>
+#include <utility>
 
+#include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/strip.h"
 #include "codepoint_count.pb.h"
@@ -14,6 +16,7 @@
 #include "ift/common/font_data.h"
 #include "ift/common/int_set.h"
 #include "ift/common/try.h"
+#include "ift/freq/compiled_unicode_frequencies.h"
 #include "ift/freq/unicode_frequencies.h"
 #include "metadata.pb.h"
 #include "riegeli/bytes/fd_reader.h"
@@ -29,6 +32,7 @@ using ift::common::DataFileResolver;
 using ift::common::FontData;
 using ift::common::hb_blob_unique_ptr;
 using ift::common::make_hb_blob;
+using ift::freq::CompiledUnicodeFrequencies;
 using ift::freq::UnicodeFrequencies;
 using ift::freq::UnicodeFrequenciesBuilder;
 using ift_encoder_data::CodepointCount;
@@ -214,12 +218,49 @@ StatusOr<UnicodeFrequencies> LoadFrequenciesFromRiegeli(
   return builder.Build();
 }
 
+static StatusOr<UnicodeFrequencies> FrequenciesFromCompiled(
+    const char* path, FontData data, std::optional<CodepointSet> filter) {
+  auto frequencies = UnicodeFrequencies::FromCompiled(std::move(data), filter);
+  if (!frequencies.ok()) {
+    return absl::InvalidArgumentError(
+        StrCat(path, ": ", frequencies.status().message()));
+  }
+  return frequencies;
+}
+
+StatusOr<UnicodeFrequencies> LoadCompiledFrequencies(
+    const char* path, std::optional<CodepointSet> filter) {
+  return FrequenciesFromCompiled(path, TRY(LoadFile(path)), filter);
+}
+
+std::string CompiledFrequenciesPath(string_view sharded_path) {
+  absl::ConsumeSuffix(&sharded_path, "@*");
+  return StrCat(sharded_path, ".iftf");
+}
+
+StatusOr<UnicodeFrequencies> LoadFrequencies(
+    const char* path, std::optional<CodepointSet> filter) {
+  // A sharded path can't be compiled itself, but may have a compiled copy of
+  // all of its shards next to it.
+  std::string compiled_path = absl::EndsWith(path, "@*")
+                                  ? CompiledFrequenciesPath(path)
+                                  : std::string(path);
+  if (std::filesystem::exists(compiled_path)) {
+    auto data = LoadFile(compiled_path.c_str());
+    if (data.ok() && CompiledUnicodeFrequencies::IsCompiled(data->str())) {
+      return FrequenciesFromCompiled(compiled_path.c_str(), std::move(*data),
+                                     filter);
+    }
+  }
+  return LoadFrequenciesFromRiegeli(path, filter);
+}
+
 StatusOr<UnicodeFrequencies> LoadBuiltInFrequencies(
     const char* name, const DataFileResolver& resolver,
     std::optional<CodepointSet> filter) {
   std::string data_dir = TRY(resolver.GetFrequencyDataDirectory());
   std::string path = StrCat(data_dir, "/", name);
-  return LoadFrequenciesFromRiegeli(path.c_str(), filter);
+  return LoadFrequencies(path.c_str(), filter);
 }
 
 StatusOr<flat_hash_map<std::string, CodepointSet>> BuiltInFrequenciesList(
@@ -2,11 +2,13 @@
 #define IFT_CONFIG_LOAD_CODEPOINTS_H_
 
 #include <optional>
+#include <string>
 #include <vector>
 
 #include "absl/container/btree_set.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
 #include "ift/common/data_file_resolver.h"
 #include "ift/common/font_data.h"
 #include "ift/common/font_helper.h"
@@ -46,10 +48,30 @@ absl::StatusOr<ift::freq::UnicodeFrequencies> LoadFrequenciesFromRiegeli(
     const char* path,
     std::optional<ift::common::CodepointSet> filter = std::nullopt);
 
+// Loads a compiled frequency data file (see
+// ift/freq/compiled_unicode_frequencies.h). The file is memory mapped where
+// possible and the frequencies are looked up in it directly without copying.
+absl::StatusOr<ift::freq::UnicodeFrequencies> LoadCompiledFrequencies(
+    const char* path,
+    std::optional<ift::common::CodepointSet> filter = std::nullopt);
+
+// Returns the path of the compiled frequency data file which may stand in for
+// the sharded path ("<path>@*"), that is "<path>.iftf".
+std::string CompiledFrequenciesPath(absl::string_view sharded_path);
+
+// Loads frequency data from either a compiled frequency data file or a
+// Riegeli file (see LoadFrequenciesFromRiegeli()). The format is detected from
+// the file contents. For sharded paths the compiled file at
+// CompiledFrequenciesPath() is used in place of the shards if it exists.
+absl::StatusOr<ift::freq::UnicodeFrequencies> LoadFrequencies(
+    const char* path,
+    std::optional<ift::common::CodepointSet> filter = std::nullopt);
+
 // loads frequency data from https://github.com/w3c/ift-encoder-data
 //
 // name is the file name to load.
-// Append "@*" to the name to load all sharded files for a name.
+// Append "@*" to the name to load all sharded files for a name. Compiled data
+// is preferred when present, see LoadFrequencies().
 absl::StatusOr<ift::freq::UnicodeFrequencies> LoadBuiltInFrequencies(
     const char* name, const ift::common::DataFileResolver& resolver,
     std::optional<ift::common::CodepointSet> filter = std::nullopt);
@@ -1,9 +1,17 @@
 #include "ift/config/load_codepoints.h"
 
 #include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
 
 #include "gtest/gtest.h"
 #include "ift/common/bazel_data_file_resolver.h"
+#include "ift/common/fixed_data_file_resolver.h"
+#include "ift/common/int_set.h"
+#include "ift/freq/compiled_unicode_frequencies.h"
+
+using ift::common::CodepointSet;
 
 namespace ift::config {
 
@@ -115,6 +123,75 @@ TEST_F(LoadCodepointsTest, LoadFrequenciesFromRiegeli_BadData) {
   ASSERT_TRUE(absl::IsInvalidArgument(result.status())) << result.status();
 }
 
+TEST_F(LoadCodepointsTest, LoadFrequencies_Compiled) {
+  auto riegeli = ift::config::LoadFrequencies(
+      "util/testdata/test_freq_data.riegeli");
+  ASSERT_TRUE(riegeli.ok()) << riegeli.status();
+
+  std::string path = ::testing::TempDir() + "/test_freq_data.iftf";
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << ift::freq::CompiledUnicodeFrequencies::Serialize(*riegeli);
+  }
+
+  auto compiled = ift::config::LoadFrequencies(path.c_str());
+  ASSERT_TRUE(compiled.ok()) << compiled.status();
+  auto filtered =
+      ift::config::LoadCompiledFrequencies(path.c_str(), CodepointSet{0x44});
+  std::remove(path.c_str());
+  ASSERT_TRUE(filtered.ok()) << filtered.status();
+
+  EXPECT_EQ(compiled->ProbabilityFor(0x43, 0x43), 1.0);
+  EXPECT_EQ(compiled->ProbabilityFor(0x44, 0x44), 75.0 / 200.0);
+  EXPECT_EQ(compiled->ProbabilityFor(0x41, 0x42), 0.5);
+  EXPECT_EQ(compiled->ProbabilityFor(0x44, 0x45), 0.25);
+  EXPECT_EQ(compiled->CoveredCodepoints(), riegeli->CoveredCodepoints());
+
+  EXPECT_EQ(filtered->CoveredCodepoints(), (CodepointSet{0x44}));
+}
+
+TEST_F(LoadCodepointsTest, LoadFrequencies_ShardedCompiledSibling) {
+  auto sharded = ift::config::LoadFrequencies(
+      "util/testdata/sharded/test_freq_data.riegeli@*");
+  ASSERT_TRUE(sharded.ok()) << sharded.status();
+
+  // Only the compiled file exists in the directory, so loading the shards can
+  // only succeed by using it.
+  std::string dir = ::testing::TempDir();
+  std::string sharded_path = dir + "/compiled_freq_data.riegeli@*";
+  std::string path = CompiledFrequenciesPath(sharded_path);
+  ASSERT_EQ(path, dir + "/compiled_freq_data.riegeli.iftf");
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << ift::freq::CompiledUnicodeFrequencies::Serialize(*sharded);
+  }
+
+  auto compiled = ift::config::LoadFrequencies(sharded_path.c_str());
+  ift::common::FixedDataFileResolver resolver("", "", dir);
+  auto built_in = ift::config::LoadBuiltInFrequencies(
+      "compiled_freq_data.riegeli@*", resolver);
+  std::remove(path.c_str());
+  ASSERT_TRUE(compiled.ok()) << compiled.status();
+  ASSERT_TRUE(built_in.ok()) << built_in.status();
+
+  for (const auto& result : {&*compiled, &*built_in}) {
+    EXPECT_EQ(result->ProbabilityFor(0x43, 0x43), 1.0);
+    EXPECT_EQ(result->ProbabilityFor(0x44, 0x44), 75.0 / 200.0);
+    EXPECT_EQ(result->ProbabilityFor(0x41, 0x42), 0.5);
+    EXPECT_EQ(result->CoveredCodepoints(), sharded->CoveredCodepoints());
+  }
+
+  // Without the compiled file the shards are needed.
+  compiled = ift::config::LoadFrequencies(sharded_path.c_str());
+  ASSERT_TRUE(absl::IsNotFound(compiled.status())) << compiled.status();
+}
+
+TEST_F(LoadCodepointsTest, LoadCompiledFrequencies_NotCompiled) {
+  auto result = ift::config::LoadCompiledFrequencies(
+      "util/testdata/test_freq_data.riegeli");
+  ASSERT_TRUE(absl::IsInvalidArgument(result.status())) << result.status();
+}
+
 TEST_F(LoadCodepointsTest, ExpandShardedPath) {
   auto result = ExpandShardedPath("util/testdata/test_freq_data.riegeli");
   ASSERT_TRUE(result.ok()) << result.status();
@@ -38,7 +38,7 @@ StatusOr<UnicodeFrequencies> SegmenterConfigUtil::GetFrequencyData(
   if (built_in) {
     std::string data_dir = TRY(resolver_->GetFrequencyDataDirectory());
     std::string path = absl::StrCat(data_dir, "/", frequency_data_file_path);
-    return LoadFrequenciesFromRiegeli(path.c_str(), filter);
+    return LoadFrequencies(path.c_str(), filter);
   }
 
   std::filesystem::path freq_path = frequency_data_file_path;
@@ -48,7 +48,7 @@ StatusOr<UnicodeFrequencies> SegmenterConfigUtil::GetFrequencyData(
     resolved_path = config_path.parent_path() / freq_path;
   }
 
-  return LoadFrequenciesFromRiegeli(resolved_path.c_str(), filter);
+  return LoadFrequencies(resolved_path.c_str(), filter);
 }
 
 SubsetDefinition SegmenterConfigUtil::SegmentProtoToSubsetDefinition(
@@ -304,6 +304,15 @@ StatusOr<SegmentationResult> SegmenterConfigUtil::RunSegmenter(
       config.brotli_quality(), config.brotli_quality_for_initial_font_merging(),
       config.unmapped_glyph_handling(), config.condition_analysis_mode(),
       resolver_);
+  segmenter.SetNumThreads(num_threads_);
+  segmenter.SetScreening(config.screening_brotli_quality(),
+                         config.screening_margin());
+  if (!checkpoint_path_.empty()) {
+    segmenter.SetCheckpointing(checkpoint_path_, checkpoint_interval_);
+  }
+  if (!resume_from_.empty()) {
+    segmenter.SetResumeFrom(resume_from_);
+  }
 
   GlyphSegmentation segmentation = TRY(segmenter.CodepointToGlyphSegments(
       face, init_segment, segments, merge_groups));
@@ -1,11 +1,14 @@
 #ifndef IFT_CONFIG_SEGMENTER_CONFIG_UTIL_H_
 #define IFT_CONFIG_SEGMENTER_CONFIG_UTIL_H_
 
+#include <cstdint>
 #include <memory>
 #include <optional>
+#include <string>
 
 #include "absl/container/btree_map.h"
 #include "absl/status/statusor.h"
+#include "absl/time/time.h"
 #include "hb.h"
 #include "ift/common/data_file_resolver.h"
 #include "ift/common/int_set.h"
@@ -34,6 +37,27 @@ class SegmenterConfigUtil {
                       std::shared_ptr<ift::common::DataFileResolver> resolver)
       : config_file_path_(config_file_path), resolver_(std::move(resolver)) {}
 
+  /*
+   * Configures the number of threads the segmenter uses to assess candidate
+   * merges.
+   */
+  void SetNumThreads(uint32_t num_threads) { num_threads_ = num_threads; }
+
+  /*
+   * Configures the segmenter to periodically save checkpoints of merging to
+   * path, see ClosureGlyphSegmenter::SetCheckpointing().
+   */
+  void SetCheckpointing(std::string path, absl::Duration interval) {
+    checkpoint_path_ = std::move(path);
+    checkpoint_interval_ = interval;
+  }
+
+  /*
+   * Configures the segmenter to resume merging from the checkpoint at path,
+   * see ClosureGlyphSegmenter::SetResumeFrom().
+   */
+  void SetResumeFrom(std::string path) { resume_from_ = std::move(path); }
+
   /*
    * Create a new segmenter, configure it with config, and then run the
    * segmenter on face.
@@ -108,6 +132,10 @@ class SegmenterConfigUtil {
 
   std::string config_file_path_;
   std::shared_ptr<ift::common::DataFileResolver> resolver_;
+  uint32_t num_threads_ = 1;
+  std::string checkpoint_path_;
+  absl::Duration checkpoint_interval_ = absl::ZeroDuration();
+  std::string resume_from_;
 };
 
 }  // namespace ift::config
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cstdint>
 #include <iterator>
+#include <memory>
 #include <optional>
 #include <utility>
 #include <vector>
@@ -51,57 +52,66 @@ StatusOr<DependencyGraph> DependencyGraph::Create(
     const RequestedSegmentationInformation* segmentation_info, hb_face_t* face,
     const DataFileResolver& resolver) {
   auto full_feature_set = TRY(FullFeatureSet(segmentation_info, face));
-  hb_depend_t* depend = hb_depend_from_face_or_fail(face);
+  std::unique_ptr<hb_depend_t, decltype(&hb_depend_destroy)> depend(
+      hb_depend_from_face_or_fail(face), &hb_depend_destroy);
   if (!depend) {
     return absl::InternalError("Call to hb_depend_from_face_or_fail() failed.");
   }
 
+  // Everything needed from harfbuzz's graph is exported here, after which it
+  // is no longer needed.
+  auto glyph_edges = TRY(
+      GlyphEdgeTable::Create(depend.get(), hb_face_get_glyph_count(face)));
+  depend.reset();
+
   auto unicode_edges =
       TRY(UnicodeEdges::ComputeUnicodeDependencyEdges(face, resolver));
 
-  return DependencyGraph(segmentation_info, depend, face, full_feature_set,
-                         std::move(unicode_edges));
+  return DependencyGraph(segmentation_info, std::move(glyph_edges), face,
+                         full_feature_set, std::move(unicode_edges));
 }
 
 DependencyGraph::DependencyGraph(
     const RequestedSegmentationInformation* segmentation_info,
-    hb_depend_t* depend, hb_face_t* face,
+    GlyphEdgeTable glyph_edges, hb_face_t* face,
     flat_hash_set<hb_tag_t> full_feature_set, UnicodeEdges unicode_edges)
     : segmentation_info_(segmentation_info),
       original_face_(ift::common::make_hb_face(hb_face_reference(face))),
       full_feature_set_(full_feature_set),
-      dependency_graph_(depend, &hb_depend_destroy),
-      layout_feature_implied_edges_(ComputeFeatureEdges()),
-      context_glyph_implied_edges_(ComputeContextGlyphEdges()),
-      unicode_edges_(std::move(unicode_edges)) {}
+      glyph_edges_(
+          std::make_shared<const GlyphEdgeTable>(std::move(glyph_edges))),
+      layout_feature_implied_edges_(
+          std::make_shared<const flat_hash_map<
+              hb_tag_t, std::vector<LayoutFeatureEdge>>>(
+              ComputeFeatureEdges())),
+      context_glyph_implied_edges_(
+          std::make_shared<const flat_hash_map<
+              glyph_id_t, std::vector<LayoutFeatureEdge>>>(
+              ComputeContextGlyphEdges())),
+      unicode_edges_(
+          std::make_shared<const UnicodeEdges>(std::move(unicode_edges))) {}
+
+DependencyGraph::DependencyGraph(
+    const DependencyGraph& other,
+    const RequestedSegmentationInformation* segmentation_info)
+    : segmentation_info_(segmentation_info),
+      original_face_(ift::common::make_hb_face(
+          hb_face_reference(other.original_face_.get()))),
+      full_feature_set_(other.full_feature_set_),
+      glyph_edges_(other.glyph_edges_),
+      layout_feature_implied_edges_(other.layout_feature_implied_edges_),
+      context_glyph_implied_edges_(other.context_glyph_implied_edges_),
+      unicode_edges_(other.unicode_edges_) {}
+
+DependencyGraph DependencyGraph::WithSegmentationInfo(
+    const RequestedSegmentationInformation* segmentation_info) const {
+  return DependencyGraph(*this, segmentation_info);
+}
 
-StatusOr<GlyphSet> GetContextSet(hb_depend_t* depend,
+StatusOr<GlyphSet> GetContextSet(const GlyphEdgeTable& glyph_edges,
                                  const GlyphSet* full_closure,
                                  hb_codepoint_t context_set_id) {
-  // the context set is actually a set of sets.
-  hb_set_unique_ptr context_sets = make_hb_set();
-  if (!hb_depend_get_set_from_index(depend, context_set_id,
-                                    context_sets.get())) {
-    return absl::InternalError("Context set lookup failed.");
-  }
-
-  GlyphSet glyphs;
-  hb_codepoint_t set_id = HB_CODEPOINT_INVALID;
-  while (hb_set_next(context_sets.get(), &set_id)) {
-    if (set_id < 0x80000000) {
-      // special case, set of one element.
-      glyphs.insert(set_id);
-      continue;
-    }
-
-    hb_codepoint_t actual_set_id = set_id & 0x7FFFFFFF;
-    hb_set_unique_ptr context_glyphs = make_hb_set();
-    if (!hb_depend_get_set_from_index(depend, actual_set_id,
-                                      context_glyphs.get())) {
-      return absl::InternalError("Context sub set lookup failed.");
-    }
-    glyphs.union_from(context_glyphs.get());
-  }
+  GlyphSet glyphs = TRY(glyph_edges.ContextGlyphs(context_set_id));
 
   // Only glyphs in the full closure are relevant.
   if (full_closure) {
@@ -115,7 +125,7 @@ StatusOr<GlyphSet> GetContextSet(hb_depend_t* depend,
 template <typename CallbackT>
 class TraversalContext {
  public:
-  hb_depend_t* depend = nullptr;
+  const GlyphEdgeTable* glyph_edges = nullptr;
 
   // Only edges from these tables will be followed.
   flat_hash_set<hb_tag_t> table_filter = {FontHelper::kCmap, FontHelper::kGlyf,
@@ -161,16 +171,11 @@ class TraversalContext {
   GlyphSet reached_glyphs_;
   flat_hash_set<hb_tag_t> reached_features_;
 
-  // To avoid creating and destroying sets every time we pull a liga or context
-  // set from the dep graph api store a scratch set that's reused.
-  hb_set_unique_ptr scratch_set_ = make_hb_set();
-  hb_set_unique_ptr scratch_set_aux_ = make_hb_set();
-
  public:
   TraversalContext() = default;
 
   TraversalContext(const TraversalContext& other) {
-    depend = other.depend;
+    glyph_edges = other.glyph_edges;
     table_filter = other.table_filter;
     glyph_filter = other.glyph_filter;
     unicode_filter = other.unicode_filter;
@@ -212,7 +217,7 @@ class TraversalContext {
   // This checks all pending edges and if any have their constraints satisfied
   // then they are traversed. Returns true if there are now more nodes in the
   // next queue.
-  StatusOr<bool> CheckPending(hb_depend_t* depend_graph);
+  StatusOr<bool> CheckPending();
 
   // Returns true if one or more pending edges remains.
   //
@@ -332,43 +337,19 @@ class TraversalContext {
  private:
   StatusOr<bool> LigaSetSatisfied(hb_codepoint_t liga_set,
                                   const GlyphSet& reached) {
-    if (!hb_depend_get_set_from_index(depend, liga_set, scratch_set_.get())) {
-      return absl::InternalError(
-          "ConstraintsSatisfied(): Ligature set lookup failed.");
-    }
+    const GlyphSet* liga_glyphs = TRY(glyph_edges->LigatureSet(liga_set));
 
     // All liga glyphs must be reached.
-    return IntSet::is_subset_of(scratch_set_.get(), reached);
+    return liga_glyphs->is_subset_of(reached);
   }
 
   StatusOr<bool> ContextSetSatisfied(hb_codepoint_t context_set_index,
                                      const GlyphSet& reached) {
-    // the context set is actually a set of sets.
-    if (!hb_depend_get_set_from_index(depend, context_set_index,
-                                      scratch_set_.get())) {
-      return absl::InternalError(
-          "ContextSetSatisfied(): Context set lookup failed.");
-    }
-
-    GlyphSet glyphs;
-    hb_codepoint_t set_id = HB_CODEPOINT_INVALID;
-    while (hb_set_next(scratch_set_.get(), &set_id)) {
-      if (set_id < 0x80000000) {
-        // special case, set of one element.
-        if (!reached.contains(set_id)) {
-          return false;
-        }
-        continue;
-      }
-
-      hb_codepoint_t actual_set_id = set_id & 0x7FFFFFFF;
-      if (!hb_depend_get_set_from_index(depend, actual_set_id,
-                                        scratch_set_aux_.get())) {
-        return absl::InternalError("Context sub set lookup failed.");
-      }
-
+    Span<const GlyphSet> groups =
+        TRY(glyph_edges->ContextSet(context_set_index));
+    for (const GlyphSet& group : groups) {
       // need minimum of one glyph in each sub-group to be reached.
-      if (!reached.intersects(scratch_set_aux_.get())) {
+      if (!reached.intersects(group)) {
         return false;
       }
     }
@@ -462,7 +443,7 @@ Status DependencyGraph::ClosureState::Visit(const TraversalContext<ClosureState>
       edge.required_feature.has_value()) {
     if (edge.required_context_set_index.has_value() && collect_context) {
       GlyphSet context_glyphs =
-          TRY(GetContextSet(context.depend, context.full_closure,
+          TRY(GetContextSet(*context.glyph_edges, context.full_closure,
                             *edge.required_context_set_index));
       traversal.VisitContextual(edge.dest, *edge.required_feature, context_glyphs);
     } else {
@@ -486,8 +467,7 @@ std::optional<Node> DependencyGraph::ClosureState::GetNext() {
 }
 
 bool DependencyGraph::ClosureState::Reached(Node node) {
-  auto [_, did_insert] = visited.insert(node);
-  if (!did_insert) {
+  if (!visited.insert(node)) {
     return false;
   }
 
@@ -510,8 +490,7 @@ static Status DoTraversal(const PendingEdge& edge,
 }
 
 template <typename CallbackT>
-StatusOr<bool> TraversalContext<CallbackT>::CheckPending(
-    hb_depend_t* depend_graph) {
+StatusOr<bool> TraversalContext<CallbackT>::CheckPending() {
   bool did_work = false;
   auto it = pending_edges_.begin();
   while (it != pending_edges_.end()) {
@@ -591,7 +570,7 @@ DependencyGraph::StronglyConnectedComponents(
   GlyphSet non_init_font_glyphs = segmentation_info_->NonInitFontGlyphs();
 
   TraversalContext<Callback> context;
-  context.depend = dependency_graph_.get();
+  context.glyph_edges = glyph_edges_.get();
   context.full_closure = &segmentation_info_->FullClosure();
   context.enforce_context = false;
   context.unicode_filter = &non_init_font_codepoints;
@@ -744,7 +723,7 @@ StatusOr<Traversal> DependencyGraph::TraverseGraph(
   while (true) {
     std::optional<Node> next = context->callback.GetNext();
     if (!next.has_value()) {
-      if (TRY(context->CheckPending(dependency_graph_.get())) &&
+      if (TRY(context->CheckPending()) &&
           !context->callback.next.empty()) {
         continue;
       } else {
@@ -815,7 +794,7 @@ StatusOr<Traversal> DependencyGraph::ClosureTraversal(
   // https://github.com/harfbuzz/harfbuzz/blob/main/src/hb-subset-plan.cc#L439
 
   TraversalContext<ClosureState> base_context;
-  base_context.depend = dependency_graph_.get();
+  base_context.glyph_edges = glyph_edges_.get();
   base_context.unicode_filter =
       unicode_filter_ptr ? unicode_filter_ptr : &non_init_font_codepoints;
   base_context.glyph_filter =
@@ -901,29 +880,29 @@ template <typename CallbackT>
 Status DependencyGraph::HandleUnicodeOutgoingEdges(
     hb_codepoint_t unicode, TraversalContext<CallbackT>* context) const {
   {
-    auto it = unicode_edges_.unicode_to_gid.find(unicode);
-    if (it != unicode_edges_.unicode_to_gid.end()) {
+    auto it = unicode_edges_->unicode_to_gid.find(unicode);
+    if (it != unicode_edges_->unicode_to_gid.end()) {
       TRYV(context->TraverseEdgeTo(Node::Unicode(unicode), Node::Glyph(it->second)));
     }
   }
 
-  auto vs_edges = unicode_edges_.variation_selector.find(unicode);
-  if (vs_edges != unicode_edges_.variation_selector.end()) {
+  auto vs_edges = unicode_edges_->variation_selector.find(unicode);
+  if (vs_edges != unicode_edges_->variation_selector.end()) {
     for (VariationSelectorEdge edge : vs_edges->second) {
       TRYV(context->TraverseUvsEdge(unicode, edge.unicode, edge.gid));
     }
   }
 
-  auto comp_edges = unicode_edges_.composition.find(unicode);
-  if (comp_edges != unicode_edges_.composition.end()) {
+  auto comp_edges = unicode_edges_->composition.find(unicode);
+  if (comp_edges != unicode_edges_->composition.end()) {
     for (const auto& edge : comp_edges->second) {
       TRYV(context->TraverseCompositionEdge(unicode, edge.other_source,
                                             edge.dest));
     }
   }
 
-  auto decomp_edges = unicode_edges_.decomposition.find(unicode);
-  if (decomp_edges != unicode_edges_.decomposition.end()) {
+  auto decomp_edges = unicode_edges_->decomposition.find(unicode);
+  if (decomp_edges != unicode_edges_->decomposition.end()) {
     for (hb_codepoint_t dest : decomp_edges->second) {
       TRYV(context->TraverseEdgeTo(Node::Unicode(unicode), Node::Unicode(dest),
                               FontHelper::kCmap));
@@ -944,39 +923,31 @@ Status DependencyGraph::HandleUnicodeOutgoingEdges(
 template <typename CallbackT>
 Status DependencyGraph::HandleGlyphOutgoingEdges(
     glyph_id_t gid, TraversalContext<CallbackT>* context) const {
-  hb_codepoint_t index = 0;
-  hb_tag_t table_tag = HB_CODEPOINT_INVALID;
-  hb_codepoint_t dep_gid = HB_CODEPOINT_INVALID;
-  hb_tag_t layout_tag = HB_CODEPOINT_INVALID;
-  hb_codepoint_t ligature_set = HB_CODEPOINT_INVALID;
-  hb_codepoint_t context_set = HB_CODEPOINT_INVALID;
-
-  while (hb_depend_get_glyph_entry(
-      dependency_graph_.get(), gid, index++, &table_tag, &dep_gid, &layout_tag,
-      &ligature_set, &context_set, nullptr /* flags */)) {
+  for (const GlyphEdgeTable::Edge& edge : glyph_edges_->EdgesFrom(gid)) {
     // Pre-filter to avoid doing extra work if not needed
     // TODO XXXX we're filtering twice once here, and once in TravserseEdgeTo
     // can we only filter once?
-    if (!context->table_filter.contains(table_tag)) {
+    if (!context->table_filter.contains(edge.table_tag)) {
       continue;
     }
     if (context->glyph_filter != nullptr &&
-        !context->glyph_filter->contains(dep_gid)) {
+        !context->glyph_filter->contains(edge.dest_gid)) {
       continue;
     }
 
-    Node dest = Node::Glyph(dep_gid);
-    if (table_tag == HB_TAG('G', 'S', 'U', 'B')) {
-      TRYV(HandleGsubGlyphOutgoingEdges(gid, dep_gid, layout_tag, ligature_set,
-                                        context_set, context));
+    if (edge.kind != GlyphEdgeTable::DISJUNCTIVE) {
+      TRYV(HandleGsubGlyphOutgoingEdges(gid, edge.dest_gid, edge.layout_tag,
+                                        edge.ligature_set, edge.context_set,
+                                        context));
       continue;
     }
 
-    TRYV(context->TraverseEdgeTo(Node::Glyph(gid), dest, table_tag));
+    TRYV(context->TraverseEdgeTo(Node::Glyph(gid), Node::Glyph(edge.dest_gid),
+                                 edge.table_tag));
   }
 
-  auto it = context_glyph_implied_edges_.find(gid);
-  if (it == context_glyph_implied_edges_.end()) {
+  auto it = context_glyph_implied_edges_->find(gid);
+  if (it == context_glyph_implied_edges_->end()) {
     return absl::OkStatus();
   }
 
@@ -1019,8 +990,8 @@ Status DependencyGraph::HandleFeatureOutgoingEdges(
     return absl::OkStatus();
   }
 
-  auto edges = layout_feature_implied_edges_.find(feature_tag);
-  if (edges == layout_feature_implied_edges_.end()) {
+  auto edges = layout_feature_implied_edges_->find(feature_tag);
+  if (edges == layout_feature_implied_edges_->end()) {
     // No outgoing edges
     return absl::OkStatus();
   }
@@ -1125,7 +1096,7 @@ StatusOr<GlyphSet> DependencyGraph::RequiredGlyphsFor(
   }
 
   if (edge.required_context_set_index.has_value()) {
-    out.union_set(TRY(GetContextSet(dependency_graph_.get(),
+    out.union_set(TRY(GetContextSet(*glyph_edges_,
                                     &segmentation_info_->FullClosure(),
                                     *edge.required_context_set_index)));
   }
@@ -1135,12 +1106,8 @@ StatusOr<GlyphSet> DependencyGraph::RequiredGlyphsFor(
 
 StatusOr<GlyphSet> DependencyGraph::GetLigaSet(
     hb_codepoint_t liga_set_id) const {
-  if (!hb_depend_get_set_from_index(dependency_graph_.get(), liga_set_id,
-                                    scratch_set_.get())) {
-    return absl::InternalError("Ligature set lookup failed.");
-  }
-  GlyphSet glyphs(scratch_set_.get());
-  return glyphs;
+  const GlyphSet* glyphs = TRY(glyph_edges_->LigatureSet(liga_set_id));
+  return *glyphs;
 }
 
 StatusOr<EdgeConditionsCnf> DependencyGraph::ExtractRequirements(
@@ -1173,32 +1140,13 @@ StatusOr<EdgeConditionsCnf> DependencyGraph::ExtractRequirements(
   // dep graph documentation for more details. They can be used to
   // decide if the resulting conditions are exact or an over approximation.
   if (edge.required_context_set_index.has_value()) {
-    // the context set is actually a set of sets.
-    if (!hb_depend_get_set_from_index(dependency_graph_.get(),
-                                      *edge.required_context_set_index,
-                                      scratch_set_.get())) {
-      return absl::InternalError("Context set lookup failed.");
-    }
-
-    hb_codepoint_t set_id = HB_CODEPOINT_INVALID;
-    while (hb_set_next(scratch_set_.get(), &set_id)) {
+    Span<const GlyphSet> groups =
+        TRY(glyph_edges_->ContextSet(*edge.required_context_set_index));
+    for (const GlyphSet& group : groups) {
+      // Sets iterate in order, so the sub group is created sorted.
       std::vector<Node> req;
-      if (set_id < 0x80000000) {
-        req.push_back(Node::Glyph(set_id));
-      } else {
-        hb_codepoint_t actual_set_id = set_id & 0x7FFFFFFF;
-        if (!hb_depend_get_set_from_index(dependency_graph_.get(),
-                                          actual_set_id,
-                                          scratch_set_aux_.get())) {
-          return absl::InternalError("Context sub set lookup failed.");
-        }
-
-        // Creating the sub group from a hb set ensure's it's created
-        // sorted.
-        hb_codepoint_t gid = HB_CODEPOINT_INVALID;
-        while (hb_set_next(scratch_set_aux_.get(), &gid)) {
-          req.push_back(Node::Glyph(gid));
-        }
+      for (glyph_id_t gid : group) {
+        req.push_back(Node::Glyph(gid));
       }
       if (!req.empty()) {
         requirements.push_back(std::move(req));
@@ -1217,14 +1165,14 @@ StatusOr<EdgeConditionsCnf> DependencyGraph::ExtractRequirements(
 flat_hash_map<glyph_id_t, std::vector<DependencyGraph::LayoutFeatureEdge>>
 DependencyGraph::ComputeContextGlyphEdges() const {
   flat_hash_map<glyph_id_t, btree_set<LayoutFeatureEdge>> edges;
-  for (const auto& [tag, feature_edges] : layout_feature_implied_edges_) {
+  for (const auto& [tag, feature_edges] : *layout_feature_implied_edges_) {
     for (const auto& edge : feature_edges) {
       if (edge.context_set == HB_CODEPOINT_INVALID) {
         continue;
       }
 
       StatusOr<GlyphSet> context_glyphs =
-          GetContextSet(dependency_graph_.get(), nullptr, edge.context_set);
+          GetContextSet(*glyph_edges_, nullptr, edge.context_set);
       if (!context_glyphs.ok()) {
         continue;
       }
@@ -1249,28 +1197,19 @@ flat_hash_map<hb_tag_t, std::vector<DependencyGraph::LayoutFeatureEdge>>
 DependencyGraph::ComputeFeatureEdges() const {
   flat_hash_map<hb_tag_t, btree_set<DependencyGraph::LayoutFeatureEdge>> edges;
 
-  for (glyph_id_t gid = 0; gid < hb_face_get_glyph_count(original_face_.get());
-       gid++) {
-    hb_codepoint_t index = 0;
-    hb_tag_t table_tag = HB_CODEPOINT_INVALID;
-    hb_codepoint_t dest_gid = HB_CODEPOINT_INVALID;
-    hb_tag_t layout_tag = HB_CODEPOINT_INVALID;
-    hb_codepoint_t ligature_set = HB_CODEPOINT_INVALID;
-    hb_codepoint_t context_set = HB_CODEPOINT_INVALID;
-    while (hb_depend_get_glyph_entry(
-        dependency_graph_.get(), gid, index++, &table_tag, &dest_gid,
-        &layout_tag, &ligature_set, &context_set, nullptr /* flags */)) {
-      if (table_tag != FontHelper::kGSUB ||
-          layout_tag == HB_CODEPOINT_INVALID) {
+  for (glyph_id_t gid = 0; gid < glyph_edges_->GlyphCount(); gid++) {
+    for (const GlyphEdgeTable::Edge& edge : glyph_edges_->EdgesFrom(gid)) {
+      if (edge.table_tag != FontHelper::kGSUB ||
+          edge.layout_tag == HB_CODEPOINT_INVALID) {
         continue;
       }
 
-      edges[layout_tag].insert(LayoutFeatureEdge{
-          .layout_tag = layout_tag,
+      edges[edge.layout_tag].insert(LayoutFeatureEdge{
+          .layout_tag = edge.layout_tag,
           .source_gid = gid,
-          .dest_gid = dest_gid,
-          .ligature_set = ligature_set,
-          .context_set = context_set,
+          .dest_gid = edge.dest_gid,
+          .ligature_set = edge.ligature_set,
+          .context_set = edge.context_set,
       });
     }
   }
@@ -1306,7 +1245,7 @@ DependencyGraph::CollectIncomingEdges(
   // flat_hash_set instead of btree, return sorted vector at the end
   flat_hash_map<Node, flat_hash_set<EdgeConditionsCnf>> incoming_edges;
   TraversalContext<IncomingEdgeCollector> context;
-  context.depend = dependency_graph_.get();
+  context.glyph_edges = glyph_edges_.get();
   context.full_closure = &segmentation_info_->FullClosure();
   context.feature_filter = &full_feature_set_;
   context.glyph_filter = &segmentation_info_->FullClosure();
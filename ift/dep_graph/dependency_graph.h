@@ -13,6 +13,7 @@
 #include "ift/common/font_helper.h"
 #include "ift/common/hb_set_unique_ptr.h"
 #include "ift/common/int_set.h"
+#include "ift/dep_graph/glyph_edge_table.h"
 #include "ift/dep_graph/node.h"
 #include "ift/dep_graph/traversal.h"
 #include "ift/dep_graph/unicode_edges.h"
@@ -35,7 +36,9 @@ class TraversalContext;
 /*
  * Wrapper around harfbuzz's glyph dependency graph API.
  *
- * Allows exploring glyph dependencies within a font.
+ * Allows exploring glyph dependencies within a font. The harfbuzz graph is
+ * exported once on creation into a GlyphEdgeTable, all traversals then run
+ * over that snapshot.
  */
 class DependencyGraph {
  private:
@@ -81,6 +84,13 @@ class DependencyGraph {
       const ift::encoder::RequestedSegmentationInformation* segmentation_info,
       hb_face_t* face, const ift::common::DataFileResolver& resolver);
 
+  // Returns a copy of this graph which reads segment information from
+  // segmentation_info instead. The edge tables depend only on the font so are
+  // shared with the copy instead of being copied.
+  DependencyGraph WithSegmentationInfo(
+      const ift::encoder::RequestedSegmentationInformation* segmentation_info)
+      const;
+
   // Traverse the full dependency graph (segments, unicodes, and gids), starting
   // at one or more specific starting nodes. Attempts to mimic hb glyph closure
   // and does the traversal in phases by table. Additionally if enforce_context
@@ -136,13 +146,17 @@ class DependencyGraph {
  private:
   DependencyGraph(
       const ift::encoder::RequestedSegmentationInformation* segmentation_info,
-      hb_depend_t* depend, hb_face_t* face,
+      GlyphEdgeTable glyph_edges, hb_face_t* face,
       absl::flat_hash_set<hb_tag_t> full_feature_set,
       UnicodeEdges unicode_edges);
 
+  DependencyGraph(
+      const DependencyGraph& other,
+      const ift::encoder::RequestedSegmentationInformation* segmentation_info);
+
   struct ClosureState {
     std::vector<Node> next{};
-    absl::flat_hash_set<Node> visited{};
+    NodeSet visited{};
     Traversal traversal;
     bool collect_context = true;
 
@@ -213,7 +227,8 @@ class DependencyGraph {
   ift::common::hb_face_unique_ptr original_face_;
   absl::flat_hash_set<hb_tag_t> full_feature_set_;
 
-  std::unique_ptr<hb_depend_t, decltype(&hb_depend_destroy)> dependency_graph_;
+  // The edge tables are immutable, see WithSegmentationInfo().
+  std::shared_ptr<const GlyphEdgeTable> glyph_edges_;
 
   struct LayoutFeatureEdge {
     hb_tag_t layout_tag;
@@ -252,16 +267,15 @@ class DependencyGraph {
 
   std::vector<Node> AllNodes(uint32_t node_type_filter) const;
 
-  absl::flat_hash_map<hb_tag_t, std::vector<LayoutFeatureEdge>>
+  std::shared_ptr<
+      const absl::flat_hash_map<hb_tag_t, std::vector<LayoutFeatureEdge>>>
       layout_feature_implied_edges_;
 
-  absl::flat_hash_map<encoder::glyph_id_t, std::vector<LayoutFeatureEdge>>
+  std::shared_ptr<const absl::flat_hash_map<encoder::glyph_id_t,
+                                            std::vector<LayoutFeatureEdge>>>
       context_glyph_implied_edges_;
 
-  UnicodeEdges unicode_edges_;
-
-  common::hb_set_unique_ptr scratch_set_ = common::make_hb_set();
-  common::hb_set_unique_ptr scratch_set_aux_ = common::make_hb_set();
+  std::shared_ptr<const UnicodeEdges> unicode_edges_;
 };
 
 }  // namespace ift::dep_graph
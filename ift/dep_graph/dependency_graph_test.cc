@@ -9,6 +9,7 @@
 #include "ift/common/font_data.h"
 #include "ift/common/font_helper.h"
 #include "ift/common/int_set.h"
+#include "ift/dep_graph/node.h"
 #include "ift/dep_graph/traversal.h"
 #include "ift/encoder/glyph_closure_cache.h"
 #include "ift/encoder/requested_segmentation_information.h"
@@ -934,6 +935,46 @@ TEST_F(DependencyGraphTest, CollectIncomingEdges_NodeInclusionFilter) {
                       }));
 }
 
+TEST(NodeSetTest, InsertAndContains) {
+  // Same id for each type, these must all be distinct.
+  std::vector<Node> nodes = {
+      Node::InitFont(),
+      Node::Segment(3),
+      Node::Unicode(3),
+      Node::Glyph(3),
+      Node::Feature(HB_TAG('l', 'i', 'g', 'a')),
+  };
+
+  NodeSet set;
+  for (size_t i = 0; i < nodes.size(); i++) {
+    ASSERT_FALSE(set.contains(nodes[i])) << nodes[i].ToString();
+    ASSERT_TRUE(set.insert(nodes[i])) << nodes[i].ToString();
+    ASSERT_TRUE(set.contains(nodes[i])) << nodes[i].ToString();
+    ASSERT_FALSE(set.insert(nodes[i])) << nodes[i].ToString();
+    for (size_t j = i + 1; j < nodes.size(); j++) {
+      ASSERT_FALSE(set.contains(nodes[j])) << nodes[j].ToString();
+    }
+  }
+
+  ASSERT_FALSE(set.contains(Node::Segment(4)));
+  ASSERT_FALSE(set.contains(Node::Unicode(4)));
+  ASSERT_FALSE(set.contains(Node::Glyph(4)));
+  ASSERT_FALSE(set.contains(Node::Feature(HB_TAG('c', 'a', 'l', 't'))));
+
+  // Large and far apart ids.
+  for (Node node : {Node::Unicode(0x10FFFF), Node::Unicode(0x20),
+                    Node::Glyph(65000), Node::Segment(100000)}) {
+    ASSERT_TRUE(set.insert(node)) << node.ToString();
+    ASSERT_TRUE(set.contains(node)) << node.ToString();
+    ASSERT_FALSE(set.insert(node)) << node.ToString();
+  }
+  ASSERT_FALSE(set.contains(Node::Glyph(0x10FFFF)));
+  ASSERT_FALSE(set.contains(Node::Unicode(65000)));
+  for (Node node : nodes) {
+    ASSERT_TRUE(set.contains(node)) << node.ToString();
+  }
+}
+
 // TODO(garretrieger):
 // - basic math, CFF, and COLR tests.
 
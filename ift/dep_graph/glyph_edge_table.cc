@@ -0,0 +1,174 @@
+#include "ift/dep_graph/glyph_edge_table.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "ift/common/font_helper.h"
+#include "ift/common/hb_set_unique_ptr.h"
+#include "ift/common/int_set.h"
+#include "ift/common/try.h"
+
+using absl::Span;
+using absl::StatusOr;
+using ift::common::FontHelper;
+using ift::common::GlyphSet;
+using ift::common::hb_set_unique_ptr;
+using ift::common::make_hb_set;
+using ift::encoder::glyph_id_t;
+
+namespace ift::dep_graph {
+
+StatusOr<GlyphEdgeTable> GlyphEdgeTable::Create(hb_depend_t* depend,
+                                                uint32_t glyph_count) {
+  if (depend == nullptr) {
+    return absl::InvalidArgumentError("depend must not be null.");
+  }
+
+  GlyphEdgeTable table;
+  table.offsets_.reserve(glyph_count + 1);
+  for (glyph_id_t gid = 0; gid < glyph_count; gid++) {
+    table.offsets_.push_back(table.edges_.size());
+
+    hb_codepoint_t index = 0;
+    hb_tag_t table_tag = HB_CODEPOINT_INVALID;
+    hb_codepoint_t dest_gid = HB_CODEPOINT_INVALID;
+    hb_tag_t layout_tag = HB_CODEPOINT_INVALID;
+    hb_codepoint_t ligature_set = HB_CODEPOINT_INVALID;
+    hb_codepoint_t context_set = HB_CODEPOINT_INVALID;
+    while (hb_depend_get_glyph_entry(depend, gid, index++, &table_tag,
+                                     &dest_gid, &layout_tag, &ligature_set,
+                                     &context_set, nullptr /* flags */)) {
+      EdgeKind kind = DISJUNCTIVE;
+      if (table_tag == FontHelper::kGSUB) {
+        if (context_set != HB_CODEPOINT_INVALID) {
+          kind = CONTEXT;
+        } else if (ligature_set != HB_CODEPOINT_INVALID) {
+          kind = LIGATURE;
+        } else {
+          kind = GSUB;
+        }
+      }
+
+      table.edges_.push_back(Edge{
+          .table_tag = table_tag,
+          .dest_gid = dest_gid,
+          .layout_tag = layout_tag,
+          .ligature_set = ligature_set,
+          .context_set = context_set,
+          .kind = kind,
+      });
+    }
+  }
+  table.offsets_.push_back(table.edges_.size());
+  table.edges_.shrink_to_fit();
+
+  table.LoadSets([depend](hb_codepoint_t index, hb_set_t* out) {
+    return hb_depend_get_set_from_index(depend, index, out);
+  });
+  return table;
+}
+
+void GlyphEdgeTable::LoadSets(SetLoader load_set) {
+  std::vector<hb_codepoint_t> ligature_ids;
+  std::vector<hb_codepoint_t> context_ids;
+  for (const Edge& edge : edges_) {
+    if (edge.ligature_set != HB_CODEPOINT_INVALID) {
+      ligature_ids.push_back(edge.ligature_set);
+    }
+    if (edge.context_set != HB_CODEPOINT_INVALID) {
+      context_ids.push_back(edge.context_set);
+    }
+  }
+  for (auto* ids : {&ligature_ids, &context_ids}) {
+    std::sort(ids->begin(), ids->end());
+    ids->erase(std::unique(ids->begin(), ids->end()), ids->end());
+  }
+
+  hb_set_unique_ptr scratch = make_hb_set();
+  hb_set_unique_ptr scratch_aux = make_hb_set();
+
+  if (!ligature_ids.empty()) {
+    ligature_set_slots_.assign(ligature_ids.back() + 1, kMissing);
+  }
+  for (hb_codepoint_t id : ligature_ids) {
+    if (!load_set(id, scratch.get())) {
+      continue;
+    }
+    ligature_set_slots_[id] = ligature_sets_.size();
+    ligature_sets_.push_back(GlyphSet(scratch));
+  }
+
+  if (!context_ids.empty()) {
+    context_set_slots_.assign(context_ids.back() + 1, kMissing);
+  }
+  context_offsets_.push_back(0);
+  for (hb_codepoint_t id : context_ids) {
+    if (!LoadContextGroups(load_set, id, scratch.get(), scratch_aux.get())) {
+      context_groups_.resize(context_offsets_.back());
+      continue;
+    }
+    context_set_slots_[id] = context_offsets_.size() - 1;
+    context_offsets_.push_back(context_groups_.size());
+  }
+}
+
+bool GlyphEdgeTable::LoadContextGroups(SetLoader load_set, hb_codepoint_t index,
+                                       hb_set_t* scratch,
+                                       hb_set_t* scratch_aux) {
+  // The context set is actually a set of sets.
+  if (!load_set(index, scratch)) {
+    return false;
+  }
+
+  hb_codepoint_t set_id = HB_CODEPOINT_INVALID;
+  while (hb_set_next(scratch, &set_id)) {
+    if (set_id < 0x80000000) {
+      // special case, set of one element.
+      context_groups_.push_back(GlyphSet{set_id});
+      continue;
+    }
+
+    if (!load_set(set_id & 0x7FFFFFFF, scratch_aux)) {
+      return false;
+    }
+    context_groups_.push_back(GlyphSet(scratch_aux));
+  }
+  return true;
+}
+
+StatusOr<const GlyphSet*> GlyphEdgeTable::LigatureSet(
+    hb_codepoint_t ligature_set) const {
+  if (ligature_set >= ligature_set_slots_.size() ||
+      ligature_set_slots_[ligature_set] == kMissing) {
+    return absl::InternalError("Ligature set lookup failed.");
+  }
+  return &ligature_sets_[ligature_set_slots_[ligature_set]];
+}
+
+StatusOr<Span<const GlyphSet>> GlyphEdgeTable::ContextSet(
+    hb_codepoint_t context_set) const {
+  if (context_set >= context_set_slots_.size() ||
+      context_set_slots_[context_set] == kMissing) {
+    return absl::InternalError("Context set lookup failed.");
+  }
+  uint32_t slot = context_set_slots_[context_set];
+  return absl::MakeConstSpan(context_groups_.data() + context_offsets_[slot],
+                             context_offsets_[slot + 1] -
+                                 context_offsets_[slot]);
+}
+
+StatusOr<GlyphSet> GlyphEdgeTable::ContextGlyphs(
+    hb_codepoint_t context_set) const {
+  Span<const GlyphSet> groups = TRY(ContextSet(context_set));
+  GlyphSet glyphs;
+  for (const GlyphSet& group : groups) {
+    glyphs.union_set(group);
+  }
+  return glyphs;
+}
+
+}  // namespace ift::dep_graph
@@ -0,0 +1,118 @@
+#ifndef IFT_DEP_GRAPH_GLYPH_EDGE_TABLE_H_
+#define IFT_DEP_GRAPH_GLYPH_EDGE_TABLE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "hb.h"
+#include "ift/common/int_set.h"
+#include "ift/encoder/types.h"
+
+namespace ift::dep_graph {
+
+/*
+ * A read only snapshot of the glyph edges of a harfbuzz dependency graph
+ * (hb_depend_t).
+ *
+ * Edges are exported once, in compressed sparse row form: the outgoing edges
+ * of glyph g are edges()[offsets[g] .. offsets[g + 1]). The ligature and
+ * context sets referenced by edges are also exported up front, so traversals
+ * never need to go back to harfbuzz and can run concurrently.
+ */
+class GlyphEdgeTable {
+ public:
+  enum EdgeKind : uint8_t {
+    // A plain dependency (glyf, CFF, COLR, MATH, ...).
+    DISJUNCTIVE,
+    // GSUB edge with no additional glyph requirements.
+    GSUB,
+    // GSUB edge which also requires all glyphs of a ligature set.
+    LIGATURE,
+    // GSUB edge which also requires glyphs from a context set.
+    CONTEXT,
+  };
+
+  struct Edge {
+    hb_tag_t table_tag;
+    encoder::glyph_id_t dest_gid;
+    hb_tag_t layout_tag;
+    hb_codepoint_t ligature_set;
+    hb_codepoint_t context_set;
+    EdgeKind kind;
+  };
+
+  static absl::StatusOr<GlyphEdgeTable> Create(hb_depend_t* depend,
+                                               uint32_t glyph_count);
+
+  GlyphEdgeTable() = default;
+
+  uint32_t GlyphCount() const {
+    return offsets_.empty() ? 0 : offsets_.size() - 1;
+  }
+
+  // The edges out of gid, in the same order hb_depend_get_glyph_entry()
+  // returns them.
+  absl::Span<const Edge> EdgesFrom(encoder::glyph_id_t gid) const {
+    if (gid >= GlyphCount()) {
+      return {};
+    }
+    return absl::MakeConstSpan(edges_.data() + offsets_[gid],
+                               offsets_[gid + 1] - offsets_[gid]);
+  }
+
+  // The glyphs of a ligature set, all of which must be present for a
+  // ligature edge to apply.
+  absl::StatusOr<const ift::common::GlyphSet*> LigatureSet(
+      hb_codepoint_t ligature_set) const;
+
+  // The groups of a context set, at least one glyph from each group must be
+  // present for a context edge to apply.
+  absl::StatusOr<absl::Span<const ift::common::GlyphSet>> ContextSet(
+      hb_codepoint_t context_set) const;
+
+  // Union of all groups in a context set.
+  absl::StatusOr<ift::common::GlyphSet> ContextGlyphs(
+      hb_codepoint_t context_set) const;
+
+  size_t EdgeCount() const { return edges_.size(); }
+
+ private:
+  friend class GlyphEdgeTableTest;
+
+  // Loads the hb_depend_t set with the given index into out, returns false if
+  // it could not be loaded.
+  using SetLoader =
+      absl::FunctionRef<bool(hb_codepoint_t index, hb_set_t* out)>;
+
+  // Exports all of the ligature and context sets referenced by edges_.
+  void LoadSets(SetLoader load_set);
+
+  // Appends the groups of context set index to context_groups_, returns
+  // false if the set (or one of its groups) could not be loaded.
+  bool LoadContextGroups(SetLoader load_set, hb_codepoint_t index,
+                         hb_set_t* scratch, hb_set_t* scratch_aux);
+
+  static constexpr uint32_t kMissing = UINT32_MAX;
+
+  std::vector<uint32_t> offsets_;
+  std::vector<Edge> edges_;
+
+  // Indexed by hb_depend set index, gives the position of that set in
+  // ligature_sets_ or kMissing for sets which are not referenced by any edge
+  // (or failed to load).
+  std::vector<uint32_t> ligature_set_slots_;
+  std::vector<ift::common::GlyphSet> ligature_sets_;
+
+  // As above, the context set in slot s has groups
+  // context_groups_[context_offsets_[s] .. context_offsets_[s + 1]).
+  std::vector<uint32_t> context_set_slots_;
+  std::vector<uint32_t> context_offsets_;
+  std::vector<ift::common::GlyphSet> context_groups_;
+};
+
+}  // namespace ift::dep_graph
+
+#endif  // IFT_DEP_GRAPH_GLYPH_EDGE_TABLE_H_
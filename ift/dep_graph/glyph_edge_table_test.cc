@@ -0,0 +1,228 @@
+#include "ift/dep_graph/glyph_edge_table.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "gtest/gtest.h"
+#include "hb.h"
+#include "ift/common/font_helper.h"
+#include "ift/common/hb_set_unique_ptr.h"
+#include "ift/common/int_set.h"
+#include "ift/common/test_font_loader.h"
+
+using absl::flat_hash_map;
+using ift::common::FontHelper;
+using ift::common::GlyphSet;
+using ift::common::hb_face_unique_ptr;
+using ift::common::hb_set_unique_ptr;
+using ift::common::make_hb_set;
+
+namespace ift::dep_graph {
+
+class GlyphEdgeTableTest : public ::testing::Test {
+ protected:
+  GlyphEdgeTableTest()
+      : face(ift::common::TestFontLoader::Default()
+                 .value()
+                 ->LoadFace("ift/common/testdata/Roboto-Regular.ttf")
+                 .value()),
+        depend(hb_depend_from_face_or_fail(face.get()), &hb_depend_destroy) {}
+
+  // Builds a table with a single glyph (gid 0) that has edges, loading the
+  // ligature and context sets from sets.
+  static GlyphEdgeTable WithSets(
+      std::vector<GlyphEdgeTable::Edge> edges,
+      const flat_hash_map<hb_codepoint_t, std::vector<hb_codepoint_t>>& sets) {
+    GlyphEdgeTable table;
+    table.offsets_ = {0, (uint32_t)edges.size()};
+    table.edges_ = std::move(edges);
+    table.LoadSets([&sets](hb_codepoint_t index, hb_set_t* out) {
+      auto it = sets.find(index);
+      if (it == sets.end()) {
+        return false;
+      }
+      hb_set_clear(out);
+      for (hb_codepoint_t v : it->second) {
+        hb_set_add(out, v);
+      }
+      return true;
+    });
+    return table;
+  }
+
+  static size_t ContextGroupCount(const GlyphEdgeTable& table) {
+    return table.context_groups_.size();
+  }
+
+  static GlyphEdgeTable::Edge LigatureEdge(hb_codepoint_t ligature_set) {
+    return GlyphEdgeTable::Edge{
+        .table_tag = FontHelper::kGSUB,
+        .dest_gid = 1,
+        .layout_tag = HB_TAG('l', 'i', 'g', 'a'),
+        .ligature_set = ligature_set,
+        .context_set = HB_CODEPOINT_INVALID,
+        .kind = GlyphEdgeTable::LIGATURE,
+    };
+  }
+
+  static GlyphEdgeTable::Edge ContextEdge(hb_codepoint_t context_set) {
+    return GlyphEdgeTable::Edge{
+        .table_tag = FontHelper::kGSUB,
+        .dest_gid = 1,
+        .layout_tag = HB_TAG('c', 'a', 'l', 't'),
+        .ligature_set = HB_CODEPOINT_INVALID,
+        .context_set = context_set,
+        .kind = GlyphEdgeTable::CONTEXT,
+    };
+  }
+
+  GlyphSet SetFromIndex(hb_codepoint_t index) {
+    hb_set_unique_ptr set = make_hb_set();
+    EXPECT_TRUE(hb_depend_get_set_from_index(depend.get(), index, set.get()));
+    return GlyphSet(set);
+  }
+
+  // Decodes a context set (a set of sets) directly from hb_depend_t.
+  std::vector<GlyphSet> ContextGroups(hb_codepoint_t index) {
+    std::vector<GlyphSet> groups;
+    for (hb_codepoint_t set_id : SetFromIndex(index)) {
+      if (set_id < 0x80000000) {
+        groups.push_back(GlyphSet{set_id});
+      } else {
+        groups.push_back(SetFromIndex(set_id & 0x7FFFFFFF));
+      }
+    }
+    return groups;
+  }
+
+  hb_face_unique_ptr face;
+  std::unique_ptr<hb_depend_t, decltype(&hb_depend_destroy)> depend;
+};
+
+TEST_F(GlyphEdgeTableTest, NullDepend) {
+  auto table = GlyphEdgeTable::Create(nullptr, 10);
+  ASSERT_TRUE(absl::IsInvalidArgument(table.status())) << table.status();
+}
+
+TEST_F(GlyphEdgeTableTest, MatchesHbDepend) {
+  ASSERT_TRUE(depend);
+  uint32_t glyph_count = hb_face_get_glyph_count(face.get());
+  auto table = GlyphEdgeTable::Create(depend.get(), glyph_count);
+  ASSERT_TRUE(table.ok()) << table.status();
+  ASSERT_EQ(table->GlyphCount(), glyph_count);
+
+  size_t edge_count = 0;
+  uint32_t ligature_edges = 0;
+  const GlyphEdgeTable::Edge* next = nullptr;
+  for (uint32_t gid = 0; gid < glyph_count; gid++) {
+    auto edges = table->EdgesFrom(gid);
+    // Offsets are contiguous: each glyph's edges start where the previous
+    // glyph's end.
+    if (next != nullptr) {
+      ASSERT_EQ(edges.data(), next) << "gid " << gid;
+    }
+    next = edges.data() + edges.size();
+
+    hb_codepoint_t index = 0;
+    hb_tag_t table_tag = HB_CODEPOINT_INVALID;
+    hb_codepoint_t dest_gid = HB_CODEPOINT_INVALID;
+    hb_tag_t layout_tag = HB_CODEPOINT_INVALID;
+    hb_codepoint_t ligature_set = HB_CODEPOINT_INVALID;
+    hb_codepoint_t context_set = HB_CODEPOINT_INVALID;
+    while (hb_depend_get_glyph_entry(depend.get(), gid, index, &table_tag,
+                                     &dest_gid, &layout_tag, &ligature_set,
+                                     &context_set, nullptr /* flags */)) {
+      ASSERT_LT(index, edges.size()) << "gid " << gid;
+      const GlyphEdgeTable::Edge& edge = edges[index];
+      ASSERT_EQ(edge.table_tag, table_tag);
+      ASSERT_EQ(edge.dest_gid, dest_gid);
+      ASSERT_EQ(edge.layout_tag, layout_tag);
+      ASSERT_EQ(edge.ligature_set, ligature_set);
+      ASSERT_EQ(edge.context_set, context_set);
+
+      if (edge.kind == GlyphEdgeTable::LIGATURE) {
+        ligature_edges++;
+        auto glyphs = table->LigatureSet(ligature_set);
+        ASSERT_TRUE(glyphs.ok()) << glyphs.status();
+        ASSERT_EQ(**glyphs, SetFromIndex(ligature_set));
+      } else if (edge.kind == GlyphEdgeTable::CONTEXT) {
+        auto groups = table->ContextSet(context_set);
+        ASSERT_TRUE(groups.ok()) << groups.status();
+        ASSERT_EQ(std::vector<GlyphSet>(groups->begin(), groups->end()),
+                  ContextGroups(context_set));
+      } else if (table_tag != FontHelper::kGSUB) {
+        ASSERT_EQ(edge.kind, GlyphEdgeTable::DISJUNCTIVE);
+      } else {
+        ASSERT_EQ(edge.kind, GlyphEdgeTable::GSUB);
+      }
+      index++;
+    }
+    ASSERT_EQ(index, edges.size()) << "gid " << gid;
+    edge_count += edges.size();
+  }
+
+  ASSERT_EQ(edge_count, table->EdgeCount());
+  // Roboto has ligatures (fi, fl, ...).
+  ASSERT_GT(ligature_edges, 0);
+  ASSERT_TRUE(table->EdgesFrom(glyph_count).empty());
+}
+
+TEST_F(GlyphEdgeTableTest, MissingSets) {
+  flat_hash_map<hb_codepoint_t, std::vector<hb_codepoint_t>> sets{
+      // Ligature sets.
+      {1, {5, 6}},
+      // Context sets, values >= 0x80000000 reference another set.
+      {10, {7, 0x80000000 | 20}},
+      // The first group loads but the second doesn't.
+      {11, {4, 0x80000000 | 21}},
+      {12, {2, 0x80000000 | 20}},
+      {20, {8, 9}},
+  };
+  GlyphEdgeTable table = WithSets(
+      {
+          LigatureEdge(1),
+          LigatureEdge(3),
+          ContextEdge(10),
+          ContextEdge(11),
+          ContextEdge(12),
+          ContextEdge(13),
+      },
+      sets);
+
+  auto ligature = table.LigatureSet(1);
+  ASSERT_TRUE(ligature.ok()) << ligature.status();
+  ASSERT_EQ(**ligature, (GlyphSet{5, 6}));
+
+  // Failed to load.
+  ASSERT_TRUE(absl::IsInternal(table.LigatureSet(3).status()));
+  // Not referenced by any edge.
+  ASSERT_TRUE(absl::IsInternal(table.LigatureSet(2).status()));
+  ASSERT_TRUE(absl::IsInternal(table.LigatureSet(100).status()));
+
+  auto context = table.ContextSet(10);
+  ASSERT_TRUE(context.ok()) << context.status();
+  ASSERT_EQ(std::vector<GlyphSet>(context->begin(), context->end()),
+            (std::vector<GlyphSet>{{7}, {8, 9}}));
+  auto context_glyphs = table.ContextGlyphs(10);
+  ASSERT_TRUE(context_glyphs.ok()) << context_glyphs.status();
+  ASSERT_EQ(*context_glyphs, (GlyphSet{7, 8, 9}));
+
+  // The partially loaded groups of set 11 are rolled back, so they don't
+  // leak into set 12.
+  ASSERT_TRUE(absl::IsInternal(table.ContextSet(11).status()));
+  ASSERT_TRUE(absl::IsInternal(table.ContextGlyphs(11).status()));
+  context = table.ContextSet(12);
+  ASSERT_TRUE(context.ok()) << context.status();
+  ASSERT_EQ(std::vector<GlyphSet>(context->begin(), context->end()),
+            (std::vector<GlyphSet>{{2}, {8, 9}}));
+  ASSERT_EQ(ContextGroupCount(table), 4);
+
+  // Missing entirely.
+  ASSERT_TRUE(absl::IsInternal(table.ContextSet(13).status()));
+  ASSERT_TRUE(absl::IsInternal(table.ContextSet(14).status()));
+}
+
+}  // namespace ift::dep_graph
@@ -2,10 +2,13 @@
 #define IFT_DEP_GRAPH_NODE_H_
 
 #include <string>
+#include <utility>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_cat.h"
 #include "hb.h"
 #include "ift/common/font_helper.h"
+#include "ift/common/int_set.h"
 #include "ift/encoder/types.h"
 
 namespace ift::dep_graph {
@@ -69,6 +72,7 @@ class Node {
   bool operator!=(const Node& other) const { return !(*this == other); }
 
   friend void PrintTo(const Node& node, std::ostream* os);
+  friend class NodeSet;
 
   template <typename H>
   friend H AbslHashValue(H h, const Node& n) {
@@ -82,6 +86,63 @@ class Node {
   NodeType type_;
 };
 
+// A set of nodes, stored as one integer set per node type so that membership
+// checks on the (dense) glyph and unicode ids are bit tests rather than hash
+// lookups.
+class NodeSet {
+ public:
+  // Returns true if node was not already in the set.
+  bool insert(Node node) {
+    switch (node.type_) {
+      case Node::INIT_FONT:
+        return !std::exchange(has_init_font_, true);
+      case Node::FEATURE:
+        return features_.insert(node.Id()).second;
+      default:
+        break;
+    }
+    ift::common::IntSet& ids = IdsFor(node.type_);
+    if (ids.contains(node.Id())) {
+      return false;
+    }
+    ids.insert(node.Id());
+    return true;
+  }
+
+  bool contains(Node node) const {
+    switch (node.type_) {
+      case Node::INIT_FONT:
+        return has_init_font_;
+      case Node::FEATURE:
+        return features_.contains(node.Id());
+      case Node::SEGMENT:
+        return segments_.contains(node.Id());
+      case Node::UNICODE:
+        return unicodes_.contains(node.Id());
+      default:
+        return glyphs_.contains(node.Id());
+    }
+  }
+
+ private:
+  ift::common::IntSet& IdsFor(Node::NodeType type) {
+    switch (type) {
+      case Node::SEGMENT:
+        return segments_;
+      case Node::UNICODE:
+        return unicodes_;
+      default:
+        return glyphs_;
+    }
+  }
+
+  bool has_init_font_ = false;
+  ift::common::IntSet segments_;
+  ift::common::IntSet unicodes_;
+  ift::common::IntSet glyphs_;
+  absl::flat_hash_set<hb_tag_t> features_;
+};
+
 }  // namespace ift::dep_graph
 
 #endif  // IFT_DEP_GRAPH_NODE_H_
\ No newline at end of file
@@ -103,10 +103,21 @@ ActivationCondition ActivationCondition::clear_exclusive(
     ActivationCondition&& condition) {
   ActivationCondition updated(std::move(condition));
   updated.is_exclusive_ = false;
-  updated.cached_hash_ = std::nullopt;
+  updated.cached_hash_.Reset();
   return updated;
 }
 
+ActivationCondition ActivationCondition::restore(
+    std::vector<SegmentSet> groups, patch_id_t activated, bool is_exclusive,
+    bool is_fallback) {
+  ActivationCondition condition;
+  condition.activated_ = {activated};
+  condition.conditions_ = std::move(groups);
+  condition.is_exclusive_ = is_exclusive;
+  condition.is_fallback_ = is_fallback;
+  return condition;
+}
+
 static void Simplify(std::vector<SegmentSet>& conditions) {
   if (conditions.size() <= 1) return;
 
@@ -163,7 +174,7 @@ ActivationCondition ActivationCondition::And(const ActivationCondition& a,
                                b.conditions().begin(), b.conditions().end());
   Simplify(condition.conditions_);
   condition.is_exclusive_ = a_exclusive && b_exclusive && condition.IsUnitary();
-  condition.cached_hash_ = std::nullopt;
+  condition.cached_hash_.Reset();
   return condition;
 }
 
@@ -292,7 +303,7 @@ ActivationCondition ActivationCondition::ReplaceSegments(
     }
   }
   Simplify(new_condition.conditions_);
-  new_condition.cached_hash_ = std::nullopt;
+  new_condition.cached_hash_.Reset();
   return new_condition;
 }
 
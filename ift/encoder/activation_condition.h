@@ -1,6 +1,7 @@
 #ifndef IFT_ENCODER_ACTIVATION_CONDITION_H_
 #define IFT_ENCODER_ACTIVATION_CONDITION_H_
 
+#include <atomic>
 #include <cstdint>
 #include <optional>
 
@@ -70,6 +71,15 @@ class ActivationCondition {
    */
   static ActivationCondition clear_exclusive(ActivationCondition&& condition);
 
+  /*
+   * Constructs a condition with exactly the provided groups and flags. Unlike
+   * composite_condition() the groups are not simplified or reordered, so this
+   * reproduces a previously captured condition (see SegmenterCheckpoint).
+   */
+  static ActivationCondition restore(
+      std::vector<ift::common::SegmentSet> groups, patch_id_t activated,
+      bool is_exclusive, bool is_fallback);
+
   // Returns a new activation condition that activates on (a && b)
   //
   // The new condition uses the values for the other fields
@@ -222,11 +232,13 @@ class ActivationCondition {
   ift::config::ActivationConditionProto ToConfigProto() const;
 
   size_t Hash() const {
-    if (!cached_hash_.has_value()) {
-      cached_hash_ = absl::HashOf(conditions_, activated_, is_fallback_,
-                                  is_exclusive_, encoding_);
+    std::optional<size_t> hash = cached_hash_.Get();
+    if (!hash.has_value()) {
+      hash = absl::HashOf(conditions_, activated_, is_fallback_, is_exclusive_,
+                          encoding_);
+      cached_hash_.Set(*hash);
     }
-    return *cached_hash_;
+    return *hash;
   }
 
   template <typename H>
@@ -237,8 +249,9 @@ class ActivationCondition {
   bool operator<(const ActivationCondition& other) const;
 
   bool operator==(const ActivationCondition& other) const {
-    if (cached_hash_.has_value() && other.cached_hash_.has_value() &&
-        cached_hash_ != other.cached_hash_) {
+    std::optional<size_t> hash = cached_hash_.Get();
+    std::optional<size_t> other_hash = other.cached_hash_.Get();
+    if (hash.has_value() && other_hash.has_value() && *hash != *other_hash) {
       return false;
     }
     return conditions_ == other.conditions_ && activated_ == other.activated_ &&
@@ -252,18 +265,54 @@ class ActivationCondition {
 
   void SetEncoding(proto::PatchEncoding encoding) {
     encoding_ = encoding;
-    cached_hash_ = std::nullopt;
+    cached_hash_.Reset();
   }
 
   void AddPrefetches(absl::Span<const patch_id_t> activated) {
     activated_.insert(activated_.end(), activated.begin(), activated.end());
-    cached_hash_ = std::nullopt;
+    cached_hash_.Reset();
   }
 
  private:
   ActivationCondition()
       : conditions_(), activated_({0}), encoding_(proto::GLYPH_KEYED) {}
 
+  // Lazily computed hash value. Conditions are shared between threads during
+  // parallel merge assessment, so the hash may be filled in concurrently by
+  // readers; the value is published with atomics to make that safe.
+  class CachedHash {
+   public:
+    CachedHash() = default;
+    CachedHash(const CachedHash& other) { *this = other; }
+    CachedHash& operator=(const CachedHash& other) {
+      std::optional<size_t> value = other.Get();
+      if (value.has_value()) {
+        Set(*value);
+      } else {
+        Reset();
+      }
+      return *this;
+    }
+
+    std::optional<size_t> Get() const {
+      if (!has_value_.load(std::memory_order_acquire)) {
+        return std::nullopt;
+      }
+      return value_.load(std::memory_order_relaxed);
+    }
+
+    void Set(size_t value) const {
+      value_.store(value, std::memory_order_relaxed);
+      has_value_.store(true, std::memory_order_release);
+    }
+
+    void Reset() { has_value_.store(false, std::memory_order_relaxed); }
+
+   private:
+    mutable std::atomic<size_t> value_ = 0;
+    mutable std::atomic<bool> has_value_ = false;
+  };
+
   bool is_fallback_ = false;
   bool is_exclusive_ = false;
   // Represents:
@@ -271,7 +320,7 @@ class ActivationCondition {
   std::vector<ift::common::SegmentSet> conditions_;
   std::vector<patch_id_t> activated_;
   proto::PatchEncoding encoding_;
-  mutable std::optional<size_t> cached_hash_ = std::nullopt;
+  CachedHash cached_hash_;
 };
 
 }  // namespace ift::encoder
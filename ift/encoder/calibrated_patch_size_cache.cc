@@ -0,0 +1,59 @@
+#include "ift/encoder/calibrated_patch_size_cache.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "absl/log/log.h"
+#include "ift/common/int_set.h"
+#include "ift/common/try.h"
+
+using absl::StatusOr;
+using ift::common::GlyphSet;
+
+namespace ift::encoder {
+
+// Calibration compresses kSampleCount runs of kSampleLength consecutive
+// glyphs, spread evenly across the font. Consecutive glyphs tend to be
+// related, like the glyphs in a typical patch.
+static constexpr uint32_t kSampleCount = 8;
+static constexpr uint32_t kSampleLength = 64;
+
+StatusOr<uint32_t> CalibratedPatchSizeCache::GetPatchSize(
+    const GlyphSet& gids) {
+  uint32_t fast_size = TRY(fast_sizes_->GetPatchSize(gids));
+  return (uint32_t)std::lround(fast_size * correction_);
+}
+
+void CalibratedPatchSizeCache::LogBrotliCallCount() const {
+  VLOG(0) << "Screening patch sizes:";
+  fast_sizes_->LogBrotliCallCount();
+}
+
+StatusOr<double> CalibratedPatchSizeCache::ComputeCorrection(
+    hb_face_t* face, uint32_t fast_quality, uint32_t target_quality) {
+  uint32_t glyph_count = hb_face_get_glyph_count(face);
+  if (glyph_count == 0) {
+    return 1.0;
+  }
+
+  PatchSizeCacheImpl fast(face, fast_quality);
+  PatchSizeCacheImpl target(face, target_quality);
+
+  uint32_t length = std::min(kSampleLength, glyph_count);
+  uint32_t stride = std::max(1u, (glyph_count - length) / kSampleCount);
+  double fast_total = 0.0;
+  double target_total = 0.0;
+  for (uint32_t start = 0; start + length <= glyph_count; start += stride) {
+    GlyphSet sample;
+    sample.insert_range(start, start + length - 1);
+    fast_total += TRY(fast.GetPatchSize(sample));
+    target_total += TRY(target.GetPatchSize(sample));
+  }
+
+  if (fast_total == 0.0) {
+    return 1.0;
+  }
+  return target_total / fast_total;
+}
+
+}  // namespace ift::encoder
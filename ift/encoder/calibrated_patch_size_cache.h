@@ -0,0 +1,56 @@
+#ifndef IFT_ENCODER_CALIBRATED_PATCH_SIZE_CACHE_H_
+#define IFT_ENCODER_CALIBRATED_PATCH_SIZE_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "absl/status/statusor.h"
+#include "hb.h"
+#include "ift/common/int_set.h"
+#include "ift/encoder/patch_size_cache.h"
+
+namespace ift::encoder {
+
+// Estimates patch sizes by compressing them at a fast (low) brotli quality and
+// scaling the result by a correction factor which maps fast quality sizes onto
+// the sizes expected at a slower (higher) target quality.
+//
+// Used to cheaply screen merge candidates, only candidates which look
+// competitive are then sized at the target quality.
+class CalibratedPatchSizeCache : public PatchSizeCache {
+ public:
+  // Sizes from fast_sizes are multiplied by correction, see
+  // ComputeCorrection(). If fast_sizes is safe to use concurrently then so is
+  // the returned cache.
+  static std::unique_ptr<PatchSizeCache> New(
+      std::unique_ptr<PatchSizeCache> fast_sizes, double correction) {
+    return std::unique_ptr<PatchSizeCache>(
+        new CalibratedPatchSizeCache(std::move(fast_sizes), correction));
+  }
+
+  absl::StatusOr<uint32_t> GetPatchSize(
+      const ift::common::GlyphSet& gids) override;
+
+  void LogBrotliCallCount() const override;
+
+  double Correction() const { return correction_; }
+
+  // Computes the ratio of target_quality to fast_quality compressed sizes for
+  // a sample of glyph ranges from face.
+  static absl::StatusOr<double> ComputeCorrection(hb_face_t* face,
+                                                  uint32_t fast_quality,
+                                                  uint32_t target_quality);
+
+ private:
+  CalibratedPatchSizeCache(std::unique_ptr<PatchSizeCache> fast_sizes,
+                           double correction)
+      : fast_sizes_(std::move(fast_sizes)), correction_(correction) {}
+
+  std::unique_ptr<PatchSizeCache> fast_sizes_;
+  double correction_;
+};
+
+}  // namespace ift::encoder
+
+#endif  // IFT_ENCODER_CALIBRATED_PATCH_SIZE_CACHE_H_
@@ -0,0 +1,67 @@
+#include "ift/encoder/calibrated_patch_size_cache.h"
+
+#include <memory>
+
+#include "gtest/gtest.h"
+#include "ift/common/font_data.h"
+#include "ift/common/int_set.h"
+#include "ift/common/test_font_loader.h"
+#include "ift/encoder/mock_patch_size_cache.h"
+#include "ift/encoder/patch_size_cache.h"
+
+using ift::common::GlyphSet;
+using ift::common::hb_face_unique_ptr;
+using ift::common::make_hb_face;
+
+namespace ift::encoder {
+
+class CalibratedPatchSizeCacheTest : public ::testing::Test {
+ protected:
+  CalibratedPatchSizeCacheTest() : roboto(make_hb_face(nullptr)) {
+    auto loader = ift::common::TestFontLoader::Default().value();
+    auto blob = loader->LoadFontData("ift/common/testdata/Roboto-Regular.ttf")
+                    .value()
+                    .blob();
+    roboto = make_hb_face(hb_face_create(blob.get(), 0));
+  }
+
+  hb_face_unique_ptr roboto;
+};
+
+TEST_F(CalibratedPatchSizeCacheTest, ScalesFastSizes) {
+  auto fast = std::make_unique<MockPatchSizeCache>();
+  fast->SetPatchSize({1, 2, 3}, 200);
+  auto cache = CalibratedPatchSizeCache::New(std::move(fast), 0.9);
+
+  EXPECT_EQ(*cache->GetPatchSize({1, 2, 3}), 180);
+  EXPECT_EQ(*cache->GetPatchSize({4}), 90);
+}
+
+TEST_F(CalibratedPatchSizeCacheTest, ComputeCorrection) {
+  auto correction =
+      CalibratedPatchSizeCache::ComputeCorrection(roboto.get(), 1, 9);
+  ASSERT_TRUE(correction.ok()) << correction.status();
+  // Higher quality compresses better.
+  EXPECT_LT(*correction, 1.0);
+  EXPECT_GT(*correction, 0.5);
+
+  correction = CalibratedPatchSizeCache::ComputeCorrection(roboto.get(), 9, 9);
+  ASSERT_TRUE(correction.ok()) << correction.status();
+  EXPECT_DOUBLE_EQ(*correction, 1.0);
+}
+
+TEST_F(CalibratedPatchSizeCacheTest, ApproximatesTargetQuality) {
+  double correction =
+      *CalibratedPatchSizeCache::ComputeCorrection(roboto.get(), 1, 9);
+  auto cache = CalibratedPatchSizeCache::New(
+      std::make_unique<PatchSizeCacheImpl>(roboto.get(), 1), correction);
+  PatchSizeCacheImpl target(roboto.get(), 9);
+
+  GlyphSet gids;
+  gids.insert_range(100, 199);
+  double screened = *cache->GetPatchSize(gids);
+  double actual = *target.GetPatchSize(gids);
+  EXPECT_NEAR(screened / actual, 1.0, 0.1);
+}
+
+}  // namespace ift::encoder
@@ -5,6 +5,7 @@
 #include <utility>
 #include <vector>
 
+#include "absl/functional/function_ref.h"
 #include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
@@ -16,8 +17,10 @@
 #include "ift/common/woff2.h"
 #include "ift/encoder/activation_condition.h"
 #include "ift/encoder/glyph_condition_set.h"
+#include "ift/encoder/init_font_size_oracle.h"
 #include "ift/encoder/invalidation_set.h"
 #include "ift/encoder/merger.h"
+#include "ift/encoder/patch_size_cache.h"
 #include "ift/encoder/requested_segmentation_information.h"
 #include "ift/encoder/segment.h"
 #include "ift/encoder/segmentation_context.h"
@@ -371,7 +374,46 @@ StatusOr<std::pair<double, GlyphSet>> CandidateMerge::ComputeInitFontCostDelta(
   // the base changes. So to help control some of this noise we use
   // smallest_size_increases to track the smallest size increase we've seen for
   // moving a specific set of glyphs.
+  return ComputeInitFontCostDeltaImpl(
+      merger, moved_glyphs,
+      [&](const GlyphSet& new_glyph_closure,
+          const GlyphSet& glyph_closure_delta) -> StatusOr<uint32_t> {
+        uint32_t after =
+            TRY(merger.Context().patch_size_cache_for_init_font->GetPatchSize(
+                new_glyph_closure));
+        if (after < existing_init_font_size) {
+          return 0;
+        }
+
+        uint32_t init_increase = after - existing_init_font_size;
+        auto [it, _] =
+            smallest_size_increases.emplace(glyph_closure_delta, UINT32_MAX);
+        if (init_increase < it->second) {
+          it->second = init_increase;
+        } else {
+          init_increase = it->second;
+        }
+        return init_increase;
+      });
+}
+
+StatusOr<std::pair<double, GlyphSet>>
+CandidateMerge::EstimateInitFontCostDelta(Merger& merger,
+                                          InitFontSizeOracle& oracle,
+                                          const GlyphSet& moved_glyphs) {
+  return ComputeInitFontCostDeltaImpl(
+      merger, moved_glyphs,
+      [&](const GlyphSet& new_glyph_closure,
+          const GlyphSet& glyph_closure_delta) -> StatusOr<uint32_t> {
+        return oracle.EstimateIncrease(glyph_closure_delta);
+      });
+}
 
+StatusOr<std::pair<double, GlyphSet>>
+CandidateMerge::ComputeInitFontCostDeltaImpl(
+    Merger& merger, const GlyphSet& moved_glyphs,
+    absl::FunctionRef<StatusOr<uint32_t>(const GlyphSet&, const GlyphSet&)>
+        init_font_increase) {
   VLOG(1) << "cost_delta for move of glyphs " << moved_glyphs.ToString()
           << " to the initial font =";
 
@@ -398,22 +440,8 @@ StatusOr<std::pair<double, GlyphSet>> CandidateMerge::ComputeInitFontCostDelta(
   TRYV(ComputeInitFontGlyphDelta(merger, moved_glyphs, new_glyph_closure,
                                  glyph_closure_delta, codepoint_closure_delta));
 
-  uint32_t after =
-      TRY(merger.Context().patch_size_cache_for_init_font->GetPatchSize(
-          new_glyph_closure));
-  uint32_t init_increase = 0;
-
-  if (after >= existing_init_font_size) {
-    init_increase = after - existing_init_font_size;
-    auto [it, _] =
-        smallest_size_increases.emplace(glyph_closure_delta, UINT32_MAX);
-    if (init_increase < it->second) {
-      it->second = init_increase;
-    } else {
-      init_increase = it->second;
-    }
-  }
-
+  uint32_t init_increase =
+      TRY(init_font_increase(new_glyph_closure, glyph_closure_delta));
   double total_delta = init_increase;
 
   VLOG(1) << "    + " << total_delta << " [init font increase]";
@@ -578,7 +606,8 @@ StatusOr<double> CandidateMerge::ComputeBestCaseInitFontCostDelta(
 template <bool best_case>
 StatusOr<double> CandidateMerge::ComputeCostDelta(
     Merger& merger, const SegmentSet& merged_segments,
-    const Segment& merged_segment, std::optional<GlyphSet> exclusive_gids) {
+    const Segment& merged_segment, std::optional<GlyphSet> exclusive_gids,
+    PatchSizeCache& patch_size_cache) {
   if (merged_segments.size() <= 1) {
     return 0;
   }
@@ -611,13 +640,12 @@ StatusOr<double> CandidateMerge::ComputeCostDelta(
 
   segment_index_t base = *merged_segments.min();
   const auto& context = merger.Context();
-  const auto& patch_size_cache = context.patch_size_cache;
   const auto& segments = context.SegmentationInfo().Segments();
   const auto* calculator = merger.Strategy().ProbabilityCalculator();
   double cost_delta = 0.0;
   const uint32_t per_request_overhead = merger.Strategy().NetworkOverheadCost();
   for (const auto& [condition, glyphs] : modified_conditions) {
-    uint32_t patch_size = TRY(patch_size_cache->GetPatchSize(*glyphs));
+    uint32_t patch_size = TRY(patch_size_cache.GetPatchSize(*glyphs));
     double p = TRY(condition->Probability(segments, *calculator));
     double d = p * (patch_size + per_request_overhead);
     cost_delta -= d;
@@ -685,8 +713,9 @@ StatusOr<double> CandidateMerge::ComputeCostDelta(
           continue;
         }
       }
-      size = TRY(patch_size_cache->GetPatchSize(info.glyphs));
-      if (merger.ShouldRecordMergedSizeReductions()) {
+      size = TRY(patch_size_cache.GetPatchSize(info.glyphs));
+      if (merger.ShouldRecordMergedSizeReductions() &&
+          &patch_size_cache == context.patch_size_cache.get()) {
         int32_t extra_raw = info.combined_patch_size - info.largest_patch_size;
         int32_t extra_actual = ((int32_t)size) - info.largest_patch_size;
         if (extra_raw != 0.0) {
@@ -709,8 +738,8 @@ StatusOr<double> CandidateMerge::ComputeCostDelta(
 
     // Fallback is always needed with 100% probability so delta is just the size
     // difference (new - old)
-    double diff = ((double)TRY(patch_size_cache->GetPatchSize(new_fallback))) -
-                  ((double)TRY(patch_size_cache->GetPatchSize(
+    double diff = ((double)TRY(patch_size_cache.GetPatchSize(new_fallback))) -
+                  ((double)TRY(patch_size_cache.GetPatchSize(
                       context.glyph_groupings.UnmappedGlyphs())));
     VLOG(1) << "    + " << diff << " [fallback delta]";
     cost_delta += diff;
@@ -809,7 +838,7 @@ CandidateMerge::ComputePatchMergeDetails(
 
 template <bool best_case>
 StatusOr<double> CandidateMerge::PatchMergeDetails::ComputePatchMergeCostDelta(
-    const Merger& merger) const {
+    const Merger& merger, PatchSizeCache& patch_size_cache) const {
   // For a patch merge only three things are affected:
   // 1. Remove the patch with condition equal to condition_a.
   // 2. Remove the patch with condition equal to condition_b.
@@ -819,22 +848,19 @@ StatusOr<double> CandidateMerge::PatchMergeDetails::ComputePatchMergeCostDelta(
 
   double network_overhead = merger.Strategy().NetworkOverheadCost();
 
-  double size_a =
-      TRY(merger.Context().patch_size_cache->GetPatchSize(glyphs_a));
+  double size_a = TRY(patch_size_cache.GetPatchSize(glyphs_a));
   double probability_a = TRY(
       condition_a.Probability(merger.Context().SegmentationInfo().Segments(),
                               *merger.Strategy().ProbabilityCalculator()));
 
-  double size_b =
-      TRY(merger.Context().patch_size_cache->GetPatchSize(glyphs_b));
+  double size_b = TRY(patch_size_cache.GetPatchSize(glyphs_b));
   double probability_b = TRY(
       condition_b.Probability(merger.Context().SegmentationInfo().Segments(),
                               *merger.Strategy().ProbabilityCalculator()));
 
   double size_existing = 0.0;
   if (!glyphs_existing.empty()) {
-    size_existing =
-        TRY(merger.Context().patch_size_cache->GetPatchSize(glyphs_existing));
+    size_existing = TRY(patch_size_cache.GetPatchSize(glyphs_existing));
   }
 
   double merged_patch_size = 0.0;
@@ -850,8 +876,7 @@ StatusOr<double> CandidateMerge::PatchMergeDetails::ComputePatchMergeCostDelta(
   } else {
     GlyphSet merged_patch_glyphs = glyphs_merged;
     merged_patch_glyphs.union_set(glyphs_existing);
-    merged_patch_size = TRY(
-        merger.Context().patch_size_cache->GetPatchSize(merged_patch_glyphs));
+    merged_patch_size = TRY(patch_size_cache.GetPatchSize(merged_patch_glyphs));
   }
 
   size_a += network_overhead;
@@ -897,6 +922,26 @@ StatusOr<std::optional<CandidateMerge>> CandidateMerge::AssessSegmentMerge(
     Merger& merger, segment_index_t base_segment_index,
     const SegmentSet& segments_to_merge_,
     const std::optional<CandidateMerge>& best_merge_candidate) {
+  CandidateAssessment assessment = TRY(AssessSegmentMergeImpl(
+      merger, base_segment_index, segments_to_merge_, best_merge_candidate,
+      false));
+  return std::move(assessment.candidate);
+}
+
+StatusOr<CandidateAssessment> CandidateMerge::AssessSegmentMergeForBatch(
+    Merger& merger, segment_index_t base_segment_index,
+    const SegmentSet& segments_to_merge_,
+    const std::optional<CandidateMerge>& best_merge_candidate) {
+  return AssessSegmentMergeImpl(merger, base_segment_index, segments_to_merge_,
+                                best_merge_candidate, true);
+}
+
+StatusOr<CandidateAssessment> CandidateMerge::AssessSegmentMergeImpl(
+    Merger& merger, segment_index_t base_segment_index,
+    const SegmentSet& segments_to_merge_,
+    const std::optional<CandidateMerge>& best_merge_candidate,
+    bool record_best_case) {
+  CandidateAssessment assessment;
   if (WouldMixFeaturesAndCodepoints(merger.Context().SegmentationInfo(),
                                     base_segment_index, segments_to_merge_)) {
     // With the heuristic merger if it doesn't find a previous merge candidate
@@ -914,7 +959,7 @@ StatusOr<std::optional<CandidateMerge>> CandidateMerge::AssessSegmentMerge(
     // cases.
     VLOG(0) << "  Merge would mix features into a codepoint only segment, "
                "skipping.";
-    return std::nullopt;
+    return assessment;
   }
 
   // Create a merged segment, and remove all of the others
@@ -934,15 +979,19 @@ StatusOr<std::optional<CandidateMerge>> CandidateMerge::AssessSegmentMerge(
   Segment merged_segment = segments[base_segment_index];
   MergeSegments(merger, segments_to_merge, merged_segment);
 
-  if (merger.Strategy().UseCosts() && best_merge_candidate.has_value()) {
+  if (merger.Strategy().UseCosts() &&
+      (best_merge_candidate.has_value() || record_best_case)) {
     // Before doing a full assessment check a "best case" cost delta.
     // If that doesn't beat the current smallest there's no need to
     // do more indepth analysis.
     double best_case_delta = TRY(ComputeCostDelta<true>(
-        merger, segments_to_merge_with_base, merged_segment, std::nullopt));
-    if (best_case_delta >= best_merge_candidate->CostDelta()) {
+        merger, segments_to_merge_with_base, merged_segment, std::nullopt,
+        *merger.Context().patch_size_cache));
+    assessment.best_case_delta = best_case_delta;
+    if (best_merge_candidate.has_value() &&
+        best_case_delta >= best_merge_candidate->CostDelta()) {
       // We can't possibly beat the current lowest delta.
-      return std::nullopt;
+      return assessment;
     }
   }
 
@@ -982,26 +1031,48 @@ StatusOr<std::optional<CandidateMerge>> CandidateMerge::AssessSegmentMerge(
       exclusive_gids->union_set(
           merger.Context().glyph_groupings.ExclusiveGlyphs(base_segment_index));
     }
+  }
+
+  PatchSizeCache* screening_sizes =
+      merger.Context().screening_patch_size_cache.get();
+  if (merger.Strategy().UseCosts() &&
+      (best_merge_candidate.has_value() || record_best_case) &&
+      screening_sizes != nullptr) {
+    // Score with cheap approximate patch sizes first, most candidates lose by
+    // a wide margin and don't need to be sized at full quality.
+    double screened_delta = TRY(ComputeCostDelta<false>(
+        merger, segments_to_merge_with_base, merged_segment, exclusive_gids,
+        *screening_sizes));
+    assessment.screened_delta = screened_delta;
+    if (best_merge_candidate.has_value() &&
+        !merger.Context().PassesScreening(screened_delta,
+                                          best_merge_candidate->CostDelta())) {
+      return assessment;
+    }
+  }
+
+  if (exclusive_gids.has_value()) {
     new_patch_size =
         TRY(merger.Context().patch_size_cache->GetPatchSize(*exclusive_gids));
   }
 
   if (!merger.Strategy().UseCosts() &&
       new_patch_size > merger.Strategy().PatchSizeMaxBytes()) {
-    return std::nullopt;
+    return assessment;
   }
 
   double cost_delta = 0.0;
   if (merger.Strategy().UseCosts()) {
     // Cost delta values are only needed when using cost based merge strategy.
     cost_delta = TRY(ComputeCostDelta<false>(
-        merger, segments_to_merge_with_base, merged_segment, exclusive_gids));
+        merger, segments_to_merge_with_base, merged_segment, exclusive_gids,
+        *merger.Context().patch_size_cache));
   }
 
   if (best_merge_candidate.has_value() &&
       cost_delta >= best_merge_candidate->CostDelta()) {
     // Our delta is not smaller, don't bother returning a candidate.
-    return std::nullopt;
+    return assessment;
   }
 
   CandidateMerge candidate(std::move(merged_segment));
@@ -1012,13 +1083,33 @@ StatusOr<std::optional<CandidateMerge>> CandidateMerge::AssessSegmentMerge(
   candidate.cost_delta_ = cost_delta;
   candidate.invalidated_glyphs_ = gid_conditions_to_update;
 
-  return candidate;
+  assessment.candidate = std::move(candidate);
+  return assessment;
 }
 
 StatusOr<std::optional<CandidateMerge>> CandidateMerge::AssessPatchMerge(
     Merger& merger, const ActivationCondition& condition_a,
     const ActivationCondition& condition_b,
     const std::optional<CandidateMerge>& best_merge_candidate) {
+  CandidateAssessment assessment = TRY(AssessPatchMergeImpl(
+      merger, condition_a, condition_b, best_merge_candidate, false));
+  return std::move(assessment.candidate);
+}
+
+StatusOr<CandidateAssessment> CandidateMerge::AssessPatchMergeForBatch(
+    Merger& merger, const ActivationCondition& condition_a,
+    const ActivationCondition& condition_b,
+    const std::optional<CandidateMerge>& best_merge_candidate) {
+  return AssessPatchMergeImpl(merger, condition_a, condition_b,
+                              best_merge_candidate, true);
+}
+
+StatusOr<CandidateAssessment> CandidateMerge::AssessPatchMergeImpl(
+    Merger& merger, const ActivationCondition& condition_a,
+    const ActivationCondition& condition_b,
+    const std::optional<CandidateMerge>& best_merge_candidate,
+    bool record_best_case) {
+  CandidateAssessment assessment;
   if (condition_a == condition_b) {
     return absl::InternalError("Can't merge condition with itself");
   }
@@ -1026,12 +1117,32 @@ StatusOr<std::optional<CandidateMerge>> CandidateMerge::AssessPatchMerge(
   PatchMergeDetails details =
       TRY(ComputePatchMergeDetails(merger, condition_a, condition_b));
 
-  if (merger.Strategy().UseCosts() && best_merge_candidate.has_value()) {
+  if (merger.Strategy().UseCosts() &&
+      (best_merge_candidate.has_value() || record_best_case)) {
     // Pre-filter, if possible, with a best case computation to avoid computing
     // the merged patch size.
-    double cost_delta = TRY(details.ComputePatchMergeCostDelta<true>(merger));
-    if (cost_delta >= best_merge_candidate->CostDelta()) {
-      return std::nullopt;
+    double cost_delta = TRY(details.ComputePatchMergeCostDelta<true>(
+        merger, *merger.Context().patch_size_cache));
+    assessment.best_case_delta = cost_delta;
+    if (best_merge_candidate.has_value() &&
+        cost_delta >= best_merge_candidate->CostDelta()) {
+      return assessment;
+    }
+  }
+
+  PatchSizeCache* screening_sizes =
+      merger.Context().screening_patch_size_cache.get();
+  if (merger.Strategy().UseCosts() &&
+      (best_merge_candidate.has_value() || record_best_case) &&
+      screening_sizes != nullptr) {
+    // As with segment merges, screen with cheap approximate sizes first.
+    double screened_delta = TRY(
+        details.ComputePatchMergeCostDelta<false>(merger, *screening_sizes));
+    assessment.screened_delta = screened_delta;
+    if (best_merge_candidate.has_value() &&
+        !merger.Context().PassesScreening(screened_delta,
+                                          best_merge_candidate->CostDelta())) {
+      return assessment;
     }
   }
 
@@ -1042,19 +1153,20 @@ StatusOr<std::optional<CandidateMerge>> CandidateMerge::AssessPatchMerge(
 
   if (!merger.Strategy().UseCosts() &&
       new_patch_size > merger.Strategy().PatchSizeMaxBytes()) {
-    return std::nullopt;
+    return assessment;
   }
 
   double cost_delta = 0.0;
   if (merger.Strategy().UseCosts()) {
     // Cost delta values are only needed when using cost based merge strategy.
-    cost_delta = TRY(details.ComputePatchMergeCostDelta<false>(merger));
+    cost_delta = TRY(details.ComputePatchMergeCostDelta<false>(
+        merger, *merger.Context().patch_size_cache));
   }
 
   if (best_merge_candidate.has_value() &&
       cost_delta >= best_merge_candidate->CostDelta()) {
     // Our delta is not smaller, don't bother returning a candidate.
-    return std::nullopt;
+    return assessment;
   }
 
   if (cost_delta >= 0) {
@@ -1065,7 +1177,7 @@ StatusOr<std::optional<CandidateMerge>> CandidateMerge::AssessPatchMerge(
     uint32_t b_group_size = details.condition_b.EffectiveGroupSize();
     if (merged_group_size <= a_group_size &&
         merged_group_size <= b_group_size) {
-      return std::nullopt;
+      return assessment;
     }
   }
 
@@ -1084,7 +1196,28 @@ StatusOr<std::optional<CandidateMerge>> CandidateMerge::AssessPatchMerge(
   // glyphs need to be invalidated by this merge.
   candidate.invalidated_glyphs_ = {};
 
-  return candidate;
+  assessment.candidate = std::move(candidate);
+  return assessment;
+}
+
+bool CandidateAssessment::Beats(const std::optional<CandidateMerge>& best,
+                                const SegmentationContext& context) const {
+  if (!candidate.has_value()) {
+    return false;
+  }
+  if (!best.has_value()) {
+    return true;
+  }
+  if (best_case_delta.has_value() && *best_case_delta >= best->CostDelta()) {
+    // Would have been rejected by the best case pre-filter.
+    return false;
+  }
+  if (screened_delta.has_value() &&
+      !context.PassesScreening(*screened_delta, best->CostDelta())) {
+    // Would have been rejected by screening.
+    return false;
+  }
+  return candidate->CostDelta() < best->CostDelta();
 }
 
 }  // namespace ift::encoder
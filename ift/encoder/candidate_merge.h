@@ -3,7 +3,9 @@
 
 #include <cstdint>
 #include <optional>
+#include <utility>
 
+#include "absl/functional/function_ref.h"
 #include "absl/status/statusor.h"
 #include "ift/common/int_set.h"
 #include "ift/encoder/activation_condition.h"
@@ -16,6 +18,10 @@ namespace ift::encoder {
 
 class Merger;
 class CandidateMergeTest;
+class InitFontSizeOracle;
+class PatchSizeCache;
+class SegmentationContext;
+struct CandidateAssessment;
 
 struct CandidateMerge {
   friend class CandidateMergeTest;
@@ -115,6 +121,15 @@ struct CandidateMerge {
       const ift::common::SegmentSet& segments_to_merge_,
       const std::optional<CandidateMerge>& best_merge_candidate);
 
+  // Variant of AssessSegmentMerge() for use when a batch of candidates is
+  // assessed concurrently. The best case cost delta is always recorded so that
+  // the outcome can later be re-checked against a better best candidate, see
+  // CandidateAssessment::Beats().
+  static absl::StatusOr<CandidateAssessment> AssessSegmentMergeForBatch(
+      Merger& context, segment_index_t base_segment_index,
+      const ift::common::SegmentSet& segments_to_merge_,
+      const std::optional<CandidateMerge>& best_merge_candidate);
+
   // Assess the result of merging together exactly two patches:
   // 1. The exclusive patch for base_segment_index.
   // 2. The patch associated with target_condition.
@@ -128,6 +143,13 @@ struct CandidateMerge {
       const ActivationCondition& condition_b,
       const std::optional<CandidateMerge>& best_merge_candidate);
 
+  // Variant of AssessPatchMerge() for use when a batch of candidates is
+  // assessed concurrently, see AssessSegmentMergeForBatch().
+  static absl::StatusOr<CandidateAssessment> AssessPatchMergeForBatch(
+      Merger& context, const ActivationCondition& condition_a,
+      const ActivationCondition& condition_b,
+      const std::optional<CandidateMerge>& best_merge_candidate);
+
   // Computes the estimated size of the patch for a segment and returns true if
   // it is below the minimum.
   static absl::StatusOr<bool> IsPatchTooSmall(
@@ -143,11 +165,14 @@ struct CandidateMerge {
   //
   // If best_case is true then this will compute an estimated best possible cost
   // delta from the merge (computationally cheap) instead of the real delta.
+  //
+  // Patch sizes are obtained from patch_size_cache.
   template <bool best_case>
   static absl::StatusOr<double> ComputeCostDelta(
       Merger& merger, const ift::common::SegmentSet& merged_segments,
       const Segment& merged_segment,
-      std::optional<common::GlyphSet> exclusive_gids);
+      std::optional<common::GlyphSet> exclusive_gids,
+      PatchSizeCache& patch_size_cache);
 
   // Computes the predicted change to the toal cost if moved_glyphs are
   // moved from patches into the initial font.
@@ -160,6 +185,15 @@ struct CandidateMerge {
                            absl::flat_hash_map<ift::common::GlyphSet, uint32_t>&
                                smallest_size_increases);
 
+  // Same as ComputeInitFontCostDelta() except that the increase in init font
+  // size is estimated by oracle instead of being computed. This avoids
+  // compressing the whole init font glyph closure, so is much cheaper, but
+  // the result should be confirmed with ComputeInitFontCostDelta() before a
+  // move is applied.
+  static absl::StatusOr<std::pair<double, ift::common::GlyphSet>>
+  EstimateInitFontCostDelta(Merger& merger, InitFontSizeOracle& oracle,
+                            const ift::common::GlyphSet& moved_glyphs);
+
   static absl::StatusOr<double> ComputeBestCaseInitFontCostDelta(
       Merger& merger, uint32_t existing_init_font_size,
       const ift::common::GlyphSet& moved_glyphs);
@@ -176,7 +210,7 @@ struct CandidateMerge {
 
     template <bool best_case>
     absl::StatusOr<double> ComputePatchMergeCostDelta(
-        const Merger& merger) const;
+        const Merger& merger, PatchSizeCache& patch_size_cache) const;
   };
 
   static absl::StatusOr<PatchMergeDetails> ComputePatchMergeDetails(
@@ -188,6 +222,27 @@ struct CandidateMerge {
                                               int quality);
 
  private:
+  static absl::StatusOr<CandidateAssessment> AssessSegmentMergeImpl(
+      Merger& context, segment_index_t base_segment_index,
+      const ift::common::SegmentSet& segments_to_merge_,
+      const std::optional<CandidateMerge>& best_merge_candidate,
+      bool record_best_case);
+
+  static absl::StatusOr<CandidateAssessment> AssessPatchMergeImpl(
+      Merger& context, const ActivationCondition& condition_a,
+      const ActivationCondition& condition_b,
+      const std::optional<CandidateMerge>& best_merge_candidate,
+      bool record_best_case);
+
+  // init_font_increase is given the new init font glyph closure and the
+  // glyphs added to it, and returns the increase in init font size.
+  static absl::StatusOr<std::pair<double, ift::common::GlyphSet>>
+  ComputeInitFontCostDeltaImpl(
+      Merger& merger, const ift::common::GlyphSet& moved_glyphs,
+      absl::FunctionRef<absl::StatusOr<uint32_t>(
+          const ift::common::GlyphSet&, const ift::common::GlyphSet&)>
+          init_font_increase);
+
   static absl::Status ComputeInitFontGlyphDelta(
       Merger& merger, const ift::common::GlyphSet& moved_glyphs,
       ift::common::GlyphSet& glyph_closure_delta,
@@ -195,6 +250,28 @@ struct CandidateMerge {
       ift::common::CodepointSet& codepoint_closure_delta);
 };
 
+// The outcome of assessing a single candidate merge against some best
+// candidate.
+struct CandidateAssessment {
+  // The best case cost delta used to pre-filter the candidate, if one was
+  // computed.
+  std::optional<double> best_case_delta;
+
+  // The cost delta computed with the screening patch sizes (see
+  // SegmentationContext::SetScreening()), if one was computed.
+  std::optional<double> screened_delta;
+
+  // Set if the candidate beat the best candidate it was assessed against.
+  std::optional<CandidateMerge> candidate;
+
+  // Returns true if this candidate would have been selected had it instead been
+  // assessed against best. best must be no worse than the best candidate that
+  // was used for the assessment, and context must be the one the candidate was
+  // assessed with.
+  bool Beats(const std::optional<CandidateMerge>& best,
+             const SegmentationContext& context) const;
+};
+
 }  // namespace ift::encoder
 
 #endif  // IFT_ENCODER_CANDIDATE_MERGE_H_
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <memory>
+#include <numeric>
 #include <optional>
 #include <string>
 #include <vector>
@@ -16,10 +18,13 @@
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "ift/common/compat_id.h"
+#include "ift/common/data_file_resolver.h"
+#include "ift/common/fingerprint.h"
 #include "ift/common/font_data.h"
 #include "ift/common/font_helper.h"
 #include "ift/common/hb_set_unique_ptr.h"
 #include "ift/common/int_set.h"
+#include "ift/common/thread_pool.h"
 #include "ift/common/try.h"
 #include "ift/common/woff2.h"
 #include "ift/encoder/activation_condition.h"
@@ -30,12 +35,14 @@
 #include "ift/encoder/merger.h"
 #include "ift/encoder/segment.h"
 #include "ift/encoder/segmentation_context.h"
+#include "ift/encoder/segmenter_checkpoint.h"
 #include "ift/encoder/subset_definition.h"
 #include "ift/encoder/types.h"
 #include "ift/freq/probability_bound.h"
 #include "ift/freq/probability_calculator.h"
 #include "ift/glyph_keyed_diff.h"
 
+using ift::config::ConditionAnalysisMode;
 using ift::config::MOVE_TO_INIT_FONT;
 using ift::config::SegmentationPlan;
 using ift::config::SegmentsProto;
@@ -53,6 +60,8 @@ using absl::StrCat;
 using ift::GlyphKeyedDiff;
 using ift::common::CodepointSet;
 using ift::common::CompatId;
+using ift::common::DataFileResolver;
+using ift::common::Fingerprint;
 using ift::common::FontData;
 using ift::common::FontHelper;
 using ift::common::GlyphSet;
@@ -62,6 +71,7 @@ using ift::common::IntSet;
 using ift::common::make_hb_face;
 using ift::common::make_hb_set;
 using ift::common::SegmentSet;
+using ift::common::ThreadPool;
 using ift::common::Woff2;
 using ift::freq::ProbabilityBound;
 using ift::freq::ProbabilityCalculator;
@@ -523,32 +533,207 @@ static StatusOr<GlyphSegmentation> ToFinalSegmentation(
   return context.ToGlyphSegmentation();
 }
 
-StatusOr<GlyphSegmentation> ClosureGlyphSegmenter::CodepointToGlyphSegments(
-    hb_face_t* face, SubsetDefinition initial_segment,
-    const std::vector<SubsetDefinition>& subset_definitions,
-    btree_map<SegmentSet, MergeStrategy> merge_groups) const {
-  for (const auto& [segments, strategy] : merge_groups) {
-    if (strategy.UseCosts()) {
-      TRYV(CheckForDisjointCodepoints(subset_definitions, segments));
+static std::string MergeGroupName(const Merger& merger, size_t group_index) {
+  if (merger.Strategy().Name().has_value()) {
+    return std::string(*merger.Strategy().Name());
+  }
+  return std::to_string(group_index);
+}
+
+// Runs each merger, in order, until it has no more merges to perform.
+// group_indices gives the merge group index of each merger (for logging). If
+// checkpoint_writer is set it's given the chance to save a checkpoint after
+// each merge.
+static Status RunMergers(SegmentationContext& context,
+                         std::vector<Merger>& mergers,
+                         const std::vector<size_t>& group_indices,
+                         CheckpointWriter* checkpoint_writer = nullptr) {
+  for (size_t i = 0; i < mergers.size(); i++) {
+    Merger& merger = mergers[i];
+    VLOG(0) << "Starting merge selection for merge group "
+            << MergeGroupName(merger, group_indices[i]) << std::endl
+            << "  " << merger.NumInscopeSegments() << " inscope segments, "
+            << merger.NumCutoffSegments() << " have optimization disabled.";
+
+    while (true) {
+      auto maybe_modified = TRY(merger.TryNextMerge());
+      if (!maybe_modified.has_value()) {
+        break;
+      }
+      TRYV(context.ReprocessChanged(std::move(*maybe_modified)));
+      if (checkpoint_writer != nullptr) {
+        TRYV(checkpoint_writer->MaybeSave(context, mergers));
+      }
     }
   }
+  return absl::OkStatus();
+}
 
-  hb_face_unique_ptr normalized_face = TRY(FontHelper::Normalize(face));
-  face = normalized_face.get();
+// Partitions the merge groups into clusters which can be merged independently
+// of each other. Returns the merge group indices in each cluster.
+//
+// Two merge groups are placed in the same cluster if they share a segment or
+// if some activation condition involves segments from both. Otherwise a merge
+// in one group can't change any condition (and so any merge decision) in the
+// other.
+//
+// The exception is the fallback patch: its glyphs have no recorded conditions,
+// so interactions through them can't be seen here, and merges in any group can
+// shrink it which changes the fallback term of every other group's costs. So
+// when there is a fallback patch all groups are placed in a single cluster. In
+// the pure dep graph modes every glyph has a condition so this doesn't apply.
+static std::vector<std::vector<size_t>> IndependentMergeGroups(
+    const SegmentationContext& context, const std::vector<Merger>& mergers) {
+  if (!context.IsPureDepGraphAnalysisMode() &&
+      !context.glyph_groupings.UnmappedGlyphs().empty()) {
+    std::vector<size_t> all(mergers.size());
+    std::iota(all.begin(), all.end(), 0);
+    return {all};
+  }
 
+  std::vector<size_t> parent(mergers.size());
+  std::iota(parent.begin(), parent.end(), 0);
+  auto find = [&](size_t i) {
+    while (parent[i] != i) {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  };
+  auto join = [&](size_t a, size_t b) {
+    a = find(a);
+    b = find(b);
+    if (a != b) {
+      parent[std::max(a, b)] = std::min(a, b);
+    }
+  };
+
+  flat_hash_map<segment_index_t, size_t> segment_to_group;
+  for (size_t i = 0; i < mergers.size(); i++) {
+    for (segment_index_t s : mergers[i].InscopeSegments()) {
+      auto [it, inserted] = segment_to_group.insert(std::pair(s, i));
+      if (!inserted) {
+        join(it->second, i);
+      }
+    }
+  }
 
-  btree_map<SegmentSet, SegmentSet> with_shared;
-  std::vector<Segment> segments =
-      TRY(ToOrderedSegments(subset_definitions, merge_groups, with_shared));
-  SegmentationContext context =
-      TRY(SegmentationContext::InitializeSegmentationContext(
-          face, initial_segment, std::move(segments), unmapped_glyph_handling_,
-          condition_analysis_mode_, brotli_quality_,
-          init_font_merging_brotli_quality_, resolver_));
+  for (const auto& [condition, _] :
+       context.glyph_groupings.ConditionsAndGlyphs()) {
+    std::optional<size_t> group;
+    for (segment_index_t s : condition.TriggeringSegments()) {
+      auto it = segment_to_group.find(s);
+      if (it == segment_to_group.end()) {
+        continue;
+      }
+      if (group.has_value()) {
+        join(*group, it->second);
+      } else {
+        group = it->second;
+      }
+    }
+  }
 
-  std::vector<Merger> mergers =
-      TRY(ToMergers(context, with_shared, merge_groups));
+  btree_map<size_t, std::vector<size_t>> clusters;
+  for (size_t i = 0; i < mergers.size(); i++) {
+    clusters[find(i)].push_back(i);
+  }
+
+  std::vector<std::vector<size_t>> out;
+  for (auto& [_, groups] : clusters) {
+    out.push_back(std::move(groups));
+  }
+  return out;
+}
+
+// Runs the mergers of each cluster concurrently, each on a separate fork of
+// context, then combines the results into a final segmentation.
+static StatusOr<GlyphSegmentation> ParallelMerge(
+    hb_face_t* face, const SegmentationContext& context,
+    const std::vector<Merger>& mergers,
+    const std::vector<std::vector<size_t>>& clusters, ThreadPool& thread_pool,
+    UnmappedGlyphHandling unmapped_glyph_handling) {
+  VLOG(0) << "Merging " << clusters.size()
+          << " independent clusters of merge groups in parallel.";
+
+  // Each cluster is merged on its own fork of the context. Since clusters
+  // don't interact (see IndependentMergeGroups()), each fork makes the same
+  // merge decisions it would have made on the shared context.
+  std::vector<std::optional<SegmentationContext>> shards(clusters.size());
+  std::vector<std::vector<Merger>> shard_mergers(clusters.size());
+  TRYV(thread_pool.ParallelFor(clusters.size(), [&](size_t i) -> Status {
+    shards[i] = context.Fork();
+    for (size_t group : clusters[i]) {
+      shard_mergers[i].push_back(mergers[group].WithContext(*shards[i]));
+    }
+    return RunMergers(*shards[i], shard_mergers[i], clusters[i]);
+  }));
+
+  // Reconcile: each shard is authoritative for the segments in its cluster, so
+  // apply the segments each cluster changed to a final fork and reprocess only
+  // those.
+  flat_hash_set<GlyphSet> combined_patches;
+  for (const GlyphSet& group :
+       TRY(context.glyph_groupings.CombinedPatches().NonIdentityGroups())) {
+    combined_patches.insert(group);
+  }
+
+  SegmentationContext merged = context.Fork();
+  const std::vector<Segment>& segments = context.SegmentationInfo().Segments();
+  SegmentSet inert_segments = context.InertSegments();
+  for (size_t i = 0; i < clusters.size(); i++) {
+    const SegmentationContext& shard = *shards[i];
+    const std::vector<Segment>& shard_segments =
+        shard.SegmentationInfo().Segments();
+    SegmentSet changed_segments;
+    for (size_t group : clusters[i]) {
+      for (segment_index_t s : mergers[group].InscopeSegments()) {
+        if (shard_segments[s].Definition() != segments[s].Definition() ||
+            shard_segments[s].ProbabilityBound() !=
+                segments[s].ProbabilityBound()) {
+          changed_segments.insert(s);
+        }
+        if (shard.InertSegments().contains(s)) {
+          inert_segments.insert(s);
+        } else {
+          inert_segments.erase(s);
+        }
+      }
+    }
+    TRYV(merged.ReassignSegments(changed_segments, shard_segments));
+
+    for (const GlyphSet& group :
+         TRY(shard.glyph_groupings.CombinedPatches().NonIdentityGroups())) {
+      if (!combined_patches.contains(group)) {
+        TRYV(merged.glyph_groupings.CombinePatches(group, {}));
+      }
+    }
+  }
+  merged.SetInertSegments(std::move(inert_segments));
+
+  VLOG(0) << "Last merge group finished. Producing final segmentation.";
+  TRYV(ValidateIncrementalGroupings(face, merged));
+
+  VLOG(0) << "Brotli calls during init font processing:";
+  context.patch_size_cache_for_init_font->LogBrotliCallCount();
+  // The shards share the patch size caches of context.
+  VLOG(0) << "Brotli calls during merging:";
+  context.patch_size_cache->LogBrotliCallCount();
+  for (const auto& cluster_mergers : shard_mergers) {
+    for (const auto& merger : cluster_mergers) {
+      merger.LogMergedSizeHistogram();
+    }
+  }
+
+  return ToFinalSegmentation(merged, unmapped_glyph_handling);
+}
 
+// Runs the init font processing which precedes merging: moving segments which
+// are likely to be needed, and if configured any fallback glyphs, into the init
+// font.
+static Status ProcessInitFont(SegmentationContext& context,
+                              std::vector<Merger>& mergers,
+                              UnmappedGlyphHandling unmapped_glyph_handling) {
   // ### First phase of merging is to check for any patches which should be
   // moved to the initial font (eg. cases where the probability of a patch is
   // ~1.0). Do this only for strategies that have opted in.
@@ -576,7 +761,7 @@ StatusOr<GlyphSegmentation> ClosureGlyphSegmenter::CodepointToGlyphSegments(
   // if requested any remaining fallback glyphs are also moved into the init
   // font.
   GlyphSet fallback_glyphs = context.glyph_groupings.UnmappedGlyphs();
-  if (unmapped_glyph_handling_ == MOVE_TO_INIT_FONT &&
+  if (unmapped_glyph_handling == MOVE_TO_INIT_FONT &&
       !fallback_glyphs.empty()) {
     VLOG(0) << "Moving " << fallback_glyphs.size()
             << " fallback glyphs into the initial font." << std::endl;
@@ -584,67 +769,137 @@ StatusOr<GlyphSegmentation> ClosureGlyphSegmenter::CodepointToGlyphSegments(
     new_def.gids.union_set(fallback_glyphs);
     TRYV(context.ReassignInitSubset(new_def));
   }
+  return absl::OkStatus();
+}
 
-  if (merge_groups.empty()) {
-    // No merging will be needed so we're done.
-    return ToFinalSegmentation(context, unmapped_glyph_handling_);
-  }
+// Creates a context from checkpoint, in place of the initial analysis and init
+// font processing of a new segmentation.
+static StatusOr<SegmentationContext> RestoreContext(
+    hb_face_t* face, const SegmenterCheckpoint& checkpoint,
+    UnmappedGlyphHandling unmapped_glyph_handling,
+    ConditionAnalysisMode condition_analysis_mode, uint32_t brotli_quality,
+    uint32_t init_font_brotli_quality,
+    std::shared_ptr<DataFileResolver> resolver, uint32_t num_threads) {
+  VLOG(0) << "Restoring segmentation state from checkpoint.";
+  SegmentationContext context = TRY(SegmentationContext::Create(
+      face, checkpoint.InitFontSegment(), checkpoint.Segments(),
+      unmapped_glyph_handling, condition_analysis_mode, brotli_quality,
+      init_font_brotli_quality, std::move(resolver)));
+  context.SetNumThreads(num_threads);
+  TRYV(checkpoint.RestoreContext(context));
+  return context;
+}
 
-  // ### Iteratively merge segments and incrementally reprocess affected data.
-  // See ../../docs/experimental/closure_glyph_segmentation_merging.md for more
-  // details on how merging works.
-  size_t merger_index = 0;
-  std::string merger_name = std::to_string(merger_index);
-  if (mergers[merger_index].Strategy().Name().has_value()) {
-    merger_name = *mergers[merger_index].Strategy().Name();
+StatusOr<GlyphSegmentation> ClosureGlyphSegmenter::CodepointToGlyphSegments(
+    hb_face_t* face, SubsetDefinition initial_segment,
+    const std::vector<SubsetDefinition>& subset_definitions,
+    btree_map<SegmentSet, MergeStrategy> merge_groups) const {
+  for (const auto& [segments, strategy] : merge_groups) {
+    if (strategy.UseCosts()) {
+      TRYV(CheckForDisjointCodepoints(subset_definitions, segments));
+    }
   }
 
-  VLOG(0) << "Starting merge selection for merge group " << merger_name
-          << std::endl
-          << "  " << mergers[merger_index].NumInscopeSegments()
-          << " inscope segments, " << mergers[merger_index].NumCutoffSegments()
-          << " have optimization disabled.";
+  hb_face_unique_ptr normalized_face = TRY(FontHelper::Normalize(face));
+  face = normalized_face.get();
+
+  btree_map<SegmentSet, SegmentSet> with_shared;
+  std::vector<Segment> segments =
+      TRY(ToOrderedSegments(subset_definitions, merge_groups, with_shared));
 
-  while (true) {
-    auto& merger = mergers[merger_index];
-    auto maybe_modified = TRY(merger.TryNextMerge());
+  // Fingerprinting the probability data is linear in its size, so skip it
+  // unless checkpoints are used.
+  Fingerprint inputs;
+  if (!resume_from_.empty() || !checkpoint_path_.empty()) {
+    inputs = SegmenterCheckpoint::InputsFingerprint(
+        face, initial_segment, segments, merge_groups, unmapped_glyph_handling_,
+        condition_analysis_mode_, brotli_quality_,
+        init_font_merging_brotli_quality_, screening_brotli_quality_,
+        screening_margin_);
+  }
+  std::optional<SegmenterCheckpoint> checkpoint;
+  if (!resume_from_.empty()) {
+    checkpoint = TRY(SegmenterCheckpoint::Load(resume_from_));
+    if (checkpoint->Inputs() != inputs) {
+      return absl::FailedPreconditionError(StrCat(
+          "Checkpoint ", resume_from_,
+          " was saved for a different font, segments, or configuration."));
+    }
+  }
 
-    if (!maybe_modified.has_value()) {
-      merger_index++;
+  SegmentationContext context = TRY(
+      checkpoint.has_value()
+          ? RestoreContext(face, *checkpoint, unmapped_glyph_handling_,
+                           condition_analysis_mode_, brotli_quality_,
+                           init_font_merging_brotli_quality_, resolver_,
+                           num_threads_)
+          : SegmentationContext::InitializeSegmentationContext(
+                face, initial_segment, std::move(segments),
+                unmapped_glyph_handling_, condition_analysis_mode_,
+                brotli_quality_, init_font_merging_brotli_quality_, resolver_,
+                num_threads_));
+  context.SetScreening(screening_brotli_quality_, screening_margin_);
 
-      if (merger_index < mergers.size()) {
-        std::string merger_name = std::to_string(merger_index);
-        if (mergers[merger_index].Strategy().Name().has_value()) {
-          merger_name = *mergers[merger_index].Strategy().Name();
-        }
-        VLOG(0) << "Merge group finished, starting next group " << merger_name
-                << std::endl
-                << "  " << mergers[merger_index].NumInscopeSegments()
-                << " inscope segments, "
-                << mergers[merger_index].NumCutoffSegments()
-                << " have optimization disabled.";
-        continue;
-      }
+  std::vector<Merger> mergers =
+      TRY(ToMergers(context, with_shared, merge_groups));
 
-      VLOG(0) << "Last merge group finished. Producing final segmentation.";
-      // Nothing was merged so we're done.
-      TRYV(ValidateIncrementalGroupings(face, context));
-      VLOG(0) << "Brotli calls during init font processing:";
-      context.patch_size_cache_for_init_font->LogBrotliCallCount();
-      VLOG(0) << "Brotli calls during merging:";
-      context.patch_size_cache->LogBrotliCallCount();
+  if (checkpoint.has_value()) {
+    // The checkpoint was taken after init font processing, so the restored
+    // context already reflects it.
+    TRYV(checkpoint->RestoreMergers(absl::MakeSpan(mergers)));
+  } else {
+    TRYV(ProcessInitFont(context, mergers, unmapped_glyph_handling_));
+  }
 
-      for (const auto& merger : mergers) {
-        merger.LogMergedSizeHistogram();
-      }
+  if (merge_groups.empty()) {
+    // No merging will be needed so we're done.
+    return ToFinalSegmentation(context, unmapped_glyph_handling_);
+  }
 
-      return ToFinalSegmentation(context, unmapped_glyph_handling_);
+  std::optional<CheckpointWriter> checkpoint_writer;
+  if (!checkpoint_path_.empty()) {
+    checkpoint_writer.emplace(checkpoint_path_, checkpoint_interval_, inputs);
+    TRYV(checkpoint_writer->Save(context, mergers));
+  }
+
+  // ### Iteratively merge segments and incrementally reprocess affected data.
+  // See ../../docs/experimental/closure_glyph_segmentation_merging.md for more
+  // details on how merging works.
+  //
+  // Checkpoints capture a single context, so when checkpointing independent
+  // merge groups are merged serially (candidate assessment still uses the
+  // thread pool).
+  ThreadPool* thread_pool = context.MergeThreadPool();
+  if (thread_pool != nullptr && thread_pool->IsParallel()) {
+    std::vector<std::vector<size_t>> clusters =
+        IndependentMergeGroups(context, mergers);
+    if (clusters.size() > 1 && checkpoint_writer.has_value()) {
+      VLOG(0) << "Checkpointing is enabled, merging " << clusters.size()
+              << " independent clusters of merge groups serially.";
+    } else if (clusters.size() > 1) {
+      return ParallelMerge(face, context, mergers, clusters, *thread_pool,
+                           unmapped_glyph_handling_);
     }
+  }
 
-    TRYV(context.ReprocessChanged(std::move(*maybe_modified)));
+  std::vector<size_t> group_indices(mergers.size());
+  std::iota(group_indices.begin(), group_indices.end(), 0);
+  TRYV(RunMergers(
+      context, mergers, group_indices,
+      checkpoint_writer.has_value() ? &*checkpoint_writer : nullptr));
+
+  VLOG(0) << "Last merge group finished. Producing final segmentation.";
+  TRYV(ValidateIncrementalGroupings(face, context));
+  VLOG(0) << "Brotli calls during init font processing:";
+  context.patch_size_cache_for_init_font->LogBrotliCallCount();
+  VLOG(0) << "Brotli calls during merging:";
+  context.patch_size_cache->LogBrotliCallCount();
+
+  for (const auto& merger : mergers) {
+    merger.LogMergedSizeHistogram();
   }
 
-  return absl::InternalError("unreachable");
+  return ToFinalSegmentation(context, unmapped_glyph_handling_);
 }
 
 StatusOr<std::vector<SegmentationCost>> ClosureGlyphSegmenter::TotalCosts(
@@ -3,10 +3,12 @@
 
 #include <memory>
 #include <optional>
+#include <string>
 #include <vector>
 
 #include "absl/container/btree_map.h"
 #include "absl/status/statusor.h"
+#include "absl/time/time.h"
 #include "ift/common/data_file_resolver.h"
 #include "ift/config/common.pb.h"
 #include "ift/config/segmentation_plan.pb.h"
@@ -54,6 +56,42 @@ class ClosureGlyphSegmenter {
         condition_analysis_mode_(condition_analysis_mode),
         resolver_(std::move(resolver)) {}
 
+  /*
+   * Configures the number of threads used to assess candidate merges and to
+   * merge independent merge groups (including the calling thread). The
+   * produced segmentation is the same regardless of thread count.
+   */
+  void SetNumThreads(uint32_t num_threads) { num_threads_ = num_threads; }
+
+  /*
+   * Configures screening of merge candidates with a faster brotli quality, see
+   * SegmentationContext::SetScreening(). Disabled by default.
+   */
+  void SetScreening(uint32_t brotli_quality, double margin) {
+    screening_brotli_quality_ = brotli_quality;
+    screening_margin_ = margin;
+  }
+
+  /*
+   * Periodically saves the state of merging to a checkpoint file at path (see
+   * SegmenterCheckpoint), at most once per interval. A checkpoint is also
+   * saved once the initial analysis is complete, before merging starts.
+   *
+   * When checkpointing, independent merge groups are merged one after another
+   * rather than in parallel, since a checkpoint captures a single context.
+   */
+  void SetCheckpointing(std::string path, absl::Duration interval) {
+    checkpoint_path_ = std::move(path);
+    checkpoint_interval_ = interval;
+  }
+
+  /*
+   * Resume merging from the checkpoint at path instead of starting from the
+   * initial analysis. The checkpoint must have been saved by a run with the
+   * same font, segments, merge groups, and settings.
+   */
+  void SetResumeFrom(std::string path) { resume_from_ = std::move(path); }
+
   /*
    * Analyzes a set of codepoint segments using a subsetter closure and computes
    * a GlyphSegmentation which will satisfy the "glyph closure requirement" for
@@ -115,6 +153,12 @@ class ClosureGlyphSegmenter {
   ift::config::UnmappedGlyphHandling unmapped_glyph_handling_;
   ift::config::ConditionAnalysisMode condition_analysis_mode_;
   std::shared_ptr<ift::common::DataFileResolver> resolver_;
+  uint32_t num_threads_ = 1;
+  uint32_t screening_brotli_quality_ = 0;
+  double screening_margin_ = 0.0;
+  std::string checkpoint_path_;
+  absl::Duration checkpoint_interval_ = absl::ZeroDuration();
+  std::string resume_from_;
 };
 
 }  // namespace ift::encoder
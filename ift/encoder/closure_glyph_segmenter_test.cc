@@ -1,7 +1,12 @@
 #include "ift/encoder/closure_glyph_segmenter.h"
 
+#include <cstdio>
 #include <optional>
+#include <string>
+#include <vector>
 
+#include "absl/status/status.h"
+#include "absl/time/time.h"
 #include "gtest/gtest.h"
 #include "ift/common/bazel_data_file_resolver.h"
 #include "ift/common/font_data.h"
@@ -12,6 +17,7 @@
 #include "ift/encoder/activation_condition.h"
 #include "ift/encoder/glyph_segmentation.h"
 #include "ift/encoder/merge_strategy.h"
+#include "ift/encoder/segmenter_checkpoint.h"
 #include "ift/encoder/subset_definition.h"
 #include "ift/freq/mock_probability_calculator.h"
 #include "ift/freq/unicode_frequencies.h"
@@ -941,6 +947,48 @@ if (s0 AND s1) then p2
 )");
 }
 
+TEST_F(ClosureGlyphSegmenterTest, CostStrategy_ParallelMatchesSerial) {
+  UnicodeFrequencies frequencies{
+      {{' ', ' '}, 100}, {{'a', 'a'}, 90}, {{'e', 'e'}, 80},
+      {{'i', 'i'}, 60},  {{'o', 'o'}, 50}, {{'n', 'n'}, 40},
+      {{'a', 'e'}, 70},  {{'i', 'o'}, 30}, {{0xC1, 0xC1}, 5},
+      // Everything unspecified defaults to a count of 1.
+  };
+  MergeStrategy strategy =
+      *MergeStrategy::BigramCostBased(std::move(frequencies), 75, 3);
+  strategy.SetUsePatchMerges(true);
+
+  std::vector<SubsetDefinition> segments;
+  for (hb_codepoint_t cp = 'a'; cp <= 'z'; cp++) {
+    segments.push_back({cp});
+  }
+  segments.push_back({0xC1}); /* Aacute */
+  segments.push_back({0x106}); /* Cacute */
+
+  // Screening quality 0 disables screening.
+  for (uint32_t screening_quality : {0u, 5u}) {
+    for (const ClosureGlyphSegmenter* base :
+         {&segmenter, &segmenter_dep_graph_only}) {
+      ClosureGlyphSegmenter serial = *base;
+      serial.SetScreening(screening_quality, 0.05);
+      auto expected = serial.CodepointToGlyphSegments(roboto.get(), {},
+                                                      segments, strategy);
+      ASSERT_TRUE(expected.ok()) << expected.status();
+
+      for (uint32_t num_threads : {2, 3, 8}) {
+        ClosureGlyphSegmenter parallel = serial;
+        parallel.SetNumThreads(num_threads);
+        auto segmentation = parallel.CodepointToGlyphSegments(
+            roboto.get(), {}, segments, strategy);
+        ASSERT_TRUE(segmentation.ok()) << segmentation.status();
+        ASSERT_EQ(segmentation->ToString(), expected->ToString())
+            << num_threads << " threads, screening quality "
+            << screening_quality;
+      }
+    }
+  }
+}
+
 TEST_F(ClosureGlyphSegmenterTest, CustomOverhead_CostStrategy) {
   UnicodeFrequencies frequencies{
       {{' ', ' '}, 100}, {{'a', 'a'}, 95}, {{'b', 'b'}, 95}, {{'c', 'c'}, 95},
@@ -1934,6 +1982,162 @@ if (s0 AND s2) then p2
 )");
 }
 
+TEST_F(ClosureGlyphSegmenterTest, MultipleMergeGroups_ParallelMatchesSerial) {
+  UnicodeFrequencies group1_freq{
+      {{' ', ' '}, 100}, {{'a', 'a'}, 100}, {{'b', 'b'}, 90},
+      {{'c', 'c'}, 60},  {{'d', 'd'}, 5},   {{'e', 'e'}, 5},
+  };
+  UnicodeFrequencies group2_freq{
+      {{' ', ' '}, 100}, {{'u', 'u'}, 80}, {{'v', 'v'}, 80},
+      {{'w', 'w'}, 40},  {{'x', 'x'}, 5},  {{'y', 'y'}, 5},
+  };
+
+  // The first two groups don't interact with anything so are merged
+  // independently, the last two interact via the fi ligature and must be
+  // merged together.
+  btree_map<SegmentSet, MergeStrategy> merge_groups{
+      {{0, 1, 2, 3, 4},
+       *MergeStrategy::CostBased(std::move(group1_freq), 75, 1)},
+      {{5, 6, 7, 8, 9},
+       *MergeStrategy::CostBased(std::move(group2_freq), 75, 1)},
+      {{10, 11}, MergeStrategy::Heuristic(10000)},
+      {{12, 13}, MergeStrategy::Heuristic(10000)},
+  };
+
+  std::vector<SubsetDefinition> segments = {
+      {'a'}, {'b'}, {'c'}, {'d'}, {'e'}, {'u'}, {'v'},
+      {'w'}, {'x'}, {'y'}, {'f'}, {'g'}, {'i'}, {'j'},
+  };
+
+  for (const ClosureGlyphSegmenter* base :
+       {&segmenter, &segmenter_dep_graph_only}) {
+    auto expected = base->CodepointToGlyphSegments(roboto.get(), {}, segments,
+                                                   merge_groups);
+    ASSERT_TRUE(expected.ok()) << expected.status();
+
+    for (uint32_t num_threads : {2, 4}) {
+      ClosureGlyphSegmenter parallel = *base;
+      parallel.SetNumThreads(num_threads);
+      auto segmentation = parallel.CodepointToGlyphSegments(
+          roboto.get(), {}, segments, merge_groups);
+      ASSERT_TRUE(segmentation.ok()) << segmentation.status();
+      ASSERT_EQ(segmentation->Segments(), expected->Segments())
+          << num_threads << " threads";
+      ASSERT_EQ(segmentation->ToString(), expected->ToString())
+          << num_threads << " threads";
+    }
+  }
+
+  // With a fallback patch merges in one group change the fallback cost term of
+  // the others, so the groups must not be merged independently.
+  std::vector<SubsetDefinition> fallback_segments = {
+      {0x62a}, {0x62b}, {0x62c}, {0x62d}};
+  UnicodeFrequencies fallback_group1_freq{
+      {{0x62a, 0x62a}, 100}, {{0x62b, 0x62b}, 90}};
+  UnicodeFrequencies fallback_group2_freq{
+      {{0x62c, 0x62c}, 100}, {{0x62d, 0x62d}, 20}};
+  btree_map<SegmentSet, MergeStrategy> fallback_merge_groups{
+      {{0, 1}, 
+       *MergeStrategy::CostBased(std::move(fallback_group1_freq), 75, 1)},
+      {{2, 3}, 
+       *MergeStrategy::CostBased(std::move(fallback_group2_freq), 75, 1)},
+  };
+
+  auto unmerged = segmenter.CodepointToGlyphSegments(
+      noto_nastaliq_urdu.get(), {}, fallback_segments);
+  ASSERT_TRUE(unmerged.ok()) << unmerged.status();
+  ASSERT_FALSE(unmerged->UnmappedGlyphs().empty());
+
+  auto expected = segmenter.CodepointToGlyphSegments(
+      noto_nastaliq_urdu.get(), {}, fallback_segments, fallback_merge_groups);
+  ASSERT_TRUE(expected.ok()) << expected.status();
+  for (uint32_t num_threads : {2, 4}) {
+    ClosureGlyphSegmenter parallel = segmenter;
+    parallel.SetNumThreads(num_threads);
+    auto segmentation = parallel.CodepointToGlyphSegments(
+        noto_nastaliq_urdu.get(), {}, fallback_segments, fallback_merge_groups);
+    ASSERT_TRUE(segmentation.ok()) << segmentation.status();
+    ASSERT_EQ(segmentation->Segments(), expected->Segments())
+        << num_threads << " threads";
+    ASSERT_EQ(segmentation->ToString(), expected->ToString())
+        << num_threads << " threads";
+  }
+}
+
+TEST_F(ClosureGlyphSegmenterTest, Checkpoint_IndependentMergeGroups) {
+  std::string path = ::testing::TempDir() + "/independent_groups.checkpoint";
+  // These groups don't interact so would normally be merged in parallel.
+  std::vector<SubsetDefinition> segments = {{'a'}, {'b'}, {'u'}, {'v'}};
+  btree_map<SegmentSet, MergeStrategy> merge_groups{
+      {{0, 1}, MergeStrategy::Heuristic(10000)},
+      {{2, 3}, MergeStrategy::Heuristic(10000)},
+  };
+
+  ClosureGlyphSegmenter writer = segmenter;
+  writer.SetNumThreads(4);
+  writer.SetCheckpointing(path, absl::ZeroDuration());
+  auto expected = writer.CodepointToGlyphSegments(roboto.get(), {}, segments,
+                                                  merge_groups);
+  ASSERT_TRUE(expected.ok()) << expected.status();
+
+  // Checkpoints are still saved as merges happen, so the last one has every
+  // group fully merged.
+  auto checkpoint = SegmenterCheckpoint::Load(path);
+  ASSERT_TRUE(checkpoint.ok()) << checkpoint.status();
+  uint32_t non_empty = 0;
+  for (const auto& segment : checkpoint->Segments()) {
+    if (!segment.Definition().Empty()) {
+      non_empty++;
+    }
+  }
+  ASSERT_EQ(non_empty, 2);
+
+  ClosureGlyphSegmenter resumed = segmenter;
+  resumed.SetNumThreads(4);
+  resumed.SetResumeFrom(path);
+  auto segmentation = resumed.CodepointToGlyphSegments(roboto.get(), {},
+                                                       segments, merge_groups);
+  ASSERT_TRUE(segmentation.ok()) << segmentation.status();
+  ASSERT_EQ(segmentation->ToString(), expected->ToString());
+
+  std::remove(path.c_str());
+}
+
+TEST_F(ClosureGlyphSegmenterTest, Checkpoint_ResumeRejectsChangedStrategy) {
+  std::string path = ::testing::TempDir() + "/changed_strategy.checkpoint";
+  std::vector<SubsetDefinition> segments = {
+      {'a', 'b', 'd'}, {'e', 'f'}, {'j', 'k', 'm', 'n'}, {'i', 'l'}};
+
+  ClosureGlyphSegmenter writer(8, 8, PATCH, CLOSURE_ONLY, resolver);
+  // A checkpoint is saved once merging starts.
+  writer.SetCheckpointing(path, absl::InfiniteDuration());
+  auto expected = writer.CodepointToGlyphSegments(
+      roboto.get(), {}, segments, MergeStrategy::Heuristic(370));
+  ASSERT_TRUE(expected.ok()) << expected.status();
+
+  ClosureGlyphSegmenter resumed(8, 8, PATCH, CLOSURE_ONLY, resolver);
+  resumed.SetResumeFrom(path);
+  auto segmentation = resumed.CodepointToGlyphSegments(
+      roboto.get(), {}, segments, MergeStrategy::Heuristic(370));
+  ASSERT_TRUE(segmentation.ok()) << segmentation.status();
+  ASSERT_EQ(segmentation->ToString(), expected->ToString());
+
+  segmentation = resumed.CodepointToGlyphSegments(
+      roboto.get(), {}, segments, MergeStrategy::Heuristic(1000));
+  ASSERT_TRUE(absl::IsFailedPrecondition(segmentation.status()))
+      << segmentation.status();
+
+  ClosureGlyphSegmenter screened(8, 8, PATCH, CLOSURE_ONLY, resolver);
+  screened.SetScreening(5, 0.1);
+  screened.SetResumeFrom(path);
+  segmentation = screened.CodepointToGlyphSegments(
+      roboto.get(), {}, segments, MergeStrategy::Heuristic(370));
+  ASSERT_TRUE(absl::IsFailedPrecondition(segmentation.status()))
+      << segmentation.status();
+
+  std::remove(path.c_str());
+}
+
 TEST_F(ClosureGlyphSegmenterTest, CompositeMerge_Cutoff) {
   UnicodeFrequencies freq{
       {{' ', ' '}, 100}, {{'g', 'g'}, 100}, {{'j', 'j'}, 100},
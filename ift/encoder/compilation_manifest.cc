@@ -0,0 +1,216 @@
+#include "ift/encoder/compilation_manifest.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "absl/container/btree_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "hb.h"
+#include "ift/common/fingerprint.h"
+#include "ift/common/font_data.h"
+#include "ift/common/font_helper.h"
+#include "ift/common/try.h"
+
+using absl::btree_set;
+using absl::Status;
+using absl::StatusOr;
+using absl::StrCat;
+using absl::string_view;
+using ift::common::Fingerprint;
+using ift::common::FontData;
+using ift::common::FontHelper;
+using ift::common::hb_face_unique_ptr;
+
+namespace ift::encoder {
+
+static constexpr uint32_t kVersion = 1;
+
+static std::string FileHeader() {
+  std::string header = "iftm";
+  FontHelper::WriteUInt32(kVersion, header);
+  return header;
+}
+
+static void WriteFingerprint(const Fingerprint& fingerprint,
+                             std::string& out) {
+  FontHelper::WriteUInt32(fingerprint.high >> 32, out);
+  FontHelper::WriteUInt32(fingerprint.high & 0xFFFFFFFF, out);
+  FontHelper::WriteUInt32(fingerprint.low >> 32, out);
+  FontHelper::WriteUInt32(fingerprint.low & 0xFFFFFFFF, out);
+}
+
+static StatusOr<uint32_t> ReadUInt32(string_view& data) {
+  uint32_t value = TRY(FontHelper::ReadUInt32(data));
+  data.remove_prefix(4);
+  return value;
+}
+
+static StatusOr<Fingerprint> ReadFingerprint(string_view& data) {
+  uint64_t values[4];
+  for (uint64_t& value : values) {
+    value = TRY(ReadUInt32(data));
+  }
+  return Fingerprint{
+      .high = (values[0] << 32) | values[1],
+      .low = (values[2] << 32) | values[3],
+  };
+}
+
+// Reads a count and checks that at least min_bytes_each remain for each of the
+// counted items, so that corrupt counts can't trigger huge allocations.
+static StatusOr<uint32_t> ReadCount(string_view& data, size_t min_bytes_each) {
+  uint32_t count = TRY(ReadUInt32(data));
+  if (count > data.size() / min_bytes_each) {
+    return absl::InvalidArgumentError("Manifest count is out of range.");
+  }
+  return count;
+}
+
+CompilationManifest::Node CompilationManifest::FingerprintNode(
+    const FontData& font) {
+  Node node;
+  node.font = Fingerprint::Of(font.str());
+  hb_face_unique_ptr face = font.face();
+  for (hb_tag_t tag : FontHelper::GetOrderedTags(face.get())) {
+    FontData table = FontHelper::TableData(face.get(), tag);
+    node.tables[tag] = Fingerprint::Of(table.str());
+  }
+  return node;
+}
+
+btree_set<hb_tag_t> CompilationManifest::ChangedTables(const Node& a,
+                                                       const Node& b) {
+  btree_set<hb_tag_t> changed;
+  for (const auto& [tag, fingerprint] : a.tables) {
+    auto it = b.tables.find(tag);
+    if (it == b.tables.end() || it->second != fingerprint) {
+      changed.insert(tag);
+    }
+  }
+  for (const auto& [tag, _] : b.tables) {
+    if (!a.tables.contains(tag)) {
+      changed.insert(tag);
+    }
+  }
+  return changed;
+}
+
+std::string CompilationManifest::Serialize() const {
+  std::string out = FileHeader();
+
+  FontHelper::WriteUInt32(patches_.size(), out);
+  for (const auto& [url, patch] : patches_) {
+    FontHelper::WriteUInt32(url.size(), out);
+    out += url;
+    WriteFingerprint(patch.inputs, out);
+    WriteFingerprint(patch.data, out);
+  }
+
+  FontHelper::WriteUInt32(nodes_.size(), out);
+  for (const auto& [subset, node] : nodes_) {
+    WriteFingerprint(subset, out);
+    WriteFingerprint(node.font, out);
+    FontHelper::WriteUInt32(node.tables.size(), out);
+    for (const auto& [tag, fingerprint] : node.tables) {
+      FontHelper::WriteUInt32(tag, out);
+      WriteFingerprint(fingerprint, out);
+    }
+  }
+  return out;
+}
+
+StatusOr<CompilationManifest> CompilationManifest::Deserialize(
+    string_view data) {
+  std::string header = FileHeader();
+  if (data.substr(0, header.size()) != header) {
+    return absl::InvalidArgumentError(
+        "Not a compilation manifest (or is an incompatible version).");
+  }
+  data.remove_prefix(header.size());
+
+  CompilationManifest manifest;
+  uint32_t num_patches = TRY(ReadCount(data, 36));
+  for (uint32_t i = 0; i < num_patches; i++) {
+    uint32_t url_length = TRY(ReadUInt32(data));
+    if (url_length > data.size()) {
+      return absl::InvalidArgumentError("Truncated url in manifest.");
+    }
+    std::string url(data.substr(0, url_length));
+    data.remove_prefix(url_length);
+
+    Patch patch;
+    patch.inputs = TRY(ReadFingerprint(data));
+    patch.data = TRY(ReadFingerprint(data));
+    manifest.patches_[std::move(url)] = patch;
+  }
+
+  uint32_t num_nodes = TRY(ReadCount(data, 36));
+  for (uint32_t i = 0; i < num_nodes; i++) {
+    Fingerprint subset = TRY(ReadFingerprint(data));
+    Node node;
+    node.font = TRY(ReadFingerprint(data));
+    uint32_t num_tables = TRY(ReadCount(data, 20));
+    for (uint32_t j = 0; j < num_tables; j++) {
+      hb_tag_t tag = TRY(ReadUInt32(data));
+      node.tables[tag] = TRY(ReadFingerprint(data));
+    }
+    manifest.nodes_[subset] = std::move(node);
+  }
+
+  if (!data.empty()) {
+    return absl::InvalidArgumentError("Unexpected trailing manifest data.");
+  }
+  return manifest;
+}
+
+StatusOr<CompilationManifest> CompilationManifest::Load(
+    const std::string& path) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return absl::NotFoundError(StrCat("Unable to open manifest ", path, ": ",
+                                      std::strerror(errno)));
+  }
+
+  std::string data;
+  char buffer[1 << 16];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    data.append(buffer, read);
+  }
+  bool failed = ferror(file);
+  fclose(file);
+  if (failed) {
+    return absl::InternalError(StrCat("Unable to read manifest ", path));
+  }
+
+  auto manifest = Deserialize(data);
+  if (!manifest.ok()) {
+    return absl::InvalidArgumentError(
+        StrCat(path, ": ", manifest.status().message()));
+  }
+  return manifest;
+}
+
+Status CompilationManifest::Save(const std::string& path) const {
+  std::string data = Serialize();
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    return absl::InternalError(
+        StrCat("Unable to open ", path, ": ", std::strerror(errno)));
+  }
+  bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+  ok = (fclose(file) == 0) && ok;
+  if (!ok) {
+    return absl::InternalError(
+        StrCat("Unable to write ", path, ": ", std::strerror(errno)));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace ift::encoder
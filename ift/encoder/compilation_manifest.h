@@ -0,0 +1,115 @@
+#ifndef IFT_ENCODER_COMPILATION_MANIFEST_H_
+#define IFT_ENCODER_COMPILATION_MANIFEST_H_
+
+#include <string>
+
+#include "absl/container/btree_map.h"
+#include "absl/container/btree_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "hb.h"
+#include "ift/common/fingerprint.h"
+#include "ift/common/font_data.h"
+
+namespace ift::encoder {
+
+/*
+ * Describes the output of a compilation (see Compiler::Encoding) so that a
+ * later compilation can tell which patches are unchanged and reuse them
+ * instead of regenerating them (see Compiler::SetPreviousEncoding()).
+ *
+ * For each patch the manifest records its url, a fingerprint of all of the
+ * inputs that determine the patch bytes, and a fingerprint of the patch bytes
+ * themselves. For each node of the table keyed patch graph it records the
+ * fingerprint of the node's subset definition, of the node's font, and of
+ * each table in that font.
+ *
+ * File format (integers are big endian):
+ *   header:  'i' 'f' 't' 'm', version (uint32)
+ *   patches: count (uint32), then per patch: url length (uint32), url, inputs
+ *            fingerprint, data fingerprint
+ *   nodes:   count (uint32), then per node: subset fingerprint, font
+ *            fingerprint, table count (uint32), and per table the tag (uint32)
+ *            and fingerprint
+ *
+ * Fingerprints are stored as two uint64s (high, low).
+ */
+class CompilationManifest {
+ public:
+  struct Patch {
+    ift::common::Fingerprint inputs;
+    ift::common::Fingerprint data;
+
+    bool operator==(const Patch& other) const {
+      return inputs == other.inputs && data == other.data;
+    }
+  };
+
+  struct Node {
+    ift::common::Fingerprint font;
+    absl::btree_map<hb_tag_t, ift::common::Fingerprint> tables;
+
+    bool operator==(const Node& other) const {
+      return font == other.font && tables == other.tables;
+    }
+  };
+
+  // Fingerprints font and each of its tables.
+  static Node FingerprintNode(const ift::common::FontData& font);
+
+  // Returns the tags of tables which were added, removed, or modified between
+  // a and b.
+  static absl::btree_set<hb_tag_t> ChangedTables(const Node& a, const Node& b);
+
+  static absl::StatusOr<CompilationManifest> Deserialize(
+      absl::string_view data);
+
+  // Loads a manifest previously written by Save().
+  static absl::StatusOr<CompilationManifest> Load(const std::string& path);
+
+  std::string Serialize() const;
+
+  absl::Status Save(const std::string& path) const;
+
+  void AddPatch(std::string url, Patch patch) {
+    patches_[std::move(url)] = patch;
+  }
+
+  void AddNode(ift::common::Fingerprint subset, Node node) {
+    nodes_[subset] = std::move(node);
+  }
+
+  // Returns the patch with url, or nullptr if there is none.
+  const Patch* FindPatch(const std::string& url) const {
+    auto it = patches_.find(url);
+    return it != patches_.end() ? &it->second : nullptr;
+  }
+
+  // Returns the node whose subset definition has fingerprint subset, or
+  // nullptr if there is none.
+  const Node* FindNode(ift::common::Fingerprint subset) const {
+    auto it = nodes_.find(subset);
+    return it != nodes_.end() ? &it->second : nullptr;
+  }
+
+  const absl::btree_map<std::string, Patch>& Patches() const {
+    return patches_;
+  }
+
+  const absl::btree_map<ift::common::Fingerprint, Node>& Nodes() const {
+    return nodes_;
+  }
+
+  bool operator==(const CompilationManifest& other) const {
+    return patches_ == other.patches_ && nodes_ == other.nodes_;
+  }
+
+ private:
+  absl::btree_map<std::string, Patch> patches_;
+  absl::btree_map<ift::common::Fingerprint, Node> nodes_;
+};
+
+}  // namespace ift::encoder
+
+#endif  // IFT_ENCODER_COMPILATION_MANIFEST_H_
@@ -0,0 +1,108 @@
+#include "ift/encoder/compilation_manifest.h"
+
+#include <cstdio>
+#include <string>
+
+#include "absl/container/btree_set.h"
+#include "absl/status/status.h"
+#include "gtest/gtest.h"
+#include "hb.h"
+#include "ift/common/fingerprint.h"
+#include "ift/common/font_data.h"
+#include "ift/common/font_helper.h"
+#include "ift/common/test_font_loader.h"
+
+using absl::btree_set;
+using ift::common::Fingerprint;
+using ift::common::FontData;
+using ift::common::FontHelper;
+
+namespace ift::encoder {
+
+class CompilationManifestTest : public ::testing::Test {
+ protected:
+  CompilationManifestTest() {
+    auto loader = ift::common::TestFontLoader::Default().value();
+    roboto =
+        loader->LoadFontData("ift/common/testdata/Roboto-Regular.ttf").value();
+
+    manifest.AddPatch("1_0.ift_tk", {.inputs = Fingerprint::Of("a"),
+                                     .data = Fingerprint::Of("b")});
+    manifest.AddPatch("1_1.ift_gk", {.inputs = Fingerprint::Of("c"),
+                                     .data = Fingerprint::Of("d")});
+    manifest.AddNode(Fingerprint::Of("root"),
+                     CompilationManifest::FingerprintNode(roboto));
+  }
+
+  FontData roboto;
+  CompilationManifest manifest;
+};
+
+TEST_F(CompilationManifestTest, RoundTrip) {
+  auto restored = CompilationManifest::Deserialize(manifest.Serialize());
+  ASSERT_TRUE(restored.ok()) << restored.status();
+  ASSERT_EQ(*restored, manifest);
+
+  const CompilationManifest::Patch* patch = restored->FindPatch("1_1.ift_gk");
+  ASSERT_NE(patch, nullptr);
+  ASSERT_EQ(patch->inputs, Fingerprint::Of("c"));
+  ASSERT_EQ(patch->data, Fingerprint::Of("d"));
+  ASSERT_EQ(restored->FindPatch("2_0.ift_tk"), nullptr);
+
+  const CompilationManifest::Node* node =
+      restored->FindNode(Fingerprint::Of("root"));
+  ASSERT_NE(node, nullptr);
+  ASSERT_EQ(node->font, Fingerprint::Of(roboto.str()));
+  ASSERT_EQ(node->tables.size(),
+            FontHelper::GetOrderedTags(roboto.face().get()).size());
+  ASSERT_EQ(restored->FindNode(Fingerprint::Of("other")), nullptr);
+}
+
+TEST_F(CompilationManifestTest, SaveAndLoad) {
+  std::string path = ::testing::TempDir() + "/manifest";
+  auto sc = manifest.Save(path);
+  ASSERT_TRUE(sc.ok()) << sc;
+
+  auto loaded = CompilationManifest::Load(path);
+  std::remove(path.c_str());
+  ASSERT_TRUE(loaded.ok()) << loaded.status();
+  ASSERT_EQ(*loaded, manifest);
+
+  ASSERT_TRUE(absl::IsNotFound(
+      CompilationManifest::Load(path + ".missing").status()));
+}
+
+TEST_F(CompilationManifestTest, RejectsCorruptData) {
+  std::string data = manifest.Serialize();
+
+  ASSERT_FALSE(CompilationManifest::Deserialize("").ok());
+  ASSERT_FALSE(CompilationManifest::Deserialize("iftm").ok());
+
+  // Truncated at every length.
+  for (size_t i = 0; i < data.size(); i++) {
+    ASSERT_FALSE(CompilationManifest::Deserialize(data.substr(0, i)).ok())
+        << "length " << i;
+  }
+
+  // Trailing data.
+  ASSERT_FALSE(CompilationManifest::Deserialize(data + "x").ok());
+}
+
+TEST_F(CompilationManifestTest, ChangedTables) {
+  CompilationManifest::Node a = CompilationManifest::FingerprintNode(roboto);
+  CompilationManifest::Node b = a;
+  ASSERT_TRUE(CompilationManifest::ChangedTables(a, b).empty());
+
+  hb_tag_t glyf = HB_TAG('g', 'l', 'y', 'f');
+  hb_tag_t cmap = HB_TAG('c', 'm', 'a', 'p');
+  hb_tag_t ift = HB_TAG('I', 'F', 'T', ' ');
+  b.tables[glyf] = Fingerprint::Of("modified");
+  b.tables.erase(cmap);
+  b.tables[ift] = Fingerprint::Of("added");
+
+  btree_set<hb_tag_t> expected = {glyf, cmap, ift};
+  ASSERT_EQ(CompilationManifest::ChangedTables(a, b), expected);
+  ASSERT_EQ(CompilationManifest::ChangedTables(b, a), expected);
+}
+
+}  // namespace ift::encoder
@@ -8,19 +8,29 @@
 #include <memory>
 #include <optional>
 
+#include "absl/container/flat_hash_set.h"
+#include "absl/functional/function_ref.h"
+#include "absl/log/log.h"
+#include "absl/log/vlog_is_on.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "hb-subset.h"
 #include "ift/common/binary_diff.h"
 #include "ift/common/compat_id.h"
+#include "ift/common/fingerprint.h"
 #include "ift/common/font_data.h"
 #include "ift/common/font_helper.h"
 #include "ift/common/int_set.h"
 #include "ift/common/try.h"
 #include "ift/common/woff2.h"
 #include "ift/encoder/activation_condition.h"
+#include "ift/encoder/compilation_manifest.h"
+#include "ift/encoder/edge_size_estimator.h"
 #include "ift/encoder/init_subset_defaults.h"
 #include "ift/encoder/subset_definition.h"
 #include "ift/encoder/types.h"
@@ -33,6 +43,8 @@
 
 using absl::btree_set;
 using absl::flat_hash_map;
+using absl::flat_hash_set;
+using absl::FunctionRef;
 using absl::Status;
 using absl::StatusOr;
 using absl::StrCat;
@@ -40,8 +52,10 @@ using absl::string_view;
 using ift::GlyphKeyedDiff;
 using ift::common::BinaryDiff;
 using ift::common::CompatId;
+using ift::common::Fingerprint;
 using ift::common::FontData;
 using ift::common::FontHelper;
+using ift::common::GlyphSet;
 using ift::common::hb_blob_unique_ptr;
 using ift::common::hb_face_unique_ptr;
 using ift::common::IntSet;
@@ -60,31 +74,45 @@ using ift::proto::TABLE_KEYED_PARTIAL;
 
 namespace ift::encoder {
 
-static void AddCombinations(const std::vector<const SubsetDefinition*>& in,
-                            uint32_t choose, std::vector<Compiler::Edge>& out) {
-  if (!choose || in.size() < choose) {
-    return;
-  }
+static void WriteFingerprint(const Fingerprint& fingerprint,
+                             std::string& out) {
+  FontHelper::WriteUInt32(fingerprint.high >> 32, out);
+  FontHelper::WriteUInt32(fingerprint.high & 0xFFFFFFFF, out);
+  FontHelper::WriteUInt32(fingerprint.low >> 32, out);
+  FontHelper::WriteUInt32(fingerprint.low & 0xFFFFFFFF, out);
+}
 
-  if (choose == 1) {
-    for (auto item : in) {
-      out.push_back(Compiler::Edge{*item});
-    }
-    return;
+// Calls emit with each combination of choose more indices from [start,
+// probabilities.size()) appended to prefix, in lexicographic order.
+// Combinations whose probability is below min_probability are skipped, since
+// probabilities are at most 1 this prunes all extensions of a prefix that is
+// already below it. Returns false if emit asked to stop.
+static bool ForEachCombination(uint32_t start, uint32_t choose,
+                               double prefix_probability,
+                               double min_probability,
+                               absl::Span<const double> probabilities,
+                               std::vector<uint32_t>& prefix,
+                               absl::FunctionRef<bool()> emit) {
+  if (!choose) {
+    return emit();
   }
 
-  for (auto it = in.begin(); it != in.end(); it++) {
-    auto it_inner = it + 1;
-    std::vector<const SubsetDefinition*> remaining;
-    std::copy(it_inner, in.end(), std::back_inserter(remaining));
+  for (uint32_t i = start; i + choose <= probabilities.size(); i++) {
+    double probability = prefix_probability * probabilities[i];
+    if (probability < min_probability) {
+      continue;
+    }
 
-    std::vector<Compiler::Edge> combinations;
-    AddCombinations(remaining, choose - 1, combinations);
-    for (auto& edge : combinations) {
-      edge.Add(**it);
-      out.push_back(std::move(edge));
+    prefix.push_back(i);
+    bool keep_going = ForEachCombination(i + 1, choose - 1, probability,
+                                         min_probability, probabilities,
+                                         prefix, emit);
+    prefix.pop_back();
+    if (!keep_going) {
+      return false;
     }
   }
+  return true;
 }
 
 StatusOr<FontData> Compiler::FullyExpandedSubset(
@@ -100,33 +128,62 @@ StatusOr<FontData> Compiler::FullyExpandedSubset(
     all.gids.insert(gids.begin(), gids.end());
   }
 
-  return CutSubset(context, face_.get(), all, false);
+  return CutSubset(context, face_.get(), all, false, false);
 }
 
 std::vector<Compiler::Edge> Compiler::OutgoingEdges(
     const SubsetDefinition& node_subset, uint32_t choose) const {
+  std::vector<Edge> result;
+  ForEachOutgoingEdge(node_subset, choose,
+                      [&](Edge edge) { result.push_back(std::move(edge)); });
+  return result;
+}
+
+void Compiler::ForEachOutgoingEdge(
+    const SubsetDefinition& node_subset, uint32_t choose,
+    absl::FunctionRef<void(Edge)> callback) const {
+  const std::vector<double>& segment_probabilities =
+      jump_ahead_pruning_.segment_probabilities;
   std::vector<SubsetDefinition> remaining_subsets;
-  for (const auto& s : extension_subsets_) {
-    SubsetDefinition filtered = s;
+  std::vector<double> probabilities;
+  for (size_t i = 0; i < extension_subsets_.size(); i++) {
+    SubsetDefinition filtered = extension_subsets_[i];
     filtered.Subtract(node_subset);
     if (filtered.Empty()) {
       continue;
     }
 
     remaining_subsets.push_back(std::move(filtered));
+    probabilities.push_back(i < segment_probabilities.size()
+                                ? segment_probabilities[i]
+                                : 1.0);
   }
 
-  std::vector<const SubsetDefinition*> input;
-  for (const auto& s : remaining_subsets) {
-    input.push_back(&s);
-  }
-
-  std::vector<Edge> result;
+  uint32_t max_multi_segment_edges =
+      jump_ahead_pruning_.max_multi_segment_edges;
+  uint32_t multi_segment_edges = 0;
+  std::vector<uint32_t> indices;
   for (uint32_t i = 1; i <= choose; i++) {
-    AddCombinations(input, i, result);
+    bool multi_segment = i > 1;
+    bool keep_going = ForEachCombination(
+        0, i, 1.0, multi_segment ? jump_ahead_pruning_.min_probability : 0.0,
+        probabilities, indices, [&]() {
+          if (multi_segment && max_multi_segment_edges &&
+              multi_segment_edges++ >= max_multi_segment_edges) {
+            return false;
+          }
+
+          Edge edge{remaining_subsets[indices.back()]};
+          for (auto it = indices.rbegin() + 1; it != indices.rend(); it++) {
+            edge.Add(remaining_subsets[*it]);
+          }
+          callback(std::move(edge));
+          return true;
+        });
+    if (!keep_going) {
+      break;
+    }
   }
-
-  return result;
 }
 
 Status Compiler::AddGlyphDataPatch(uint32_t id, const IntSet& gids) {
@@ -201,13 +258,21 @@ void Compiler::AddDesignSpaceSegment(const design_space_t& space) {
 }
 
 StatusOr<Compiler::Encoding> Compiler::Compile() const {
+  InMemoryPatchSink sink;
+  Encoding result = TRY(Compile(sink));
+  result.patches = sink.TakePatches();
+  return result;
+}
+
+StatusOr<Compiler::Encoding> Compiler::Compile(PatchSink& sink) const {
   // See ../../docs/experimental/compiler.md for a detailed discussion of
   // how this implementation works.
   if (!face_) {
     return absl::FailedPreconditionError("Encoder must have a face set.");
   }
 
-  ProcessingContext context(next_id_);
+  ProcessingContext context(next_id_, num_threads_,
+                            table_diff_cache_max_bytes_, sink);
   context.init_subset_ = init_subset_;
   AddInitSubsetDefaults(context.init_subset_);
   if (IsMixedMode()) {
@@ -242,6 +307,7 @@ StatusOr<Compiler::Encoding> Compiler::Compile() const {
   auto expanded = TRY(FullyExpandedSubset(context));
 
   context.fully_expanded_subset_.shallow_copy(expanded);
+  context.edge_size_estimator_ = TRY(EdgeSizeEstimator::Create(expanded));
   auto expanded_face = expanded.face();
 
   // TODO(garretrieger): we don't need to force long gvar anymore. The client is
@@ -251,7 +317,18 @@ StatusOr<Compiler::Encoding> Compiler::Compile() const {
       TRY(FontHelper::HasLongLoca(expanded_face.get())) ||
       FontHelper::HasWideGvar(expanded_face.get());
 
+  if (IsMixedMode()) {
+    TRYV(InstanceDesignSpaces(context));
+  }
+
+  CountNodeReferences(context);
   auto init_compile_result = TRY(Compile(context, context.init_subset_, true));
+  TRYV(GeneratePendingPatches(context));
+  LogEdgeSizeRankingError(context);
+
+  // The per node table sizes are only needed while patch maps are being
+  // ordered, don't hold on to them for the rest of the compile.
+  context.node_table_sizes_.clear();
 
   Encoding result;
 
@@ -268,7 +345,21 @@ StatusOr<Compiler::Encoding> Compiler::Compile() const {
   } else {
     result.init_font.shallow_copy(init_compile_result.font_data);
   }
-  result.patches = std::move(context.patches_);
+  result.table_diff_cache_stats = context.table_diff_cache_.GetStats();
+  result.subset_plan_cache_stats = context.subset_plan_cache_.GetStats();
+  result.max_pending_patches = context.max_pending_patches_;
+
+  absl::MutexLock lock(&context.manifest_mutex_);
+  result.manifest = std::move(context.manifest_);
+  result.incremental_stats = context.incremental_stats_;
+  result.patch_metadata = std::move(context.patch_metadata_);
+  if (previous_patches_ != nullptr) {
+    VLOG(0) << "Incremental compile reused "
+            << result.incremental_stats.reused_patches << " patches, generated "
+            << result.incremental_stats.generated_patches << " patches ("
+            << result.incremental_stats.changed_nodes
+            << " graph nodes changed).";
+  }
   return result;
 }
 
@@ -316,20 +407,20 @@ Status Compiler::EnsureGlyphKeyedPatchesPopulated(
     return absl::OkStatus();
   }
 
-  auto full_face = context.fully_expanded_subset_.face();
   FontData instance;
-  instance.set(full_face.get());
-
-  if (!design_space.empty()) {
+  if (design_space.empty()) {
+    instance.shallow_copy(context.fully_expanded_subset_);
+  } else {
     // If a design space is provided, apply it.
-    auto result = TRY(Instance(context, full_face.get(), design_space));
-    instance.shallow_copy(result);
+    instance = TRY(DesignSpaceInstance(context, design_space));
   }
 
   GlyphKeyedDiff differ(instance, compat_id,
                         {FontHelper::kGlyf, FontHelper::kGvar, FontHelper::kCFF,
                          FontHelper::kCFF2});
 
+  std::vector<std::string> urls;
+  std::vector<const IntSet*> segment_gids;
   for (uint32_t index : reachable_segments) {
     auto e = glyph_data_patches_.find(index);
     if (e == glyph_data_patches_.end()) {
@@ -337,16 +428,105 @@ Status Compiler::EnsureGlyphKeyedPatchesPopulated(
           StrCat("Glyph data segment ", index, " was not provided."));
     }
 
-    std::string url = TRY(URLTemplate::PatchToUrl(url_template, index));
-
-    const auto& gids = e->second;
-    auto patch = TRY(differ.CreatePatch(gids));
-    context.patches_[url].shallow_copy(patch);
+    urls.push_back(TRY(URLTemplate::PatchToUrl(url_template, index)));
+    segment_gids.push_back(&e->second);
   }
 
+  // Each patch is independent so they can be created in parallel, and each is
+  // handed off to the sink as soon as it's been created.
+  TRYV(context.thread_pool_.ParallelFor(
+      urls.size(), [&](size_t i) -> Status {
+        Fingerprint inputs = TRY(differ.PatchFingerprint(*segment_gids[i]));
+        return EmitPatch(context, urls[i], inputs, [&]() {
+          return differ.CreatePatch(*segment_gids[i]);
+        });
+      }));
+
+  if (!design_space.empty()) {
+    context.subset_plan_cache_.ReleaseInstance(design_space);
+  }
   return absl::OkStatus();
 }
 
+Status Compiler::EmitPatch(ProcessingContext& context, const std::string& url,
+                           Fingerprint inputs,
+                           FunctionRef<StatusOr<FontData>()> generate) const {
+  FontData patch;
+  std::optional<FontData> previous = ReusablePatch(url, inputs);
+  if (previous.has_value()) {
+    patch.shallow_copy(*previous);
+  } else {
+    patch = TRY(generate());
+  }
+
+  {
+    absl::MutexLock lock(&context.manifest_mutex_);
+    context.manifest_.AddPatch(url, {.inputs = inputs,
+                                     .data = Fingerprint::Of(patch.str())});
+    context.patch_metadata_[url].size = patch.size();
+    if (previous.has_value()) {
+      context.incremental_stats_.reused_patches++;
+    } else {
+      context.incremental_stats_.generated_patches++;
+    }
+  }
+  return context.sink_->Accept(url, patch);
+}
+
+std::optional<FontData> Compiler::ReusablePatch(const std::string& url,
+                                                Fingerprint inputs) const {
+  if (previous_patches_ == nullptr) {
+    return std::nullopt;
+  }
+  const CompilationManifest::Patch* entry = previous_manifest_.FindPatch(url);
+  if (entry == nullptr || entry->inputs != inputs) {
+    return std::nullopt;
+  }
+
+  auto patch = previous_patches_->Load(url);
+  if (!patch.ok()) {
+    LOG(WARNING) << "Regenerating " << url
+                 << ", previous patch is unavailable: " << patch.status();
+    return std::nullopt;
+  }
+  if (Fingerprint::Of(patch->str()) != entry->data) {
+    LOG(WARNING) << "Regenerating " << url
+                 << ", previous patch does not match the manifest.";
+    return std::nullopt;
+  }
+  return std::move(*patch);
+}
+
+Fingerprint Compiler::RecordNode(ProcessingContext& context,
+                                 const SubsetDefinition& node_subset,
+                                 const FontData& node_data) const {
+  CompilationManifest::Node node =
+      CompilationManifest::FingerprintNode(node_data);
+  Fingerprint subset = node_subset.fingerprint();
+  Fingerprint font = node.font;
+
+  const CompilationManifest::Node* previous =
+      previous_patches_ != nullptr ? previous_manifest_.FindNode(subset)
+                                   : nullptr;
+  bool changed = previous != nullptr && previous->font != font;
+  if (changed) {
+    VLOG(1) << "Graph node with " << node_subset.codepoints.size()
+            << " codepoints changed, modified tables: "
+            << absl::StrJoin(
+                   CompilationManifest::ChangedTables(*previous, node), ", ",
+                   [](std::string* out, hb_tag_t tag) {
+                     out->append(FontHelper::ToString(tag));
+                   });
+  }
+
+  absl::MutexLock lock(&context.manifest_mutex_);
+  context.manifest_.AddNode(subset, std::move(node));
+  if (changed) {
+    context.incremental_stats_.changed_nodes++;
+  }
+  return font;
+}
+
 Status Compiler::PopulateGlyphKeyedPatchMap(PatchMap& patch_map) const {
   if (glyph_data_patches_.empty()) {
     return absl::OkStatus();
@@ -424,68 +604,147 @@ std::vector<ActivationCondition> Compiler::EdgesToActivationConditions(
 
 StatusOr<std::vector<std::pair<size_t, uint64_t>>> Compiler::EstimateEdgeSizes(
     ProcessingContext& context, const SubsetDefinition& base_subset,
-    const FontData& base_font_data, const CompatId& table_keyed_compat_id,
-    const std::vector<uint8_t>& glyph_keyed_url_template,
+    const FontData& base_font_data,
     absl::Span<const Compiler::Edge> edges) const {
-  std::vector<std::pair<size_t, uint64_t>> sizes;
-  sizes.reserve(edges.size());
-
-  size_t index = 0;
+  // Patch sizes are predicted from the table sizes of the fonts at either end
+  // of each jump (see EdgeSizeEstimator), so only the subsets of the jump
+  // targets are needed. Any that haven't been cut yet are cut in parallel and
+  // kept for when the target is compiled.
+  context.node_table_sizes_.try_emplace(
+      base_subset, EdgeSizeEstimator::SizesOf(base_font_data));
+
+  std::vector<SubsetDefinition> to_cut;
+  flat_hash_set<SubsetDefinition> seen;
   for (const auto& edge : edges) {
-    uint64_t total_estimated_size = 0;
+    for (const auto& j : edge.Jumps(base_subset, this->use_prefetch_lists_)) {
+      if (!context.node_table_sizes_.contains(j.end) &&
+          !context.built_subsets_.contains(j.end) &&
+          !context.node_subsets_.contains(j.end) && seen.insert(j.end).second) {
+        to_cut.push_back(j.end);
+      }
+    }
+  }
 
-    SubsetDefinition current_subset = base_subset;
-    CompileResult current{
-        .table_keyed_compat_id = table_keyed_compat_id,
-        .glyph_keyed_url_template = glyph_keyed_url_template,
-    };
-    current.font_data.shallow_copy(base_font_data);
+  std::vector<FontData> cut(to_cut.size());
+  TRYV(context.thread_pool_.ParallelFor(to_cut.size(), [&](size_t i) -> Status {
+    cut[i] = TRY(CutNodeSubset(context, to_cut[i]));
+    return absl::OkStatus();
+  }));
+  for (size_t i = 0; i < to_cut.size(); i++) {
+    context.node_subsets_[std::move(to_cut[i])] = std::move(cut[i]);
+  }
 
+  // node_table_sizes_ is a node map so returned references remain valid.
+  using TableSizes = EdgeSizeEstimator::TableSizes;
+  auto sizes_of = [&](const SubsetDefinition& subset) -> const TableSizes& {
+    auto [it, inserted] = context.node_table_sizes_.try_emplace(subset);
+    if (inserted) {
+      auto built = context.built_subsets_.find(subset);
+      it->second = EdgeSizeEstimator::SizesOf(
+          built != context.built_subsets_.end()
+              ? built->second.font_data
+              : context.node_subsets_.at(subset));
+    }
+    return it->second;
+  };
+
+  for (const auto& edge : edges) {
+    SubsetDefinition current_subset = base_subset;
     for (const auto& j : edge.Jumps(base_subset, this->use_prefetch_lists_)) {
       if (j.start != current_subset) {
         return absl::InternalError(
             "PopulateTableKeyedPatchMap: Base mismatch with the current jump.");
       }
-
-      auto next_res = TRY(Compile(context, j.end, false));
-
-      uint64_t patch_size = 0;
-      auto cache_it = context.estimated_patch_sizes_.find(j);
-      if (cache_it != context.estimated_patch_sizes_.end()) {
-        patch_size = cache_it->second;
-      } else {
-        bool replace_url_template =
-            IsMixedMode() && (next_res.glyph_keyed_url_template !=
-                              current.glyph_keyed_url_template);
-
-        auto tentative_differ = TRY(GetTentativeDifferFor(
-            context, current.table_keyed_compat_id, replace_url_template));
-
-        FontData tentative_patch;
-        TRYV(tentative_differ->Diff(current.font_data, next_res.font_data,
-                                    &tentative_patch));
-        patch_size = tentative_patch.size();
-        context.estimated_patch_sizes_[j] = patch_size;
+      current_subset = j.end;
+      if (context.estimated_patch_sizes_.contains(j)) {
+        continue;
       }
 
-      total_estimated_size += patch_size;
+      // Matches the tables handled by the differ from GetDifferFor(), except
+      // the IFT tables which don't depend on the patch content.
+      flat_hash_set<hb_tag_t> excluded = {FontHelper::kIFT, FontHelper::kIFTX};
+      flat_hash_set<hb_tag_t> replaced;
+      if (IsMixedMode()) {
+        excluded.insert(
+            {FontHelper::kGlyf, FontHelper::kLoca, FontHelper::kCFF});
+        if (j.start.design_space != j.end.design_space) {
+          replaced = {FontHelper::kGvar, FontHelper::kCFF2};
+        } else {
+          excluded.insert({FontHelper::kGvar, FontHelper::kCFF2});
+        }
+      }
 
-      current = std::move(next_res);
-      current_subset = j.end;
+      context.estimated_patch_sizes_[j] =
+          context.edge_size_estimator_->Estimate(
+              sizes_of(j.start), sizes_of(j.end), excluded, replaced);
     }
+  }
+
+  std::vector<std::pair<size_t, uint64_t>> sizes;
+  sizes.reserve(edges.size());
 
+  size_t index = 0;
+  for (const auto& edge : edges) {
+    uint64_t total_estimated_size = 0;
+    for (const auto& j : edge.Jumps(base_subset, this->use_prefetch_lists_)) {
+      total_estimated_size += context.estimated_patch_sizes_.at(j);
+    }
     sizes.push_back(std::make_pair(index++, total_estimated_size));
   }
 
   return sizes;
 }
 
+void Compiler::LogEdgeSizeRankingError(ProcessingContext& context) const {
+  if (!VLOG_IS_ON(1)) {
+    return;
+  }
+
+  // Group the estimated and real sizes by the node whose patch map they order.
+  std::vector<uint8_t> url_template = UrlTemplate(0);
+  flat_hash_map<SubsetDefinition, std::vector<std::pair<uint64_t, uint64_t>>>
+      sizes_by_node;
+  {
+    absl::MutexLock lock(&context.manifest_mutex_);
+    for (const auto& [jump, estimated] : context.estimated_patch_sizes_) {
+      auto id = context.table_keyed_patch_id_map_.find(jump);
+      if (id == context.table_keyed_patch_id_map_.end()) {
+        continue;
+      }
+      auto url = URLTemplate::PatchToUrl(url_template, id->second);
+      if (!url.ok()) {
+        continue;
+      }
+      auto metadata = context.patch_metadata_.find(*url);
+      if (metadata == context.patch_metadata_.end()) {
+        continue;
+      }
+      sizes_by_node[jump.start].push_back(
+          std::make_pair(estimated, metadata->second.size));
+    }
+  }
+
+  double total_error = 0.0;
+  uint32_t nodes = 0;
+  for (const auto& [_, sizes] : sizes_by_node) {
+    if (sizes.size() < 2) {
+      continue;
+    }
+    total_error += EdgeSizeEstimator::RankingError(sizes);
+    nodes++;
+  }
+
+  if (nodes) {
+    VLOG(1) << "Edge size estimates misordered " << 100.0 * total_error / nodes
+            << "% of table keyed patch pairs (mean over " << nodes
+            << " nodes).";
+  }
+}
+
 Status Compiler::PopulateTableKeyedPatchMap(
     ProcessingContext& context, const SubsetDefinition& node_subset,
-    const FontData& base_font_data, const CompatId& table_keyed_compat_id,
-    const std::vector<uint8_t>& glyph_keyed_url_template,
-    const std::vector<Compiler::Edge>& edges, PatchEncoding encoding,
-    PatchMap& table_keyed_patch_map) const {
+    const FontData& base_font_data, const std::vector<Compiler::Edge>& edges,
+    PatchEncoding encoding, PatchMap& table_keyed_patch_map) const {
   // To create the table keyed patch mappings we use the activation condition
   // compiler. The outgoing edges for this node are converted into an activation
   // condition list and then compiled into mapping entries.
@@ -494,9 +753,8 @@ Status Compiler::PopulateTableKeyedPatchMap(
   // earlier in the patch map. To optimize client behaviour we want to ensure
   // that patch map entries are ordered from smallest to largest number of
   // loaded bytes. So ties will break towards the smaller patch set.
-  std::vector<std::pair<size_t, uint64_t>> edge_sizes = TRY(EstimateEdgeSizes(
-      context, node_subset, base_font_data, table_keyed_compat_id,
-      glyph_keyed_url_template, edges));
+  std::vector<std::pair<size_t, uint64_t>> edge_sizes =
+      TRY(EstimateEdgeSizes(context, node_subset, base_font_data, edges));
 
   std::stable_sort(
       edge_sizes.begin(), edge_sizes.end(),
@@ -541,16 +799,19 @@ StatusOr<Compiler::CompileResult> Compiler::Compile(
                                         glyph_keyed_compat_id));
 
   std::vector<Edge> edges = OutgoingEdges(node_subset, jump_ahead_);
+  if (context.thread_pool_.IsParallel()) {
+    TRYV(PrecutNodeSubsets(context, node_subset, edges));
+  }
 
   // The first subset forms the base file, the remaining subsets are made
   // reachable via patches.
-  auto full_face = context.fully_expanded_subset_.face();
-  auto node_data =
-      TRY(CutSubset(context, full_face.get(), node_subset, IsMixedMode()));
+  auto node_data = TRY(NodeSubset(context, node_subset));
 
   if (edges.empty() && !IsMixedMode()) {
     // This is a leaf node, a IFT table isn't needed.
+    Fingerprint font_fingerprint = RecordNode(context, node_subset, node_data);
     CompileResult result = {.font_data = std::move(node_data),
+                            .font_fingerprint = font_fingerprint,
                             .table_keyed_compat_id = {},
                             .glyph_keyed_compat_id = {},
                             .glyph_keyed_url_template = {}};
@@ -571,9 +832,8 @@ StatusOr<Compiler::CompileResult> Compiler::Compile(
   PatchMap& table_keyed_patch_map = table_keyed.GetPatchMap();
   PatchEncoding encoding =
       IsMixedMode() ? TABLE_KEYED_PARTIAL : TABLE_KEYED_FULL;
-  TRYV(PopulateTableKeyedPatchMap(
-      context, node_subset, node_data, table_keyed_compat_id,
-      glyph_keyed_url_template, edges, encoding, table_keyed_patch_map));
+  TRYV(PopulateTableKeyedPatchMap(context, node_subset, node_data, edges,
+                                  encoding, table_keyed_patch_map));
 
   auto face = node_data.face();
   std::optional<IFTTable*> ext =
@@ -588,7 +848,9 @@ StatusOr<Compiler::CompileResult> Compiler::Compile(
     node_data.shallow_copy(new_node_data);
   }
 
+  Fingerprint font_fingerprint = RecordNode(context, node_subset, node_data);
   CompileResult result = {.font_data = std::move(node_data),
+                          .font_fingerprint = font_fingerprint,
                           .table_keyed_compat_id = table_keyed_compat_id,
                           .glyph_keyed_compat_id = glyph_keyed_compat_id,
                           .glyph_keyed_url_template = glyph_keyed_url_template};
@@ -598,6 +860,7 @@ StatusOr<Compiler::CompileResult> Compiler::Compile(
     SubsetDefinition current_node_subset = node_subset;
     FontData current_node_data;
     current_node_data.shallow_copy(result.font_data);
+    Fingerprint current_node_fingerprint = result.font_fingerprint;
     CompatId current_table_keyed_compat_id = table_keyed_compat_id;
     std::vector<uint8_t> current_glyph_keyed_url_template =
         glyph_keyed_url_template;
@@ -611,9 +874,13 @@ StatusOr<Compiler::CompileResult> Compiler::Compile(
       }
 
       auto next = TRY(Compile(context, j.end, false));
+      // next holds its own reference to the font, so the built copy can be
+      // released now if this was the last jump to it.
+      ReleaseNodeReference(context, j.end);
       if (context.built_table_keyed_patches_.contains(id)) {
         current_node_subset = j.end;
         current_node_data = std::move(next.font_data);
+        current_node_fingerprint = next.font_fingerprint;
         current_table_keyed_compat_id = next.table_keyed_compat_id;
         current_glyph_keyed_url_template = next.glyph_keyed_url_template;
         continue;
@@ -623,18 +890,30 @@ StatusOr<Compiler::CompileResult> Compiler::Compile(
           IsMixedMode() &&
           (next.glyph_keyed_url_template != current_glyph_keyed_url_template);
 
-      FontData patch;
-      auto differ = TRY(GetDifferFor(context, current_table_keyed_compat_id,
-                                     replace_url_template));
-
-      TRYV((*differ).Diff(current_node_data, next.font_data, &patch));
-
-      std::string url =
-          TRY(URLTemplate::PatchToUrl(table_keyed_url_template, id));
-      context.patches_[url].shallow_copy(patch);
+      // The diff itself doesn't influence the rest of the graph traversal so
+      // defer it, pending patches are generated in parallel batches. Both
+      // fonts already exist so each batch is diffed and sent to the sink as
+      // soon as it's full. See GeneratePendingPatches().
+      PendingPatch pending{
+          .url = TRY(URLTemplate::PatchToUrl(table_keyed_url_template, id)),
+          .base_compat_id = current_table_keyed_compat_id,
+          .replace_url_template = replace_url_template,
+          .base_fingerprint = current_node_fingerprint,
+          .derived_fingerprint = next.font_fingerprint,
+      };
+      pending.base.shallow_copy(current_node_data);
+      pending.derived.shallow_copy(next.font_data);
+      context.pending_patches_.push_back(std::move(pending));
       context.built_table_keyed_patches_.insert(id);
+      context.max_pending_patches_ = std::max(
+          context.max_pending_patches_, context.pending_patches_.size());
+      if (context.pending_patches_.size() >=
+          context.thread_pool_.NumThreads()) {
+        TRYV(GeneratePendingPatches(context));
+      }
 
       current_node_data = std::move(next.font_data);
+      current_node_fingerprint = next.font_fingerprint;
       current_table_keyed_compat_id = next.table_keyed_compat_id;
       current_glyph_keyed_url_template = next.glyph_keyed_url_template;
       current_node_subset = j.end;
@@ -644,65 +923,255 @@ StatusOr<Compiler::CompileResult> Compiler::Compile(
   return std::move(result);
 }
 
-TableKeyedDiff* Compiler::GetTableKeyedDifferFor(ProcessingContext& context,
-                                                 CompatId compat_id,
-                                                 bool replace_url_template,
-                                                 bool exclude_ift) const {
+Status Compiler::PrecutNodeSubsets(ProcessingContext& context,
+                                   const SubsetDefinition& node_subset,
+                                   absl::Span<const Edge> edges) const {
+  // Only this node and the targets of its outgoing jumps are cut, so the
+  // precut subsets held at any time are bounded by the nodes on the current
+  // traversal path and their children rather than by the size of the graph.
+  std::vector<SubsetDefinition> to_cut;
+  flat_hash_set<SubsetDefinition> seen;
+  auto add = [&](const SubsetDefinition& subset) {
+    if (!context.built_subsets_.contains(subset) &&
+        !context.node_subsets_.contains(subset) && seen.insert(subset).second) {
+      to_cut.push_back(subset);
+    }
+  };
+
+  add(node_subset);
+  for (const auto& edge : edges) {
+    for (const auto& j : edge.Jumps(node_subset, use_prefetch_lists_)) {
+      add(j.end);
+    }
+  }
+
+  std::vector<FontData> subsets(to_cut.size());
+  TRYV(context.thread_pool_.ParallelFor(to_cut.size(), [&](size_t i) -> Status {
+    subsets[i] = TRY(CutNodeSubset(context, to_cut[i]));
+    return absl::OkStatus();
+  }));
+
+  for (size_t i = 0; i < to_cut.size(); i++) {
+    context.node_subsets_[std::move(to_cut[i])] = std::move(subsets[i]);
+  }
+  return absl::OkStatus();
+}
+
+void Compiler::CountNodeReferences(ProcessingContext& context) const {
+  // Follows the same edges that Compile() will. Only the nodes waiting to be
+  // expanded are held, not the fonts.
+  std::vector<SubsetDefinition> to_visit = {context.init_subset_};
+  while (!to_visit.empty()) {
+    SubsetDefinition node = std::move(to_visit.back());
+    to_visit.pop_back();
+    ForEachOutgoingEdge(node, jump_ahead_, [&](Edge edge) {
+      for (const auto& j : edge.Jumps(node, use_prefetch_lists_)) {
+        if (context.node_references_[j.end]++ == 0 &&
+            j.end != context.init_subset_) {
+          to_visit.push_back(j.end);
+        }
+      }
+    });
+  }
+}
+
+void Compiler::ReleaseNodeReference(ProcessingContext& context,
+                                    const SubsetDefinition& node_subset) const {
+  auto it = context.node_references_.find(node_subset);
+  if (it == context.node_references_.end() || --it->second > 0) {
+    return;
+  }
+  context.node_references_.erase(it);
+
+  auto built = context.built_subsets_.find(node_subset);
+  if (built != context.built_subsets_.end()) {
+    // Pending patches hold their own references to the font, so it's freed
+    // once they have been generated.
+    built->second.font_data = FontData();
+  }
+}
+
+Status Compiler::InstanceDesignSpaces(ProcessingContext& context) const {
+  // A node's design space is the union of the init design space with the
+  // design spaces of the segments added to reach it, so the reachable design
+  // spaces are closed under union with each segment's design space.
+  std::vector<design_space_t> design_spaces = {
+      context.init_subset_.design_space};
+  flat_hash_set<design_space_t> seen = {context.init_subset_.design_space};
+  for (const SubsetDefinition& segment : extension_subsets_) {
+    if (segment.design_space.empty()) {
+      continue;
+    }
+    SubsetDefinition expansion;
+    expansion.design_space = segment.design_space;
+    size_t count = design_spaces.size();
+    for (size_t i = 0; i < count; i++) {
+      SubsetDefinition node;
+      node.design_space = design_spaces[i];
+      node.Union(expansion);
+      if (seen.insert(node.design_space).second) {
+        design_spaces.push_back(std::move(node.design_space));
+      }
+    }
+  }
+
+  // Count how many times each instance will be used so it can be released
+  // after the last one: once for the glyph keyed patches (the empty design
+  // space uses the uninstanced font for those) and once per glyph keyed base
+  // table, see CutSubset().
+  auto full_face = context.fully_expanded_subset_.face();
+  auto tags = FontHelper::GetTags(full_face.get());
+  std::vector<design_space_t> used_design_spaces;
+  for (auto& design_space : design_spaces) {
+    SubsetDefinition node;
+    node.design_space = design_space;
+    uint32_t uses = 0;
+    if (!glyph_data_patches_.empty() && !design_space.empty()) {
+      uses++;
+    }
+    if (tags.contains(FontHelper::kGvar) &&
+        TRY(node.IsVariableFor(full_face.get()))) {
+      uses++;
+    }
+    if (tags.contains(FontHelper::kCFF2)) {
+      uses++;
+    }
+
+    context.subset_plan_cache_.SetInstanceUses(design_space, uses);
+    if (uses > 0) {
+      used_design_spaces.push_back(std::move(design_space));
+    }
+  }
+
+  return context.thread_pool_.ParallelFor(
+      used_design_spaces.size(), [&](size_t i) -> Status {
+        TRYV(DesignSpaceInstance(context, used_design_spaces[i]).status());
+        return absl::OkStatus();
+      });
+}
+
+StatusOr<FontData> Compiler::DesignSpaceInstance(
+    const ProcessingContext& context,
+    const design_space_t& design_space) const {
+  return context.subset_plan_cache_.Instance(
+      design_space, [&]() -> StatusOr<FontData> {
+        // Each call uses it's own face object so this is safe to run
+        // concurrently.
+        auto full_face = context.fully_expanded_subset_.face();
+        return Instance(context, full_face.get(), design_space);
+      });
+}
+
+StatusOr<FontData> Compiler::NodeSubset(
+    ProcessingContext& context, const SubsetDefinition& node_subset) const {
+  auto it = context.node_subsets_.find(node_subset);
+  if (it != context.node_subsets_.end()) {
+    // Each node is only compiled once, so the precut subset is no longer
+    // needed after this.
+    FontData result = std::move(it->second);
+    context.node_subsets_.erase(it);
+    return result;
+  }
+
+  return CutNodeSubset(context, node_subset);
+}
+
+StatusOr<FontData> Compiler::CutNodeSubset(
+    const ProcessingContext& context,
+    const SubsetDefinition& node_subset) const {
+  // Each call uses it's own face object so this is safe to run concurrently.
+  auto full_face = context.fully_expanded_subset_.face();
+  return CutSubset(context, full_face.get(), node_subset, IsMixedMode(),
+                   incremental_subsetting_);
+}
+
+Status Compiler::GeneratePendingPatches(ProcessingContext& context) const {
+  std::vector<PendingPatch>& pending = context.pending_patches_;
+  TRYV(context.thread_pool_.ParallelFor(
+      pending.size(), [&](size_t i) -> Status {
+        PendingPatch& p = pending[i];
+
+        // Everything the differ output depends on.
+        std::string inputs;
+        WriteFingerprint(p.base_fingerprint, inputs);
+        WriteFingerprint(p.derived_fingerprint, inputs);
+        p.base_compat_id.WriteTo(inputs);
+        FontHelper::WriteUInt8(p.replace_url_template, inputs);
+        FontHelper::WriteUInt8(IsMixedMode(), inputs);
+        FontHelper::WriteUInt8(use_glyph_table_diff_, inputs);
+
+        TRYV(EmitPatch(
+            context, p.url, Fingerprint::Of(inputs),
+            [&]() -> StatusOr<FontData> {
+              auto differ = TRY(GetDifferFor(context, p.base_compat_id,
+                                             p.replace_url_template));
+              FontData patch;
+              TRYV(differ->Diff(p.base, p.derived, &patch));
+              return patch;
+            }));
+
+        if (record_patch_maps_) {
+          // Keep the patch maps the client will see after applying this patch,
+          // see Encoding::patch_metadata.
+          auto face = p.derived.face();
+          std::string ift_table(
+              FontHelper::TableData(face.get(), FontHelper::kIFT).str());
+          std::string iftx_table(
+              FontHelper::TableData(face.get(), FontHelper::kIFTX).str());
+          absl::MutexLock lock(&context.manifest_mutex_);
+          auto& metadata = context.patch_metadata_[p.url];
+          metadata.ift_table = std::move(ift_table);
+          metadata.iftx_table = std::move(iftx_table);
+        }
+
+        // Release our references to the base and derived fonts so they can be
+        // freed once no other pending patch needs them.
+        p.base = FontData();
+        p.derived = FontData();
+        return absl::OkStatus();
+      }));
+
+  context.pending_patches_.clear();
+  return absl::OkStatus();
+}
+
+TableKeyedDiff* Compiler::GetTableKeyedDifferFor(
+    ProcessingContext& context, CompatId compat_id,
+    bool replace_url_template) const {
   if (!IsMixedMode()) {
     // If only table keyed patches are used we can diff the whole font.
-    if (exclude_ift) {
-      return new TableKeyedDiff(compat_id, {"IFT ", "IFTX"},
-                                &context.table_diff_cache_);
-    } else {
-      return new TableKeyedDiff(compat_id, &context.table_diff_cache_);
-    }
+    return new TableKeyedDiff(compat_id, &context.table_diff_cache_);
   }
 
   if (replace_url_template) {
     // Glyph keyed patches are in use, but we are changing design space. So
     // tables with variations will need to be replaced (gvar/CFF2), all other
     // glyph data tables are excluded.
-    if (exclude_ift) {
-      return new TableKeyedDiff(compat_id,
-                                {"IFT ", "IFTX", "glyf", "loca", "CFF "},
-                                {"gvar", "CFF2"}, &context.table_diff_cache_);
-    } else {
-      return new TableKeyedDiff(compat_id, {"glyf", "loca", "CFF "},
-                                {"IFTX", "gvar", "CFF2"},
-                                &context.table_diff_cache_);
-    }
+    return new TableKeyedDiff(compat_id, {"glyf", "loca", "CFF "},
+                              {"IFTX", "gvar", "CFF2"},
+                              &context.table_diff_cache_);
   }
 
   // Glyph keyed patches are in use, all glyph data tables are excluded as these
   // are handled by glyph keyed patches
-  if (exclude_ift) {
-    return new TableKeyedDiff(
-        compat_id, {"IFT ", "IFTX", "glyf", "loca", "gvar", "CFF ", "CFF2"}, {},
-        &context.table_diff_cache_);
-  } else {
-    return new TableKeyedDiff(compat_id,
-                              {"IFTX", "glyf", "loca", "gvar", "CFF ", "CFF2"},
-                              {}, &context.table_diff_cache_);
-  }
-}
-
-StatusOr<std::unique_ptr<const BinaryDiff>> Compiler::GetTentativeDifferFor(
-    ProcessingContext& context, CompatId compat_id,
-    bool replace_url_template) const {
-  return std::unique_ptr<const BinaryDiff>(GetTableKeyedDifferFor(
-      context, compat_id, replace_url_template, /*exclude_ift=*/true));
+  return new TableKeyedDiff(compat_id,
+                            {"IFTX", "glyf", "loca", "gvar", "CFF ", "CFF2"},
+                            {}, &context.table_diff_cache_);
 }
 
 StatusOr<std::unique_ptr<const BinaryDiff>> Compiler::GetDifferFor(
     ProcessingContext& context, CompatId compat_id,
     bool replace_url_template) const {
-  return std::unique_ptr<const BinaryDiff>(GetTableKeyedDifferFor(
-      context, compat_id, replace_url_template, /*exclude_ift=*/false));
+  TableKeyedDiff* differ =
+      GetTableKeyedDifferFor(context, compat_id, replace_url_template);
+  differ->SetUseGlyphTableDiff(use_glyph_table_diff_);
+  return std::unique_ptr<const BinaryDiff>(differ);
 }
 
 StatusOr<hb_subset_plan_t*> Compiler::CreateSubsetPlan(
     const ProcessingContext& context, hb_face_t* font,
-    const SubsetDefinition& def) const {
+    const SubsetDefinition& def,
+    const flat_hash_set<hb_tag_t>& drop_tables) const {
   hb_subset_input_t* input = hb_subset_input_create_or_fail();
   if (!input) {
     return absl::InternalError("Failed to create subset input.");
@@ -711,6 +1180,11 @@ StatusOr<hb_subset_plan_t*> Compiler::CreateSubsetPlan(
   def.ConfigureInput(input, font);
   SetMixedModeSubsettingFlagsIfNeeded(context, input);
 
+  hb_set_t* drop = hb_subset_input_set(input, HB_SUBSET_SETS_DROP_TABLE_TAG);
+  for (hb_tag_t tag : drop_tables) {
+    hb_set_add(drop, tag);
+  }
+
   hb_subset_plan_t* plan = hb_subset_plan_create_or_fail(font, input);
   hb_subset_input_destroy(input);
   if (!plan) {
@@ -720,10 +1194,68 @@ StatusOr<hb_subset_plan_t*> Compiler::CreateSubsetPlan(
   return plan;
 }
 
+// Returns the (original) glyph ids retained by plan.
+static GlyphSet RetainedGlyphsOf(hb_subset_plan_t* plan) {
+  hb_map_t* old_to_new = hb_subset_plan_old_to_new_glyph_mapping(plan);
+
+  int index = -1;
+  uint32_t old_gid = HB_MAP_VALUE_INVALID;
+  uint32_t new_gid = HB_MAP_VALUE_INVALID;
+  GlyphSet gids;
+  while (hb_map_next(old_to_new, &index, &old_gid, &new_gid)) {
+    gids.insert(old_gid);
+  }
+  return gids;
+}
+
+// If 'reuse_tables' is true then tables which only depend on the design space
+// (see SubsetPlanCache::DesignSpaceOnly()) are taken from the subset plan
+// cache when a previous subset with the same design space has serialized them.
+// Those tables are dropped from the subset plan so harfbuzz doesn't redo the
+// work, and are then added back to the result. Any which are not yet cached
+// are saved from the result for use by later subsets.
+//
+// Dropping these tables doesn't alter the glyph closure or the subsetting of
+// any other table, so the result is identical either way. The glyphs retained
+// by the plan are also recorded in the subset plan cache so that later lookups
+// of def (such as the init subset closure in GenerateBaseCff2()) don't need to
+// plan it again. Only use this when 'font' is the fully expanded subset since
+// the cache isn't keyed by font.
 StatusOr<hb_face_unique_ptr> Compiler::CutSubsetFaceBuilder(
     const ProcessingContext& context, hb_face_t* font,
-    const SubsetDefinition& def) const {
-  hb_subset_plan_t* plan = TRY(CreateSubsetPlan(context, font, def));
+    const SubsetDefinition& def, bool reuse_tables) const {
+  flat_hash_map<hb_tag_t, FontData> reused_tables;
+  flat_hash_set<hb_tag_t> drop_tables;
+  std::vector<hb_tag_t> tables_to_save;
+  if (reuse_tables) {
+    for (hb_tag_t tag : FontHelper::GetTags(font)) {
+      if (!SubsetPlanCache::DesignSpaceOnly(tag)) {
+        continue;
+      }
+      FontData table;
+      if (context.subset_plan_cache_.GetDesignSpaceTable(
+              tag, def.design_space, table)) {
+        reused_tables[tag] = std::move(table);
+        drop_tables.insert(tag);
+      } else {
+        tables_to_save.push_back(tag);
+      }
+    }
+  }
+
+  hb_subset_plan_t* plan =
+      TRY(CreateSubsetPlan(context, font, def, drop_tables));
+  if (reuse_tables) {
+    auto sc = context.subset_plan_cache_
+                  .RetainedGlyphs(def, [&]() -> StatusOr<GlyphSet> {
+                    return RetainedGlyphsOf(plan);
+                  })
+                  .status();
+    if (!sc.ok()) {
+      hb_subset_plan_destroy(plan);
+      return sc;
+    }
+  }
 
   hb_face_unique_ptr result =
       make_hb_face(hb_subset_plan_execute_or_fail(plan));
@@ -732,11 +1264,27 @@ StatusOr<hb_face_unique_ptr> Compiler::CutSubsetFaceBuilder(
     return absl::InternalError("Harfbuzz subsetting operation failed.");
   }
 
+  for (const auto& [tag, table] : reused_tables) {
+    hb_blob_unique_ptr blob = table.blob();
+    hb_face_builder_add_table(result.get(), tag, blob.get());
+  }
+
+  for (hb_tag_t tag : tables_to_save) {
+    hb_blob_unique_ptr blob =
+        make_hb_blob(hb_face_reference_table(result.get(), tag));
+    if (hb_blob_get_length(blob.get()) == 0) {
+      // Not retained by the subsetter, so there's nothing to reuse.
+      continue;
+    }
+    context.subset_plan_cache_.InsertDesignSpaceTable(tag, def.design_space,
+                                                      FontData(blob.get()));
+  }
+
   return result;
 }
 
 StatusOr<FontData> Compiler::GenerateBaseGvar(
-    const ProcessingContext& context, hb_face_t* font,
+    const ProcessingContext& context,
     const design_space_t& design_space) const {
   // When generating a gvar table for use with glyph keyed patches care
   // must be taken to ensure that the shared tuples in the gvar
@@ -756,7 +1304,7 @@ StatusOr<FontData> Compiler::GenerateBaseGvar(
   //    not modify shared tuples.
 
   // Step 1: Instancing
-  auto instance = TRY(Instance(context, font, design_space));
+  auto instance = TRY(DesignSpaceInstance(context, design_space));
 
   // Step 2: glyph subsetting
   SubsetDefinition subset = context.init_subset_;
@@ -765,8 +1313,8 @@ StatusOr<FontData> Compiler::GenerateBaseGvar(
   subset.design_space = {};
 
   hb_face_unique_ptr instanced_face = instance.face();
-  auto face_builder =
-      TRY(CutSubsetFaceBuilder(context, instanced_face.get(), subset));
+  auto face_builder = TRY(CutSubsetFaceBuilder(context, instanced_face.get(),
+                                               subset, false));
 
   // Step 3: extract gvar table.
   hb_blob_unique_ptr gvar_blob = make_hb_blob(
@@ -856,22 +1404,20 @@ StatusOr<FontData> Compiler::GenerateBaseCff2(
   // our own.
 
   // Step 1: Instancing
-  auto instance = TRY(Instance(context, font, design_space));
+  auto instance = TRY(DesignSpaceInstance(context, design_space));
   auto instance_face = instance.face();
 
-  // Step 2: find the glyph closure for the base subset.
-  SubsetDefinition subset = context.init_subset_;
-  hb_subset_plan_t* plan = TRY(CreateSubsetPlan(context, font, subset));
-  hb_map_t* old_to_new = hb_subset_plan_old_to_new_glyph_mapping(plan);
-
-  int index = -1;
-  uint32_t old_gid = HB_MAP_VALUE_INVALID;
-  uint32_t new_gid = HB_MAP_VALUE_INVALID;
-  IntSet gids;
-  while (hb_map_next(old_to_new, &index, &old_gid, &new_gid)) {
-    gids.insert(old_gid);
-  }
-  hb_subset_plan_destroy(plan);
+  // Step 2: find the glyph closure for the base subset, this is the same for
+  // every design space so is only computed once.
+  const SubsetDefinition& subset = context.init_subset_;
+  GlyphSet gids = TRY(context.subset_plan_cache_.RetainedGlyphs(
+      subset, [&]() -> StatusOr<GlyphSet> {
+        hb_subset_plan_t* plan =
+            TRY(CreateSubsetPlan(context, font, subset, {}));
+        GlyphSet gids = RetainedGlyphsOf(plan);
+        hb_subset_plan_destroy(plan);
+        return gids;
+      }));
 
   // Step 3: locate charstrings data
   FontData instance_non_charstrings;
@@ -937,8 +1483,9 @@ void Compiler::SetMixedModeSubsettingFlagsIfNeeded(
 StatusOr<FontData> Compiler::CutSubset(const ProcessingContext& context,
                                        hb_face_t* font,
                                        const SubsetDefinition& def,
-                                       bool generate_glyph_keyed_bases) const {
-  auto result = TRY(CutSubsetFaceBuilder(context, font, def));
+                                       bool generate_glyph_keyed_bases,
+                                       bool reuse_tables) const {
+  auto result = TRY(CutSubsetFaceBuilder(context, font, def, reuse_tables));
 
   auto tags = FontHelper::GetTags(font);
   if (generate_glyph_keyed_bases && TRY(def.IsVariableFor(font)) &&
@@ -951,7 +1498,13 @@ StatusOr<FontData> Compiler::CutSubset(const ProcessingContext& context,
     // Create such a gvar table here and overwrite the one that was otherwise
     // generated by the normal subsetting operation. The patch generation will
     // handle including a replacement gvar patch when needed.
-    auto base_gvar = TRY(GenerateBaseGvar(context, font, def.design_space));
+    //
+    // The base gvar only depends on the design space so it's shared by all
+    // nodes with the same design space.
+    auto base_gvar = TRY(context.subset_plan_cache_.GlyphKeyedBaseTable(
+        FontHelper::kGvar, def.design_space, [&]() {
+          return GenerateBaseGvar(context, def.design_space);
+        }));
     hb_blob_unique_ptr gvar_blob = base_gvar.blob();
     hb_face_builder_add_table(result.get(), FontHelper::kGvar, gvar_blob.get());
   }
@@ -961,7 +1514,10 @@ StatusOr<FontData> Compiler::CutSubset(const ProcessingContext& context,
     // the CFF2 table may contain shared variation data outside of the glyphs.
     // So when creating a subsetted CFF2 table here we need to ensure the shared
     // variation data will match whatever the glyph keyed patches were cut from.
-    auto base_cff2 = TRY(GenerateBaseCff2(context, font, def.design_space));
+    auto base_cff2 = TRY(context.subset_plan_cache_.GlyphKeyedBaseTable(
+        FontHelper::kCFF2, def.design_space, [&]() {
+          return GenerateBaseCff2(context, font, def.design_space);
+        }));
     hb_blob_unique_ptr cff2_blob = base_cff2.blob();
     hb_face_builder_add_table(result.get(), FontHelper::kCFF2, cff2_blob.get());
   }
@@ -2,20 +2,33 @@
 #define IFT_ENCODER_COMPILER_H_
 
 #include <cstdint>
+#include <memory>
+#include <optional>
 #include <random>
 #include <string>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/container/btree_set.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/container/node_hash_map.h"
+#include "absl/functional/function_ref.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "hb-subset.h"
 #include "ift/common/compat_id.h"
+#include "ift/common/fingerprint.h"
 #include "ift/common/font_data.h"
 #include "ift/common/int_set.h"
+#include "ift/common/thread_pool.h"
 #include "ift/encoder/activation_condition.h"
+#include "ift/encoder/compilation_manifest.h"
+#include "ift/encoder/edge_size_estimator.h"
+#include "ift/encoder/patch_sink.h"
 #include "ift/encoder/subset_definition.h"
+#include "ift/encoder/subset_plan_cache.h"
 #include "ift/encoder/types.h"
 #include "ift/table_keyed_diff.h"
 
@@ -56,8 +69,99 @@ class Compiler {
    */
   void SetUsePrefetchLists(bool value) { this->use_prefetch_lists_ = value; }
 
+  /*
+   * Limits which multi segment edges are generated when jump ahead is greater
+   * than 1. Without pruning every combination of up to jump ahead outstanding
+   * segments gets an edge (and a patch), which grows combinatorially with the
+   * number of segments. Single segment edges are never pruned.
+   */
+  struct JumpAheadPruning {
+    // Probability of each extension segment being needed, in the order the
+    // segments were added. Segments without a probability are treated as
+    // always needed.
+    std::vector<double> segment_probabilities;
+
+    // Multi segment edges whose probability (the product of their segments'
+    // probabilities) is below this are not generated.
+    double min_probability = 0.0;
+
+    // If non-zero, at most this many multi segment edges are generated from
+    // each node. Smaller jumps and segments added earlier are preferred.
+    uint32_t max_multi_segment_edges = 0;
+  };
+
+  void SetJumpAheadPruning(JumpAheadPruning pruning) {
+    this->jump_ahead_pruning_ = std::move(pruning);
+  }
+
   void SetWoff2Encode(bool value) { this->woff2_encode_ = value; }
 
+  /*
+   * Configures the number of threads used to generate subsets and patches
+   * during compilation. Defaults to 1 (all work is done on the calling
+   * thread). The compiled output is the same regardless of thread count.
+   */
+  void SetNumThreads(uint32_t count) { this->num_threads_ = count; }
+
+  /*
+   * If enabled table keyed patches diff glyf, loca, hmtx, and vmtx by matching
+   * up per glyph records with the base table instead of running a full brotli
+   * diff over them. Unchanged glyph data is copied from the base, only new
+   * bytes are compressed. Substantially reduces compile time for large fonts
+   * at the cost of slightly larger patches.
+   */
+  void SetUseGlyphTableDiff(bool value) { this->use_glyph_table_diff_ = value; }
+
+  /*
+   * If enabled tables which depend only on the design space (see
+   * SubsetPlanCache::DesignSpaceOnly()) are serialized once per design space
+   * and then reused by every other node subset with that design space, instead
+   * of being re-serialized by each subsetting operation. The glyphs retained
+   * by each node subset are also recorded in the subset plan cache. The
+   * compiled output is the same either way.
+   */
+  void SetIncrementalSubsetting(bool value) {
+    this->incremental_subsetting_ = value;
+  }
+
+  /*
+   * If enabled the patch maps produced by each table keyed patch are kept in
+   * Encoding::patch_metadata, as needed by ift::client::ClientSimulator (see
+   * ClientSimulator::ConfigureCompiler()). Off by default since it holds a copy
+   * of every patch map until the compile finishes.
+   */
+  void SetRecordPatchMaps(bool value) { this->record_patch_maps_ = value; }
+
+  /*
+   * Sets the memory budget (in bytes) for the cache of per table diffs reused
+   * across table keyed patches. Least recently used diffs are evicted once the
+   * budget is exceeded. Defaults to TableDiffCache::kDefaultMaxBytes.
+   */
+  void SetTableDiffCacheMaxBytes(size_t max_bytes) {
+    this->table_diff_cache_max_bytes_ = max_bytes;
+  }
+
+  /*
+   * Enables incremental compilation against a previous encoding. manifest is
+   * the previous encoding's manifest (see Encoding::manifest) and patches
+   * provides its patches.
+   *
+   * Every patch is still identified as usual, but any patch whose inputs (the
+   * fonts and compat id for table keyed patches, or the glyph data and compat
+   * id for glyph keyed patches) match the previous encoding is copied from
+   * patches instead of being regenerated. The compiled output is the same
+   * either way.
+   *
+   * Only patch generation (diffing and compression) is skipped, every graph
+   * node is still subset since patch inputs are fingerprinted from the node
+   * fonts.
+   */
+  void SetPreviousEncoding(CompilationManifest manifest,
+                           std::shared_ptr<const PatchSource> patches) {
+    previous_manifest_ = std::move(manifest);
+    previous_patches_ = std::move(patches);
+  }
+
   void SetOverrideUrlTemplatePrefix(const std::vector<uint8_t>& prefix) {
     override_url_template_prefix_ = prefix;
   }
@@ -130,6 +234,44 @@ class Compiler {
   struct Encoding {
     ift::common::FontData init_font;
     absl::flat_hash_map<std::string, ift::common::FontData> patches;
+
+    // Usage of the table diff cache during compilation, useful for sizing it.
+    ift::TableDiffCache::Stats table_diff_cache_stats;
+
+    // Usage of the cache of work shared between node subsets.
+    SubsetPlanCache::Stats subset_plan_cache_stats;
+
+    // Describes this encoding, can be given to SetPreviousEncoding() to
+    // incrementally compile a later version of the font.
+    CompilationManifest manifest;
+
+    struct IncrementalStats {
+      // Patches copied from the previous encoding.
+      uint64_t reused_patches = 0;
+      // Patches which were generated.
+      uint64_t generated_patches = 0;
+      // Graph nodes present in the previous encoding whose font changed.
+      uint64_t changed_nodes = 0;
+    };
+    IncrementalStats incremental_stats;
+
+    // What a client needs to know about each patch to decide which to fetch,
+    // allowing client behaviour to be simulated without applying any patches
+    // (see ift::client::ClientSimulator).
+    struct PatchMetadata {
+      uint32_t size = 0;
+      // For table keyed patches, the 'IFT ' and 'IFTX' tables of the font
+      // produced by applying the patch (empty if that font has none). Only
+      // set if SetRecordPatchMaps() is enabled.
+      std::string ift_table;
+      std::string iftx_table;
+    };
+    absl::flat_hash_map<std::string, PatchMetadata> patch_metadata;
+
+    // The most table keyed patches that were queued waiting to be diffed at
+    // any one time. Patches are diffed and passed to the sink in batches
+    // during the graph traversal, so this is bounded by the thread count.
+    uint64_t max_pending_patches = 0;
   };
 
   /*
@@ -142,6 +284,14 @@ class Compiler {
    */
   absl::StatusOr<Encoding> Compile() const;
 
+  /*
+   * Same as Compile() except that each patch is passed to sink as soon as it
+   * is final instead of being collected into the returned encoding (the
+   * returned patches map is left empty). This avoids holding all patches in
+   * memory at once.
+   */
+  absl::StatusOr<Encoding> Compile(PatchSink& sink) const;
+
   static absl::StatusOr<ift::common::FontData> RoundTripWoff2(
       absl::string_view font, bool glyf_transform = true);
 
@@ -236,16 +386,26 @@ class Compiler {
   std::vector<Edge> OutgoingEdges(const SubsetDefinition& base,
                                   uint32_t choose) const;
 
+  /*
+   * Streams the same edges as OutgoingEdges() to callback, in the same order,
+   * without materializing them all at once. Combinations that are excluded by
+   * the jump ahead pruning are skipped without being enumerated.
+   */
+  void ForEachOutgoingEdge(const SubsetDefinition& base, uint32_t choose,
+                           absl::FunctionRef<void(Edge)> callback) const;
+
  private:
   struct ProcessingContext;
   struct CompileResult {
     ift::common::FontData font_data;
+    ift::common::Fingerprint font_fingerprint;
     ift::common::CompatId table_keyed_compat_id;
     ift::common::CompatId glyph_keyed_compat_id;
     std::vector<uint8_t> glyph_keyed_url_template;
 
     void shallow_copy(const CompileResult& other) {
       font_data.shallow_copy(other.font_data);
+      font_fingerprint = other.font_fingerprint;
       table_keyed_compat_id = other.table_keyed_compat_id;
       glyph_keyed_compat_id = other.glyph_keyed_compat_id;
       glyph_keyed_url_template = other.glyph_keyed_url_template;
@@ -310,36 +470,107 @@ class Compiler {
   absl::Status PopulateGlyphKeyedPatchMap(
       ift::proto::PatchMap& patch_map) const;
 
+  /*
+   * Cuts the subsets for node_subset and the targets of each of its outgoing
+   * edges in parallel, skipping any that are already built or cut. Compile()
+   * calls this for each node as it walks the graph and then uses the precut
+   * subsets instead of cutting them one at a time. Each precut subset is
+   * released once its node is compiled.
+   */
+  absl::Status PrecutNodeSubsets(ProcessingContext& context,
+                                 const SubsetDefinition& node_subset,
+                                 absl::Span<const Edge> edges) const;
+
+  /*
+   * In mixed mode, finds every design space reachable in the table keyed patch
+   * graph and instances the fully expanded subset to each of them in parallel.
+   * The instances are held in the subset plan cache for use by
+   * DesignSpaceInstance(), each is dropped once the glyph keyed patches and
+   * glyph keyed base tables cut from it have been generated.
+   */
+  absl::Status InstanceDesignSpaces(ProcessingContext& context) const;
+
+  // Returns the fully expanded subset instanced to design_space, either from
+  // those made by InstanceDesignSpaces() or by instancing it now.
+  absl::StatusOr<ift::common::FontData> DesignSpaceInstance(
+      const ProcessingContext& context,
+      const design_space_t& design_space) const;
+
+  // Returns the subset for a table keyed graph node, either from those cut by
+  // PrecutNodeSubsets() or by cutting it now.
+  absl::StatusOr<ift::common::FontData> NodeSubset(
+      ProcessingContext& context, const SubsetDefinition& node_subset) const;
+
+  // Computes the diffs for all table keyed patches that are queued and passes
+  // them to the sink. Compile() calls this whenever enough patches are queued
+  // to occupy the thread pool, and once more after the traversal.
+  absl::Status GeneratePendingPatches(ProcessingContext& context) const;
+
+  // Counts the number of jumps in the table keyed patch graph that end at each
+  // node, see ProcessingContext::node_references_.
+  void CountNodeReferences(ProcessingContext& context) const;
+
+  // Marks one jump to node_subset as traversed. After the last one the node's
+  // font is no longer needed by the traversal, so it's dropped from the built
+  // subsets.
+  void ReleaseNodeReference(ProcessingContext& context,
+                            const SubsetDefinition& node_subset) const;
+
+  // Passes the patch at url to the sink and records it in the manifest. If the
+  // previous encoding has a patch at url with the same inputs that is used,
+  // otherwise the patch is produced by generate. Thread safe.
+  absl::Status EmitPatch(
+      ProcessingContext& context, const std::string& url,
+      ift::common::Fingerprint inputs,
+      absl::FunctionRef<absl::StatusOr<ift::common::FontData>()> generate)
+      const;
+
+  // Returns the previous encoding's patch at url if its inputs match, or
+  // std::nullopt if it needs to be regenerated.
+  std::optional<ift::common::FontData> ReusablePatch(
+      const std::string& url, ift::common::Fingerprint inputs) const;
+
+  // Records a compiled graph node in the manifest and returns the fingerprint
+  // of node_data. Also counts the node as changed if it differs from the
+  // previous encoding.
+  ift::common::Fingerprint RecordNode(
+      ProcessingContext& context, const SubsetDefinition& node_subset,
+      const ift::common::FontData& node_data) const;
+
   std::vector<ActivationCondition> EdgesToActivationConditions(
       ProcessingContext& context, const SubsetDefinition& node_subset,
       absl::Span<const Compiler::Edge> edges, proto::PatchEncoding encoding,
       absl::flat_hash_map<segment_index_t, SubsetDefinition>& segments) const;
 
+  // Estimates the size of the patches needed to traverse each edge, for
+  // ordering patch map entries. Returns pairs of edge index and size.
   absl::StatusOr<std::vector<std::pair<size_t, uint64_t>>> EstimateEdgeSizes(
       ProcessingContext& context, const SubsetDefinition& base_subset,
       const ift::common::FontData& base_font_data,
-      const ift::common::CompatId& table_keyed_compat_id,
-      const std::vector<uint8_t>& glyph_keyed_url_template,
       absl::Span<const Compiler::Edge> edges) const;
 
+  // Logs how well the estimates from EstimateEdgeSizes() ordered the real
+  // patch sizes, no-op unless VLOG(1) is enabled. Must be called after all
+  // patches have been generated.
+  void LogEdgeSizeRankingError(ProcessingContext& context) const;
+
   absl::Status PopulateTableKeyedPatchMap(
       ProcessingContext& context, const SubsetDefinition& base_subset,
       const ift::common::FontData& base_font_data,
-      const ift::common::CompatId& table_keyed_compat_id,
-      const std::vector<uint8_t>& glyph_keyed_url_template,
       const std::vector<Compiler::Edge>& edges, proto::PatchEncoding encoding,
       proto::PatchMap& table_keyed_patch_map) const;
 
   absl::StatusOr<hb_subset_plan_t*> CreateSubsetPlan(
       const ProcessingContext& context, hb_face_t* font,
-      const SubsetDefinition& def) const;
+      const SubsetDefinition& def,
+      const absl::flat_hash_set<hb_tag_t>& drop_tables) const;
 
   absl::StatusOr<ift::common::hb_face_unique_ptr> CutSubsetFaceBuilder(
       const ProcessingContext& context, hb_face_t* font,
-      const SubsetDefinition& def) const;
+      const SubsetDefinition& def, bool reuse_tables) const;
 
   absl::StatusOr<ift::common::FontData> GenerateBaseGvar(
-      const ProcessingContext& context, hb_face_t* font,
+      const ProcessingContext& context,
       const design_space_t& design_space) const;
 
   absl::StatusOr<ift::common::FontData> GenerateBaseCff2(
@@ -351,25 +582,26 @@ class Compiler {
 
   absl::StatusOr<ift::common::FontData> CutSubset(
       const ProcessingContext& context, hb_face_t* font,
-      const SubsetDefinition& def, bool generate_glyph_keyed_bases) const;
+      const SubsetDefinition& def, bool generate_glyph_keyed_bases,
+      bool reuse_tables) const;
+
+  // Cuts the subset for a node of the patch graph from the fully expanded
+  // subset.
+  absl::StatusOr<ift::common::FontData> CutNodeSubset(
+      const ProcessingContext& context,
+      const SubsetDefinition& node_subset) const;
 
   absl::StatusOr<ift::common::FontData> Instance(
       const ProcessingContext& context, hb_face_t* font,
       const design_space_t& design_space) const;
 
-  absl::StatusOr<std::unique_ptr<const ift::common::BinaryDiff>>
-  GetTentativeDifferFor(ProcessingContext& context,
-                        ift::common::CompatId compat_id,
-                        bool replace_url_template) const;
-
   absl::StatusOr<std::unique_ptr<const ift::common::BinaryDiff>> GetDifferFor(
       ProcessingContext& context, ift::common::CompatId compat_id,
       bool replace_url_template) const;
 
   ift::TableKeyedDiff* GetTableKeyedDifferFor(ProcessingContext& context,
                                               ift::common::CompatId compat_id,
-                                              bool replace_url_template,
-                                              bool exclude_ift) const;
+                                              bool replace_url_template) const;
 
   bool AllocatePatchSet(ProcessingContext& context,
                         const design_space_t& design_space,
@@ -383,16 +615,40 @@ class Compiler {
   SubsetDefinition init_subset_;
   std::vector<SubsetDefinition> extension_subsets_;
   uint32_t jump_ahead_ = 1;
+  JumpAheadPruning jump_ahead_pruning_;
   uint32_t next_id_ = 0;
   bool use_prefetch_lists_ = false;
   bool woff2_encode_ = false;
+  uint32_t num_threads_ = 1;
+  bool use_glyph_table_diff_ = false;
+  bool incremental_subsetting_ = false;
+  bool record_patch_maps_ = false;
+  size_t table_diff_cache_max_bytes_ = ift::TableDiffCache::kDefaultMaxBytes;
   std::vector<uint8_t> override_url_template_prefix_;
+  CompilationManifest previous_manifest_;
+  std::shared_ptr<const PatchSource> previous_patches_;
+
+  // A table keyed patch whose diff has been deferred so that it can be
+  // computed in parallel with the other patches.
+  struct PendingPatch {
+    std::string url;
+    ift::common::CompatId base_compat_id;
+    bool replace_url_template = false;
+    ift::common::FontData base;
+    ift::common::FontData derived;
+    ift::common::Fingerprint base_fingerprint;
+    ift::common::Fingerprint derived_fingerprint;
+  };
 
   struct ProcessingContext {
-    ProcessingContext(uint32_t next_id)
+    ProcessingContext(uint32_t next_id, uint32_t num_threads,
+                      size_t table_diff_cache_max_bytes, PatchSink& sink)
         : gen_(),
           random_values_(0, std::numeric_limits<uint32_t>::max()),
-          next_id_(next_id) {}
+          next_id_(next_id),
+          sink_(&sink),
+          table_diff_cache_(table_diff_cache_max_bytes),
+          thread_pool_(num_threads) {}
 
     std::mt19937 gen_;
     std::uniform_int_distribution<uint32_t> random_values_;
@@ -409,11 +665,38 @@ class Compiler {
         glyph_keyed_compat_ids_;
 
     absl::flat_hash_map<SubsetDefinition, CompileResult> built_subsets_;
-    absl::flat_hash_map<std::string, ift::common::FontData> patches_;
+    // Receives each patch once it's complete.
+    PatchSink* sink_;
     absl::flat_hash_map<Jump, uint32_t> table_keyed_patch_id_map_;
     absl::flat_hash_map<Jump, uint64_t> estimated_patch_sizes_;
+    std::optional<EdgeSizeEstimator> edge_size_estimator_;
+    // Table sizes of graph nodes, for EstimateEdgeSizes().
+    absl::node_hash_map<SubsetDefinition, EdgeSizeEstimator::TableSizes>
+        node_table_sizes_;
     ift::common::IntSet built_table_keyed_patches_;
+    // Number of jumps not yet traversed which end at each node.
+    absl::flat_hash_map<SubsetDefinition, uint32_t> node_references_;
+    std::vector<PendingPatch> pending_patches_;
+    size_t max_pending_patches_ = 0;
+    absl::flat_hash_map<SubsetDefinition, ift::common::FontData> node_subsets_;
     ift::TableDiffCache table_diff_cache_;
+    // Thread safe, and only ever added to, so is usable from the const
+    // context passed to the subsetting methods.
+    mutable SubsetPlanCache subset_plan_cache_;
+
+    // Describes the encoding as it's produced, and how much of the previous
+    // encoding (if any) was reused. Patches are emitted from worker threads.
+    absl::Mutex manifest_mutex_;
+    CompilationManifest manifest_ ABSL_GUARDED_BY(manifest_mutex_);
+    Encoding::IncrementalStats incremental_stats_
+        ABSL_GUARDED_BY(manifest_mutex_);
+    absl::flat_hash_map<std::string, Encoding::PatchMetadata> patch_metadata_
+        ABSL_GUARDED_BY(manifest_mutex_);
+
+    // Only the expensive and order independent work (subsetting and diffing)
+    // is dispatched to this pool. Graph traversal, and hence assignment of
+    // compat ids and patch ids, always happens serially on the calling thread.
+    ift::common::ThreadPool thread_pool_;
 
     SubsetDefinition init_subset_;
 
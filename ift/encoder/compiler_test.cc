@@ -6,10 +6,15 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
 
 #include "absl/container/btree_map.h"
 #include "absl/container/btree_set.h"
+#include "absl/status/status.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/span.h"
 #include "gtest/gtest.h"
 #include "ift/client/fontations_client.h"
@@ -20,6 +25,9 @@
 #include "ift/common/font_helper.h"
 #include "ift/common/int_set.h"
 #include "ift/common/test_font_loader.h"
+#include "ift/common/try.h"
+#include "ift/encoder/compilation_manifest.h"
+#include "ift/encoder/patch_sink.h"
 #include "ift/encoder/subset_definition.h"
 #include "ift/proto/ift_table.h"
 #include "ift/proto/patch_encoding.h"
@@ -164,6 +172,17 @@ StatusOr<bool> PatchHasGvar(const flat_hash_map<std::string, FontData>& patches,
   return font_data.str().find("gvar") != std::string::npos;
 }
 
+void CheckEncodingsEqual(const Compiler::Encoding& a,
+                         const Compiler::Encoding& b) {
+  ASSERT_EQ(a.init_font, b.init_font);
+  ASSERT_EQ(a.patches.size(), b.patches.size());
+  for (const auto& [url, patch] : a.patches) {
+    auto it = b.patches.find(url);
+    ASSERT_TRUE(it != b.patches.end()) << url;
+    ASSERT_EQ(patch, it->second) << url;
+  }
+}
+
 // TODO(garretrieger): additional tests:
 // - rejects duplicate glyph data segment ids.
 
@@ -237,6 +256,63 @@ TEST_F(CompilerTest, OutgoingEdges) {
   ASSERT_EQ(combos, expected);
 }
 
+TEST_F(CompilerTest, OutgoingEdges_PruneByProbability) {
+  Compiler compiler;
+  compiler.AddNonGlyphDataSegment(IntSet{1, 2});
+  compiler.AddNonGlyphDataSegment(IntSet{3, 4});
+  compiler.AddNonGlyphDataSegment(IntSet{5, 6});
+  compiler.AddNonGlyphDataSegment(IntSet{7, 8});
+  compiler.SetJumpAheadPruning({
+      .segment_probabilities = {0.9, 0.8, 0.5, 0.1},
+      .min_probability = 0.35,
+  });
+
+  auto combos = compiler.OutgoingEdges({}, 3);
+  std::vector<Compiler::Edge> expected = {// l1, never pruned
+                                          {{1, 2}},
+                                          {{3, 4}},
+                                          {{5, 6}},
+                                          {{7, 8}},
+
+                                          // l2
+                                          {{1, 2}, {3, 4}},
+                                          {{1, 2}, {5, 6}},
+                                          {{3, 4}, {5, 6}},
+
+                                          // l3
+                                          {{1, 2}, {3, 4}, {5, 6}}};
+  ASSERT_EQ(combos, expected);
+
+  // Probabilities follow the segment they were given for, even once earlier
+  // segments have been added to the node.
+  combos = compiler.OutgoingEdges({1, 2}, 3);
+  expected = {{{3, 4}}, {{5, 6}}, {{7, 8}}, {{3, 4}, {5, 6}}};
+  ASSERT_EQ(combos, expected);
+}
+
+TEST_F(CompilerTest, OutgoingEdges_PruneByCount) {
+  Compiler compiler;
+  compiler.AddNonGlyphDataSegment(IntSet{1, 2});
+  compiler.AddNonGlyphDataSegment(IntSet{3, 4});
+  compiler.AddNonGlyphDataSegment(IntSet{5, 6});
+  compiler.AddNonGlyphDataSegment(IntSet{7, 8});
+  compiler.SetJumpAheadPruning({.max_multi_segment_edges = 2});
+
+  auto combos = compiler.OutgoingEdges({}, 3);
+  std::vector<Compiler::Edge> expected = {{{1, 2}},
+                                          {{3, 4}},
+                                          {{5, 6}},
+                                          {{7, 8}},
+                                          {{1, 2}, {3, 4}},
+                                          {{1, 2}, {5, 6}}};
+  ASSERT_EQ(combos, expected);
+
+  std::vector<Compiler::Edge> streamed;
+  compiler.ForEachOutgoingEdge(
+      {}, 3, [&](Compiler::Edge edge) { streamed.push_back(edge); });
+  ASSERT_EQ(streamed, expected);
+}
+
 TEST_F(CompilerTest, OutgoingEdges_DesignSpace_PointToRange) {
   SubsetDefinition base{1, 2};
   base.design_space[kWght] = AxisRange::Point(300);
@@ -846,6 +922,397 @@ TEST_F(CompilerTest, Encode_FourSubsets_WithJumpAhead_AndPreload) {
   ASSERT_EQ(g, expected);
 }
 
+TEST_F(CompilerTest, Encode_FourSubsets_WithJumpAhead_Parallel) {
+  auto compile = [&](uint32_t num_threads) {
+    Compiler compiler;
+    auto face = font.face();
+    compiler.SetFace(face.get());
+    auto s = compiler.SetInitSubset(IntSet{'a'});
+    EXPECT_TRUE(s.ok()) << s;
+    compiler.AddNonGlyphDataSegment(IntSet{'b'});
+    compiler.AddNonGlyphDataSegment(IntSet{'c'});
+    compiler.AddNonGlyphDataSegment(IntSet{'d'});
+    compiler.SetJumpAhead(2);
+    compiler.SetNumThreads(num_threads);
+    return compiler.Compile();
+  };
+
+  auto serial = compile(1);
+  ASSERT_TRUE(serial.ok()) << serial.status();
+  auto parallel = compile(4);
+  ASSERT_TRUE(parallel.ok()) << parallel.status();
+
+  ASSERT_EQ(serial->patches.size(), 18);
+  // Output must be byte for byte identical regardless of thread count.
+  CheckEncodingsEqual(*serial, *parallel);
+}
+
+TEST_F(CompilerTest, Encode_FourSubsets_WithJumpAhead_Pruned) {
+  auto compile = [&](bool prune) {
+    Compiler compiler;
+    auto face = font.face();
+    compiler.SetFace(face.get());
+    auto s = compiler.SetInitSubset(IntSet{'a'});
+    EXPECT_TRUE(s.ok()) << s;
+    compiler.AddNonGlyphDataSegment(IntSet{'b'});
+    compiler.AddNonGlyphDataSegment(IntSet{'c'});
+    compiler.AddNonGlyphDataSegment(IntSet{'d'});
+    compiler.SetJumpAhead(3);
+    if (prune) {
+      compiler.SetJumpAheadPruning({.max_multi_segment_edges = 1});
+    }
+    return compiler.Compile();
+  };
+
+  auto all = compile(false);
+  ASSERT_TRUE(all.ok()) << all.status();
+  auto pruned = compile(true);
+  ASSERT_TRUE(pruned.ok()) << pruned.status();
+
+  // Each node keeps only its first multi segment jump, so the root loses its
+  // {b, d}, {c, d} and {b, c, d} patches.
+  ASSERT_EQ(all->patches.size(), 19);
+  ASSERT_EQ(pruned->patches.size(), 16);
+}
+
+TEST_F(CompilerTest, Encode_Mixed_Parallel) {
+  auto compile = [&](uint32_t num_threads) -> StatusOr<Compiler::Encoding> {
+    Compiler compiler;
+    auto face = noto_sans_jp.face();
+    compiler.SetFace(face.get());
+
+    TRYV(compiler.AddGlyphDataPatch(0, segment_0_gids));
+    TRYV(compiler.AddGlyphDataPatch(1, segment_1_gids));
+    TRYV(compiler.AddGlyphDataPatch(2, segment_2_gids));
+    TRYV(compiler.AddGlyphDataPatch(3, segment_3_gids));
+    TRYV(compiler.AddGlyphDataPatch(4, segment_4_gids));
+    TRYV(compiler.AddGlyphDataPatchCondition(
+        PatchMap::Entry(segment_1_cps, 1, PatchEncoding::GLYPH_KEYED)));
+    TRYV(compiler.AddGlyphDataPatchCondition(
+        PatchMap::Entry(segment_2_cps, 2, PatchEncoding::GLYPH_KEYED)));
+    TRYV(compiler.AddGlyphDataPatchCondition(
+        PatchMap::Entry(segment_3_cps, 3, PatchEncoding::GLYPH_KEYED)));
+    TRYV(compiler.AddGlyphDataPatchCondition(
+        PatchMap::Entry(segment_4_cps, 4, PatchEncoding::GLYPH_KEYED)));
+
+    TRYV(compiler.SetInitSubset(segment_0_cps));
+    compiler.AddNonGlyphDataSegment(segment_1_cps);
+    compiler.AddNonGlyphDataSegment(segment_2_cps);
+    compiler.AddNonGlyphDataSegment(segment_3_cps);
+    compiler.AddNonGlyphDataSegment(segment_4_cps);
+    compiler.SetNumThreads(num_threads);
+    return compiler.Compile();
+  };
+
+  auto serial = compile(1);
+  ASSERT_TRUE(serial.ok()) << serial.status();
+  auto parallel = compile(4);
+  ASSERT_TRUE(parallel.ok()) << parallel.status();
+
+  CheckEncodingsEqual(*serial, *parallel);
+}
+
+TEST_F(CompilerTest, Encode_Mixed_VF_IncrementalSubsetting) {
+  auto compile = [&](bool incremental) -> StatusOr<Compiler::Encoding> {
+    Compiler compiler;
+    auto face = vf_font.face();
+    compiler.SetFace(face.get());
+
+    TRYV(compiler.AddGlyphDataPatch(0, {37, 38, 39, 40}));
+    TRYV(compiler.AddGlyphDataPatch(1, {41, 42, 43, 44}));
+    TRYV(compiler.AddGlyphDataPatchCondition(PatchMap::Entry(
+        {0x41, 0x42, 0x43, 0x44}, 0, PatchEncoding::GLYPH_KEYED)));
+    TRYV(compiler.AddGlyphDataPatchCondition(PatchMap::Entry(
+        {0x45, 0x46, 0x47, 0x48}, 1, PatchEncoding::GLYPH_KEYED)));
+
+    SubsetDefinition base_subset;
+    base_subset.design_space[kWdth] = AxisRange::Point(100.0f);
+    base_subset.design_space[kWght] = AxisRange::Point(300.0f);
+    TRYV(compiler.SetInitSubsetFromDef(base_subset));
+
+    compiler.AddNonGlyphDataSegment(IntSet{0x41, 0x42, 0x43, 0x44});
+    compiler.AddNonGlyphDataSegment(IntSet{0x45, 0x46, 0x47, 0x48});
+    compiler.AddDesignSpaceSegment(
+        {{kWght, *AxisRange::Range(200.0f, 700.0f)}});
+    compiler.SetIncrementalSubsetting(incremental);
+    return compiler.Compile();
+  };
+
+  auto full = compile(false);
+  ASSERT_TRUE(full.ok()) << full.status();
+  auto incremental = compile(true);
+  ASSERT_TRUE(incremental.ok()) << incremental.status();
+
+  // Reusing tables must not change the output.
+  CheckEncodingsEqual(*full, *incremental);
+
+  // Nodes share design spaces, so the base gvar and the design space only
+  // tables are served from the cache.
+  ASSERT_GT(full->subset_plan_cache_stats.hits, 0);
+  ASSERT_GT(incremental->subset_plan_cache_stats.hits,
+            full->subset_plan_cache_stats.hits);
+}
+
+TEST_F(CompilerTest, Encode_VF_IncrementalSubsetting) {
+  // Table keyed only, so every node subset is instanced from the variable
+  // font and the reused design space only tables end up in the patches.
+  auto compile = [&](bool incremental) -> StatusOr<Compiler::Encoding> {
+    Compiler compiler;
+    auto face = vf_font.face();
+    compiler.SetFace(face.get());
+
+    SubsetDefinition base_subset{'a'};
+    base_subset.design_space[kWdth] = AxisRange::Point(100.0f);
+    base_subset.design_space[kWght] = AxisRange::Point(300.0f);
+    TRYV(compiler.SetInitSubsetFromDef(base_subset));
+
+    compiler.AddNonGlyphDataSegment(IntSet{'b'});
+    compiler.AddNonGlyphDataSegment(IntSet{'c'});
+    compiler.AddDesignSpaceSegment(
+        {{kWght, *AxisRange::Range(200.0f, 700.0f)}});
+    compiler.AddDesignSpaceSegment(
+        {{kWdth, *AxisRange::Range(75.0f, 100.0f)}});
+    compiler.SetIncrementalSubsetting(incremental);
+    return compiler.Compile();
+  };
+
+  auto full = compile(false);
+  ASSERT_TRUE(full.ok()) << full.status();
+  auto incremental = compile(true);
+  ASSERT_TRUE(incremental.ok()) << incremental.status();
+
+  // Reusing tables must not change any of the fonts, including the name
+  // records referenced by fvar and STAT.
+  CheckEncodingsEqual(*full, *incremental);
+  ASSERT_GT(incremental->subset_plan_cache_stats.hits,
+            full->subset_plan_cache_stats.hits);
+}
+
+TEST_F(CompilerTest, Encode_Mixed_VF_Parallel) {
+  auto compile = [&](uint32_t num_threads) -> StatusOr<Compiler::Encoding> {
+    Compiler compiler;
+    auto face = vf_font.face();
+    compiler.SetFace(face.get());
+
+    TRYV(compiler.AddGlyphDataPatch(0, {37, 38, 39, 40}));
+    TRYV(compiler.AddGlyphDataPatch(1, {41, 42, 43, 44}));
+    TRYV(compiler.AddGlyphDataPatchCondition(PatchMap::Entry(
+        {0x41, 0x42, 0x43, 0x44}, 0, PatchEncoding::GLYPH_KEYED)));
+    TRYV(compiler.AddGlyphDataPatchCondition(PatchMap::Entry(
+        {0x45, 0x46, 0x47, 0x48}, 1, PatchEncoding::GLYPH_KEYED)));
+
+    SubsetDefinition base_subset;
+    base_subset.design_space[kWdth] = AxisRange::Point(100.0f);
+    base_subset.design_space[kWght] = AxisRange::Point(300.0f);
+    TRYV(compiler.SetInitSubsetFromDef(base_subset));
+
+    compiler.AddNonGlyphDataSegment(IntSet{0x41, 0x42, 0x43, 0x44});
+    compiler.AddDesignSpaceSegment(
+        {{kWght, *AxisRange::Range(200.0f, 700.0f)}});
+    compiler.AddDesignSpaceSegment(
+        {{kWdth, *AxisRange::Range(75.0f, 100.0f)}});
+    compiler.SetNumThreads(num_threads);
+    return compiler.Compile();
+  };
+
+  auto serial = compile(1);
+  ASSERT_TRUE(serial.ok()) << serial.status();
+  auto parallel = compile(4);
+  ASSERT_TRUE(parallel.ok()) << parallel.status();
+
+  // All four design spaces are instanced up front, so the instances are
+  // shared between the glyph keyed patches and the base gvar tables.
+  CheckEncodingsEqual(*serial, *parallel);
+  ASSERT_GT(serial->subset_plan_cache_stats.hits, 0);
+}
+
+// Records patches and fails if any url is delivered more than once.
+class RecordingPatchSink : public PatchSink {
+ public:
+  Status Accept(const std::string& url, const FontData& patch) override {
+    absl::MutexLock lock(&mutex_);
+    if (error_.has_value()) {
+      return *error_;
+    }
+    if (patches_.contains(url)) {
+      return absl::InternalError(StrCat("Duplicate patch ", url));
+    }
+    patches_[url].shallow_copy(patch);
+    return absl::OkStatus();
+  }
+
+  absl::Mutex mutex_;
+  std::optional<Status> error_;
+  flat_hash_map<std::string, FontData> patches_;
+};
+
+TEST_F(CompilerTest, Encode_Mixed_StreamsToSink) {
+  auto configure = [&](Compiler& compiler) -> Status {
+    auto face = noto_sans_jp.face();
+    compiler.SetFace(face.get());
+    TRYV(compiler.AddGlyphDataPatch(0, segment_0_gids));
+    TRYV(compiler.AddGlyphDataPatch(1, segment_1_gids));
+    TRYV(compiler.AddGlyphDataPatch(2, segment_2_gids));
+    TRYV(compiler.AddGlyphDataPatchCondition(
+        PatchMap::Entry(segment_1_cps, 1, PatchEncoding::GLYPH_KEYED)));
+    TRYV(compiler.AddGlyphDataPatchCondition(
+        PatchMap::Entry(segment_2_cps, 2, PatchEncoding::GLYPH_KEYED)));
+    TRYV(compiler.SetInitSubset(segment_0_cps));
+    compiler.AddNonGlyphDataSegment(segment_1_cps);
+    compiler.AddNonGlyphDataSegment(segment_2_cps);
+    compiler.SetNumThreads(4);
+    return absl::OkStatus();
+  };
+
+  Compiler buffered_compiler;
+  ASSERT_TRUE(configure(buffered_compiler).ok());
+  auto buffered = buffered_compiler.Compile();
+  ASSERT_TRUE(buffered.ok()) << buffered.status();
+
+  Compiler streaming_compiler;
+  ASSERT_TRUE(configure(streaming_compiler).ok());
+  RecordingPatchSink sink;
+  auto streamed = streaming_compiler.Compile(sink);
+  ASSERT_TRUE(streamed.ok()) << streamed.status();
+  ASSERT_TRUE(streamed->patches.empty());
+
+  streamed->patches = std::move(sink.patches_);
+  CheckEncodingsEqual(*buffered, *streamed);
+}
+
+TEST_F(CompilerTest, Encode_StreamsPatchesDuringTraversal) {
+  for (uint32_t num_threads : {1, 4}) {
+    Compiler compiler;
+    auto face = font.face();
+    compiler.SetFace(face.get());
+    auto s = compiler.SetInitSubset(IntSet{'a'});
+    ASSERT_TRUE(s.ok()) << s;
+    compiler.AddNonGlyphDataSegment(IntSet{'b'});
+    compiler.AddNonGlyphDataSegment(IntSet{'c'});
+    compiler.AddNonGlyphDataSegment(IntSet{'d'});
+    compiler.AddNonGlyphDataSegment(IntSet{'e'});
+    compiler.SetNumThreads(num_threads);
+
+    RecordingPatchSink sink;
+    auto encoding = compiler.Compile(sink);
+    ASSERT_TRUE(encoding.ok()) << encoding.status();
+
+    // Patches are sent to the sink in batches of at most one per thread while
+    // the graph is traversed, rather than all at once after it.
+    ASSERT_GT(encoding->max_pending_patches, 0);
+    ASSERT_LE(encoding->max_pending_patches, num_threads);
+    ASSERT_LT(encoding->max_pending_patches, sink.patches_.size());
+  }
+}
+
+TEST_F(CompilerTest, Encode_SinkErrorAbortsCompile) {
+  Compiler compiler;
+  auto face = font.face();
+  compiler.SetFace(face.get());
+  auto s = compiler.SetInitSubset(IntSet{'a'});
+  ASSERT_TRUE(s.ok()) << s;
+  compiler.AddNonGlyphDataSegment(IntSet{'b'});
+  compiler.AddNonGlyphDataSegment(IntSet{'c'});
+
+  RecordingPatchSink sink;
+  sink.error_ = absl::InternalError("disk full");
+  auto encoding = compiler.Compile(sink);
+  ASSERT_EQ(encoding.status(), absl::InternalError("disk full"));
+}
+
+TEST_F(CompilerTest, Encode_Mixed_ReusesPreviousEncoding) {
+  auto compile = [&](const GlyphSet& segment_2,
+                     const Compiler::Encoding* previous)
+      -> StatusOr<Compiler::Encoding> {
+    Compiler compiler;
+    auto face = noto_sans_jp.face();
+    compiler.SetFace(face.get());
+    TRYV(compiler.AddGlyphDataPatch(0, segment_0_gids));
+    TRYV(compiler.AddGlyphDataPatch(1, segment_1_gids));
+    TRYV(compiler.AddGlyphDataPatch(2, segment_2));
+    TRYV(compiler.AddGlyphDataPatchCondition(
+        PatchMap::Entry(segment_1_cps, 1, PatchEncoding::GLYPH_KEYED)));
+    TRYV(compiler.AddGlyphDataPatchCondition(
+        PatchMap::Entry(segment_2_cps, 2, PatchEncoding::GLYPH_KEYED)));
+    TRYV(compiler.SetInitSubset(segment_0_cps));
+    compiler.AddNonGlyphDataSegment(segment_1_cps);
+    compiler.AddNonGlyphDataSegment(segment_2_cps);
+    compiler.SetNumThreads(4);
+
+    if (previous != nullptr) {
+      flat_hash_map<std::string, FontData> patches;
+      for (const auto& [url, patch] : previous->patches) {
+        patches[url].shallow_copy(patch);
+      }
+      compiler.SetPreviousEncoding(
+          previous->manifest,
+          std::make_shared<InMemoryPatchSource>(std::move(patches)));
+    }
+    return compiler.Compile();
+  };
+
+  auto original = compile(segment_2_gids, nullptr);
+  ASSERT_TRUE(original.ok()) << original.status();
+  ASSERT_EQ(original->incremental_stats.reused_patches, 0);
+  ASSERT_EQ(original->incremental_stats.generated_patches,
+            original->patches.size());
+
+  // Nothing changed, so every patch is reused.
+  auto unchanged = compile(segment_2_gids, &*original);
+  ASSERT_TRUE(unchanged.ok()) << unchanged.status();
+  CheckEncodingsEqual(*original, *unchanged);
+  ASSERT_EQ(unchanged->incremental_stats.reused_patches,
+            original->patches.size());
+  ASSERT_EQ(unchanged->incremental_stats.generated_patches, 0);
+  ASSERT_EQ(unchanged->incremental_stats.changed_nodes, 0);
+  ASSERT_TRUE(unchanged->manifest == original->manifest);
+
+  // Modifying one glyph keyed segment only regenerates the patches it affects,
+  // and the result matches a from scratch compile.
+  GlyphSet modified_segment_2 = segment_2_gids;
+  modified_segment_2.erase(modified_segment_2.max().value());
+  auto full = compile(modified_segment_2, nullptr);
+  ASSERT_TRUE(full.ok()) << full.status();
+  auto incremental = compile(modified_segment_2, &*original);
+  ASSERT_TRUE(incremental.ok()) << incremental.status();
+  CheckEncodingsEqual(*full, *incremental);
+  ASSERT_GT(incremental->incremental_stats.reused_patches, 0);
+  ASSERT_GT(incremental->incremental_stats.generated_patches, 0);
+  ASSERT_LT(incremental->incremental_stats.generated_patches,
+            incremental->patches.size());
+}
+
+TEST_F(CompilerTest, Encode_RegeneratesMissingPreviousPatches) {
+  auto compile = [&](std::shared_ptr<const PatchSource> previous_patches,
+                     const CompilationManifest& previous_manifest)
+      -> StatusOr<Compiler::Encoding> {
+    Compiler compiler;
+    auto face = font.face();
+    compiler.SetFace(face.get());
+    TRYV(compiler.SetInitSubset(IntSet{'a'}));
+    compiler.AddNonGlyphDataSegment(IntSet{'b'});
+    compiler.AddNonGlyphDataSegment(IntSet{'c'});
+    if (previous_patches != nullptr) {
+      compiler.SetPreviousEncoding(previous_manifest, previous_patches);
+    }
+    return compiler.Compile();
+  };
+
+  auto original = compile(nullptr, {});
+  ASSERT_TRUE(original.ok()) << original.status();
+
+  // The previous patches are unavailable, so everything is regenerated.
+  auto incremental = compile(
+      std::make_shared<InMemoryPatchSource>(
+          flat_hash_map<std::string, FontData>{}),
+      original->manifest);
+  ASSERT_TRUE(incremental.ok()) << incremental.status();
+  CheckEncodingsEqual(*original, *incremental);
+  ASSERT_EQ(incremental->incremental_stats.reused_patches, 0);
+  ASSERT_EQ(incremental->incremental_stats.generated_patches,
+            original->patches.size());
+}
+
 void ClearCompatIdFromFormat2(uint8_t* data) {
   for (uint32_t index = 5; index < (5 + 16); index++) {
     data[index] = 0;
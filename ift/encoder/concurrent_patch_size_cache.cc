@@ -0,0 +1,107 @@
+#include "ift/encoder/concurrent_patch_size_cache.h"
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/log/log.h"
+#include "ift/common/compat_id.h"
+#include "ift/common/fingerprint.h"
+#include "ift/common/font_data.h"
+#include "ift/common/font_helper.h"
+#include "ift/common/try.h"
+#include "ift/glyph_keyed_diff.h"
+
+using absl::StatusOr;
+using ift::common::CompatId;
+using ift::common::Fingerprint;
+using ift::common::FontData;
+using ift::common::FontHelper;
+using ift::common::GlyphSet;
+
+namespace ift::encoder {
+
+std::unique_ptr<PatchSizeCache> ConcurrentPatchSizeCache::NewBrotli(
+    hb_face_t* original_face, uint32_t brotli_quality,
+    std::shared_ptr<PatchSizeStore> store) {
+  // GlyphKeyedDiff::CreatePatch() is const and sets up a new face and brotli
+  // encoder on each call, so a single differ can be shared by all threads
+  // (see the class comment in glyph_keyed_diff.h). font_data is kept alive by
+  // the size function since the differ only holds a reference to it.
+  auto font_data = std::make_shared<FontData>(original_face);
+  auto differ = std::make_shared<GlyphKeyedDiff>(
+      *font_data, CompatId(),
+      absl::flat_hash_set<hb_tag_t>{FontHelper::kGlyf, FontHelper::kGvar,
+                                    FontHelper::kCFF, FontHelper::kCFF2},
+      brotli_quality);
+  uint64_t font_checksum =
+      store != nullptr ? PatchSizeStore::FontChecksum(original_face) : 0;
+
+  return std::make_unique<ConcurrentPatchSizeCache>(
+      [font_data, differ, store, font_checksum,
+       brotli_quality](const GlyphSet& gids) -> StatusOr<uint32_t> {
+        if (store != nullptr) {
+          auto size = store->Get(font_checksum, brotli_quality, gids);
+          if (size.has_value()) {
+            return *size;
+          }
+        }
+
+        auto patch = differ->CreatePatch(gids);
+        if (!patch.ok()) {
+          return patch.status();
+        }
+
+        if (store != nullptr) {
+          TRYV(store->Put(font_checksum, brotli_quality, gids, patch->size()));
+        }
+        return patch->size();
+      });
+}
+
+StatusOr<uint32_t> ConcurrentPatchSizeCache::GetPatchSize(
+    const GlyphSet& gids) {
+  Fingerprint key = gids.fingerprint();
+  Shard& shard = shards_[key.low % kNumShards];
+
+  std::shared_ptr<Entry> entry;
+  bool owner = false;
+  {
+    absl::MutexLock lock(&shard.mutex);
+    const std::shared_ptr<Entry>* existing = shard.entries.find(key, gids);
+    if (existing) {
+      entry = *existing;
+    } else {
+      entry = shard.entries.insert_or_assign(key, gids,
+                                             std::make_shared<Entry>());
+      owner = true;
+    }
+  }
+
+  if (!owner) {
+    absl::MutexLock lock(&entry->mutex);
+    entry->mutex.Await(absl::Condition(&entry->done));
+    return entry->result;
+  }
+
+  compute_count_++;
+  StatusOr<uint32_t> result = size_function_(gids);
+  {
+    absl::MutexLock lock(&entry->mutex);
+    entry->result = result;
+    entry->done = true;
+  }
+
+  if (!result.ok()) {
+    // Errors are passed on to any waiting threads but not cached, later
+    // requests will retry.
+    absl::MutexLock lock(&shard.mutex);
+    shard.entries.erase(key);
+  }
+
+  return result;
+}
+
+void ConcurrentPatchSizeCache::LogBrotliCallCount() const {
+  VLOG(0) << "Total number of patch size computations = "
+          << compute_count_.load();
+}
+
+}  // namespace ift::encoder
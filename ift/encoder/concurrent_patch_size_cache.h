@@ -0,0 +1,76 @@
+#ifndef IFT_ENCODER_CONCURRENT_PATCH_SIZE_CACHE_H_
+#define IFT_ENCODER_CONCURRENT_PATCH_SIZE_CACHE_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "hb.h"
+#include "ift/common/fingerprint_map.h"
+#include "ift/common/int_set.h"
+#include "ift/encoder/patch_size_cache.h"
+#include "ift/encoder/persistent_patch_size_cache.h"
+
+namespace ift::encoder {
+
+/*
+ * A PatchSizeCache which is safe to use from multiple threads concurrently.
+ *
+ * Cached sizes are keyed by glyph set fingerprint and split across a number
+ * of independently locked shards so lookups from different threads rarely
+ * contend. If several threads request the size of the same glyph set at the
+ * same time only one of them will compute it, the others block until the
+ * result is ready.
+ *
+ * Sizes are computed outside of any lock, so the provided size function must
+ * itself be safe to call concurrently.
+ */
+class ConcurrentPatchSizeCache : public PatchSizeCache {
+ public:
+  using SizeFunction =
+      std::function<absl::StatusOr<uint32_t>(const ift::common::GlyphSet&)>;
+
+  // Sizes patches by brotli compressing them (same results as
+  // PatchSizeCacheImpl). If store is provided previously persisted sizes are
+  // reused from it and newly computed sizes are added to it.
+  static std::unique_ptr<PatchSizeCache> NewBrotli(
+      hb_face_t* original_face, uint32_t brotli_quality,
+      std::shared_ptr<PatchSizeStore> store = nullptr);
+
+  explicit ConcurrentPatchSizeCache(SizeFunction size_function)
+      : size_function_(std::move(size_function)) {}
+
+  absl::StatusOr<uint32_t> GetPatchSize(
+      const ift::common::GlyphSet& gids) override;
+
+  void LogBrotliCallCount() const override;
+
+ private:
+  static constexpr size_t kNumShards = 64;
+
+  // A size which is either computed or in the process of being computed.
+  struct Entry {
+    absl::Mutex mutex;
+    bool done ABSL_GUARDED_BY(mutex) = false;
+    absl::StatusOr<uint32_t> result ABSL_GUARDED_BY(mutex);
+  };
+
+  struct Shard {
+    absl::Mutex mutex;
+    ift::common::FingerprintMap<ift::common::GlyphSet, std::shared_ptr<Entry>>
+        entries ABSL_GUARDED_BY(mutex);
+  };
+
+  SizeFunction size_function_;
+  std::array<Shard, kNumShards> shards_;
+  std::atomic<uint64_t> compute_count_ = 0;
+};
+
+}  // namespace ift::encoder
+
+#endif  // IFT_ENCODER_CONCURRENT_PATCH_SIZE_CACHE_H_
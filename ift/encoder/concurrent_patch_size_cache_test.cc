@@ -0,0 +1,133 @@
+#include "ift/encoder/concurrent_patch_size_cache.h"
+
+#include <atomic>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "ift/common/font_data.h"
+#include "ift/common/int_set.h"
+#include "ift/common/test_font_loader.h"
+#include "ift/common/thread_pool.h"
+#include "ift/encoder/patch_size_cache.h"
+
+using absl::StatusOr;
+using ift::common::GlyphSet;
+using ift::common::hb_face_unique_ptr;
+using ift::common::make_hb_face;
+using ift::common::ThreadPool;
+
+namespace ift::encoder {
+
+class ConcurrentPatchSizeCacheTest : public ::testing::Test {
+ protected:
+  ConcurrentPatchSizeCacheTest() : roboto(make_hb_face(nullptr)) {
+    auto loader = ift::common::TestFontLoader::Default().value();
+    auto blob = loader->LoadFontData("ift/common/testdata/Roboto-Regular.ttf")
+                    .value()
+                    .blob();
+    roboto = make_hb_face(hb_face_create(blob.get(), 0));
+  }
+
+  hb_face_unique_ptr roboto;
+};
+
+TEST_F(ConcurrentPatchSizeCacheTest, MatchesPatchSizeCacheImpl) {
+  PatchSizeCacheImpl expected(roboto.get(), 9);
+  auto cache = ConcurrentPatchSizeCache::NewBrotli(roboto.get(), 9);
+
+  std::vector<GlyphSet> sets = {{44, 47, 49}, {45, 48, 50, 51}, {52}};
+  ThreadPool pool(4);
+  std::vector<uint32_t> sizes(sets.size() * 4);
+  auto sc = pool.ParallelFor(sizes.size(), [&](size_t i) {
+    auto size = cache->GetPatchSize(sets[i % sets.size()]);
+    if (!size.ok()) {
+      return size.status();
+    }
+    sizes[i] = *size;
+    return absl::OkStatus();
+  });
+  ASSERT_TRUE(sc.ok()) << sc;
+
+  for (size_t i = 0; i < sizes.size(); i++) {
+    ASSERT_EQ(sizes[i], *expected.GetPatchSize(sets[i % sets.size()]));
+  }
+}
+
+TEST_F(ConcurrentPatchSizeCacheTest, SharedDifferConcurrentMisses) {
+  // Every set is distinct so each lookup misses and the shared glyph keyed
+  // differ is used by all of the threads at once.
+  PatchSizeCacheImpl expected(roboto.get(), 5);
+  auto cache = ConcurrentPatchSizeCache::NewBrotli(roboto.get(), 5);
+
+  std::vector<GlyphSet> sets(64);
+  for (uint32_t i = 0; i < sets.size(); i++) {
+    sets[i].insert_range(40 + i, 40 + 2 * i);
+  }
+
+  ThreadPool pool(8);
+  std::vector<uint32_t> sizes(sets.size());
+  auto sc = pool.ParallelFor(sets.size(), [&](size_t i) {
+    auto size = cache->GetPatchSize(sets[i]);
+    if (!size.ok()) {
+      return size.status();
+    }
+    sizes[i] = *size;
+    return absl::OkStatus();
+  });
+  ASSERT_TRUE(sc.ok()) << sc;
+
+  for (size_t i = 0; i < sets.size(); i++) {
+    ASSERT_EQ(sizes[i], *expected.GetPatchSize(sets[i])) << i;
+  }
+}
+
+TEST_F(ConcurrentPatchSizeCacheTest, DeduplicatesInFlightRequests) {
+  std::atomic<uint32_t> calls = 0;
+  ConcurrentPatchSizeCache cache(
+      [&](const GlyphSet& gids) -> StatusOr<uint32_t> {
+        calls++;
+        // Make it likely that other threads request the same set while this
+        // is in progress.
+        absl::SleepFor(absl::Milliseconds(20));
+        return (uint32_t)gids.size();
+      });
+
+  ThreadPool pool(8);
+  auto sc = pool.ParallelFor(64, [&](size_t i) {
+    GlyphSet gids;
+    gids.insert_range(0, i % 4);
+    auto size = cache.GetPatchSize(gids);
+    if (!size.ok()) {
+      return size.status();
+    }
+    if (*size != (i % 4) + 1) {
+      return absl::InternalError("Incorrect size.");
+    }
+    return absl::OkStatus();
+  });
+  ASSERT_TRUE(sc.ok()) << sc;
+  ASSERT_EQ(calls.load(), 4);
+}
+
+TEST_F(ConcurrentPatchSizeCacheTest, ErrorsAreNotCached) {
+  uint32_t calls = 0;
+  ConcurrentPatchSizeCache cache(
+      [&](const GlyphSet& gids) -> StatusOr<uint32_t> {
+        calls++;
+        if (calls == 1) {
+          return absl::InternalError("failed");
+        }
+        return 10;
+      });
+
+  ASSERT_EQ(cache.GetPatchSize(GlyphSet{1}).status(),
+            absl::InternalError("failed"));
+  ASSERT_EQ(*cache.GetPatchSize(GlyphSet{1}), 10);
+  ASSERT_EQ(*cache.GetPatchSize(GlyphSet{1}), 10);
+  ASSERT_EQ(calls, 2);
+}
+
+}  // namespace ift::encoder
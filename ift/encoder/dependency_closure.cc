@@ -72,6 +72,30 @@ Status DependencyClosure::InitFontChanged(const SegmentSet& segments) {
   return absl::OkStatus();
 }
 
+std::unique_ptr<DependencyClosure> DependencyClosure::Clone(
+    const RequestedSegmentationInformation* segmentation_info) const {
+  auto result = std::unique_ptr<DependencyClosure>(new DependencyClosure(
+      graph_.WithSegmentationInfo(segmentation_info), segmentation_info,
+      original_face_.get()));
+  result->context_glyphs_ = context_glyphs_;
+  result->init_font_context_glyphs_ = init_font_context_glyphs_;
+  result->inert_segments_ = inert_segments_;
+  result->glyph_condition_cache_ = glyph_condition_cache_;
+  result->node_condition_cache_ = node_condition_cache_;
+  result->node_conditions_with_segment_ = node_conditions_with_segment_;
+  for (uint32_t phase = 0; phase < DependencyGraph::kNumberOfClosurePhases;
+       phase++) {
+    result->phase_node_condition_cache_[phase] =
+        phase_node_condition_cache_[phase];
+  }
+  result->last_seen_full_closure_size_ = last_seen_full_closure_size_;
+  result->incoming_edges_cache_ = incoming_edges_cache_;
+  result->init_font_nodes_ = init_font_nodes_;
+  result->accurate_results_ = accurate_results_.load();
+  result->inaccurate_results_ = inaccurate_results_.load();
+  return result;
+}
+
 Status DependencyClosure::SegmentsMerged(segment_index_t base_segment,
                                          const SegmentSet& segments) {
   if (!segmentation_info_->SegmentsAreDisjoint()) {
@@ -1,6 +1,7 @@
 #ifndef IFT_ENCODER_DEPENDENCY_CLOSURE_H_
 #define IFT_ENCODER_DEPENDENCY_CLOSURE_H_
 
+#include <atomic>
 #include <memory>
 #include <optional>
 
@@ -56,6 +57,13 @@ class DependencyClosure {
 #endif
   }
 
+  // Returns a copy of this closure, including all of the computed conditions,
+  // which reads segment information from segmentation_info instead.
+  // segmentation_info must currently match the segmentation info used by this
+  // closure. The dependency graph's edge tables are shared with the copy.
+  std::unique_ptr<DependencyClosure> Clone(
+      const RequestedSegmentationInformation* segmentation_info) const;
+
   enum AnalysisAccuracy {
     // The analysis is accurate and should match true glyph closure.
     ACCURATE,
@@ -90,6 +98,10 @@ class DependencyClosure {
   // exclusive_gids: these gids are exclusively needed by the union of input
   // segments.
   //                 ie. (s_1 U ... U s_n) -> exclusive_gids
+  //
+  // Only reads the cached dependency information so this is safe to call
+  // concurrently from multiple threads, but not concurrently with
+  // InitFontChanged() or SegmentsMerged().
   absl::StatusOr<AnalysisAccuracy> AnalyzeSegment(
       const ift::common::SegmentSet& segments, ift::common::GlyphSet& and_gids,
       ift::common::GlyphSet& or_gids, ift::common::GlyphSet& exclusive_gids);
@@ -260,8 +272,8 @@ class DependencyClosure {
 
 #endif
 
-  uint64_t accurate_results_ = 0;
-  uint64_t inaccurate_results_ = 0;
+  std::atomic<uint64_t> accurate_results_ = 0;
+  std::atomic<uint64_t> inaccurate_results_ = 0;
 };
 
 }  // namespace ift::encoder
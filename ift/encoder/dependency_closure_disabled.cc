@@ -9,6 +9,11 @@ using ift::common::SegmentSet;
 
 namespace ift::encoder {
 
+std::unique_ptr<DependencyClosure> DependencyClosure::Clone(
+    const RequestedSegmentationInformation* segmentation_info) const {
+  return std::unique_ptr<DependencyClosure>(new DependencyClosure());
+}
+
 Status DependencyClosure::InitFontChanged(const SegmentSet& segments) {
   return absl::UnimplementedError(
       "Dependency graph functionality was disabled during compilation and is "
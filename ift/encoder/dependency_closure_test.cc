@@ -9,6 +9,7 @@
 #include "ift/common/font_helper.h"
 #include "ift/common/int_set.h"
 #include "ift/common/test_font_loader.h"
+#include "ift/common/thread_pool.h"
 #include "ift/config/common.pb.h"
 #include "ift/dep_graph/node.h"
 #include "ift/encoder/glyph_closure_cache.h"
@@ -36,6 +37,7 @@ using ift::common::GlyphSet;
 using ift::common::hb_face_unique_ptr;
 using ift::common::make_hb_font;
 using ift::common::SegmentSet;
+using ift::common::ThreadPool;
 using ift::dep_graph::Node;
 using ift::freq::ProbabilityBound;
 
@@ -366,6 +368,65 @@ TEST_F(DependencyClosureTest, ExtractAllGlyphConditions_FullFont) {
                    "AND (s", c2sc, " OR s", smcp, ")) then p0"));
 }
 
+TEST_F(DependencyClosureTest, ConcurrentAnalysis) {
+  std::vector<Segment> segments;
+  for (hb_codepoint_t cp : FontHelper::ToCodepointsSet(face.get())) {
+    segments.push_back({{cp}, ProbabilityBound::Zero()});
+  }
+  for (hb_tag_t feature : FontHelper::GetFeatureTags(face.get())) {
+    SubsetDefinition f;
+    f.feature_tags.insert(feature);
+    segments.push_back({f, ProbabilityBound::Zero()});
+  }
+  Reconfigure({}, segments);
+
+  struct Result {
+    DependencyClosure::AnalysisAccuracy accuracy;
+    GlyphSet and_gids;
+    GlyphSet or_gids;
+    GlyphSet exclusive_gids;
+  };
+
+  // Single segments and adjacent pairs of segments.
+  std::vector<SegmentSet> inputs;
+  for (segment_index_t s = 0; s < segments.size(); s++) {
+    inputs.push_back({s});
+    if (s + 1 < segments.size()) {
+      inputs.push_back({s, s + 1});
+    }
+  }
+
+  auto analyze = [&](size_t i, Result& result) -> Status {
+    result.accuracy = TRY(dependency_closure->AnalyzeSegment(
+        inputs[i], result.and_gids, result.or_gids, result.exclusive_gids));
+    return absl::OkStatus();
+  };
+
+  std::vector<Result> expected(inputs.size());
+  for (size_t i = 0; i < inputs.size(); i++) {
+    ASSERT_TRUE(analyze(i, expected[i]).ok());
+  }
+  uint64_t accurate = dependency_closure->AccurateResults();
+  uint64_t inaccurate = dependency_closure->InaccurateResults();
+  ASSERT_EQ(accurate + inaccurate, inputs.size());
+
+  ThreadPool pool(8);
+  std::vector<Result> actual(inputs.size());
+  Status sc = pool.ParallelFor(
+      inputs.size(), [&](size_t i) { return analyze(i, actual[i]); });
+  ASSERT_TRUE(sc.ok()) << sc;
+
+  for (size_t i = 0; i < inputs.size(); i++) {
+    EXPECT_EQ(actual[i].accuracy, expected[i].accuracy) << inputs[i].ToString();
+    EXPECT_EQ(actual[i].and_gids, expected[i].and_gids) << inputs[i].ToString();
+    EXPECT_EQ(actual[i].or_gids, expected[i].or_gids) << inputs[i].ToString();
+    EXPECT_EQ(actual[i].exclusive_gids, expected[i].exclusive_gids)
+        << inputs[i].ToString();
+  }
+  EXPECT_EQ(dependency_closure->AccurateResults(), 2 * accurate);
+  EXPECT_EQ(dependency_closure->InaccurateResults(), 2 * inaccurate);
+}
+
 TEST_F(DependencyClosureTest, ExtractAllGlyphConditions_PhaseCycle) {
   // This is a case where's there's a cycle in the graph unless you
   // process phase by phase.
@@ -0,0 +1,122 @@
+#include "ift/encoder/edge_size_estimator.h"
+
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "hb.h"
+#include "ift/common/brotli_binary_diff.h"
+#include "ift/common/font_data.h"
+#include "ift/common/font_helper.h"
+#include "ift/common/try.h"
+
+using absl::flat_hash_set;
+using absl::Span;
+using absl::StatusOr;
+using ift::common::BrotliBinaryDiff;
+using ift::common::FontData;
+using ift::common::FontHelper;
+using ift::common::hb_face_unique_ptr;
+
+namespace ift::encoder {
+
+// Fast brotli quality, only the ratio between tables matters.
+static constexpr unsigned kBrotliQuality = 5;
+
+// Approximate cost of a table entry in a patch (tag, flags, length).
+static constexpr uint64_t kPerTableOverhead = 9;
+
+StatusOr<EdgeSizeEstimator> EdgeSizeEstimator::Create(const FontData& font) {
+  EdgeSizeEstimator estimator;
+  BrotliBinaryDiff brotli(kBrotliQuality);
+  FontData empty;
+
+  uint64_t total_raw = 0;
+  uint64_t total_compressed = 0;
+  hb_face_unique_ptr face = font.face();
+  for (hb_tag_t tag : FontHelper::GetOrderedTags(face.get())) {
+    FontData table = FontHelper::TableData(face.get(), tag);
+    if (table.empty()) {
+      continue;
+    }
+
+    FontData compressed;
+    TRYV(brotli.Diff(empty, table, &compressed));
+    estimator.ratios_[tag] = (double)compressed.size() / (double)table.size();
+    total_raw += table.size();
+    total_compressed += compressed.size();
+  }
+
+  if (total_raw > 0) {
+    estimator.default_ratio_ = (double)total_compressed / (double)total_raw;
+  }
+  return estimator;
+}
+
+EdgeSizeEstimator::TableSizes EdgeSizeEstimator::SizesOf(
+    const FontData& font) {
+  TableSizes sizes;
+  hb_face_unique_ptr face = font.face();
+  for (hb_tag_t tag : FontHelper::GetOrderedTags(face.get())) {
+    sizes[tag] = FontHelper::TableData(face.get(), tag).size();
+  }
+  return sizes;
+}
+
+uint64_t EdgeSizeEstimator::Estimate(
+    const TableSizes& base, const TableSizes& derived,
+    const flat_hash_set<hb_tag_t>& excluded,
+    const flat_hash_set<hb_tag_t>& replaced) const {
+  double size = 0.0;
+  for (const auto& [tag, derived_size] : derived) {
+    if (excluded.contains(tag)) {
+      continue;
+    }
+
+    auto it = base.find(tag);
+    uint32_t base_size = it != base.end() ? it->second : 0;
+    if (replaced.contains(tag)) {
+      size += kPerTableOverhead + derived_size * CompressionRatio(tag);
+    } else if (derived_size != base_size || it == base.end()) {
+      uint32_t growth = derived_size > base_size ? derived_size - base_size : 0;
+      size += kPerTableOverhead + growth * CompressionRatio(tag);
+    }
+  }
+
+  for (const auto& [tag, _] : base) {
+    if (!excluded.contains(tag) && !derived.contains(tag)) {
+      // Removed table.
+      size += kPerTableOverhead;
+    }
+  }
+
+  return (uint64_t)std::llround(size);
+}
+
+double EdgeSizeEstimator::RankingError(
+    Span<const std::pair<uint64_t, uint64_t>> estimated_and_actual) {
+  uint64_t pairs = 0;
+  double wrong = 0.0;
+  for (size_t i = 0; i < estimated_and_actual.size(); i++) {
+    const auto& [estimated_i, actual_i] = estimated_and_actual[i];
+    for (size_t j = i + 1; j < estimated_and_actual.size(); j++) {
+      const auto& [estimated_j, actual_j] = estimated_and_actual[j];
+      if (actual_i == actual_j) {
+        continue;
+      }
+
+      pairs++;
+      if (estimated_i == estimated_j) {
+        wrong += 0.5;
+      } else if ((estimated_i < estimated_j) != (actual_i < actual_j)) {
+        wrong += 1.0;
+      }
+    }
+  }
+  return pairs ? wrong / (double)pairs : 0.0;
+}
+
+}  // namespace ift::encoder
@@ -0,0 +1,64 @@
+#ifndef IFT_ENCODER_EDGE_SIZE_ESTIMATOR_H_
+#define IFT_ENCODER_EDGE_SIZE_ESTIMATOR_H_
+
+#include <cstdint>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "hb.h"
+#include "ift/common/font_data.h"
+
+namespace ift::encoder {
+
+/*
+ * Predicts the size of a table keyed patch from the per table sizes of the
+ * fonts before and after the patch, without computing any diffs.
+ *
+ * The compiler only needs patch sizes to order the entries of a table keyed
+ * patch map, so a cheap prediction is sufficient. Each table contributes the
+ * bytes it grows by (or its full size if it's replaced), scaled by a per table
+ * compression ratio which is measured once per font by compressing each
+ * table of the fully expanded subset.
+ */
+class EdgeSizeEstimator {
+ public:
+  using TableSizes = absl::flat_hash_map<hb_tag_t, uint32_t>;
+
+  // Measures the compression ratio of each table in font.
+  static absl::StatusOr<EdgeSizeEstimator> Create(
+      const ift::common::FontData& font);
+
+  static TableSizes SizesOf(const ift::common::FontData& font);
+
+  // Estimates the size of a patch from a font with base table sizes to one
+  // with derived table sizes. Tables in excluded are not part of the patch,
+  // tables in replaced are included in full rather than diffed.
+  uint64_t Estimate(const TableSizes& base, const TableSizes& derived,
+                    const absl::flat_hash_set<hb_tag_t>& excluded,
+                    const absl::flat_hash_set<hb_tag_t>& replaced) const;
+
+  // For a set of (estimated, actual) sizes, returns the fraction of pairs with
+  // differing actual sizes that the estimates put in the wrong order (ties in
+  // the estimate count as half wrong). Returns 0 if there are no such pairs.
+  static double RankingError(
+      absl::Span<const std::pair<uint64_t, uint64_t>> estimated_and_actual);
+
+  double CompressionRatio(hb_tag_t tag) const {
+    auto it = ratios_.find(tag);
+    return it != ratios_.end() ? it->second : default_ratio_;
+  }
+
+ private:
+  EdgeSizeEstimator() = default;
+
+  absl::flat_hash_map<hb_tag_t, double> ratios_;
+  // Used for tables not present in the measured font.
+  double default_ratio_ = 1.0;
+};
+
+}  // namespace ift::encoder
+
+#endif  // IFT_ENCODER_EDGE_SIZE_ESTIMATOR_H_
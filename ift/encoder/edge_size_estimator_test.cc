@@ -0,0 +1,93 @@
+#include "ift/encoder/edge_size_estimator.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "hb.h"
+#include "ift/common/font_data.h"
+#include "ift/common/font_helper.h"
+#include "ift/common/test_font_loader.h"
+
+using ift::common::FontData;
+using ift::common::FontHelper;
+
+namespace ift::encoder {
+
+class EdgeSizeEstimatorTest : public ::testing::Test {
+ protected:
+  EdgeSizeEstimatorTest() {
+    auto loader = ift::common::TestFontLoader::Default().value();
+    roboto =
+        loader->LoadFontData("ift/common/testdata/Roboto-Regular.ttf").value();
+  }
+
+  FontData roboto;
+};
+
+TEST_F(EdgeSizeEstimatorTest, SizesOf) {
+  auto sizes = EdgeSizeEstimator::SizesOf(roboto);
+  auto face = roboto.face();
+  ASSERT_EQ(sizes.size(), FontHelper::GetOrderedTags(face.get()).size());
+  ASSERT_EQ(sizes.at(FontHelper::kGlyf),
+            FontHelper::TableData(face.get(), FontHelper::kGlyf).size());
+}
+
+TEST_F(EdgeSizeEstimatorTest, CompressionRatios) {
+  auto estimator = EdgeSizeEstimator::Create(roboto);
+  ASSERT_TRUE(estimator.ok()) << estimator.status();
+
+  double glyf = estimator->CompressionRatio(FontHelper::kGlyf);
+  ASSERT_GT(glyf, 0.0);
+  ASSERT_LT(glyf, 1.0);
+  // Tables not in the font use the font wide ratio.
+  double missing = estimator->CompressionRatio(HB_TAG('z', 'z', 'z', 'z'));
+  ASSERT_GT(missing, 0.0);
+  ASSERT_LT(missing, 1.0);
+}
+
+TEST_F(EdgeSizeEstimatorTest, Estimate) {
+  auto estimator = EdgeSizeEstimator::Create(roboto);
+  ASSERT_TRUE(estimator.ok()) << estimator.status();
+
+  hb_tag_t glyf = FontHelper::kGlyf;
+  hb_tag_t cmap = FontHelper::kCmap;
+  hb_tag_t head = FontHelper::kHead;
+  EdgeSizeEstimator::TableSizes base = {
+      {glyf, 1000}, {cmap, 100}, {head, 54}};
+  EdgeSizeEstimator::TableSizes small = {
+      {glyf, 2000}, {cmap, 120}, {head, 54}};
+  EdgeSizeEstimator::TableSizes large = {
+      {glyf, 9000}, {cmap, 200}, {head, 54}};
+
+  ASSERT_EQ(estimator->Estimate(base, base, {}, {}), 0);
+  uint64_t small_size = estimator->Estimate(base, small, {}, {});
+  uint64_t large_size = estimator->Estimate(base, large, {}, {});
+  ASSERT_GT(small_size, 0);
+  ASSERT_LT(small_size, large_size);
+
+  // Excluded tables don't contribute.
+  ASSERT_LT(estimator->Estimate(base, large, {glyf}, {}), large_size);
+
+  // Replaced tables contribute their full size, even if unchanged.
+  ASSERT_GT(estimator->Estimate(base, base, {}, {head}), 0);
+}
+
+TEST_F(EdgeSizeEstimatorTest, RankingError) {
+  using Sizes = std::vector<std::pair<uint64_t, uint64_t>>;
+  ASSERT_EQ(EdgeSizeEstimator::RankingError(Sizes{}), 0.0);
+  ASSERT_EQ(EdgeSizeEstimator::RankingError(Sizes{{1, 10}, {2, 20}, {3, 30}}),
+            0.0);
+  ASSERT_EQ(EdgeSizeEstimator::RankingError(Sizes{{3, 10}, {2, 20}, {1, 30}}),
+            1.0);
+  // One of three pairs out of order.
+  ASSERT_DOUBLE_EQ(
+      EdgeSizeEstimator::RankingError(Sizes{{1, 10}, {3, 20}, {2, 30}}),
+      1.0 / 3.0);
+  // Estimate ties count as half, actual ties are ignored.
+  ASSERT_EQ(EdgeSizeEstimator::RankingError(Sizes{{1, 10}, {1, 20}}), 0.5);
+  ASSERT_EQ(EdgeSizeEstimator::RankingError(Sizes{{1, 10}, {2, 10}}), 0.0);
+}
+
+}  // namespace ift::encoder
@@ -1,5 +1,9 @@
 #include "ift/encoder/glyph_closure_cache.h"
 
+#include <utility>
+#include <vector>
+
+#include "ift/common/fingerprint.h"
 #include "ift/common/font_data.h"
 #include "ift/common/font_helper.h"
 #include "ift/common/hb_set_unique_ptr.h"
@@ -12,10 +16,13 @@
 
 using ift::config::Glyphs;
 
+using absl::MutexLock;
+using absl::Span;
 using absl::Status;
 using absl::StatusOr;
 using ift::common::CodepointSet;
 using ift::common::DataFileResolver;
+using ift::common::Fingerprint;
 using ift::common::FontHelper;
 using ift::common::GlyphSet;
 using ift::common::hb_face_unique_ptr;
@@ -23,6 +30,7 @@ using ift::common::hb_set_unique_ptr;
 using ift::common::make_hb_face;
 using ift::common::make_hb_set;
 using ift::common::SegmentSet;
+using ift::common::ThreadPool;
 using ift::dep_graph::UnicodeEdges;
 
 namespace ift::encoder {
@@ -42,7 +50,29 @@ GlyphClosureCache::GlyphClosureCache(hb_face_t* original_face,
     : original_face_(make_hb_face(hb_face_reference(original_face))),
       preprocessed_face_(std::move(preprocessed_face)),
       gid_to_unicode_(FontHelper::GidToUnicodeMap(preprocessed_face_.get())),
-      unicode_edges_(std::move(unicode_edges)) {}
+      unicode_edges_(std::move(unicode_edges)) {
+  idle_faces_.push_back(
+      make_hb_face(hb_face_reference(preprocessed_face_.get())));
+}
+
+hb_face_unique_ptr GlyphClosureCache::AcquireFace() {
+  {
+    MutexLock lock(&faces_mutex_);
+    if (!idle_faces_.empty()) {
+      hb_face_unique_ptr face = std::move(idle_faces_.back());
+      idle_faces_.pop_back();
+      return face;
+    }
+  }
+  // hb_subset_preprocess() is deterministic so this is equivalent to
+  // preprocessed_face_.
+  return make_hb_face(hb_subset_preprocess(original_face_.get()));
+}
+
+void GlyphClosureCache::ReleaseFace(hb_face_unique_ptr face) {
+  MutexLock lock(&faces_mutex_);
+  idle_faces_.push_back(std::move(face));
+}
 
 StatusOr<GlyphSet> GlyphClosureCache::SegmentClosure(
     const RequestedSegmentationInformation* segmentation_info,
@@ -83,6 +113,32 @@ SubsetDefinition ComputeExceptSegment(
   return except_segment;
 }
 
+// The definitions which AnalyzeSegment() computes the closure of for
+// segment_ids.
+struct AnalysisDefinitions {
+  // Union of all segments except for segment_ids.
+  SubsetDefinition except_segment;
+  // Union of segment_ids and the init font.
+  SubsetDefinition only_segment;
+};
+
+static AnalysisDefinitions ComputeAnalysisDefinitions(
+    const RequestedSegmentationInformation& segmentation_info,
+    const SegmentSet& segment_ids) {
+  SubsetDefinition
+      combined;  // This is the subset definition of the unions of segment_ids.
+  for (segment_index_t s_id : segment_ids) {
+    combined.Union(segmentation_info.Segments()[s_id].Definition());
+  }
+
+  AnalysisDefinitions result;
+  result.except_segment =
+      ComputeExceptSegment(segmentation_info, segment_ids, combined);
+  result.only_segment = std::move(combined);
+  result.only_segment.Union(segmentation_info.InitFontSegment());
+  return result;
+}
+
 StatusOr<bool> GlyphClosureCache::HasAdditionalConditions(
     const RequestedSegmentationInformation* segmentation_info,
     const SegmentSet& segments, const GlyphSet& glyphs) {
@@ -137,25 +193,42 @@ CodepointSet GlyphClosureCache::UnicodeClosure(
 
 StatusOr<GlyphSet> GlyphClosureCache::GlyphClosure(
     const SubsetDefinition& segment) {
-  auto it = glyph_closure_cache_.find(segment);
-  if (it != glyph_closure_cache_.end()) {
-    glyph_closure_cache_hit_++;
-    return it->second;
+  Fingerprint key = segment.fingerprint();
+  Shard& shard = shards_[key.low % kNumShards];
+  {
+    MutexLock lock(&shard.mutex);
+    const GlyphSet* cached = shard.closures.find(key, segment);
+    if (cached) {
+      glyph_closure_cache_hit_++;
+      return *cached;
+    }
   }
 
   glyph_closure_cache_miss_++;
 
+  SubsetDefinition expanded_segment = segment;
+  expanded_segment.codepoints = UnicodeClosure(segment.codepoints);
+
+  hb_face_unique_ptr face = AcquireFace();
+  auto gids = ComputeClosure(face.get(), expanded_segment);
+  ReleaseFace(std::move(face));
+  if (!gids.ok()) {
+    return gids.status();
+  }
+
+  MutexLock lock(&shard.mutex);
+  return shard.closures.insert_or_assign(key, segment, std::move(*gids));
+}
+
+StatusOr<GlyphSet> GlyphClosureCache::ComputeClosure(
+    hb_face_t* face, const SubsetDefinition& segment) const {
   hb_subset_input_t* input = hb_subset_input_create_or_fail();
   if (!input) {
     return absl::InternalError("Closure subset configuration failed.");
   }
 
-  SubsetDefinition expanded_segment = segment;
-  expanded_segment.codepoints = UnicodeClosure(segment.codepoints);
-
-  expanded_segment.ConfigureInput(input, preprocessed_face_.get());
-  hb_subset_plan_t* plan =
-      hb_subset_plan_create_or_fail(preprocessed_face_.get(), input);
+  segment.ConfigureInput(input, face);
+  hb_subset_plan_t* plan = hb_subset_plan_create_or_fail(face, input);
   hb_subset_input_destroy(input);
   if (!plan) {
     return absl::InternalError("Closure calculation failed.");
@@ -166,11 +239,27 @@ StatusOr<GlyphSet> GlyphClosureCache::GlyphClosure(
   hb_map_values(new_to_old, gids.get());
   hb_subset_plan_destroy(plan);
 
-  glyph_closure_cache_.insert(std::pair(segment, GlyphSet(gids)));
-
   return GlyphSet(gids);
 }
 
+StatusOr<std::vector<GlyphSet>> GlyphClosureCache::GlyphClosures(
+    Span<const SubsetDefinition> definitions, ThreadPool* thread_pool) {
+  std::vector<GlyphSet> results(definitions.size());
+  auto compute = [&](size_t i) -> Status {
+    results[i] = TRY(GlyphClosure(definitions[i]));
+    return absl::OkStatus();
+  };
+
+  if (thread_pool == nullptr) {
+    for (size_t i = 0; i < definitions.size(); i++) {
+      TRYV(compute(i));
+    }
+  } else {
+    TRYV(thread_pool->ParallelFor(definitions.size(), compute));
+  }
+  return results;
+}
+
 StatusOr<GlyphSet> GlyphClosureCache::CodepointsToOrGids(
     const RequestedSegmentationInformation& segmentation_info,
     const SegmentSet& segment_ids) {
@@ -216,20 +305,11 @@ Status GlyphClosureCache::AnalyzeSegment(
   //          Where … is one or more additional segments.
   // * D intersection I: the activation conditions for these glyphs is only s_i
 
-  SubsetDefinition
-      combined;  // This is the subset definition of the unions of segment_ids.
-  for (segment_index_t s_id : segment_ids) {
-    combined.Union(segmentation_info.Segments()[s_id].Definition());
-  }
-
-  SubsetDefinition except_segment =
-      ComputeExceptSegment(segmentation_info, segment_ids, combined);
-  auto B_except_segment_closure = TRY(GlyphClosure(except_segment));
-
-  SubsetDefinition only_segment = combined;
-  only_segment.Union(segmentation_info.InitFontSegment());
-
-  auto I_only_segment_closure = TRY(GlyphClosure(only_segment));
+  AnalysisDefinitions definitions =
+      ComputeAnalysisDefinitions(segmentation_info, segment_ids);
+  auto B_except_segment_closure =
+      TRY(GlyphClosure(definitions.except_segment));
+  auto I_only_segment_closure = TRY(GlyphClosure(definitions.only_segment));
   I_only_segment_closure.subtract(segmentation_info.InitFontGlyphs());
 
   GlyphSet D_dropped = segmentation_info.FullClosure();
@@ -247,6 +327,33 @@ Status GlyphClosureCache::AnalyzeSegment(
   return absl::OkStatus();
 }
 
+Status GlyphClosureCache::PrecomputeAnalysis(
+    const RequestedSegmentationInformation& segmentation_info,
+    Span<const SegmentSet> segments, ThreadPool* thread_pool) {
+  std::vector<SubsetDefinition> definitions;
+  definitions.reserve(segments.size() * 2);
+  for (const SegmentSet& segment_ids : segments) {
+    if (segment_ids.empty()) {
+      continue;
+    }
+    AnalysisDefinitions analysis =
+        ComputeAnalysisDefinitions(segmentation_info, segment_ids);
+    definitions.push_back(std::move(analysis.except_segment));
+    definitions.push_back(std::move(analysis.only_segment));
+  }
+
+  auto precompute = [&](size_t i) -> Status {
+    return GlyphClosure(definitions[i]).status();
+  };
+  if (thread_pool == nullptr) {
+    for (size_t i = 0; i < definitions.size(); i++) {
+      TRYV(precompute(i));
+    }
+    return absl::OkStatus();
+  }
+  return thread_pool->ParallelFor(definitions.size(), precompute);
+}
+
 CodepointSet GlyphClosureCache::CodepointsForGlyphs(
     const GlyphSet& glyphs) const {
   // Codepoints can map to glyphs via either standard cmap mappings, or via
@@ -1,12 +1,20 @@
 #ifndef IFT_ENCODER_GLYPH_CLOSURE_CACHE_H_
 #define IFT_ENCODER_GLYPH_CLOSURE_CACHE_H_
 
+#include <array>
+#include <atomic>
 #include <memory>
+#include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "ift/common/data_file_resolver.h"
+#include "ift/common/fingerprint_map.h"
 #include "ift/common/font_data.h"
 #include "ift/common/int_set.h"
+#include "ift/common/thread_pool.h"
 #include "ift/dep_graph/unicode_edges.h"
 #include "ift/encoder/subset_definition.h"
 
@@ -16,6 +24,12 @@ class RequestedSegmentationInformation;
 
 /*
  * A cache of the results of glyph closure on a specific font face.
+ *
+ * Safe to use from multiple threads concurrently. Results are kept in a set of
+ * independently locked shards, and each closure computation borrows its own
+ * preprocessed face so harfbuzz state is never shared between threads. If two
+ * threads miss on the same definition at once both compute it, the results are
+ * identical.
  */
 class GlyphClosureCache {
  public:
@@ -31,6 +45,21 @@ class GlyphClosureCache {
   absl::StatusOr<ift::common::GlyphSet> GlyphClosure(
       const SubsetDefinition& segment);
 
+  // Computes the glyph closure of each of definitions, results are in the same
+  // order as definitions. Cache misses are computed in parallel on
+  // thread_pool, which may be nullptr to compute them serially.
+  absl::StatusOr<std::vector<ift::common::GlyphSet>> GlyphClosures(
+      absl::Span<const SubsetDefinition> definitions,
+      ift::common::ThreadPool* thread_pool);
+
+  // Populates the cache with all closures that AnalyzeSegment() needs for each
+  // of segments, computing them in parallel on thread_pool. Subsequent
+  // AnalyzeSegment() calls for those segments will then be cache hits.
+  absl::Status PrecomputeAnalysis(
+      const RequestedSegmentationInformation& segmentation_info,
+      absl::Span<const ift::common::SegmentSet> segments,
+      ift::common::ThreadPool* thread_pool);
+
   absl::StatusOr<ift::common::GlyphSet> SegmentClosure(
       const RequestedSegmentationInformation* segmentation_info,
       const ift::common::SegmentSet& segments);
@@ -67,15 +96,35 @@ class GlyphClosureCache {
   hb_face_t* Face() { return preprocessed_face_.get(); }
 
  private:
+  static constexpr size_t kNumShards = 16;
+
+  struct Shard {
+    absl::Mutex mutex;
+    ift::common::FingerprintMap<SubsetDefinition, ift::common::GlyphSet>
+        closures ABSL_GUARDED_BY(mutex);
+  };
+
   common::CodepointSet UnicodeClosure(
       const common::CodepointSet& unicodes) const;
 
+  // Runs closure on segment (which must already have been expanded by
+  // UnicodeClosure()) using face.
+  absl::StatusOr<ift::common::GlyphSet> ComputeClosure(
+      hb_face_t* face, const SubsetDefinition& segment) const;
+
+  // Takes a preprocessed face for exclusive use by the caller, creating a new
+  // one if all existing faces are in use. Return it with ReleaseFace().
+  ift::common::hb_face_unique_ptr AcquireFace();
+  void ReleaseFace(ift::common::hb_face_unique_ptr face);
+
   ift::common::hb_face_unique_ptr original_face_;
   ift::common::hb_face_unique_ptr preprocessed_face_;
-  absl::flat_hash_map<SubsetDefinition, ift::common::GlyphSet>
-      glyph_closure_cache_;
-  uint64_t glyph_closure_cache_hit_ = 0;
-  uint64_t glyph_closure_cache_miss_ = 0;
+  std::array<Shard, kNumShards> shards_;
+  absl::Mutex faces_mutex_;
+  std::vector<ift::common::hb_face_unique_ptr> idle_faces_
+      ABSL_GUARDED_BY(faces_mutex_);
+  std::atomic<uint64_t> glyph_closure_cache_hit_ = 0;
+  std::atomic<uint64_t> glyph_closure_cache_miss_ = 0;
   absl::flat_hash_map<uint32_t, common::CodepointSet> gid_to_unicode_;
   dep_graph::UnicodeEdges unicode_edges_;
 };
@@ -24,6 +24,7 @@ using ift::common::GlyphSet;
 using ift::common::hb_face_unique_ptr;
 using ift::common::make_hb_face;
 using ift::common::SegmentSet;
+using ift::common::ThreadPool;
 using ift::freq::ProbabilityBound;
 
 namespace ift::encoder {
@@ -53,6 +54,67 @@ TEST_F(GlyphClosureCacheTest, GlyphClosure) {
   ASSERT_EQ(*closure, (GlyphSet{0, 69}));
 }
 
+TEST_F(GlyphClosureCacheTest, GlyphClosures) {
+  auto cache = GlyphClosureCache::Create(roboto.get(), *resolver);
+  ASSERT_TRUE(cache.ok()) << cache.status();
+
+  std::vector<SubsetDefinition> definitions;
+  for (hb_codepoint_t cp = 'a'; cp <= 'z'; cp++) {
+    definitions.push_back(SubsetDefinition{cp});
+  }
+  // Duplicates are fine.
+  definitions.push_back(SubsetDefinition{'a'});
+
+  ThreadPool thread_pool(4);
+  auto closures = (*cache)->GlyphClosures(definitions, &thread_pool);
+  ASSERT_TRUE(closures.ok()) << closures.status();
+  ASSERT_EQ(closures->size(), definitions.size());
+
+  // Same results as the serial path.
+  auto serial_cache = GlyphClosureCache::Create(roboto.get(), *resolver);
+  ASSERT_TRUE(serial_cache.ok()) << serial_cache.status();
+  for (size_t i = 0; i < definitions.size(); i++) {
+    EXPECT_EQ((*closures)[i], *(*serial_cache)->GlyphClosure(definitions[i]));
+  }
+  EXPECT_EQ(closures->front(), (GlyphSet{0, 69}));
+  EXPECT_EQ(closures->back(), (GlyphSet{0, 69}));
+
+  EXPECT_EQ((*cache)->CacheHits() + (*cache)->CacheMisses(),
+            definitions.size());
+}
+
+TEST_F(GlyphClosureCacheTest, PrecomputeAnalysis) {
+  auto cache = GlyphClosureCache::Create(roboto.get(), *resolver);
+  ASSERT_TRUE(cache.ok()) << cache.status();
+  std::vector<Segment> segments{
+      {{'f'}, ProbabilityBound::Zero()},
+      {{'i'}, ProbabilityBound::Zero()},
+  };
+
+  SubsetDefinition init;
+  init.feature_tags = {HB_TAG('l', 'i', 'g', 'a')};
+  auto info =
+      RequestedSegmentationInformation::Create(segments, init, **cache, PATCH);
+  ASSERT_TRUE(info.ok());
+
+  ThreadPool thread_pool(2);
+  std::vector<SegmentSet> to_analyze{{0}, {1}};
+  auto sc =
+      (*cache)->PrecomputeAnalysis(*info->get(), to_analyze, &thread_pool);
+  ASSERT_TRUE(sc.ok()) << sc;
+
+  uint64_t misses = (*cache)->CacheMisses();
+  GlyphSet and_gids, or_gids, exclusive_gids;
+  auto status = (*cache)->AnalyzeSegment(*info->get(), {0}, and_gids, or_gids,
+                                         exclusive_gids);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ((*cache)->CacheMisses(), misses);
+
+  EXPECT_EQ(exclusive_gids, (GlyphSet{74 /* f */}));
+  EXPECT_EQ(or_gids, (GlyphSet{}));
+  EXPECT_EQ(and_gids, (GlyphSet{444 /* fi */, 446 /* ffi */}));
+}
+
 TEST_F(GlyphClosureCacheTest, SegmentClosure) {
   auto cache = GlyphClosureCache::Create(roboto.get(), *resolver);
   ASSERT_TRUE(cache.ok()) << cache.status();
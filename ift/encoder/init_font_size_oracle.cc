@@ -0,0 +1,101 @@
+#include "ift/encoder/init_font_size_oracle.h"
+
+#include <cmath>
+#include <cstdint>
+#include <optional>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "ift/common/font_data.h"
+#include "ift/common/font_helper.h"
+#include "ift/common/int_set.h"
+#include "ift/common/try.h"
+
+using absl::flat_hash_set;
+using absl::Status;
+using absl::StatusOr;
+using ift::common::FontHelper;
+using ift::common::GlyphSet;
+using ift::common::make_hb_face;
+
+namespace ift::encoder {
+
+static uint32_t PerGlyphOverhead(hb_face_t* face) {
+  flat_hash_set<hb_tag_t> tags = FontHelper::GetTags(face);
+  uint32_t table_count = (tags.contains(FontHelper::kCFF) ? 1 : 0) +
+                         (tags.contains(FontHelper::kCFF2) ? 1 : 0) +
+                         (tags.contains(FontHelper::kGlyf) ? 1 : 0) +
+                         (tags.contains(FontHelper::kGvar) ? 1 : 0);
+  // A glyph id plus one data offset per table.
+  return 2 + 4 * table_count;
+}
+
+InitFontSizeOracle::InitFontSizeOracle(hb_face_t* original_face,
+                                       PatchSizeCache& exact_sizes)
+    : face_(make_hb_face(hb_face_reference(original_face))),
+      exact_sizes_(exact_sizes),
+      per_glyph_overhead_(PerGlyphOverhead(original_face)) {}
+
+StatusOr<uint64_t> InitFontSizeOracle::UncompressedSize(const GlyphSet& gids) {
+  uint64_t size = TRY(FontHelper::TotalGlyphData(face_.get(), gids));
+  return size + (uint64_t)gids.size() * per_glyph_overhead_;
+}
+
+Status InitFontSizeOracle::Reset(const GlyphSet& init_glyphs) {
+  if (init_glyphs == init_glyphs_ && current_uncompressed_size_ > 0) {
+    return absl::OkStatus();
+  }
+
+  uint32_t size = TRY(exact_sizes_.GetPatchSize(init_glyphs));
+  uint64_t uncompressed_size = TRY(UncompressedSize(init_glyphs));
+
+  bool grew = current_uncompressed_size_ > 0 &&
+              init_glyphs_.is_subset_of(init_glyphs) &&
+              uncompressed_size > current_uncompressed_size_ &&
+              size > current_size_;
+  if (grew) {
+    marginal_ratio_ = (double)(size - current_size_) /
+                      (double)(uncompressed_size - current_uncompressed_size_);
+    VLOG(1) << "Init font grew by " << (size - current_size_)
+            << " bytes, marginal compression ratio is now " << *marginal_ratio_;
+  }
+
+  init_glyphs_ = init_glyphs;
+  current_size_ = size;
+  current_uncompressed_size_ = uncompressed_size;
+  return absl::OkStatus();
+}
+
+std::optional<double> InitFontSizeOracle::CompressionRatio() const {
+  if (marginal_ratio_.has_value()) {
+    return marginal_ratio_;
+  }
+  if (current_uncompressed_size_ == 0) {
+    return std::nullopt;
+  }
+  return (double)current_size_ / (double)current_uncompressed_size_;
+}
+
+StatusOr<uint32_t> InitFontSizeOracle::EstimateIncrease(
+    const GlyphSet& added_glyphs) {
+  if (added_glyphs.empty()) {
+    return 0;
+  }
+
+  std::optional<double> ratio = CompressionRatio();
+  if (!ratio.has_value()) {
+    // Nothing to base a ratio on yet, so fall back to the exact size.
+    GlyphSet after = init_glyphs_;
+    after.union_set(added_glyphs);
+    uint32_t size = TRY(exact_sizes_.GetPatchSize(after));
+    return size > current_size_ ? size - current_size_ : 0;
+  }
+
+  estimate_count_++;
+  uint64_t added = TRY(UncompressedSize(added_glyphs));
+  return (uint32_t)std::lround((double)added * *ratio);
+}
+
+}  // namespace ift::encoder
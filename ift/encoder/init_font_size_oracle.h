@@ -0,0 +1,77 @@
+#ifndef IFT_ENCODER_INIT_FONT_SIZE_ORACLE_H_
+#define IFT_ENCODER_INIT_FONT_SIZE_ORACLE_H_
+
+#include <cstdint>
+#include <optional>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "hb.h"
+#include "ift/common/font_data.h"
+#include "ift/common/int_set.h"
+#include "ift/encoder/patch_size_cache.h"
+
+namespace ift::encoder {
+
+/*
+ * Estimates how much the glyph data of the initial font grows when glyphs are
+ * added to it, without compressing anything.
+ *
+ * The glyph data of the initial font is measured as the size of a glyph keyed
+ * patch containing all of the init font glyphs (see
+ * CandidateMerge::ComputeInitFontCostDelta). Computing that exactly requires
+ * a brotli compression of the whole init font glyph closure for every
+ * candidate, since each candidate produces a different closure. Instead the
+ * oracle keeps the exact size and uncompressed glyph data size of the current
+ * init font, and estimates the increase from adding glyphs as the
+ * uncompressed size of the added glyph data scaled by a compression ratio.
+ *
+ * The compression ratio starts as the average ratio of the current init font.
+ * Once the init font has grown at least once, the marginal ratio observed for
+ * that growth is used instead, since additional glyphs compress better
+ * against a larger base than the average suggests.
+ *
+ * Exact sizes are obtained from the provided PatchSizeCache, which should be
+ * used to confirm a move before it's applied.
+ */
+class InitFontSizeOracle {
+ public:
+  InitFontSizeOracle(hb_face_t* original_face, PatchSizeCache& exact_sizes);
+
+  // Sets the glyphs currently in the initial font. Computes the exact size
+  // of their glyph data, and if they are a superset of the previous init
+  // glyphs updates the compression ratio from the observed growth.
+  absl::Status Reset(const ift::common::GlyphSet& init_glyphs);
+
+  // The exact size of the glyph data of the current init font.
+  uint32_t CurrentSize() const { return current_size_; }
+
+  // Estimates the increase in init font glyph data size from adding
+  // added_glyphs. added_glyphs must not intersect the current init glyphs.
+  absl::StatusOr<uint32_t> EstimateIncrease(
+      const ift::common::GlyphSet& added_glyphs);
+
+  // The ratio currently used to scale uncompressed glyph data sizes.
+  std::optional<double> CompressionRatio() const;
+
+  uint64_t EstimateCount() const { return estimate_count_; }
+
+ private:
+  // Uncompressed size of the glyph data of gids as it appears in a glyph
+  // keyed patch (outline data plus per glyph id and offset overhead).
+  absl::StatusOr<uint64_t> UncompressedSize(const ift::common::GlyphSet& gids);
+
+  ift::common::hb_face_unique_ptr face_;
+  PatchSizeCache& exact_sizes_;
+  uint32_t per_glyph_overhead_;
+
+  ift::common::GlyphSet init_glyphs_;
+  uint32_t current_size_ = 0;
+  uint64_t current_uncompressed_size_ = 0;
+  std::optional<double> marginal_ratio_;
+  uint64_t estimate_count_ = 0;
+};
+
+}  // namespace ift::encoder
+
+#endif  // IFT_ENCODER_INIT_FONT_SIZE_ORACLE_H_
@@ -0,0 +1,112 @@
+#include "ift/encoder/init_font_size_oracle.h"
+
+#include <cmath>
+#include <cstdint>
+
+#include "gtest/gtest.h"
+#include "ift/common/font_data.h"
+#include "ift/common/font_helper.h"
+#include "ift/common/int_set.h"
+#include "ift/common/test_font_loader.h"
+#include "ift/encoder/mock_patch_size_cache.h"
+#include "ift/encoder/patch_size_cache.h"
+
+using ift::common::FontData;
+using ift::common::FontHelper;
+using ift::common::GlyphSet;
+using ift::common::hb_face_unique_ptr;
+
+namespace ift::encoder {
+
+class InitFontSizeOracleTest : public ::testing::Test {
+ protected:
+  InitFontSizeOracleTest() {
+    auto loader = ift::common::TestFontLoader::Default().value();
+    font =
+        loader->LoadFontData("ift/common/testdata/Roboto-Regular.ttf").value();
+    face = font.face();
+  }
+
+  // Roboto only has glyf, so each glyph has a 2 byte id and one offset.
+  double Uncompressed(const GlyphSet& gids) {
+    return *FontHelper::TotalGlyphData(face.get(), gids) + gids.size() * 6;
+  }
+
+  static GlyphSet Range(uint32_t start, uint32_t end) {
+    GlyphSet gids;
+    gids.insert_range(start, end);
+    return gids;
+  }
+
+  FontData font;
+  hb_face_unique_ptr face = ift::common::make_hb_face(nullptr);
+};
+
+TEST_F(InitFontSizeOracleTest, EstimatesWithAverageRatio) {
+  MockPatchSizeCache exact;
+  GlyphSet init = Range(1, 20);
+  exact.SetPatchSize(init, 1000);
+
+  InitFontSizeOracle oracle(face.get(), exact);
+  ASSERT_TRUE(oracle.Reset(init).ok());
+  ASSERT_EQ(oracle.CurrentSize(), 1000);
+
+  double ratio = 1000.0 / Uncompressed(init);
+  ASSERT_DOUBLE_EQ(*oracle.CompressionRatio(), ratio);
+
+  GlyphSet added = Range(40, 45);
+  auto increase = oracle.EstimateIncrease(added);
+  ASSERT_TRUE(increase.ok()) << increase.status();
+  ASSERT_EQ(*increase, std::lround(Uncompressed(added) * ratio));
+  ASSERT_EQ(*oracle.EstimateIncrease(GlyphSet{}), 0);
+  ASSERT_EQ(oracle.EstimateCount(), 1);
+}
+
+TEST_F(InitFontSizeOracleTest, UsesMarginalRatioAfterGrowth) {
+  MockPatchSizeCache exact;
+  GlyphSet init = Range(1, 20);
+  GlyphSet grown = Range(1, 30);
+  exact.SetPatchSize(init, 1000);
+  exact.SetPatchSize(grown, 1200);
+
+  InitFontSizeOracle oracle(face.get(), exact);
+  ASSERT_TRUE(oracle.Reset(init).ok());
+  ASSERT_TRUE(oracle.Reset(grown).ok());
+  ASSERT_EQ(oracle.CurrentSize(), 1200);
+
+  double ratio = 200.0 / (Uncompressed(grown) - Uncompressed(init));
+  ASSERT_DOUBLE_EQ(*oracle.CompressionRatio(), ratio);
+
+  GlyphSet added = Range(40, 45);
+  ASSERT_EQ(*oracle.EstimateIncrease(added),
+            std::lround(Uncompressed(added) * ratio));
+}
+
+TEST_F(InitFontSizeOracleTest, FallsBackToExactWithoutGlyphData) {
+  MockPatchSizeCache exact;
+  exact.SetPatchSize(GlyphSet{}, 0);
+  exact.SetPatchSize(GlyphSet{40, 41}, 150);
+
+  InitFontSizeOracle oracle(face.get(), exact);
+  ASSERT_TRUE(oracle.Reset(GlyphSet{}).ok());
+  ASSERT_FALSE(oracle.CompressionRatio().has_value());
+  ASSERT_EQ(*oracle.EstimateIncrease(GlyphSet{40, 41}), 150);
+  ASSERT_EQ(oracle.EstimateCount(), 0);
+}
+
+TEST_F(InitFontSizeOracleTest, CloseToRealSize) {
+  PatchSizeCacheImpl exact(face.get(), 11);
+  GlyphSet init = Range(1, 200);
+
+  InitFontSizeOracle oracle(face.get(), exact);
+  ASSERT_TRUE(oracle.Reset(init).ok());
+
+  GlyphSet added = Range(300, 340);
+  GlyphSet after = init;
+  after.union_set(added);
+  double actual = *exact.GetPatchSize(after) - oracle.CurrentSize();
+  double estimated = *oracle.EstimateIncrease(added);
+  ASSERT_NEAR(estimated / actual, 1.0, 0.35);
+}
+
+}  // namespace ift::encoder
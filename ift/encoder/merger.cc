@@ -1,23 +1,29 @@
 #include "ift/encoder/merger.h"
 
 #include <optional>
+#include <vector>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/flags/flag.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "ift/common/int_set.h"
+#include "ift/common/thread_pool.h"
 #include "ift/encoder/activation_condition.h"
 #include "ift/encoder/candidate_merge.h"
+#include "ift/encoder/init_font_size_oracle.h"
 #include "ift/encoder/invalidation_set.h"
 #include "ift/encoder/subset_definition.h"
 #include "ift/encoder/types.h"
 
 using absl::btree_map;
 using absl::flat_hash_map;
+using absl::flat_hash_set;
 using absl::Status;
 using absl::StatusOr;
 using ift::common::GlyphSet;
 using ift::common::SegmentSet;
+using ift::common::ThreadPool;
 
 ABSL_FLAG(bool, record_merged_size_reductions, false,
           "When enabled the merger will record the percent size reductions of "
@@ -194,23 +200,37 @@ Status Merger::MoveSegmentsToInitFont() {
 
   flat_hash_map<ift::common::GlyphSet, uint32_t> smallest_size_increases;
 
+  // Candidates are ranked using an estimated init font size increase which is
+  // much cheaper than compressing the full init font closure for each one.
+  // Only the moves which are actually chosen get an exact cost computed.
+  InitFontSizeOracle oracle(Context().original_face.get(),
+                            *Context().patch_size_cache_for_init_font);
+  // Candidates whose estimated delta was under the threshold but exact delta
+  // was not. Cleared whenever the init font changes.
+  flat_hash_set<GlyphSet> rejected;
+  uint64_t confirmations = 0;
+
   bool batch_mode = true;
   VLOG(0) << " batch checking inert segments for move to init font.";
   do {
     SegmentSet to_check = InitFontSegmentsToCheck(inscope);
 
-    uint32_t init_font_size =
-        TRY(Context().patch_size_cache_for_init_font->GetPatchSize(
-            Context().SegmentationInfo().InitFontGlyphs()));
+    TRYV(oracle.Reset(Context().SegmentationInfo().InitFontGlyphs()));
+    uint32_t init_font_size = oracle.CurrentSize();
 
     double total_delta = 0.0;
     double lowest_delta = *strategy_.InitFontMergeThreshold();
     std::optional<GlyphSet> glyphs_for_lowest = std::nullopt;
+    std::optional<GlyphSet> candidate_for_lowest = std::nullopt;
 
     btree_map<ActivationCondition, GlyphSet> conditions =
         InitFontConditionsToCheck(to_check, batch_mode);
 
     for (const auto& [condition, glyphs] : conditions) {
+      if (rejected.contains(glyphs)) {
+        continue;
+      }
+
       auto best_case_delta =
           TRY(CandidateMerge::ComputeBestCaseInitFontCostDelta(
               *this, init_font_size, glyphs));
@@ -219,25 +239,50 @@ Status Merger::MoveSegmentsToInitFont() {
         continue;
       }
 
-      auto [delta, all_glyphs] = TRY(CandidateMerge::ComputeInitFontCostDelta(
-          *this, init_font_size, glyphs, smallest_size_increases));
+      auto [delta, all_glyphs] =
+          TRY(CandidateMerge::EstimateInitFontCostDelta(*this, oracle, glyphs));
       if (delta >= lowest_delta) {
         continue;
       }
 
       if (batch_mode) {
         // In batch mode we accept any merges under the threshold instead of
-        // finding the lowest.
+        // finding the lowest, so each accepted merge is confirmed as we go.
+        confirmations++;
+        auto [exact_delta, exact_glyphs] =
+            TRY(CandidateMerge::ComputeInitFontCostDelta(
+                *this, init_font_size, glyphs, smallest_size_increases));
+        if (exact_delta >= lowest_delta) {
+          continue;
+        }
         if (!glyphs_for_lowest.has_value()) {
           glyphs_for_lowest = GlyphSet{};
         }
-        total_delta += delta;
-        glyphs_for_lowest->union_set(all_glyphs);
+        total_delta += exact_delta;
+        glyphs_for_lowest->union_set(exact_glyphs);
       } else {
         lowest_delta = delta;
         total_delta = delta;
         glyphs_for_lowest = all_glyphs;
+        candidate_for_lowest = glyphs;
+      }
+    }
+
+    if (candidate_for_lowest.has_value()) {
+      confirmations++;
+      auto [exact_delta, exact_glyphs] =
+          TRY(CandidateMerge::ComputeInitFontCostDelta(
+              *this, init_font_size, *candidate_for_lowest,
+              smallest_size_increases));
+      if (exact_delta >= *strategy_.InitFontMergeThreshold()) {
+        VLOG(1) << "  Estimated delta " << total_delta << " for move of "
+                << candidate_for_lowest->size() << " glyphs was not confirmed ("
+                << exact_delta << "), skipping it.";
+        rejected.insert(*candidate_for_lowest);
+        continue;
       }
+      total_delta = exact_delta;
+      glyphs_for_lowest = std::move(exact_glyphs);
     }
 
     if (!glyphs_for_lowest.has_value()) {
@@ -253,8 +298,13 @@ Status Merger::MoveSegmentsToInitFont() {
     }
 
     TRYV(ApplyInitFontMove(*glyphs_for_lowest, total_delta));
+    rejected.clear();
   } while (true);
 
+  VLOG(0) << "Estimated " << oracle.EstimateCount()
+          << " init font size increases, " << confirmations
+          << " were confirmed with an exact size.";
+
   VLOG(0) << "Initial font now has "
           << Context().SegmentationInfo().InitFontSegment().codepoints.size()
           << " codepoints and "
@@ -466,25 +516,36 @@ StatusOr<std::optional<InvalidationSet>> Merger::PatchMergeWithCosts(
     smallest_candidate_merge = CandidateMerge::BaselineCandidate(0, 0.0);
   }
 
-  for (const auto& [next, probability] : ordered_candidates) {
-    if (next == base) {
-      continue;
-    }
-
-    std::optional<segment_index_t> min = next.TriggeringSegments().min();
-    if (smallest_candidate_merge.has_value() && min.has_value() &&
-        min >= optimization_cutoff_segment_) {
-      // This condition is below the optimization cutoff, so we won't evaluate
-      // it unless we still need to select at least one candidate.
-      continue;
-    }
+  TRYV(AssessCandidates(
+      ordered_candidates.size(),
+      [&](size_t i, const std::optional<CandidateMerge>& best) {
+        const ActivationCondition& next = ordered_candidates[i].first;
+        if (next == base) {
+          return CandidateFilter::SKIP;
+        }
 
-    auto candidate = TRY(CandidateMerge::AssessPatchMerge(
-        *this, base, next, smallest_candidate_merge));
-    if (candidate.has_value()) {
-      smallest_candidate_merge = *candidate;
-    }
-  }
+        std::optional<segment_index_t> min = next.TriggeringSegments().min();
+        if (best.has_value() && min.has_value() &&
+            min >= optimization_cutoff_segment_) {
+          // This condition is below the optimization cutoff, so we won't
+          // evaluate it unless we still need to select at least one
+          // candidate.
+          return CandidateFilter::SKIP;
+        }
+        return CandidateFilter::ASSESS;
+      },
+      [&](size_t i, const std::optional<CandidateMerge>& best,
+          bool batched) -> StatusOr<CandidateAssessment> {
+        const ActivationCondition& next = ordered_candidates[i].first;
+        if (batched) {
+          return CandidateMerge::AssessPatchMergeForBatch(*this, base, next,
+                                                          best);
+        }
+        return CandidateAssessment{
+            .candidate =
+                TRY(CandidateMerge::AssessPatchMerge(*this, base, next, best))};
+      },
+      smallest_candidate_merge));
 
   if (!smallest_candidate_merge.has_value() ||
       smallest_candidate_merge->SegmentsToMerge() == SegmentSet{0}) {
@@ -541,59 +602,61 @@ Status Merger::CollectExclusiveCandidateMerges(
                                 .at(base_segment_index)
                                 .Probability();
 
-  double inert_threshold = -1.0;
-  if (smallest_candidate_merge.has_value()) {
-    inert_threshold = BestCaseInertProbabilityThreshold(
-        base_size, base_probability, smallest_candidate_merge->CostDelta());
-  }
-
+  std::vector<segment_index_t> candidates;
   for (auto it = candidate_segments_.lower_bound(base_segment_index);
        it != candidate_segments_.end(); it++) {
-    if (*it == base_segment_index) {
-      continue;
-    }
-
-    segment_index_t segment_index = *it;
-
-    if (segment_index >= optimization_cutoff_segment_ &&
-        smallest_candidate_merge.has_value()) {
-      // We are at the optimization cutoff, so we won't evaluate any further
-      // candidates beyond what is need to select at least one. Since a
-      // candidate already exists, we can stop here.
-      return absl::OkStatus();
-    }
-
-    if (context_->InertSegments().contains(segment_index) &&
-        context_->SegmentationInfo()
-                .Segments()
-                .at(segment_index)
-                .Probability() <= inert_threshold) {
-      // Since we iteration is in probability order from highest to lowest, once
-      // one segment fails the threshold then we know all further ones will as
-      // well.
-      break;
+    if (*it != base_segment_index) {
+      candidates.push_back(*it);
     }
+  }
 
-    auto segment_glyphs =
-        context_->glyph_groupings.ExclusiveGlyphs(segment_index);
-    if (segment_glyphs.empty()) {
-      // This segment has no exclusive glyphs, so no need to consider it for a
-      // merge.
-      continue;
-    }
+  return AssessCandidates(
+      candidates.size(),
+      [&](size_t i, const std::optional<CandidateMerge>& best) {
+        segment_index_t segment_index = candidates[i];
+        if (segment_index >= optimization_cutoff_segment_ &&
+            best.has_value()) {
+          // We are at the optimization cutoff, so we won't evaluate any
+          // further candidates beyond what is need to select at least one.
+          // Since a candidate already exists, we can stop here.
+          return CandidateFilter::STOP;
+        }
 
-    SegmentSet triggering_segments{segment_index};
-    auto candidate_merge = TRY(CandidateMerge::AssessSegmentMerge(
-        *this, base_segment_index, triggering_segments,
-        smallest_candidate_merge));
-    if (candidate_merge.has_value()) {
-      smallest_candidate_merge = *candidate_merge;
-      inert_threshold = BestCaseInertProbabilityThreshold(
-          base_size, base_probability, smallest_candidate_merge->CostDelta());
-    }
-  }
+        double inert_threshold = -1.0;
+        if (best.has_value()) {
+          inert_threshold = BestCaseInertProbabilityThreshold(
+              base_size, base_probability, best->CostDelta());
+        }
+        if (context_->InertSegments().contains(segment_index) &&
+            context_->SegmentationInfo()
+                    .Segments()
+                    .at(segment_index)
+                    .Probability() <= inert_threshold) {
+          // Since we iteration is in probability order from highest to lowest,
+          // once one segment fails the threshold then we know all further ones
+          // will as well.
+          return CandidateFilter::STOP;
+        }
 
-  return absl::OkStatus();
+        if (context_->glyph_groupings.ExclusiveGlyphs(segment_index).empty()) {
+          // This segment has no exclusive glyphs, so no need to consider it
+          // for a merge.
+          return CandidateFilter::SKIP;
+        }
+        return CandidateFilter::ASSESS;
+      },
+      [&](size_t i, const std::optional<CandidateMerge>& best,
+          bool batched) -> StatusOr<CandidateAssessment> {
+        SegmentSet triggering_segments{candidates[i]};
+        if (batched) {
+          return CandidateMerge::AssessSegmentMergeForBatch(
+              *this, base_segment_index, triggering_segments, best);
+        }
+        return CandidateAssessment{
+            .candidate = TRY(CandidateMerge::AssessSegmentMerge(
+                *this, base_segment_index, triggering_segments, best))};
+      },
+      smallest_candidate_merge);
 }
 
 Status Merger::CollectCompositeCandidateMerges(
@@ -610,6 +673,7 @@ Status Merger::CollectCompositeCandidateMerges(
   ActivationCondition last_exclusive =
       ActivationCondition::exclusive_segment(UINT32_MAX, 0);
 
+  std::vector<SegmentSet> candidates;
   for (auto it = context_->glyph_groupings.OrderedConditions().lower_bound(
            last_exclusive);
        it != context_->glyph_groupings.OrderedConditions().end(); it++) {
@@ -640,13 +704,106 @@ Status Merger::CollectCompositeCandidateMerges(
       continue;
     }
 
-    auto candidate_merge = TRY(CandidateMerge::AssessSegmentMerge(
-        *this, base_segment_index, triggering_segments,
-        smallest_candidate_merge));
-    if (candidate_merge.has_value()) {
-      smallest_candidate_merge = *candidate_merge;
+    candidates.push_back(std::move(triggering_segments));
+  }
+
+  return AssessCandidates(
+      candidates.size(),
+      [](size_t, const std::optional<CandidateMerge>&) {
+        return CandidateFilter::ASSESS;
+      },
+      [&](size_t i, const std::optional<CandidateMerge>& best,
+          bool batched) -> StatusOr<CandidateAssessment> {
+        if (batched) {
+          return CandidateMerge::AssessSegmentMergeForBatch(
+              *this, base_segment_index, candidates[i], best);
+        }
+        return CandidateAssessment{
+            .candidate = TRY(CandidateMerge::AssessSegmentMerge(
+                *this, base_segment_index, candidates[i], best))};
+      },
+      smallest_candidate_merge);
+}
+
+Status Merger::AssessCandidates(
+    size_t count,
+    absl::FunctionRef<CandidateFilter(size_t,
+                                      const std::optional<CandidateMerge>&)>
+        filter,
+    absl::FunctionRef<StatusOr<CandidateAssessment>(
+        size_t, const std::optional<CandidateMerge>&, bool)>
+        assess,
+    std::optional<CandidateMerge>& smallest_candidate_merge) {
+  ThreadPool* pool = context_->MergeThreadPool();
+  if (pool == nullptr || !pool->IsParallel() ||
+      ShouldRecordMergedSizeReductions()) {
+    // The merged size histogram is not thread safe, so recording it forces
+    // serial assessment.
+    for (size_t i = 0; i < count; i++) {
+      CandidateFilter action = filter(i, smallest_candidate_merge);
+      if (action == CandidateFilter::STOP) {
+        break;
+      }
+      if (action == CandidateFilter::SKIP) {
+        continue;
+      }
+
+      CandidateAssessment assessment =
+          TRY(assess(i, smallest_candidate_merge, false));
+      if (assessment.Beats(smallest_candidate_merge, *context_)) {
+        smallest_candidate_merge = std::move(assessment.candidate);
+      }
+    }
+    return absl::OkStatus();
+  }
+
+  const size_t batch_size = 2 * pool->NumThreads();
+  size_t next = 0;
+  bool stopped = false;
+  while (next < count && !stopped) {
+    // Since filters only become more restrictive as the best candidate
+    // improves anything rejected here using the best candidate so far would
+    // also have been rejected by a serial assessment.
+    std::vector<size_t> batch;
+    for (; next < count && batch.size() < batch_size; next++) {
+      CandidateFilter action = filter(next, smallest_candidate_merge);
+      if (action == CandidateFilter::STOP) {
+        stopped = true;
+        break;
+      }
+      if (action == CandidateFilter::ASSESS) {
+        batch.push_back(next);
+      }
+    }
+
+    const std::optional<CandidateMerge> batch_best = smallest_candidate_merge;
+    std::vector<StatusOr<CandidateAssessment>> assessments(
+        batch.size(), absl::UnknownError("Not assessed."));
+    TRYV(pool->ParallelFor(batch.size(), [&](size_t j) {
+      assessments[j] = assess(batch[j], batch_best, true);
+      return absl::OkStatus();
+    }));
+
+    // Replay the assessments in order against the running best candidate, as
+    // a serial assessment would have done.
+    for (size_t j = 0; j < batch.size(); j++) {
+      CandidateFilter action = filter(batch[j], smallest_candidate_merge);
+      if (action == CandidateFilter::STOP) {
+        return absl::OkStatus();
+      }
+      if (action == CandidateFilter::SKIP) {
+        continue;
+      }
+
+      if (!assessments[j].ok()) {
+        return assessments[j].status();
+      }
+      if (assessments[j]->Beats(smallest_candidate_merge, *context_)) {
+        smallest_candidate_merge = std::move(assessments[j]->candidate);
+      }
     }
   }
+
   return absl::OkStatus();
 }
 
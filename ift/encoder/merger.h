@@ -2,7 +2,12 @@
 #define IFT_ENCODER_MERGER_H_
 
 #include <cstdint>
+#include <optional>
+#include <utility>
 
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "ift/common/int_set.h"
 #include "ift/encoder/activation_condition.h"
 #include "ift/encoder/candidate_merge.h"
@@ -86,6 +91,47 @@ class Merger {
 
   uint32_t NumInscopeSegments() const { return inscope_segments_.size(); }
 
+  const ift::common::SegmentSet& InscopeSegments() const {
+    return inscope_segments_;
+  }
+
+  /*
+   * Returns a copy of this merger, including its current merge progress, which
+   * operates on context instead. context must have the same segments as this
+   * merger's current context.
+   */
+  Merger WithContext(SegmentationContext& context) const {
+    Merger merger = *this;
+    merger.context_ = &context;
+    return merger;
+  }
+
+  /*
+   * The merge progress of a merger. Together with the strategy and inscope
+   * segments (which come from the configuration) this is enough to resume
+   * merging, see SegmenterCheckpoint.
+   */
+  struct Progress {
+    ift::common::SegmentSet candidate_segments;
+    ift::common::GlyphSet candidate_patch_merge_glyphs;
+    segment_index_t optimization_cutoff_segment;
+  };
+
+  Progress GetProgress() const {
+    return Progress{
+        .candidate_segments = candidate_segments_,
+        .candidate_patch_merge_glyphs = candidate_patch_merge_glyphs_,
+        .optimization_cutoff_segment = optimization_cutoff_segment_,
+    };
+  }
+
+  void RestoreProgress(Progress progress) {
+    candidate_segments_ = std::move(progress.candidate_segments);
+    candidate_patch_merge_glyphs_ =
+        std::move(progress.candidate_patch_merge_glyphs);
+    optimization_cutoff_segment_ = progress.optimization_cutoff_segment;
+  }
+
   void RecordMergedSizeReduction(double size_reduction) {
     int32_t reduction_percent = 100.0 * size_reduction;
     merged_size_reduction_histogram_[reduction_percent]++;
@@ -142,6 +188,42 @@ class Merger {
       uint32_t base_segment_index,
       std::optional<CandidateMerge>& smallest_candidate_merge);
 
+  enum class CandidateFilter {
+    // Assess the candidate.
+    ASSESS,
+    // Don't assess this candidate, but continue on to the next one.
+    SKIP,
+    // Don't assess this or any later candidates.
+    STOP,
+  };
+
+  /*
+   * Assesses candidates [0, count) in order and replaces
+   * smallest_candidate_merge with any candidate that beats it.
+   *
+   * filter(i, best) decides if candidate i is assessed given the current best
+   * candidate. It must only become more restrictive as best improves.
+   *
+   * assess(i, best, batched) assesses candidate i against best. When batched is
+   * true the assessment is run concurrently with others and must use the
+   * *ForBatch() assessment methods.
+   *
+   * If the context has a thread pool candidates are assessed in parallel
+   * batches. Each batch is assessed against the best candidate found prior to
+   * the batch and the results are then replayed in order against the running
+   * best. This selects exactly the same candidate as a serial assessment,
+   * regardless of the number of threads.
+   */
+  absl::Status AssessCandidates(
+      size_t count,
+      absl::FunctionRef<CandidateFilter(size_t,
+                                        const std::optional<CandidateMerge>&)>
+          filter,
+      absl::FunctionRef<absl::StatusOr<CandidateAssessment>(
+          size_t, const std::optional<CandidateMerge>&, bool)>
+          assess,
+      std::optional<CandidateMerge>& smallest_candidate_merge);
+
   absl::StatusOr<std::optional<InvalidationSet>> MergeSegmentWithHeuristic(
       uint32_t base_segment_index);
 
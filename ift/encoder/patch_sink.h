@@ -0,0 +1,102 @@
+#ifndef IFT_ENCODER_PATCH_SINK_H_
+#define IFT_ENCODER_PATCH_SINK_H_
+
+#include <string>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "ift/common/font_data.h"
+
+namespace ift::encoder {
+
+/*
+ * Receives the patches produced by Compiler as soon as each one is final,
+ * allowing them to be written out (or otherwise consumed) without first
+ * buffering the complete set of patches in memory.
+ */
+class PatchSink {
+ public:
+  virtual ~PatchSink() = default;
+
+  /*
+   * Called exactly once per patch. When the compiler is configured with more
+   * than one thread this is called concurrently from the worker threads, so
+   * implementations must be thread safe. The order of calls is unspecified.
+   *
+   * Returning an error aborts the compilation.
+   */
+  virtual absl::Status Accept(const std::string& url,
+                              const ift::common::FontData& patch) = 0;
+};
+
+/*
+ * A PatchSink which collects all patches into a map keyed by url.
+ */
+class InMemoryPatchSink : public PatchSink {
+ public:
+  absl::Status Accept(const std::string& url,
+                      const ift::common::FontData& patch) override {
+    absl::MutexLock lock(&mutex_);
+    patches_[url].shallow_copy(patch);
+    return absl::OkStatus();
+  }
+
+  absl::flat_hash_map<std::string, ift::common::FontData> TakePatches() {
+    absl::MutexLock lock(&mutex_);
+    return std::move(patches_);
+  }
+
+ private:
+  absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, ift::common::FontData> patches_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+/*
+ * Provides the patches of a previously compiled encoding, see
+ * Compiler::SetPreviousEncoding().
+ */
+class PatchSource {
+ public:
+  virtual ~PatchSource() = default;
+
+  /*
+   * Returns the patch at url. May be called concurrently from multiple
+   * threads, so implementations must be thread safe.
+   */
+  virtual absl::StatusOr<ift::common::FontData> Load(
+      const std::string& url) const = 0;
+};
+
+/*
+ * A PatchSource for patches held in memory, such as those of an Encoding.
+ */
+class InMemoryPatchSource : public PatchSource {
+ public:
+  explicit InMemoryPatchSource(
+      absl::flat_hash_map<std::string, ift::common::FontData> patches)
+      : patches_(std::move(patches)) {}
+
+  absl::StatusOr<ift::common::FontData> Load(
+      const std::string& url) const override {
+    auto it = patches_.find(url);
+    if (it == patches_.end()) {
+      return absl::NotFoundError(absl::StrCat("No patch at ", url));
+    }
+    ift::common::FontData patch;
+    patch.shallow_copy(it->second);
+    return patch;
+  }
+
+ private:
+  absl::flat_hash_map<std::string, ift::common::FontData> patches_;
+};
+
+}  // namespace ift::encoder
+
+#endif  // IFT_ENCODER_PATCH_SINK_H_
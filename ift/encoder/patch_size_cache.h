@@ -3,9 +3,9 @@
 
 #include <cstdint>
 
-#include "absl/container/flat_hash_map.h"
 #include "absl/log/log.h"
 #include "absl/status/statusor.h"
+#include "ift/common/fingerprint_map.h"
 #include "ift/common/font_data.h"
 #include "ift/common/int_set.h"
 #include "ift/common/try.h"
@@ -37,15 +37,16 @@ class PatchSizeCacheImpl : public PatchSizeCache {
 
   absl::StatusOr<uint32_t> GetPatchSize(
       const ift::common::GlyphSet& gids) override {
-    auto it = cache_.find(gids);
-    if (it != cache_.end()) {
-      return it->second;
+    ift::common::Fingerprint key = gids.fingerprint();
+    const uint32_t* cached = cache_.find(key, gids);
+    if (cached) {
+      return *cached;
     }
 
     brotli_call_count_++;
     auto patch_data = TRY(differ_.CreatePatch(gids));
     uint32_t size = patch_data.size();
-    cache_[gids] = size;
+    cache_.insert_or_assign(key, gids, size);
     return size;
   }
 
@@ -57,7 +58,7 @@ class PatchSizeCacheImpl : public PatchSizeCache {
   ift::common::FontData font_data_;
   ift::common::CompatId id_;
   GlyphKeyedDiff differ_;
-  absl::flat_hash_map<ift::common::GlyphSet, uint32_t> cache_;
+  ift::common::FingerprintMap<ift::common::GlyphSet, uint32_t> cache_;
   uint64_t brotli_call_count_ = 0;
 };
 
@@ -0,0 +1,242 @@
+#include "ift/encoder/patch_size_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/log/log.h"
+#include "absl/strings/string_view.h"
+#include "ift/common/font_helper.h"
+#include "ift/common/int_set.h"
+#include "ift/common/try.h"
+
+using absl::flat_hash_set;
+using absl::Span;
+using absl::StatusOr;
+using absl::string_view;
+using ift::common::FontHelper;
+using ift::common::GlyphSet;
+
+namespace ift::encoder {
+
+// Sample group sizes used for fitting, larger groups are capped to the glyph
+// count of the font.
+static constexpr uint32_t kSampleSizes[] = {1, 2, 4, 8, 16, 32, 64, 128, 256};
+
+// For each sample size this many contiguous and this many scattered groups
+// are sampled.
+static constexpr uint32_t kSamplesPerSize = 3;
+
+// Every kValidationStride'th sample is held out from fitting and used to
+// measure the error of the fit.
+static constexpr uint32_t kValidationStride = 4;
+
+StatusOr<std::unique_ptr<const PatchSizeModel>> PatchSizeModel::Fit(
+    hb_face_t* face, Options options) {
+  uint32_t glyph_count = hb_face_get_glyph_count(face);
+  if (glyph_count == 0) {
+    return absl::InvalidArgumentError("Font has no glyphs.");
+  }
+
+  std::unique_ptr<PatchSizeModel> model(new PatchSizeModel(
+      TRY(ComputeGlyphBytes(face)), options.model_redundancy));
+
+  PatchSizeCacheImpl reference(face, options.brotli_quality);
+  std::vector<GlyphSet> validation;
+  std::vector<Features> features;
+  std::vector<double> sizes;
+  std::vector<GlyphSet> samples = SampleGroups(glyph_count);
+  for (uint32_t i = 0; i < samples.size(); i++) {
+    if (i % kValidationStride == kValidationStride - 1) {
+      validation.push_back(std::move(samples[i]));
+      continue;
+    }
+    features.push_back(model->ComputeFeatures(samples[i]));
+    sizes.push_back(TRY(reference.GetPatchSize(samples[i])));
+  }
+
+  model->FitCoefficients(features, sizes);
+  model->validation_error_ =
+      TRY(model->MeanRelativeError(reference, validation));
+
+  VLOG(0) << "Fit patch size model to " << sizes.size()
+          << " samples, mean relative error on " << validation.size()
+          << " held out samples = " << model->validation_error_;
+  return model;
+}
+
+uint32_t PatchSizeModel::PredictPatchSize(const GlyphSet& gids) const {
+  Features features = ComputeFeatures(gids);
+  double size = 0.0;
+  for (size_t i = 0; i < kNumFeatures; i++) {
+    size += coefficients_[i] * features[i];
+  }
+  return (uint32_t)std::lround(std::max(size, 0.0));
+}
+
+StatusOr<double> PatchSizeModel::MeanRelativeError(
+    PatchSizeCache& reference, Span<const GlyphSet> samples) const {
+  if (samples.empty()) {
+    return 0.0;
+  }
+
+  double total_error = 0.0;
+  for (const GlyphSet& gids : samples) {
+    double actual = TRY(reference.GetPatchSize(gids));
+    double predicted = PredictPatchSize(gids);
+    if (actual > 0.0) {
+      total_error += std::abs(predicted - actual) / actual;
+    }
+  }
+  return total_error / samples.size();
+}
+
+StatusOr<std::vector<PatchSizeModel::GlyphBytes>>
+PatchSizeModel::ComputeGlyphBytes(hb_face_t* face) {
+  flat_hash_set<hb_tag_t> tags = FontHelper::GetTags(face);
+  uint32_t glyph_count = hb_face_get_glyph_count(face);
+
+  std::vector<GlyphBytes> result(glyph_count);
+  for (uint32_t gid = 0; gid < glyph_count; gid++) {
+    GlyphBytes& bytes = result[gid];
+    if (tags.contains(FontHelper::kGlyf)) {
+      string_view glyf = TRY(FontHelper::GlyfData(face, gid));
+      // A negative numberOfContours marks a composite glyph.
+      bool composite = glyf.size() >= 2 && (glyf[0] & 0x80);
+      if (composite) {
+        bytes.composite_glyf = glyf.size();
+      } else {
+        bytes.simple_glyf = glyf.size();
+      }
+    }
+
+    if (tags.contains(FontHelper::kGvar)) {
+      bytes.gvar = TRY(FontHelper::GvarData(face, gid)).size();
+    }
+
+    if (tags.contains(FontHelper::kCFF)) {
+      bytes.cff += FontHelper::CffData(face, gid).size();
+    }
+
+    if (tags.contains(FontHelper::kCFF2)) {
+      bytes.cff += FontHelper::Cff2Data(face, gid).size();
+    }
+  }
+  return result;
+}
+
+std::vector<GlyphSet> PatchSizeModel::SampleGroups(uint32_t glyph_count) {
+  // Fixed seed so that fitting is deterministic.
+  std::mt19937 random(0x1f7);
+  std::uniform_int_distribution<uint32_t> random_gid(0, glyph_count - 1);
+
+  std::vector<GlyphSet> samples;
+  for (uint32_t size : kSampleSizes) {
+    size = std::min(size, glyph_count);
+    for (uint32_t i = 0; i < kSamplesPerSize; i++) {
+      // Contiguous runs, related glyphs are typically near each other.
+      uint32_t start =
+          (uint64_t)(i + 1) * (glyph_count - size) / (kSamplesPerSize + 1);
+      GlyphSet run;
+      run.insert_range(start, start + size - 1);
+      samples.push_back(std::move(run));
+
+      // Scattered groups.
+      GlyphSet scattered;
+      while (scattered.size() < size) {
+        scattered.insert(random_gid(random));
+      }
+      samples.push_back(std::move(scattered));
+    }
+  }
+  return samples;
+}
+
+PatchSizeModel::Features PatchSizeModel::ComputeFeatures(
+    const GlyphSet& gids) const {
+  Features features = {};
+  features[0] = 1.0;
+  for (uint32_t gid : gids) {
+    if (gid >= glyph_bytes_.size()) {
+      continue;
+    }
+    const GlyphBytes& bytes = glyph_bytes_[gid];
+    features[1] += 1.0;
+    features[2] += bytes.simple_glyf;
+    features[3] += bytes.composite_glyf;
+    features[4] += bytes.gvar;
+    features[5] += bytes.cff;
+  }
+
+  if (model_redundancy_ && features[1] > 1.0) {
+    double total_bytes = features[2] + features[3] + features[4] + features[5];
+    features[6] = total_bytes * std::log2(features[1]);
+  }
+  return features;
+}
+
+void PatchSizeModel::FitCoefficients(Span<const Features> features,
+                                     Span<const double> sizes) {
+  // Solves the ridge regularized normal equations (X^T X + lambda I) w = X^T y.
+  // Columns are first normalized to unit length so that lambda affects all
+  // features equally, and so that unused (all zero) features get a zero
+  // coefficient.
+  constexpr double kLambda = 1e-6;
+
+  Features scale = {};
+  for (const Features& x : features) {
+    for (size_t j = 0; j < kNumFeatures; j++) {
+      scale[j] += x[j] * x[j];
+    }
+  }
+  for (double& s : scale) {
+    s = s > 0.0 ? std::sqrt(s) : 1.0;
+  }
+
+  // Augmented matrix [X^T X + lambda I | X^T y].
+  std::array<std::array<double, kNumFeatures + 1>, kNumFeatures> m = {};
+  for (size_t k = 0; k < features.size(); k++) {
+    for (size_t i = 0; i < kNumFeatures; i++) {
+      double xi = features[k][i] / scale[i];
+      for (size_t j = 0; j < kNumFeatures; j++) {
+        m[i][j] += xi * features[k][j] / scale[j];
+      }
+      m[i][kNumFeatures] += xi * sizes[k];
+    }
+  }
+  for (size_t i = 0; i < kNumFeatures; i++) {
+    m[i][i] += kLambda;
+  }
+
+  // Gaussian elimination with partial pivoting, the matrix is symmetric
+  // positive definite so this is well behaved.
+  for (size_t col = 0; col < kNumFeatures; col++) {
+    size_t pivot = col;
+    for (size_t row = col + 1; row < kNumFeatures; row++) {
+      if (std::abs(m[row][col]) > std::abs(m[pivot][col])) {
+        pivot = row;
+      }
+    }
+    std::swap(m[col], m[pivot]);
+    for (size_t row = col + 1; row < kNumFeatures; row++) {
+      double factor = m[row][col] / m[col][col];
+      for (size_t j = col; j <= kNumFeatures; j++) {
+        m[row][j] -= factor * m[col][j];
+      }
+    }
+  }
+
+  for (size_t i = kNumFeatures; i-- > 0;) {
+    double value = m[i][kNumFeatures];
+    for (size_t j = i + 1; j < kNumFeatures; j++) {
+      value -= m[i][j] * coefficients_[j] * scale[j];
+    }
+    coefficients_[i] = value / m[i][i] / scale[i];
+  }
+}
+
+}  // namespace ift::encoder
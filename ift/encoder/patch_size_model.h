@@ -0,0 +1,111 @@
+#ifndef IFT_ENCODER_PATCH_SIZE_MODEL_H_
+#define IFT_ENCODER_PATCH_SIZE_MODEL_H_
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "hb.h"
+#include "ift/common/int_set.h"
+#include "ift/encoder/patch_size_cache.h"
+
+namespace ift::encoder {
+
+/*
+ * Predicts the size of a glyph keyed patch from the glyphs it contains,
+ * without compressing anything.
+ *
+ * The model is linear in a handful of per patch features: glyph count, the
+ * bytes of simple glyf, composite glyf, gvar and CFF/CFF2 data, and optionally
+ * a redundancy term (total bytes * log2(glyph count)) which captures the
+ * extra compression achieved when more glyphs share outline structure. The
+ * coefficients are fit by least squares to real brotli sizes of sample glyph
+ * groups taken from the font.
+ *
+ * Once created a model is immutable and safe to use from multiple threads.
+ */
+class PatchSizeModel {
+ public:
+  struct Options {
+    // Brotli quality of the sample patches the model is fit to.
+    uint32_t brotli_quality = 11;
+    bool model_redundancy = true;
+  };
+
+  static absl::StatusOr<std::unique_ptr<const PatchSizeModel>> Fit(
+      hb_face_t* face, Options options);
+
+  // Predicts the size of a patch containing gids, runs in O(|gids|).
+  uint32_t PredictPatchSize(const ift::common::GlyphSet& gids) const;
+
+  // The mean absolute relative error of predictions against reference for
+  // samples.
+  absl::StatusOr<double> MeanRelativeError(
+      PatchSizeCache& reference,
+      absl::Span<const ift::common::GlyphSet> samples) const;
+
+  // The mean relative error against real brotli sizes of sample groups which
+  // were held out from fitting.
+  double ValidationError() const { return validation_error_; }
+
+ private:
+  // intercept, glyph count, simple glyf, composite glyf, gvar, cff, redundancy
+  static constexpr size_t kNumFeatures = 7;
+  using Features = std::array<double, kNumFeatures>;
+
+  struct GlyphBytes {
+    uint32_t simple_glyf = 0;
+    uint32_t composite_glyf = 0;
+    uint32_t gvar = 0;
+    uint32_t cff = 0;
+  };
+
+  explicit PatchSizeModel(std::vector<GlyphBytes> glyph_bytes,
+                          bool model_redundancy)
+      : glyph_bytes_(std::move(glyph_bytes)),
+        model_redundancy_(model_redundancy) {}
+
+  static absl::StatusOr<std::vector<GlyphBytes>> ComputeGlyphBytes(
+      hb_face_t* face);
+
+  static std::vector<ift::common::GlyphSet> SampleGroups(uint32_t glyph_count);
+
+  Features ComputeFeatures(const ift::common::GlyphSet& gids) const;
+
+  // Sets coefficients_ to the least squares fit of sizes given features.
+  void FitCoefficients(absl::Span<const Features> features,
+                       absl::Span<const double> sizes);
+
+  std::vector<GlyphBytes> glyph_bytes_;
+  bool model_redundancy_;
+  Features coefficients_ = {};
+  double validation_error_ = 0.0;
+};
+
+/*
+ * A PatchSizeCache which predicts sizes with a PatchSizeModel. Predictions are
+ * cheap so nothing is cached. Safe to use from multiple threads.
+ */
+class ModelPatchSizeCache : public PatchSizeCache {
+ public:
+  explicit ModelPatchSizeCache(std::shared_ptr<const PatchSizeModel> model)
+      : model_(std::move(model)) {}
+
+  absl::StatusOr<uint32_t> GetPatchSize(
+      const ift::common::GlyphSet& gids) override {
+    return model_->PredictPatchSize(gids);
+  }
+
+  void LogBrotliCallCount() const override {}
+
+ private:
+  std::shared_ptr<const PatchSizeModel> model_;
+};
+
+}  // namespace ift::encoder
+
+#endif  // IFT_ENCODER_PATCH_SIZE_MODEL_H_
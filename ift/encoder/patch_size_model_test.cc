@@ -0,0 +1,81 @@
+#include "ift/encoder/patch_size_model.h"
+
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "ift/common/font_data.h"
+#include "ift/common/int_set.h"
+#include "ift/common/test_font_loader.h"
+#include "ift/encoder/patch_size_cache.h"
+
+using ift::common::GlyphSet;
+using ift::common::hb_face_unique_ptr;
+using ift::common::make_hb_face;
+
+namespace ift::encoder {
+
+class PatchSizeModelTest : public ::testing::Test {
+ protected:
+  PatchSizeModelTest() : roboto(make_hb_face(nullptr)) {
+    auto loader = ift::common::TestFontLoader::Default().value();
+    auto blob = loader->LoadFontData("ift/common/testdata/Roboto-Regular.ttf")
+                    .value()
+                    .blob();
+    roboto = make_hb_face(hb_face_create(blob.get(), 0));
+  }
+
+  static std::vector<GlyphSet> TestGroups() {
+    GlyphSet latin;
+    latin.insert_range(37, 94);
+    GlyphSet accented;
+    accented.insert_range(600, 700);
+    return {{44, 47, 49}, {45, 48, 50, 51, 52, 53}, latin, accented};
+  }
+
+  hb_face_unique_ptr roboto;
+};
+
+TEST_F(PatchSizeModelTest, Fit) {
+  auto model = PatchSizeModel::Fit(roboto.get(), {});
+  ASSERT_TRUE(model.ok()) << model.status();
+  EXPECT_LT((*model)->ValidationError(), 0.2);
+
+  PatchSizeCacheImpl reference(roboto.get(), 11);
+  auto error = (*model)->MeanRelativeError(reference, TestGroups());
+  ASSERT_TRUE(error.ok()) << error.status();
+  EXPECT_LT(*error, 0.2);
+}
+
+TEST_F(PatchSizeModelTest, WithoutRedundancy) {
+  auto model = PatchSizeModel::Fit(
+      roboto.get(), {.brotli_quality = 9, .model_redundancy = false});
+  ASSERT_TRUE(model.ok()) << model.status();
+
+  PatchSizeCacheImpl reference(roboto.get(), 9);
+  auto error = (*model)->MeanRelativeError(reference, TestGroups());
+  ASSERT_TRUE(error.ok()) << error.status();
+  EXPECT_LT(*error, 0.3);
+}
+
+TEST_F(PatchSizeModelTest, LargerGroupsAreLarger) {
+  auto model = PatchSizeModel::Fit(roboto.get(), {});
+  ASSERT_TRUE(model.ok()) << model.status();
+
+  GlyphSet small{44, 47, 49};
+  GlyphSet large = small;
+  large.insert_range(100, 150);
+  EXPECT_GT((*model)->PredictPatchSize(large),
+            (*model)->PredictPatchSize(small));
+}
+
+TEST_F(PatchSizeModelTest, ModelPatchSizeCache) {
+  std::shared_ptr<const PatchSizeModel> model =
+      *PatchSizeModel::Fit(roboto.get(), {});
+  ModelPatchSizeCache cache(model);
+  for (const GlyphSet& gids : TestGroups()) {
+    EXPECT_EQ(*cache.GetPatchSize(gids), model->PredictPatchSize(gids));
+  }
+}
+
+}  // namespace ift::encoder
@@ -0,0 +1,260 @@
+#include "ift/encoder/persistent_patch_size_cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "absl/functional/function_ref.h"
+#include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "ift/common/fingerprint.h"
+#include "ift/common/font_data.h"
+#include "ift/common/font_helper.h"
+#include "ift/common/sparse_bit_set.h"
+#include "ift/common/try.h"
+
+using absl::Status;
+using absl::StatusOr;
+using absl::StrCat;
+using absl::string_view;
+using ift::common::Fingerprint;
+using ift::common::FontHelper;
+using ift::common::GlyphSet;
+using ift::common::hb_blob_unique_ptr;
+using ift::common::make_hb_blob;
+using ift::common::SparseBitSet;
+
+namespace ift::encoder {
+
+static constexpr uint32_t kVersion = 1;
+// checksum + quality + patch size + glyph set length
+static constexpr size_t kEntryHeaderSize = 8 + 1 + 4 + 4;
+
+static std::string FileHeader() {
+  std::string header = "ifts";
+  FontHelper::WriteUInt32(kVersion, header);
+  return header;
+}
+
+static Status ErrnoError(absl::string_view message, const std::string& path) {
+  return absl::InternalError(
+      StrCat(message, " ", path, ": ", std::strerror(errno)));
+}
+
+// Reads the contents of path, if it exists, via mmap and passes them to
+// load. Returns the size of the existing file (0 if it does not exist).
+static StatusOr<size_t> MapExisting(
+    const std::string& path,
+    absl::FunctionRef<Status(string_view data)> load) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    if (errno == ENOENT) {
+      return 0;
+    }
+    return ErrnoError("Unable to open", path);
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return ErrnoError("Unable to stat", path);
+  }
+  size_t size = st.st_size;
+  if (size == 0) {
+    close(fd);
+    return 0;
+  }
+
+  void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    return ErrnoError("Unable to mmap", path);
+  }
+
+  Status sc = load(string_view(static_cast<const char*>(mapped), size));
+  munmap(mapped, size);
+  if (!sc.ok()) {
+    return sc;
+  }
+  return size;
+}
+
+StatusOr<std::shared_ptr<PatchSizeStore>> PatchSizeStore::Open(
+    const std::string& path) {
+  std::shared_ptr<PatchSizeStore> store(new PatchSizeStore(nullptr));
+  std::string header = FileHeader();
+
+  size_t valid_size = 0;
+  size_t file_size = TRY(MapExisting(path, [&](string_view data) -> Status {
+    if (data.size() < header.size()) {
+      // Header was never fully written, treat as empty.
+      return absl::OkStatus();
+    }
+    if (data.substr(0, header.size()) != header) {
+      return absl::InvalidArgumentError(
+          StrCat(path, " is not a patch size cache file (or is an "
+                       "incompatible version)."));
+    }
+    valid_size = header.size() + TRY(store->Load(data.substr(header.size())));
+    return absl::OkStatus();
+  }));
+
+  if (valid_size < file_size) {
+    // Drop any partially written trailing entry so appends start from a clean
+    // entry boundary.
+    if (truncate(path.c_str(), valid_size) != 0) {
+      return ErrnoError("Unable to truncate", path);
+    }
+  }
+
+  store->file_ = fopen(path.c_str(), "ab");
+  if (store->file_ == nullptr) {
+    return ErrnoError("Unable to open", path);
+  }
+
+  if (valid_size == 0) {
+    if (fwrite(header.data(), 1, header.size(), store->file_) !=
+            header.size() ||
+        fflush(store->file_) != 0) {
+      return ErrnoError("Unable to write", path);
+    }
+  }
+
+  VLOG(0) << "Loaded " << store->size() << " patch sizes from " << path;
+  return store;
+}
+
+PatchSizeStore::~PatchSizeStore() {
+  if (file_ != nullptr) {
+    fclose(file_);
+  }
+}
+
+uint64_t PatchSizeStore::FontChecksum(hb_face_t* face) {
+  hb_blob_unique_ptr blob = make_hb_blob(hb_face_reference_blob(face));
+  unsigned length = 0;
+  const char* data = hb_blob_get_data(blob.get(), &length);
+
+  // 64 bit FNV-1a, must be stable across runs so std/absl hashing can't be
+  // used.
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (unsigned i = 0; i < length; i++) {
+    hash ^= (uint8_t)data[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+Fingerprint PatchSizeStore::KeyFingerprint(uint64_t font_checksum,
+                                           uint32_t brotli_quality,
+                                           const GlyphSet& gids) {
+  Fingerprint gids_fingerprint = gids.fingerprint();
+  std::string key;
+  FontHelper::WriteUInt32(font_checksum >> 32, key);
+  FontHelper::WriteUInt32(font_checksum & 0xFFFFFFFF, key);
+  FontHelper::WriteUInt32(brotli_quality, key);
+  FontHelper::WriteUInt32(gids_fingerprint.high >> 32, key);
+  FontHelper::WriteUInt32(gids_fingerprint.high & 0xFFFFFFFF, key);
+  FontHelper::WriteUInt32(gids_fingerprint.low >> 32, key);
+  FontHelper::WriteUInt32(gids_fingerprint.low & 0xFFFFFFFF, key);
+  return Fingerprint::Of(key);
+}
+
+std::optional<uint32_t> PatchSizeStore::Get(uint64_t font_checksum,
+                                            uint32_t brotli_quality,
+                                            const GlyphSet& gids) const {
+  absl::MutexLock lock(&mutex_);
+  auto it = entries_.find(KeyFingerprint(font_checksum, brotli_quality, gids));
+  if (it == entries_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+Status PatchSizeStore::Put(uint64_t font_checksum, uint32_t brotli_quality,
+                           const GlyphSet& gids, uint32_t patch_size) {
+  if (brotli_quality > 0xFF) {
+    return absl::InvalidArgumentError("brotli quality is out of range.");
+  }
+
+  absl::MutexLock lock(&mutex_);
+  auto [it, inserted] = entries_.insert(std::pair(
+      KeyFingerprint(font_checksum, brotli_quality, gids), patch_size));
+  if (!inserted) {
+    return absl::OkStatus();
+  }
+
+  std::string encoded_gids = SparseBitSet::Encode(gids);
+  std::string entry;
+  entry.reserve(kEntryHeaderSize + encoded_gids.size());
+  FontHelper::WriteUInt32(font_checksum >> 32, entry);
+  FontHelper::WriteUInt32(font_checksum & 0xFFFFFFFF, entry);
+  FontHelper::WriteUInt8(brotli_quality, entry);
+  FontHelper::WriteUInt32(patch_size, entry);
+  FontHelper::WriteUInt32(encoded_gids.size(), entry);
+  entry += encoded_gids;
+
+  if (fwrite(entry.data(), 1, entry.size(), file_) != entry.size() ||
+      fflush(file_) != 0) {
+    return absl::InternalError(
+        StrCat("Failed to append to patch size cache: ", std::strerror(errno)));
+  }
+  return absl::OkStatus();
+}
+
+StatusOr<size_t> PatchSizeStore::Load(string_view data) {
+  size_t consumed = 0;
+  while (data.size() >= kEntryHeaderSize) {
+    uint64_t checksum_high = TRY(FontHelper::ReadUInt32(data));
+    uint64_t checksum_low = TRY(FontHelper::ReadUInt32(data.substr(4)));
+    uint8_t brotli_quality = TRY(FontHelper::ReadUInt8(data.substr(8)));
+    uint32_t patch_size = TRY(FontHelper::ReadUInt32(data.substr(9)));
+    uint32_t length = TRY(FontHelper::ReadUInt32(data.substr(13)));
+    if (data.size() - kEntryHeaderSize < length) {
+      // Truncated entry.
+      break;
+    }
+
+    GlyphSet gids;
+    string_view remaining =
+        TRY(SparseBitSet::Decode(data.substr(kEntryHeaderSize, length), gids));
+    if (!remaining.empty()) {
+      return absl::InvalidArgumentError(
+          "Malformed glyph set in patch size cache.");
+    }
+
+    // The glyph set is only decoded to validate and fingerprint it.
+    entries_[KeyFingerprint((checksum_high << 32) | checksum_low,
+                            brotli_quality, gids)] = patch_size;
+
+    consumed += kEntryHeaderSize + length;
+    data.remove_prefix(kEntryHeaderSize + length);
+  }
+  return consumed;
+}
+
+StatusOr<uint32_t> PersistentPatchSizeCache::GetPatchSize(
+    const GlyphSet& gids) {
+  auto size = store_->Get(font_checksum_, brotli_quality_, gids);
+  if (size.has_value()) {
+    store_hit_count_++;
+    return *size;
+  }
+
+  uint32_t computed = TRY(fallback_.GetPatchSize(gids));
+  TRYV(store_->Put(font_checksum_, brotli_quality_, gids, computed));
+  return computed;
+}
+
+void PersistentPatchSizeCache::LogBrotliCallCount() const {
+  fallback_.LogBrotliCallCount();
+  VLOG(0) << "Total number of patch sizes loaded from persistent cache = "
+          << store_hit_count_;
+}
+
+}  // namespace ift::encoder
@@ -0,0 +1,115 @@
+#ifndef IFT_ENCODER_PERSISTENT_PATCH_SIZE_CACHE_H_
+#define IFT_ENCODER_PERSISTENT_PATCH_SIZE_CACHE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "hb.h"
+#include "ift/common/fingerprint.h"
+#include "ift/common/int_set.h"
+#include "ift/encoder/patch_size_cache.h"
+
+namespace ift::encoder {
+
+/*
+ * An append only file of previously computed glyph keyed patch sizes. Allows
+ * the (expensive) brotli compressions done by PatchSizeCacheImpl to be reused
+ * across multiple segmenter runs on the same font.
+ *
+ * Entries are keyed by a checksum of the font, the brotli quality, and the
+ * glyph set. On open the existing file is mmap'd and indexed, only a 128 bit
+ * fingerprint of each entry's key and its size are kept in memory (the glyph
+ * sets themselves are not). New entries are appended to the end of the file
+ * as they are added.
+ *
+ * File format (integers are big endian):
+ *   header: 'i' 'f' 't' 's', version (uint32)
+ *   entry:  font checksum (uint64), brotli quality (uint8), patch size
+ *           (uint32), glyph set length (uint32), glyph set (sparse bit set)
+ *
+ * A truncated final entry (for example from an interrupted run) is discarded
+ * on open.
+ *
+ * Get() and Put() are safe to call from multiple threads concurrently.
+ */
+class PatchSizeStore {
+ public:
+  static absl::StatusOr<std::shared_ptr<PatchSizeStore>> Open(
+      const std::string& path);
+
+  ~PatchSizeStore();
+
+  PatchSizeStore(const PatchSizeStore&) = delete;
+  PatchSizeStore& operator=(const PatchSizeStore&) = delete;
+
+  // Computes the checksum used to key entries for face.
+  static uint64_t FontChecksum(hb_face_t* face);
+
+  std::optional<uint32_t> Get(uint64_t font_checksum, uint32_t brotli_quality,
+                              const ift::common::GlyphSet& gids) const;
+
+  // Records a patch size, both in memory and in the backing file.
+  absl::Status Put(uint64_t font_checksum, uint32_t brotli_quality,
+                   const ift::common::GlyphSet& gids, uint32_t patch_size);
+
+  // Number of entries currently in the store.
+  size_t size() const {
+    absl::MutexLock lock(&mutex_);
+    return entries_.size();
+  }
+
+ private:
+  // Fingerprint of an entry's key, stable across runs and platforms.
+  static ift::common::Fingerprint KeyFingerprint(
+      uint64_t font_checksum, uint32_t brotli_quality,
+      const ift::common::GlyphSet& gids);
+
+  explicit PatchSizeStore(FILE* file) : file_(file) {}
+
+  // Loads all complete entries in data, returns the number of bytes consumed.
+  absl::StatusOr<size_t> Load(absl::string_view data);
+
+  // Guards file_ and entries_ after Open() has returned.
+  mutable absl::Mutex mutex_;
+  FILE* file_;
+  absl::flat_hash_map<ift::common::Fingerprint, uint32_t> entries_;
+};
+
+/*
+ * A PatchSizeCache which first checks a persistent PatchSizeStore, falling back
+ * to computing the patch size with PatchSizeCacheImpl. Newly computed sizes are
+ * added to the store.
+ */
+class PersistentPatchSizeCache : public PatchSizeCache {
+ public:
+  PersistentPatchSizeCache(std::shared_ptr<PatchSizeStore> store,
+                           hb_face_t* original_face, uint32_t brotli_quality)
+      : store_(std::move(store)),
+        font_checksum_(PatchSizeStore::FontChecksum(original_face)),
+        brotli_quality_(brotli_quality),
+        fallback_(original_face, brotli_quality) {}
+
+  absl::StatusOr<uint32_t> GetPatchSize(
+      const ift::common::GlyphSet& gids) override;
+
+  void LogBrotliCallCount() const override;
+
+ private:
+  std::shared_ptr<PatchSizeStore> store_;
+  uint64_t font_checksum_;
+  uint32_t brotli_quality_;
+  PatchSizeCacheImpl fallback_;
+  uint64_t store_hit_count_ = 0;
+};
+
+}  // namespace ift::encoder
+
+#endif  // IFT_ENCODER_PERSISTENT_PATCH_SIZE_CACHE_H_
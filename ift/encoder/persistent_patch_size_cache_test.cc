@@ -0,0 +1,121 @@
+#include "ift/encoder/persistent_patch_size_cache.h"
+
+#include <cstdio>
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+#include "ift/common/font_data.h"
+#include "ift/common/int_set.h"
+#include "ift/common/test_font_loader.h"
+#include "ift/encoder/patch_size_cache.h"
+
+using ift::common::GlyphSet;
+using ift::common::hb_face_unique_ptr;
+using ift::common::make_hb_face;
+
+namespace ift::encoder {
+
+class PersistentPatchSizeCacheTest : public ::testing::Test {
+ protected:
+  PersistentPatchSizeCacheTest() : roboto(make_hb_face(nullptr)) {
+    auto loader = ift::common::TestFontLoader::Default().value();
+    auto blob = loader->LoadFontData("ift/common/testdata/Roboto-Regular.ttf")
+                    .value()
+                    .blob();
+    roboto = make_hb_face(hb_face_create(blob.get(), 0));
+
+    path = absl::StrCat(::testing::TempDir(), "/",
+                        ::testing::UnitTest::GetInstance()
+                            ->current_test_info()
+                            ->name(),
+                        ".patch_sizes");
+    std::remove(path.c_str());
+  }
+
+  ~PersistentPatchSizeCacheTest() override { std::remove(path.c_str()); }
+
+  void Append(const std::string& data) {
+    FILE* f = fopen(path.c_str(), "ab");
+    fwrite(data.data(), 1, data.size(), f);
+    fclose(f);
+  }
+
+  hb_face_unique_ptr roboto;
+  std::string path;
+};
+
+TEST_F(PersistentPatchSizeCacheTest, PersistsAcrossOpens) {
+  GlyphSet gids{44, 47, 49};
+  PatchSizeCacheImpl reference(roboto.get(), 11);
+  uint32_t expected = *reference.GetPatchSize(gids);
+
+  {
+    auto store = PatchSizeStore::Open(path);
+    ASSERT_TRUE(store.ok()) << store.status();
+    ASSERT_EQ((*store)->size(), 0);
+
+    PersistentPatchSizeCache cache(*store, roboto.get(), 11);
+    ASSERT_EQ(*cache.GetPatchSize(gids), expected);
+    ASSERT_EQ(*cache.GetPatchSize(gids), expected);
+    ASSERT_EQ((*store)->size(), 1);
+  }
+
+  auto store = PatchSizeStore::Open(path);
+  ASSERT_TRUE(store.ok()) << store.status();
+  ASSERT_EQ((*store)->size(), 1);
+
+  uint64_t checksum = PatchSizeStore::FontChecksum(roboto.get());
+  ASSERT_EQ((*store)->Get(checksum, 11, gids), expected);
+
+  // Other fonts, qualities, and glyph sets don't match.
+  ASSERT_EQ((*store)->Get(checksum + 1, 11, gids), std::nullopt);
+  ASSERT_EQ((*store)->Get(checksum, 9, gids), std::nullopt);
+  ASSERT_EQ((*store)->Get(checksum, 11, GlyphSet{44, 47}), std::nullopt);
+}
+
+TEST_F(PersistentPatchSizeCacheTest, UsesStoredSize) {
+  GlyphSet gids{44, 47, 49};
+  uint64_t checksum = PatchSizeStore::FontChecksum(roboto.get());
+  auto store = PatchSizeStore::Open(path);
+  ASSERT_TRUE(store.ok()) << store.status();
+  ASSERT_TRUE((*store)->Put(checksum, 11, gids, 1234).ok());
+
+  // A stored value is returned without recomputing.
+  PersistentPatchSizeCache cache(*store, roboto.get(), 11);
+  ASSERT_EQ(*cache.GetPatchSize(gids), 1234);
+}
+
+TEST_F(PersistentPatchSizeCacheTest, DiscardsTruncatedEntry) {
+  {
+    auto store = PatchSizeStore::Open(path);
+    ASSERT_TRUE(store.ok()) << store.status();
+    ASSERT_TRUE((*store)->Put(1, 11, GlyphSet{1, 2, 3}, 100).ok());
+    ASSERT_TRUE((*store)->Put(1, 11, GlyphSet{4, 5}, 200).ok());
+  }
+
+  // Simulate an interrupted write.
+  Append(std::string("\x00\x00\x00\x00\x00\x00\x00\x01\x0b", 9));
+
+  {
+    auto store = PatchSizeStore::Open(path);
+    ASSERT_TRUE(store.ok()) << store.status();
+    ASSERT_EQ((*store)->size(), 2);
+    ASSERT_TRUE((*store)->Put(2, 11, GlyphSet{6}, 300).ok());
+  }
+
+  auto store = PatchSizeStore::Open(path);
+  ASSERT_TRUE(store.ok()) << store.status();
+  ASSERT_EQ((*store)->size(), 3);
+  ASSERT_EQ((*store)->Get(1, 11, GlyphSet{1, 2, 3}), 100);
+  ASSERT_EQ((*store)->Get(1, 11, GlyphSet{4, 5}), 200);
+  ASSERT_EQ((*store)->Get(2, 11, GlyphSet{6}), 300);
+}
+
+TEST_F(PersistentPatchSizeCacheTest, RejectsOtherFiles) {
+  Append("this is not a patch size cache");
+  auto store = PatchSizeStore::Open(path);
+  ASSERT_TRUE(absl::IsInvalidArgument(store.status())) << store.status();
+}
+
+}  // namespace ift::encoder
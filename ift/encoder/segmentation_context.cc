@@ -1,7 +1,10 @@
 #include "ift/encoder/segmentation_context.h"
 
 #include <cstdint>
+#include <memory>
+#include <vector>
 
+#include "absl/flags/flag.h"
 #include "absl/status/status.h"
 #include "ift/common/int_set.h"
 #include "ift/common/try.h"
@@ -25,8 +28,57 @@ using ift::common::GlyphSet;
 using ift::common::IntSet;
 using ift::common::SegmentSet;
 
+ABSL_FLAG(std::string, patch_size_cache_path, "",
+          "If set, glyph keyed patch sizes computed during segmentation are "
+          "persisted to (and reused from) this file across runs. Entries are "
+          "keyed by font checksum, brotli quality, and glyph set.");
+
 namespace ift::encoder {
 
+std::shared_ptr<PatchSizeStore> SegmentationContext::OpenPatchSizeStore() {
+  std::string path = absl::GetFlag(FLAGS_patch_size_cache_path);
+  if (path.empty()) {
+    return nullptr;
+  }
+
+  auto store = PatchSizeStore::Open(path);
+  if (!store.ok()) {
+    LOG(WARNING) << "Persistent patch size cache is disabled: "
+                 << store.status();
+    return nullptr;
+  }
+  return *store;
+}
+
+SegmentationContext::SegmentationContext(const SegmentationContext& other)
+    : patch_size_model_(other.patch_size_model_),
+      screening_brotli_quality_(other.screening_brotli_quality_),
+      screening_margin_(other.screening_margin_),
+      screening_correction_(other.screening_correction_),
+      patch_size_store_(other.patch_size_store_),
+      thread_pool_(other.thread_pool_),
+      patch_size_cache(other.patch_size_cache),
+      patch_size_cache_for_init_font(other.patch_size_cache_for_init_font),
+      screening_patch_size_cache(other.screening_patch_size_cache),
+      glyph_closure_cache(other.glyph_closure_cache),
+      original_face(ift::common::make_hb_face(
+          hb_face_reference(other.original_face.get()))),
+      segmentation_info_(std::make_unique<RequestedSegmentationInformation>(
+          *other.segmentation_info_)),
+      dependency_closure_(std::nullopt),
+      glyph_condition_set(other.glyph_condition_set),
+      glyph_groupings(other.glyph_groupings),
+      inert_segments_(other.inert_segments_),
+      brotli_quality_(other.brotli_quality_),
+      init_font_brotli_quality_(other.init_font_brotli_quality_),
+      condition_analysis_mode_(other.condition_analysis_mode_),
+      resolver_(other.resolver_) {
+  if (other.dependency_closure_.has_value()) {
+    dependency_closure_ =
+        (*other.dependency_closure_)->Clone(segmentation_info_.get());
+  }
+}
+
 Status SegmentationContext::ValidateSegmentation(
     const GlyphSegmentation& segmentation) const {
   GlyphSet visited;
@@ -107,6 +159,25 @@ Status SegmentationContext::ReprocessChanged(InvalidationSet modified) {
 
 Status SegmentationContext::ReprocessAll() {
   if (!IsPureDepGraphAnalysisMode()) {
+    if (thread_pool_ != nullptr &&
+        (condition_analysis_mode_ == CLOSURE_ONLY ||
+         condition_analysis_mode_ == CLOSURE_AND_VALIDATE_DEP_GRAPH)) {
+      // Analysis of each segment needs two closures, which are independent
+      // across segments. Compute them all up front in parallel, the serial
+      // pass below is then all cache hits. In the other modes most segments
+      // are analyzed with the dep graph instead so this is skipped.
+      const auto& segments = SegmentationInfo().Segments();
+      std::vector<SegmentSet> all_segments;
+      all_segments.reserve(segments.size());
+      for (segment_index_t s = 0; s < segments.size(); s++) {
+        if (!segments[s].Definition().Empty()) {
+          all_segments.push_back(SegmentSet{s});
+        }
+      }
+      TRYV(glyph_closure_cache->PrecomputeAnalysis(
+          *segmentation_info_, all_segments, thread_pool_.get()));
+    }
+
     for (segment_index_t segment_index = 0;
          segment_index < SegmentationInfo().Segments().size();
          segment_index++) {
@@ -127,6 +198,46 @@ Status SegmentationContext::ReprocessAll() {
   return GroupGlyphs(SegmentationInfo().NonInitFontGlyphs(), {});
 }
 
+Status SegmentationContext::ReassignSegments(
+    const SegmentSet& segments, const std::vector<Segment>& new_segments) {
+  if (segments.empty()) {
+    return absl::OkStatus();
+  }
+
+  // Glyphs whose conditions currently involve the changed segments.
+  GlyphSet changed_gids;
+  for (segment_index_t s : segments) {
+    changed_gids.union_set(glyph_condition_set.GlyphsWithSegment(s));
+  }
+
+  for (segment_index_t s : segments) {
+    segmentation_info_->AssignMergedSegment(s, {}, new_segments.at(s));
+  }
+  if (dependency_closure_.has_value()) {
+    TRYV((*dependency_closure_)->InitFontChanged(segments));
+  }
+
+  glyph_condition_set.InvalidateGlyphInformation(segments);
+  inert_segments_.subtract(segments);
+
+  if (!IsPureDepGraphAnalysisMode()) {
+    for (segment_index_t s : segments) {
+      changed_gids.union_set(TRY(ReprocessSegment(s)));
+    }
+  } else {
+#ifndef HB_DEPEND_API
+    return absl::InternalError(
+        "DEP_GRAPH_ONLY mode requires dependency graph support.");
+#else
+    changed_gids.union_set(
+        (*dependency_closure_)->SegmentsToAffectedGlyphs(segments));
+    TransferDependencyGraphGlyphConditions(changed_gids);
+#endif
+  }
+
+  return GroupGlyphs(changed_gids, segments);
+}
+
 StatusOr<GlyphSet> SegmentationContext::ReprocessSegment(
     segment_index_t segment_index) {
   if (segmentation_info_->Segments()[segment_index].Definition().Empty()) {
@@ -338,7 +449,7 @@ SegmentationContext::InitializeSegmentationContext(
     UnmappedGlyphHandling unmapped_glyph_handling,
     ConditionAnalysisMode condition_analysis_mode, uint32_t brotli_quality,
     uint32_t init_font_brotli_quality,
-    std::shared_ptr<DataFileResolver> resolver) {
+    std::shared_ptr<DataFileResolver> resolver, uint32_t num_threads) {
   if (!hb_face_get_glyph_count(face)) {
     return absl::InvalidArgumentError("Provided font has no glyphs.");
   }
@@ -352,6 +463,7 @@ SegmentationContext::InitializeSegmentationContext(
       face, initial_segment, segments, unmapped_glyph_handling,
       condition_analysis_mode, brotli_quality, init_font_brotli_quality,
       std::move(resolver)));
+  context.SetNumThreads(num_threads);
 
   // ### Generate the initial conditions and groupings by processing all
   // segments and glyphs. ###
@@ -1,25 +1,31 @@
 #ifndef IFT_ENCODER_SEGMENTATION_CONTEXT_H_
 #define IFT_ENCODER_SEGMENTATION_CONTEXT_H_
 
+#include <cmath>
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <vector>
 
 #include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "hb.h"
 #include "ift/common/font_data.h"
 #include "ift/common/int_set.h"
+#include "ift/common/thread_pool.h"
 #include "ift/common/try.h"
 #include "ift/config/segmenter_config.pb.h"
+#include "ift/encoder/calibrated_patch_size_cache.h"
+#include "ift/encoder/concurrent_patch_size_cache.h"
 #include "ift/encoder/dependency_closure.h"
-#include "ift/encoder/estimated_patch_size_cache.h"
 #include "ift/encoder/glyph_closure_cache.h"
 #include "ift/encoder/glyph_condition_set.h"
 #include "ift/encoder/glyph_groupings.h"
 #include "ift/encoder/glyph_segmentation.h"
 #include "ift/encoder/invalidation_set.h"
 #include "ift/encoder/patch_size_cache.h"
+#include "ift/encoder/patch_size_model.h"
+#include "ift/encoder/persistent_patch_size_cache.h"
 #include "ift/encoder/requested_segmentation_information.h"
 #include "ift/encoder/segment.h"
 #include "ift/encoder/subset_definition.h"
@@ -72,30 +78,61 @@ class SegmentationContext {
     return context;
   }
 
+  SegmentationContext(SegmentationContext&& other) = default;
+  SegmentationContext& operator=(SegmentationContext&& other) = default;
+
   absl::StatusOr<SegmentationContext> WithSameSettings() const {
+    return WithSegments(SegmentationInfo().Segments());
+  }
+
+  /*
+   * Creates a new context with the same settings and init font as this one,
+   * but with segments in place of the current segments. As with
+   * WithSameSettings() glyph conditions and groupings are not computed, call
+   * ReprocessAll() on the new context to populate them.
+   */
+  absl::StatusOr<SegmentationContext> WithSegments(
+      std::vector<Segment> segments) const {
     std::unique_ptr<GlyphClosureCache> closure_cache =
         TRY(GlyphClosureCache::Create(original_face.get(), *resolver_));
 
     std::unique_ptr<RequestedSegmentationInformation> segmentation_info =
         TRY(RequestedSegmentationInformation::Create(
-            SegmentationInfo().Segments(), SegmentationInfo().InitFontSegment(),
+            std::move(segments), SegmentationInfo().InitFontSegment(),
             *closure_cache, SegmentationInfo().GetUnmappedGlyphHandling()));
 
     SegmentationContext context(
         original_face.get(), SegmentationInfo().GetUnmappedGlyphHandling(),
         condition_analysis_mode_, brotli_quality_, init_font_brotli_quality_,
         std::move(closure_cache), std::move(segmentation_info), resolver_,
-        estimated_compression_ratio_);
+        patch_size_model_);
+    context.UseThreadPool(thread_pool_);
+    context.screening_correction_ = screening_correction_;
+    context.SetScreening(screening_brotli_quality_, screening_margin_);
 
     TRYV(context.InitDependencyClosure());
     return std::move(context);
   }
 
+  /*
+   * Creates a copy of this context which can be modified independently of it.
+   * Unlike WithSegments() the glyph conditions and groupings are copied
+   * instead of recomputed.
+   *
+   * The glyph closure and patch size caches are shared with the copy rather
+   * than copied. They are only safe to use from more than one context at a time
+   * if a thread pool has been configured (see SetNumThreads()).
+   */
+  SegmentationContext Fork() const { return SegmentationContext(*this); }
+
   /*
    * Generates a segmentation context for the provided segmentation input.
    *
    * This context will contain the initial groupings without doing any merging.
    * Useful for writing tests that require a initialized segmentation context.
+   *
+   * num_threads is passed to SetNumThreads() before the initial groupings are
+   * computed, so that their closures can be computed in parallel.
    */
   static absl::StatusOr<SegmentationContext> InitializeSegmentationContext(
       hb_face_t* face, SubsetDefinition initial_segment,
@@ -103,7 +140,8 @@ class SegmentationContext {
       ift::config::UnmappedGlyphHandling unmapped_glyph_handling,
       ift::config::ConditionAnalysisMode condition_analysis_mode,
       uint32_t brotli_quality, uint32_t init_font_brotli_quality,
-      std::shared_ptr<ift::common::DataFileResolver> resolver);
+      std::shared_ptr<ift::common::DataFileResolver> resolver,
+      uint32_t num_threads = 1);
 
  private:
   SegmentationContext(
@@ -114,8 +152,10 @@ class SegmentationContext {
       std::unique_ptr<GlyphClosureCache> closure_cache,
       std::unique_ptr<RequestedSegmentationInformation> segmentation_info,
       std::shared_ptr<ift::common::DataFileResolver> resolver,
-      std::optional<double> estimated_compression_ratio = std::nullopt)
-      : estimated_compression_ratio_(estimated_compression_ratio),
+      std::shared_ptr<const PatchSizeModel> patch_size_model = nullptr)
+      : patch_size_model_(std::move(patch_size_model)),
+        patch_size_store_(OpenPatchSizeStore()),
+        thread_pool_(nullptr),
         patch_size_cache(NewPatchSizeCache(face, brotli_quality)),
         patch_size_cache_for_init_font(
             NewPatchSizeCache(face, init_font_brotli_quality)),
@@ -132,6 +172,9 @@ class SegmentationContext {
         condition_analysis_mode_(condition_analysis_mode),
         resolver_(std::move(resolver)) {}
 
+  // Used by Fork().
+  SegmentationContext(const SegmentationContext& other);
+
   absl::Status InitDependencyClosure() {
     if (UsingDepGraph()) {
       dependency_closure_ = TRY(DependencyClosure::Create(
@@ -144,6 +187,47 @@ class SegmentationContext {
  public:
   unsigned BrotliQuality() const { return brotli_quality_; }
 
+  /*
+   * Configures the number of threads used to assess candidate merges. When
+   * more than one thread is used the patch size caches are replaced with thread
+   * safe versions (any previously cached sizes are discarded).
+   */
+  void SetNumThreads(uint32_t num_threads) {
+    UseThreadPool(num_threads > 1
+                      ? std::make_shared<ift::common::ThreadPool>(num_threads)
+                      : nullptr);
+  }
+
+  /*
+   * Enables two tier sizing of merge candidates. Candidates are first scored
+   * using patch sizes compressed at brotli_quality, scaled to approximate
+   * sizes at BrotliQuality(). Only candidates whose screened cost delta is
+   * within margin (a fraction of the magnitude of the best delta) of the
+   * current best candidate are then scored at full quality.
+   *
+   * Screening is disabled if brotli_quality is 0 or not lower than
+   * BrotliQuality().
+   */
+  void SetScreening(uint32_t brotli_quality, double margin) {
+    screening_brotli_quality_ = brotli_quality;
+    screening_margin_ = margin;
+    screening_patch_size_cache = NewScreeningPatchSizeCache();
+  }
+
+  // Returns true if a candidate with a cost delta of screened_delta (computed
+  // with screening_patch_size_cache) should be scored at full quality, given
+  // that the current best candidate has a delta of best_delta.
+  bool PassesScreening(double screened_delta, double best_delta) const {
+    return screened_delta <
+           best_delta + screening_margin_ * std::abs(best_delta);
+  }
+
+  // The thread pool to assess candidate merges with, nullptr if candidates
+  // should be assessed serially.
+  ift::common::ThreadPool* MergeThreadPool() const {
+    return thread_pool_.get();
+  }
+
   // Convert the information in this context into a finalized GlyphSegmentation
   // representation.
   absl::StatusOr<GlyphSegmentation> ToGlyphSegmentation() const {
@@ -193,6 +277,10 @@ class SegmentationContext {
     return inert_segments_;
   }
 
+  void SetInertSegments(ift::common::SegmentSet inert_segments) {
+    inert_segments_ = std::move(inert_segments);
+  }
+
   const RequestedSegmentationInformation& SegmentationInfo() const {
     return *segmentation_info_;
   }
@@ -275,8 +363,25 @@ class SegmentationContext {
   // Regenerates glyphs conditions and groupings for all segments.
   absl::Status ReprocessAll();
 
+  // Replaces the definitions of each segment in 'segments' with the one at the
+  // same index in new_segments, then regenerates the glyph conditions and
+  // groupings affected by the change. Only the changed segments are
+  // reprocessed.
+  absl::Status ReassignSegments(const ift::common::SegmentSet& segments,
+                                const std::vector<Segment>& new_segments);
+
+  // Regenerates groupings for all segments from glyph_condition_set, which
+  // must already be fully populated (for example from a checkpoint). Unlike
+  // ReprocessAll() no closure analysis is performed.
+  absl::Status RegroupAll() {
+    return GroupGlyphs(SegmentationInfo().NonInitFontGlyphs(), {});
+  }
+
   // Performs a closure analysis on codepoints and returns the associated
   // and, or, and exclusive glyph sets.
+  //
+  // Safe to call from multiple threads concurrently, but not while the
+  // segments or init font are being modified.
   absl::Status AnalyzeSegment(const ift::common::SegmentSet& segment_ids,
                               ift::common::GlyphSet& and_gids,
                               ift::common::GlyphSet& or_gids,
@@ -321,34 +426,102 @@ class SegmentationContext {
   // too small to be worthwhile.
   absl::StatusOr<segment_index_t> ComputeSegmentCutoff() const;
 
+  void UseThreadPool(std::shared_ptr<ift::common::ThreadPool> thread_pool) {
+    if (thread_pool == thread_pool_) {
+      return;
+    }
+    thread_pool_ = std::move(thread_pool);
+    patch_size_cache = NewPatchSizeCache(original_face.get(), brotli_quality_);
+    patch_size_cache_for_init_font =
+        NewPatchSizeCache(original_face.get(), init_font_brotli_quality_);
+    screening_patch_size_cache = NewScreeningPatchSizeCache();
+  }
+
+  std::unique_ptr<PatchSizeCache> NewScreeningPatchSizeCache() {
+    if (screening_brotli_quality_ == 0 ||
+        screening_brotli_quality_ >= brotli_quality_) {
+      return nullptr;
+    }
+
+    if (!screening_correction_.has_value()) {
+      auto correction = CalibratedPatchSizeCache::ComputeCorrection(
+          original_face.get(), screening_brotli_quality_, brotli_quality_);
+      if (!correction.ok()) {
+        LOG(WARNING) << "Unable to calibrate screening patch sizes, screening "
+                        "is disabled: "
+                     << correction.status();
+        return nullptr;
+      }
+      screening_correction_ = *correction;
+      VLOG(0) << "Screening merge candidates at brotli quality "
+              << screening_brotli_quality_ << " with correction factor "
+              << *screening_correction_;
+    }
+
+    std::unique_ptr<PatchSizeCache> fast_sizes;
+    if (thread_pool_ != nullptr) {
+      fast_sizes = ConcurrentPatchSizeCache::NewBrotli(
+          original_face.get(), screening_brotli_quality_);
+    } else {
+      fast_sizes = std::unique_ptr<PatchSizeCache>(new PatchSizeCacheImpl(
+          original_face.get(), screening_brotli_quality_));
+    }
+    return CalibratedPatchSizeCache::New(std::move(fast_sizes),
+                                         *screening_correction_);
+  }
+
   // TODO XXXX make this return StatusOr<...>
   std::unique_ptr<PatchSizeCache> NewPatchSizeCache(hb_face_t* face,
                                                     uint32_t brotli_quality) {
     if (brotli_quality == 0) {
-      if (!estimated_compression_ratio_.has_value()) {
-        auto r = EstimatedPatchSizeCache::EstimateCompressionRatio(face);
-        if (r.ok()) {
-          estimated_compression_ratio_ = *r;
+      if (patch_size_model_ == nullptr) {
+        auto model = PatchSizeModel::Fit(face, {});
+        if (model.ok()) {
+          patch_size_model_ = std::move(*model);
+        } else {
+          LOG(WARNING) << "Unable to fit patch size model, falling back to "
+                          "brotli: "
+                       << model.status();
         }
       }
 
-      if (estimated_compression_ratio_.has_value()) {
-        return EstimatedPatchSizeCache::New(face,
-                                            *estimated_compression_ratio_);
+      if (patch_size_model_ != nullptr) {
+        // The model is immutable, so this is safe to share between threads.
+        return std::make_unique<ModelPatchSizeCache>(patch_size_model_);
       }
     }
+    if (thread_pool_ != nullptr) {
+      return ConcurrentPatchSizeCache::NewBrotli(face, brotli_quality,
+                                                 patch_size_store_);
+    }
+    if (patch_size_store_ != nullptr) {
+      return std::unique_ptr<PatchSizeCache>(new PersistentPatchSizeCache(
+          patch_size_store_, face, brotli_quality));
+    }
     return std::unique_ptr<PatchSizeCache>(
         new PatchSizeCacheImpl(face, brotli_quality));
   }
 
+  // Opens the persistent patch size store configured by the
+  // --patch_size_cache_path flag. Returns nullptr if none is configured.
+  static std::shared_ptr<PatchSizeStore> OpenPatchSizeStore();
+
  private:
-  std::optional<double> estimated_compression_ratio_;
+  std::shared_ptr<const PatchSizeModel> patch_size_model_;
+  uint32_t screening_brotli_quality_ = 0;
+  double screening_margin_ = 0.0;
+  std::optional<double> screening_correction_;
+  std::shared_ptr<PatchSizeStore> patch_size_store_;
+  std::shared_ptr<ift::common::ThreadPool> thread_pool_;
 
  public:
-  // Caches and logging
-  std::unique_ptr<PatchSizeCache> patch_size_cache;
-  std::unique_ptr<PatchSizeCache> patch_size_cache_for_init_font;
-  std::unique_ptr<GlyphClosureCache> glyph_closure_cache;
+  // Caches and logging, these are shared with forks of this context.
+  std::shared_ptr<PatchSizeCache> patch_size_cache;
+  std::shared_ptr<PatchSizeCache> patch_size_cache_for_init_font;
+  // Cheap approximate sizes used to screen merge candidates, nullptr if
+  // screening is disabled (see SetScreening()).
+  std::shared_ptr<PatchSizeCache> screening_patch_size_cache;
+  std::shared_ptr<GlyphClosureCache> glyph_closure_cache;
 
   // Init
   ift::common::hb_face_unique_ptr original_face;
@@ -0,0 +1,131 @@
+#include "ift/encoder/segmentation_context.h"
+
+#include <memory>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "gtest/gtest.h"
+#include "ift/common/bazel_data_file_resolver.h"
+#include "ift/common/font_data.h"
+#include "ift/common/int_set.h"
+#include "ift/common/test_font_loader.h"
+#include "ift/config/common.pb.h"
+#include "ift/encoder/glyph_condition_set.h"
+#include "ift/encoder/glyph_segmentation.h"
+#include "ift/encoder/segment.h"
+#include "ift/freq/probability_bound.h"
+
+using absl::StatusOr;
+using ift::common::BazelDataFileResolver;
+using ift::common::DataFileResolver;
+using ift::common::hb_face_unique_ptr;
+using ift::common::SegmentSet;
+using ift::config::CLOSURE_ONLY;
+using ift::config::ConditionAnalysisMode;
+using ift::config::DEP_GRAPH_ONLY;
+using ift::config::PATCH;
+using ift::freq::ProbabilityBound;
+
+namespace ift::encoder {
+
+class SegmentationContextTest : public ::testing::Test {
+ protected:
+  SegmentationContextTest()
+      : roboto(from_file("ift/common/testdata/Roboto-Regular.ttf")),
+        resolver(*BazelDataFileResolver::CreateForTest()) {}
+
+  static hb_face_unique_ptr from_file(const char* filename) {
+    auto loader = ift::common::TestFontLoader::Default().value();
+    return loader->LoadFace(filename).value();
+  }
+
+  StatusOr<SegmentationContext> Create(std::vector<Segment> segments,
+                                       ConditionAnalysisMode mode) {
+    return SegmentationContext::InitializeSegmentationContext(
+        roboto.get(), {}, std::move(segments), PATCH, mode, 8, 8, resolver);
+  }
+
+  // Merges segments 'f' into 'i' and 'A' into 'Aacute'.
+  std::vector<Segment> MergedSegments() const {
+    std::vector<Segment> merged = segments;
+    merged[2] = {{'f', 'i'}, ProbabilityBound::Zero()};
+    merged[1].Clear();
+    merged[5] = {{'A', 0xC1}, ProbabilityBound::Zero()};
+    merged[4].Clear();
+    return merged;
+  }
+
+  hb_face_unique_ptr roboto;
+  std::shared_ptr<DataFileResolver> resolver;
+
+  std::vector<Segment> segments = {
+      /* 0 */ {{'a'}, ProbabilityBound::Zero()},
+      /* 1 */ {{'f'}, ProbabilityBound::Zero()},
+      /* 2 */ {{'i'}, ProbabilityBound::Zero()},
+      /* 3 */ {{'q'}, ProbabilityBound::Zero()},
+      /* 4 */ {{'A'}, ProbabilityBound::Zero()},
+      /* 5 */ {{0xC1 /* Aacute */}, ProbabilityBound::Zero()},
+  };
+};
+
+TEST_F(SegmentationContextTest, Fork) {
+  auto context = Create(segments, CLOSURE_ONLY);
+  ASSERT_TRUE(context.ok()) << context.status();
+
+  SegmentationContext fork = context->Fork();
+  ASSERT_EQ(fork.glyph_condition_set, context->glyph_condition_set);
+  ASSERT_EQ(fork.glyph_groupings, context->glyph_groupings);
+  ASSERT_EQ(fork.InertSegments(), context->InertSegments());
+
+  // Caches are shared.
+  ASSERT_EQ(fork.glyph_closure_cache, context->glyph_closure_cache);
+  ASSERT_EQ(fork.patch_size_cache, context->patch_size_cache);
+
+  // Changes to the fork don't affect the original.
+  GlyphConditionSet original_conditions = context->glyph_condition_set;
+  auto original_segmentation = context->ToGlyphSegmentation();
+  ASSERT_TRUE(original_segmentation.ok()) << original_segmentation.status();
+
+  auto sc = fork.ReassignSegments({1, 2, 4, 5}, MergedSegments());
+  ASSERT_TRUE(sc.ok()) << sc;
+  ASSERT_NE(fork.glyph_condition_set, original_conditions);
+
+  ASSERT_EQ(context->glyph_condition_set, original_conditions);
+  ASSERT_EQ(context->SegmentationInfo().Segments()[1].Definition(),
+            segments[1].Definition());
+  auto segmentation = context->ToGlyphSegmentation();
+  ASSERT_TRUE(segmentation.ok()) << segmentation.status();
+  ASSERT_EQ(segmentation->ToString(), original_segmentation->ToString());
+}
+
+TEST_F(SegmentationContextTest, ReassignSegments) {
+  std::vector<ConditionAnalysisMode> modes = {CLOSURE_ONLY};
+#ifdef HB_DEPEND_API
+  modes.push_back(DEP_GRAPH_ONLY);
+#endif
+
+  for (ConditionAnalysisMode mode : modes) {
+    auto context = Create(segments, mode);
+    ASSERT_TRUE(context.ok()) << context.status();
+
+    auto sc = context->ReassignSegments({1, 2, 4, 5}, MergedSegments());
+    ASSERT_TRUE(sc.ok()) << sc;
+
+    // Should match processing the new segments from scratch.
+    auto expected = Create(MergedSegments(), mode);
+    ASSERT_TRUE(expected.ok()) << expected.status();
+
+    ASSERT_EQ(context->glyph_condition_set, expected->glyph_condition_set)
+        << mode;
+    ASSERT_EQ(context->InertSegments(), expected->InertSegments()) << mode;
+
+    auto segmentation = context->ToGlyphSegmentation();
+    ASSERT_TRUE(segmentation.ok()) << segmentation.status();
+    auto expected_segmentation = expected->ToGlyphSegmentation();
+    ASSERT_TRUE(expected_segmentation.ok()) << expected_segmentation.status();
+    ASSERT_EQ(segmentation->ToString(), expected_segmentation->ToString())
+        << mode;
+  }
+}
+
+}  // namespace ift::encoder
@@ -0,0 +1,492 @@
+#include "ift/encoder/segmenter_checkpoint.h"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/btree_map.h"
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "ift/common/axis_range.h"
+#include "ift/common/fingerprint.h"
+#include "ift/common/font_helper.h"
+#include "ift/common/int_set.h"
+#include "ift/common/sparse_bit_set.h"
+#include "ift/common/try.h"
+#include "ift/encoder/persistent_patch_size_cache.h"
+#include "ift/freq/probability_bound.h"
+#include "ift/freq/probability_calculator.h"
+
+using absl::btree_map;
+using absl::Span;
+using absl::Status;
+using absl::StatusOr;
+using absl::StrCat;
+using absl::string_view;
+using ift::common::AxisRange;
+using ift::common::Fingerprint;
+using ift::common::FontHelper;
+using ift::common::GlyphSet;
+using ift::common::IntSet;
+using ift::common::SegmentSet;
+using ift::common::SparseBitSet;
+using ift::config::ConditionAnalysisMode;
+using ift::config::UnmappedGlyphHandling;
+using ift::freq::ProbabilityBound;
+using ift::freq::ProbabilityCalculator;
+
+namespace ift::encoder {
+
+static constexpr uint32_t kVersion = 1;
+
+static constexpr uint8_t kExclusiveFlag = 1 << 0;
+static constexpr uint8_t kFallbackFlag = 1 << 1;
+
+static std::string FileHeader() {
+  std::string header = "iftk";
+  FontHelper::WriteUInt32(kVersion, header);
+  return header;
+}
+
+static void WriteUInt64(uint64_t value, std::string& out) {
+  FontHelper::WriteUInt32(value >> 32, out);
+  FontHelper::WriteUInt32(value & 0xFFFFFFFF, out);
+}
+
+static void WriteDouble(double value, std::string& out) {
+  WriteUInt64(std::bit_cast<uint64_t>(value), out);
+}
+
+static void WriteFloat(float value, std::string& out) {
+  FontHelper::WriteUInt32(std::bit_cast<uint32_t>(value), out);
+}
+
+static void WriteSet(const IntSet& set, std::string& out) {
+  std::string encoded = SparseBitSet::Encode(set);
+  FontHelper::WriteUInt32(encoded.size(), out);
+  out += encoded;
+}
+
+static void WriteSubsetDefinition(const SubsetDefinition& def,
+                                  std::string& out) {
+  WriteSet(def.codepoints, out);
+  WriteSet(def.gids, out);
+
+  FontHelper::WriteUInt32(def.feature_tags.size(), out);
+  for (hb_tag_t tag : def.feature_tags) {
+    FontHelper::WriteUInt32(tag, out);
+  }
+
+  // design_space_t is unordered, sort by tag so the encoding is stable.
+  std::vector<std::pair<hb_tag_t, AxisRange>> axes(def.design_space.begin(),
+                                                   def.design_space.end());
+  std::sort(axes.begin(), axes.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+  FontHelper::WriteUInt32(axes.size(), out);
+  for (const auto& [tag, range] : axes) {
+    FontHelper::WriteUInt32(tag, out);
+    WriteFloat(range.start(), out);
+    WriteFloat(range.end(), out);
+  }
+}
+
+// Sequentially reads the fields of a serialized checkpoint.
+class CheckpointReader {
+ public:
+  explicit CheckpointReader(string_view data) : data_(data) {}
+
+  bool Done() const { return data_.empty(); }
+
+  StatusOr<uint8_t> ReadUInt8() {
+    uint8_t value = TRY(FontHelper::ReadUInt8(data_));
+    data_.remove_prefix(1);
+    return value;
+  }
+
+  StatusOr<uint32_t> ReadUInt32() {
+    uint32_t value = TRY(FontHelper::ReadUInt32(data_));
+    data_.remove_prefix(4);
+    return value;
+  }
+
+  StatusOr<uint64_t> ReadUInt64() {
+    uint64_t high = TRY(ReadUInt32());
+    uint64_t low = TRY(ReadUInt32());
+    return (high << 32) | low;
+  }
+
+  StatusOr<double> ReadDouble() {
+    return std::bit_cast<double>(TRY(ReadUInt64()));
+  }
+
+  StatusOr<float> ReadFloat() {
+    return std::bit_cast<float>(TRY(ReadUInt32()));
+  }
+
+  // Reads a count and checks that at least min_bytes_each remain for each of
+  // the counted items, so that corrupt counts can't trigger huge allocations.
+  StatusOr<uint32_t> ReadCount(size_t min_bytes_each) {
+    uint32_t count = TRY(ReadUInt32());
+    if (min_bytes_each > 0 && count > data_.size() / min_bytes_each) {
+      return absl::InvalidArgumentError("Checkpoint count is out of range.");
+    }
+    return count;
+  }
+
+  template <typename Set>
+  StatusOr<Set> ReadSet() {
+    uint32_t length = TRY(ReadUInt32());
+    if (length > data_.size()) {
+      return absl::InvalidArgumentError("Truncated set in checkpoint.");
+    }
+    Set set;
+    string_view remaining =
+        TRY(SparseBitSet::Decode(data_.substr(0, length), set));
+    if (!remaining.empty()) {
+      return absl::InvalidArgumentError("Malformed set in checkpoint.");
+    }
+    data_.remove_prefix(length);
+    return set;
+  }
+
+  StatusOr<SubsetDefinition> ReadSubsetDefinition() {
+    SubsetDefinition def;
+    def.codepoints = TRY(ReadSet<ift::common::CodepointSet>());
+    def.gids = TRY(ReadSet<GlyphSet>());
+
+    uint32_t num_features = TRY(ReadCount(4));
+    for (uint32_t i = 0; i < num_features; i++) {
+      def.feature_tags.insert(TRY(ReadUInt32()));
+    }
+
+    uint32_t num_axes = TRY(ReadCount(12));
+    for (uint32_t i = 0; i < num_axes; i++) {
+      hb_tag_t tag = TRY(ReadUInt32());
+      float start = TRY(ReadFloat());
+      float end = TRY(ReadFloat());
+      def.design_space[tag] = TRY(AxisRange::Range(start, end));
+    }
+    return def;
+  }
+
+ private:
+  string_view data_;
+};
+
+static void WriteOptionalDouble(std::optional<double> value,
+                                std::string& out) {
+  FontHelper::WriteUInt8(value.has_value(), out);
+  WriteDouble(value.value_or(0.0), out);
+}
+
+static void WriteMergeStrategy(const MergeStrategy& strategy,
+                               std::string& out) {
+  FontHelper::WriteUInt8(strategy.UseCosts(), out);
+  FontHelper::WriteUInt8(strategy.UsePatchMerges(), out);
+  FontHelper::WriteUInt32(strategy.NetworkOverheadCost(), out);
+  FontHelper::WriteUInt32(strategy.MinimumGroupSize(), out);
+  FontHelper::WriteUInt32(strategy.PatchSizeMinBytes(), out);
+  FontHelper::WriteUInt32(strategy.PatchSizeMaxBytes(), out);
+  WriteDouble(strategy.OptimizationCutoffFraction(), out);
+  WriteDouble(strategy.BestCaseSizeReductionFraction(), out);
+  WriteOptionalDouble(strategy.InitFontMergeThreshold(), out);
+  WriteOptionalDouble(strategy.InitFontMergeProbabilityThreshold(), out);
+  FontHelper::WriteUInt32(strategy.PreClosureGroupSize(), out);
+  WriteDouble(strategy.PreClosureProbabilityThreshold(), out);
+
+  const ProbabilityCalculator* calculator = strategy.ProbabilityCalculator();
+  Fingerprint data =
+      calculator != nullptr ? calculator->DataFingerprint() : Fingerprint{};
+  FontHelper::WriteUInt8(calculator != nullptr, out);
+  WriteUInt64(data.high, out);
+  WriteUInt64(data.low, out);
+}
+
+Fingerprint SegmenterCheckpoint::InputsFingerprint(
+    hb_face_t* face, const SubsetDefinition& init_segment,
+    Span<const Segment> segments,
+    const btree_map<SegmentSet, MergeStrategy>& merge_groups,
+    UnmappedGlyphHandling unmapped_glyph_handling,
+    ConditionAnalysisMode condition_analysis_mode, uint32_t brotli_quality,
+    uint32_t init_font_brotli_quality, uint32_t screening_brotli_quality,
+    double screening_margin) {
+  std::string inputs;
+  WriteUInt64(PatchSizeStore::FontChecksum(face), inputs);
+  WriteSubsetDefinition(init_segment, inputs);
+  FontHelper::WriteUInt32(segments.size(), inputs);
+  for (const Segment& segment : segments) {
+    WriteSubsetDefinition(segment.Definition(), inputs);
+    WriteDouble(segment.ProbabilityBound().Min(), inputs);
+    WriteDouble(segment.ProbabilityBound().Max(), inputs);
+  }
+  FontHelper::WriteUInt32(merge_groups.size(), inputs);
+  for (const auto& [group, strategy] : merge_groups) {
+    WriteSet(group, inputs);
+    WriteMergeStrategy(strategy, inputs);
+  }
+  FontHelper::WriteUInt32(unmapped_glyph_handling, inputs);
+  FontHelper::WriteUInt32(condition_analysis_mode, inputs);
+  FontHelper::WriteUInt32(brotli_quality, inputs);
+  FontHelper::WriteUInt32(init_font_brotli_quality, inputs);
+  FontHelper::WriteUInt32(screening_brotli_quality, inputs);
+  WriteDouble(screening_margin, inputs);
+  return Fingerprint::Of(inputs);
+}
+
+StatusOr<SegmenterCheckpoint> SegmenterCheckpoint::Capture(
+    Fingerprint inputs, const SegmentationContext& context,
+    Span<const Merger> mergers) {
+  SegmenterCheckpoint checkpoint;
+  checkpoint.inputs_ = inputs;
+  checkpoint.init_segment_ = context.SegmentationInfo().InitFontSegment();
+  checkpoint.segments_ = context.SegmentationInfo().Segments();
+  checkpoint.inert_segments_ = context.InertSegments();
+
+  auto combined =
+      TRY(context.glyph_groupings.CombinedPatches().NonIdentityGroups());
+  checkpoint.combined_patches_.assign(combined.begin(), combined.end());
+
+  checkpoint.glyph_count_ =
+      hb_face_get_glyph_count(context.original_face.get());
+  for (glyph_id_t gid = 0; gid < checkpoint.glyph_count_; gid++) {
+    const ActivationCondition& condition =
+        context.glyph_condition_set.ConditionsFor(gid).activation();
+    if (!condition.IsAlwaysTrue()) {
+      checkpoint.conditions_.push_back(std::pair(gid, condition));
+    }
+  }
+
+  for (const Merger& merger : mergers) {
+    checkpoint.merger_progress_.push_back(merger.GetProgress());
+  }
+  return checkpoint;
+}
+
+std::string SegmenterCheckpoint::Serialize() const {
+  std::string out = FileHeader();
+  WriteUInt64(inputs_.high, out);
+  WriteUInt64(inputs_.low, out);
+
+  WriteSubsetDefinition(init_segment_, out);
+
+  FontHelper::WriteUInt32(segments_.size(), out);
+  for (const Segment& segment : segments_) {
+    WriteSubsetDefinition(segment.Definition(), out);
+    WriteDouble(segment.ProbabilityBound().Min(), out);
+    WriteDouble(segment.ProbabilityBound().Max(), out);
+  }
+
+  WriteSet(inert_segments_, out);
+
+  FontHelper::WriteUInt32(combined_patches_.size(), out);
+  for (const GlyphSet& patch : combined_patches_) {
+    WriteSet(patch, out);
+  }
+
+  FontHelper::WriteUInt32(glyph_count_, out);
+  FontHelper::WriteUInt32(conditions_.size(), out);
+  for (const auto& [gid, condition] : conditions_) {
+    FontHelper::WriteUInt32(gid, out);
+    uint8_t flags = (condition.IsExclusive() ? kExclusiveFlag : 0) |
+                    (condition.IsFallback() ? kFallbackFlag : 0);
+    FontHelper::WriteUInt8(flags, out);
+    FontHelper::WriteUInt32(condition.conditions().size(), out);
+    for (const SegmentSet& group : condition.conditions()) {
+      WriteSet(group, out);
+    }
+  }
+
+  FontHelper::WriteUInt32(merger_progress_.size(), out);
+  for (const Merger::Progress& progress : merger_progress_) {
+    WriteSet(progress.candidate_segments, out);
+    WriteSet(progress.candidate_patch_merge_glyphs, out);
+    FontHelper::WriteUInt32(progress.optimization_cutoff_segment, out);
+  }
+  return out;
+}
+
+StatusOr<SegmenterCheckpoint> SegmenterCheckpoint::Deserialize(
+    string_view data) {
+  std::string header = FileHeader();
+  if (data.substr(0, header.size()) != header) {
+    return absl::InvalidArgumentError(
+        "Not a segmenter checkpoint (or is an incompatible version).");
+  }
+  CheckpointReader reader(data.substr(header.size()));
+
+  SegmenterCheckpoint checkpoint;
+  checkpoint.inputs_.high = TRY(reader.ReadUInt64());
+  checkpoint.inputs_.low = TRY(reader.ReadUInt64());
+
+  checkpoint.init_segment_ = TRY(reader.ReadSubsetDefinition());
+
+  // Each segment is at least 2 empty sets, 2 counts, and 2 doubles.
+  uint32_t num_segments = TRY(reader.ReadCount(32));
+  checkpoint.segments_.reserve(num_segments);
+  for (uint32_t i = 0; i < num_segments; i++) {
+    SubsetDefinition def = TRY(reader.ReadSubsetDefinition());
+    double min = TRY(reader.ReadDouble());
+    double max = TRY(reader.ReadDouble());
+    checkpoint.segments_.push_back(
+        Segment(std::move(def), ProbabilityBound(min, max)));
+  }
+
+  checkpoint.inert_segments_ = TRY(reader.ReadSet<SegmentSet>());
+
+  uint32_t num_combined = TRY(reader.ReadCount(4));
+  for (uint32_t i = 0; i < num_combined; i++) {
+    checkpoint.combined_patches_.push_back(TRY(reader.ReadSet<GlyphSet>()));
+  }
+
+  checkpoint.glyph_count_ = TRY(reader.ReadUInt32());
+  uint32_t num_conditions = TRY(reader.ReadCount(9));
+  for (uint32_t i = 0; i < num_conditions; i++) {
+    glyph_id_t gid = TRY(reader.ReadUInt32());
+    if (gid >= checkpoint.glyph_count_) {
+      return absl::InvalidArgumentError(
+          StrCat("Checkpoint condition for out of range glyph ", gid));
+    }
+    uint8_t flags = TRY(reader.ReadUInt8());
+    uint32_t num_groups = TRY(reader.ReadCount(4));
+    std::vector<SegmentSet> groups;
+    for (uint32_t j = 0; j < num_groups; j++) {
+      groups.push_back(TRY(reader.ReadSet<SegmentSet>()));
+    }
+
+    ActivationCondition condition = ActivationCondition::restore(
+        std::move(groups), 0, flags & kExclusiveFlag, flags & kFallbackFlag);
+    checkpoint.conditions_.push_back(std::pair(gid, std::move(condition)));
+  }
+
+  uint32_t num_mergers = TRY(reader.ReadCount(12));
+  for (uint32_t i = 0; i < num_mergers; i++) {
+    Merger::Progress progress;
+    progress.candidate_segments = TRY(reader.ReadSet<SegmentSet>());
+    progress.candidate_patch_merge_glyphs = TRY(reader.ReadSet<GlyphSet>());
+    progress.optimization_cutoff_segment = TRY(reader.ReadUInt32());
+    checkpoint.merger_progress_.push_back(std::move(progress));
+  }
+
+  if (!reader.Done()) {
+    return absl::InvalidArgumentError("Unexpected trailing checkpoint data.");
+  }
+  return checkpoint;
+}
+
+StatusOr<SegmenterCheckpoint> SegmenterCheckpoint::Load(
+    const std::string& path) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return absl::NotFoundError(StrCat("Unable to open checkpoint ", path, ": ",
+                                      std::strerror(errno)));
+  }
+
+  std::string data;
+  char buffer[1 << 16];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    data.append(buffer, read);
+  }
+  bool failed = ferror(file);
+  fclose(file);
+  if (failed) {
+    return absl::InternalError(StrCat("Unable to read checkpoint ", path));
+  }
+
+  auto checkpoint = Deserialize(data);
+  if (!checkpoint.ok()) {
+    return absl::InvalidArgumentError(
+        StrCat(path, ": ", checkpoint.status().message()));
+  }
+  return checkpoint;
+}
+
+Status SegmenterCheckpoint::Save(const std::string& path) const {
+  std::string data = Serialize();
+
+  // Write to a temporary file and then rename over the destination, so a
+  // crash mid write doesn't lose the previous checkpoint.
+  std::string temp_path = StrCat(path, ".tmp");
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr) {
+    return absl::InternalError(StrCat("Unable to open ", temp_path, ": ",
+                                      std::strerror(errno)));
+  }
+  bool ok = fwrite(data.data(), 1, data.size(), file) == data.size() &&
+            fflush(file) == 0;
+  ok = (fclose(file) == 0) && ok;
+  if (!ok) {
+    return absl::InternalError(StrCat("Unable to write ", temp_path, ": ",
+                                      std::strerror(errno)));
+  }
+
+  if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+    return absl::InternalError(StrCat("Unable to rename ", temp_path, " to ",
+                                      path, ": ", std::strerror(errno)));
+  }
+  return absl::OkStatus();
+}
+
+Status SegmenterCheckpoint::RestoreContext(SegmentationContext& context) const {
+  if (hb_face_get_glyph_count(context.original_face.get()) != glyph_count_) {
+    return absl::FailedPreconditionError(
+        "Checkpoint glyph count does not match the font.");
+  }
+  if (context.SegmentationInfo().Segments().size() != segments_.size()) {
+    return absl::FailedPreconditionError(
+        "Context was not created from the checkpointed segments.");
+  }
+
+  for (const auto& [gid, condition] : conditions_) {
+    context.glyph_condition_set.SetCondition(gid, condition);
+  }
+  for (const GlyphSet& patch : combined_patches_) {
+    TRYV(context.glyph_groupings.CombinePatches(patch, {}));
+  }
+  TRYV(context.RegroupAll());
+  context.SetInertSegments(inert_segments_);
+  return absl::OkStatus();
+}
+
+Status SegmenterCheckpoint::RestoreMergers(Span<Merger> mergers) const {
+  if (mergers.size() != merger_progress_.size()) {
+    return absl::FailedPreconditionError(
+        StrCat("Checkpoint has ", merger_progress_.size(),
+               " merge groups, but there are ", mergers.size(), "."));
+  }
+  for (size_t i = 0; i < mergers.size(); i++) {
+    mergers[i].RestoreProgress(merger_progress_[i]);
+  }
+  return absl::OkStatus();
+}
+
+Status CheckpointWriter::MaybeSave(const SegmentationContext& context,
+                                   Span<const Merger> mergers) {
+  if (absl::Now() - last_save_ < interval_) {
+    return absl::OkStatus();
+  }
+  return Save(context, mergers);
+}
+
+Status CheckpointWriter::Save(const SegmentationContext& context,
+                              Span<const Merger> mergers) {
+  SegmenterCheckpoint checkpoint =
+      TRY(SegmenterCheckpoint::Capture(inputs_, context, mergers));
+  TRYV(checkpoint.Save(path_));
+  last_save_ = absl::Now();
+  VLOG(0) << "Saved segmenter checkpoint to " << path_;
+  return absl::OkStatus();
+}
+
+}  // namespace ift::encoder
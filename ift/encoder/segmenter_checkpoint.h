@@ -0,0 +1,149 @@
+#ifndef IFT_ENCODER_SEGMENTER_CHECKPOINT_H_
+#define IFT_ENCODER_SEGMENTER_CHECKPOINT_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/btree_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "hb.h"
+#include "ift/common/fingerprint.h"
+#include "ift/common/int_set.h"
+#include "ift/config/common.pb.h"
+#include "ift/config/segmenter_config.pb.h"
+#include "ift/encoder/activation_condition.h"
+#include "ift/encoder/merge_strategy.h"
+#include "ift/encoder/merger.h"
+#include "ift/encoder/segment.h"
+#include "ift/encoder/segmentation_context.h"
+#include "ift/encoder/subset_definition.h"
+#include "ift/encoder/types.h"
+
+namespace ift::encoder {
+
+/*
+ * A snapshot of an in progress segmenter merge, which can be saved to a file
+ * and later used to resume merging from where it left off.
+ *
+ * Holds the current segments and init font segment, inert segments, combined
+ * patches, the per glyph activation conditions, and the progress of each
+ * merger. Restoring a context from a checkpoint only needs to regroup glyphs
+ * from the saved conditions, the per segment closure analysis is not redone.
+ *
+ * File format (integers are big endian):
+ *   header:   'i' 'f' 't' 'k', version (uint32)
+ *   inputs:   fingerprint (2 x uint64) of the font and segmenter inputs
+ *   init font segment: subset definition
+ *   segments: count (uint32), then per segment a subset definition and
+ *             probability bound (min, max as IEEE doubles)
+ *   inert segments: sparse bit set
+ *   combined patches: count (uint32), then a sparse bit set per patch
+ *   conditions: glyph count (uint32), count (uint32), then per glyph with a
+ *               non trivial condition: gid (uint32), flags (uint8), group
+ *               count (uint32), a sparse bit set per group
+ *   mergers:  count (uint32), then per merger candidate segments and
+ *             candidate patch merge glyphs (sparse bit sets) and the
+ *             optimization cutoff segment (uint32)
+ *
+ * Sparse bit sets are prefixed by their length (uint32). Subset definitions
+ * are stored as codepoints and gids (sparse bit sets), feature tags (count +
+ * uint32 tags), and design space (count + uint32 tag, start and end as IEEE
+ * floats).
+ */
+class SegmenterCheckpoint {
+ public:
+  // Fingerprint of everything which must be the same between the run that
+  // saved a checkpoint and the run that resumes from it.
+  //
+  // Includes each merge group's strategy (including the probability data a
+  // cost based strategy uses), the brotli qualities and the screening
+  // settings, since merge decisions depend on all of them.
+  static ift::common::Fingerprint InputsFingerprint(
+      hb_face_t* face, const SubsetDefinition& init_segment,
+      absl::Span<const Segment> segments,
+      const absl::btree_map<ift::common::SegmentSet, MergeStrategy>&
+          merge_groups,
+      ift::config::UnmappedGlyphHandling unmapped_glyph_handling,
+      ift::config::ConditionAnalysisMode condition_analysis_mode,
+      uint32_t brotli_quality, uint32_t init_font_brotli_quality,
+      uint32_t screening_brotli_quality, double screening_margin);
+
+  // Captures the current state of context and mergers.
+  static absl::StatusOr<SegmenterCheckpoint> Capture(
+      ift::common::Fingerprint inputs, const SegmentationContext& context,
+      absl::Span<const Merger> mergers);
+
+  static absl::StatusOr<SegmenterCheckpoint> Deserialize(
+      absl::string_view data);
+
+  // Loads a checkpoint previously written by Save().
+  static absl::StatusOr<SegmenterCheckpoint> Load(const std::string& path);
+
+  std::string Serialize() const;
+
+  // Writes this checkpoint to path. The file is replaced atomically so an
+  // interrupted save leaves the previous checkpoint intact.
+  absl::Status Save(const std::string& path) const;
+
+  const ift::common::Fingerprint& Inputs() const { return inputs_; }
+  const SubsetDefinition& InitFontSegment() const { return init_segment_; }
+  const std::vector<Segment>& Segments() const { return segments_; }
+
+  // Restores glyph conditions, combined patches, groupings and inert segments
+  // into context. context must be newly created with InitFontSegment() and
+  // Segments() (and the same font and settings as the checkpointed run).
+  absl::Status RestoreContext(SegmentationContext& context) const;
+
+  // Restores the progress of each merger. mergers must be newly created for
+  // the same merge groups, in the same order, as were checkpointed.
+  absl::Status RestoreMergers(absl::Span<Merger> mergers) const;
+
+ private:
+  SegmenterCheckpoint() = default;
+
+  ift::common::Fingerprint inputs_;
+  SubsetDefinition init_segment_;
+  std::vector<Segment> segments_;
+  ift::common::SegmentSet inert_segments_;
+  std::vector<ift::common::GlyphSet> combined_patches_;
+  uint32_t glyph_count_ = 0;
+  std::vector<std::pair<glyph_id_t, ActivationCondition>> conditions_;
+  std::vector<Merger::Progress> merger_progress_;
+};
+
+/*
+ * Periodically saves checkpoints of an in progress merge to a file.
+ */
+class CheckpointWriter {
+ public:
+  CheckpointWriter(std::string path, absl::Duration interval,
+                   ift::common::Fingerprint inputs)
+      : path_(std::move(path)),
+        interval_(interval),
+        inputs_(inputs),
+        last_save_(absl::Now()) {}
+
+  // Saves a checkpoint if at least the configured interval has passed since
+  // the last one was saved.
+  absl::Status MaybeSave(const SegmentationContext& context,
+                         absl::Span<const Merger> mergers);
+
+  absl::Status Save(const SegmentationContext& context,
+                    absl::Span<const Merger> mergers);
+
+ private:
+  std::string path_;
+  absl::Duration interval_;
+  ift::common::Fingerprint inputs_;
+  absl::Time last_save_;
+};
+
+}  // namespace ift::encoder
+
+#endif  // IFT_ENCODER_SEGMENTER_CHECKPOINT_H_
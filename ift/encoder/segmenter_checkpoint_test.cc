@@ -0,0 +1,284 @@
+#include "ift/encoder/segmenter_checkpoint.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/btree_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "ift/common/bazel_data_file_resolver.h"
+#include "ift/common/int_set.h"
+#include "ift/common/test_font_loader.h"
+#include "ift/common/try.h"
+#include "ift/config/common.pb.h"
+#include "ift/encoder/activation_condition.h"
+#include "ift/encoder/merge_strategy.h"
+#include "ift/encoder/merger.h"
+#include "ift/encoder/segment.h"
+#include "ift/encoder/segmentation_context.h"
+#include "ift/freq/probability_bound.h"
+#include "ift/freq/unicode_frequencies.h"
+#include "ift/freq/unigram_probability_calculator.h"
+
+using absl::btree_map;
+using absl::StatusOr;
+using ift::common::BazelDataFileResolver;
+using ift::common::DataFileResolver;
+using ift::common::Fingerprint;
+using ift::common::hb_face_unique_ptr;
+using ift::common::make_hb_face;
+using ift::common::SegmentSet;
+using ift::config::CLOSURE_ONLY;
+using ift::config::PATCH;
+using ift::freq::ProbabilityBound;
+using ift::freq::UnicodeFrequencies;
+using ift::freq::UnigramProbabilityCalculator;
+
+namespace ift::encoder {
+
+class SegmenterCheckpointTest : public ::testing::Test {
+ protected:
+  SegmenterCheckpointTest()
+      : roboto(make_hb_face(nullptr)),
+        resolver(*BazelDataFileResolver::CreateForTest()),
+        segments({
+            {{'a', 'b', 'c'}, ProbabilityBound::Zero()},
+            {{'d', 'e', 'f'}, ProbabilityBound::Zero()},
+            {{'g', 'h', 'i'}, ProbabilityBound::Zero()},
+            {{'j', 'k', 'l'}, ProbabilityBound::Zero()},
+            {{'m', 'n', 'o'}, ProbabilityBound::Zero()},
+            {{'f', 'i'}, ProbabilityBound::Zero()},
+        }) {
+    auto loader = ift::common::TestFontLoader::Default().value();
+    roboto =
+        loader->LoadFace("ift/common/testdata/Roboto-Regular.ttf").value();
+    SegmentSet all;
+    all.insert_range(0, 5);
+    merge_groups = {{all, MergeStrategy::Heuristic(2000)}};
+    inputs = InputsFor(merge_groups);
+
+    path = ::testing::TempDir() + "/" +
+           ::testing::UnitTest::GetInstance()->current_test_info()->name() +
+           ".checkpoint";
+    std::remove(path.c_str());
+  }
+
+  ~SegmenterCheckpointTest() override { std::remove(path.c_str()); }
+
+  Fingerprint InputsFor(const btree_map<SegmentSet, MergeStrategy>& groups,
+                        uint32_t brotli_quality = 8,
+                        uint32_t screening_brotli_quality = 0,
+                        double screening_margin = 0.0) {
+    return SegmenterCheckpoint::InputsFingerprint(
+        roboto.get(), {}, segments, groups, PATCH, CLOSURE_ONLY,
+        brotli_quality, 8, screening_brotli_quality, screening_margin);
+  }
+
+  StatusOr<SegmentationContext> NewContext() {
+    return SegmentationContext::InitializeSegmentationContext(
+        roboto.get(), {}, segments, PATCH, CLOSURE_ONLY, 8, 8, resolver);
+  }
+
+  StatusOr<SegmentationContext> RestoredContext(
+      const SegmenterCheckpoint& checkpoint) {
+    SegmentationContext context = TRY(SegmentationContext::Create(
+        roboto.get(), checkpoint.InitFontSegment(), checkpoint.Segments(),
+        PATCH, CLOSURE_ONLY, 8, 8, resolver));
+    TRYV(checkpoint.RestoreContext(context));
+    return context;
+  }
+
+  static StatusOr<Merger> NewMerger(SegmentationContext& context) {
+    SegmentSet all;
+    all.insert_range(0, 5);
+    return Merger::New(context, MergeStrategy::Heuristic(2000), all, all);
+  }
+
+  // Performs up to count merges, returns the number performed.
+  static uint32_t Merge(SegmentationContext& context, Merger& merger,
+                        uint32_t count) {
+    uint32_t merges = 0;
+    while (merges < count) {
+      auto modified = merger.TryNextMerge();
+      EXPECT_TRUE(modified.ok()) << modified.status();
+      if (!modified.ok() || !modified->has_value()) {
+        break;
+      }
+      auto sc = context.ReprocessChanged(std::move(**modified));
+      EXPECT_TRUE(sc.ok()) << sc;
+      merges++;
+    }
+    return merges;
+  }
+
+  hb_face_unique_ptr roboto;
+  std::shared_ptr<DataFileResolver> resolver;
+  std::vector<Segment> segments;
+  btree_map<SegmentSet, MergeStrategy> merge_groups;
+  Fingerprint inputs;
+  std::string path;
+};
+
+TEST_F(SegmenterCheckpointTest, RoundTrip) {
+  auto context = NewContext();
+  ASSERT_TRUE(context.ok()) << context.status();
+  auto merger = NewMerger(*context);
+  ASSERT_TRUE(merger.ok()) << merger.status();
+  ASSERT_EQ(Merge(*context, *merger, 2), 2);
+
+  auto checkpoint =
+      SegmenterCheckpoint::Capture(inputs, *context, {&*merger, 1});
+  ASSERT_TRUE(checkpoint.ok()) << checkpoint.status();
+
+  auto restored = SegmenterCheckpoint::Deserialize(checkpoint->Serialize());
+  ASSERT_TRUE(restored.ok()) << restored.status();
+  ASSERT_EQ(restored->Inputs(), inputs);
+  ASSERT_EQ(restored->InitFontSegment(),
+            context->SegmentationInfo().InitFontSegment());
+  ASSERT_EQ(restored->Serialize(), checkpoint->Serialize());
+
+  auto restored_context = RestoredContext(*restored);
+  ASSERT_TRUE(restored_context.ok()) << restored_context.status();
+  ASSERT_EQ(restored_context->glyph_condition_set,
+            context->glyph_condition_set);
+  ASSERT_TRUE(restored_context->glyph_groupings == context->glyph_groupings);
+  ASSERT_EQ(restored_context->InertSegments(), context->InertSegments());
+}
+
+TEST_F(SegmenterCheckpointTest, ResumedMergingMatches) {
+  auto context = NewContext();
+  ASSERT_TRUE(context.ok()) << context.status();
+  auto merger = NewMerger(*context);
+  ASSERT_TRUE(merger.ok()) << merger.status();
+  ASSERT_EQ(Merge(*context, *merger, 1), 1);
+
+  CheckpointWriter writer(path, absl::Hours(1), inputs);
+  auto sc = writer.Save(*context, {&*merger, 1});
+  ASSERT_TRUE(sc.ok()) << sc;
+
+  ASSERT_EQ(Merge(*context, *merger, 1), 1);
+  // Not enough time has passed, so this doesn't replace the saved checkpoint.
+  sc = writer.MaybeSave(*context, {&*merger, 1});
+  ASSERT_TRUE(sc.ok()) << sc;
+
+  auto checkpoint = SegmenterCheckpoint::Load(path);
+  ASSERT_TRUE(checkpoint.ok()) << checkpoint.status();
+  auto resumed_context = RestoredContext(*checkpoint);
+  ASSERT_TRUE(resumed_context.ok()) << resumed_context.status();
+  auto resumed_merger = NewMerger(*resumed_context);
+  ASSERT_TRUE(resumed_merger.ok()) << resumed_merger.status();
+  sc = checkpoint->RestoreMergers({&*resumed_merger, 1});
+  ASSERT_TRUE(sc.ok()) << sc;
+
+  Merge(*context, *merger, UINT32_MAX);
+  Merge(*resumed_context, *resumed_merger, UINT32_MAX);
+
+  auto expected = context->ToGlyphSegmentation();
+  ASSERT_TRUE(expected.ok()) << expected.status();
+  auto actual = resumed_context->ToGlyphSegmentation();
+  ASSERT_TRUE(actual.ok()) << actual.status();
+  ASSERT_EQ(*actual, *expected);
+}
+
+TEST_F(SegmenterCheckpointTest, RejectsMismatchedMergers) {
+  auto context = NewContext();
+  ASSERT_TRUE(context.ok()) << context.status();
+  auto merger = NewMerger(*context);
+  ASSERT_TRUE(merger.ok()) << merger.status();
+
+  auto checkpoint =
+      SegmenterCheckpoint::Capture(inputs, *context, {&*merger, 1});
+  ASSERT_TRUE(checkpoint.ok()) << checkpoint.status();
+  ASSERT_TRUE(absl::IsFailedPrecondition(checkpoint->RestoreMergers({})));
+}
+
+TEST_F(SegmenterCheckpointTest, InputsFingerprint) {
+  ASSERT_EQ(InputsFor(merge_groups), inputs);
+
+  auto two_groups = merge_groups;
+  two_groups[{5}] = MergeStrategy::Heuristic(2000);
+  ASSERT_NE(InputsFor(two_groups), inputs);
+
+  SubsetDefinition init{'z'};
+  ASSERT_NE(SegmenterCheckpoint::InputsFingerprint(
+                roboto.get(), init, segments, merge_groups, PATCH,
+                CLOSURE_ONLY, 8, 8, 0, 0.0),
+            inputs);
+
+  std::vector<Segment> other = segments;
+  other.pop_back();
+  ASSERT_NE(SegmenterCheckpoint::InputsFingerprint(
+                roboto.get(), {}, other, merge_groups, PATCH, CLOSURE_ONLY, 8,
+                8, 0, 0.0),
+            inputs);
+
+  // Brotli quality and screening.
+  ASSERT_NE(InputsFor(merge_groups, 9), inputs);
+  ASSERT_NE(InputsFor(merge_groups, 8, 5), inputs);
+  ASSERT_NE(InputsFor(merge_groups, 8, 0, 0.1), inputs);
+}
+
+TEST_F(SegmenterCheckpointTest, InputsFingerprint_MergeStrategy) {
+  auto with_strategy = [&](MergeStrategy strategy) {
+    auto groups = merge_groups;
+    groups.begin()->second = std::move(strategy);
+    return InputsFor(groups);
+  };
+
+  ASSERT_EQ(with_strategy(MergeStrategy::Heuristic(2000)), inputs);
+  ASSERT_NE(with_strategy(MergeStrategy::Heuristic(3000)), inputs);
+  ASSERT_NE(with_strategy(MergeStrategy::Heuristic(2000, 4000)), inputs);
+
+  MergeStrategy cutoff = MergeStrategy::Heuristic(2000);
+  cutoff.SetOptimizationCutoffFraction(0.5);
+  ASSERT_NE(with_strategy(cutoff), inputs);
+
+  MergeStrategy init_font = MergeStrategy::Heuristic(2000);
+  init_font.SetInitFontMergeThreshold(0.0);
+  ASSERT_NE(with_strategy(init_font), inputs);
+
+  // Cost based strategies are distinguished by their probability data.
+  auto cost = [](uint64_t b_count) {
+    UnicodeFrequencies frequencies{{{'a', 'a'}, 10}, {{'b', 'b'}, b_count}};
+    return MergeStrategy::CostBased(
+        std::make_unique<UnigramProbabilityCalculator>(std::move(frequencies)),
+        75, 4);
+  };
+  Fingerprint cost_inputs = with_strategy(cost(5));
+  ASSERT_NE(cost_inputs, inputs);
+  ASSERT_EQ(with_strategy(cost(5)), cost_inputs);
+  ASSERT_NE(with_strategy(cost(6)), cost_inputs);
+}
+
+TEST_F(SegmenterCheckpointTest, RejectsCorruptData) {
+  auto context = NewContext();
+  ASSERT_TRUE(context.ok()) << context.status();
+  auto merger = NewMerger(*context);
+  ASSERT_TRUE(merger.ok()) << merger.status();
+  auto checkpoint =
+      SegmenterCheckpoint::Capture(inputs, *context, {&*merger, 1});
+  ASSERT_TRUE(checkpoint.ok()) << checkpoint.status();
+  std::string data = checkpoint->Serialize();
+
+  ASSERT_FALSE(SegmenterCheckpoint::Deserialize("").ok());
+  ASSERT_FALSE(SegmenterCheckpoint::Deserialize("iftk").ok());
+
+  // Truncated at every length.
+  for (size_t i = 0; i < data.size(); i++) {
+    ASSERT_FALSE(SegmenterCheckpoint::Deserialize(data.substr(0, i)).ok())
+        << "length " << i;
+  }
+
+  // Trailing data.
+  ASSERT_FALSE(SegmenterCheckpoint::Deserialize(data + "x").ok());
+
+  ASSERT_TRUE(absl::IsNotFound(
+      SegmenterCheckpoint::Load(path + ".missing").status()));
+}
+
+}  // namespace ift::encoder
@@ -1,10 +1,16 @@
 #include "ift/encoder/subset_definition.h"
 
+#include <algorithm>
+#include <bit>
 #include <optional>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/container/btree_set.h"
+#include "absl/container/inlined_vector.h"
 #include "ift/common/axis_range.h"
+#include "ift/common/fingerprint.h"
 #include "ift/common/font_helper.h"
 #include "ift/common/int_set.h"
 #include "ift/common/try.h"
@@ -15,6 +21,8 @@ using absl::btree_set;
 using absl::flat_hash_map;
 using absl::StatusOr;
 using ift::common::AxisRange;
+using ift::common::Fingerprint;
+using ift::common::FingerprintHasher;
 using ift::common::FontHelper;
 using ift::common::IntSet;
 using ift::proto::PatchEncoding;
@@ -157,6 +165,48 @@ void SubsetDefinition::Subtract(const SubsetDefinition& other) {
   design_space = subtract(design_space, other.design_space);
 }
 
+static void HashUInt32(uint32_t value, FingerprintHasher& hasher) {
+  // Short enough to fit in the string's inline buffer, so nothing is
+  // allocated.
+  std::string bytes;
+  FontHelper::WriteUInt32(value, bytes);
+  hasher.Update(bytes);
+}
+
+static void HashFingerprint(Fingerprint f, FingerprintHasher& hasher) {
+  HashUInt32(f.high >> 32, hasher);
+  HashUInt32(f.high & 0xFFFFFFFF, hasher);
+  HashUInt32(f.low >> 32, hasher);
+  HashUInt32(f.low & 0xFFFFFFFF, hasher);
+}
+
+Fingerprint SubsetDefinition::fingerprint() const {
+  // The sets are reduced to their (incrementally maintained) fingerprints,
+  // everything else is small and hashed in full. All values are hashed as big
+  // endian bytes so the fingerprint is the same on every platform.
+  FingerprintHasher hasher;
+  HashFingerprint(codepoints.fingerprint(), hasher);
+  HashFingerprint(gids.fingerprint(), hasher);
+
+  HashUInt32(feature_tags.size(), hasher);
+  for (hb_tag_t tag : feature_tags) {
+    HashUInt32(tag, hasher);
+  }
+
+  // design_space is unordered, sort it so equal definitions match.
+  absl::InlinedVector<std::pair<hb_tag_t, AxisRange>, 4> sorted_design_space(
+      design_space.begin(), design_space.end());
+  std::sort(sorted_design_space.begin(), sorted_design_space.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+  for (const auto& [tag, range] : sorted_design_space) {
+    HashUInt32(tag, hasher);
+    HashUInt32(std::bit_cast<uint32_t>(range.start()), hasher);
+    HashUInt32(std::bit_cast<uint32_t>(range.end()), hasher);
+  }
+
+  return hasher.Finish();
+}
+
 void SubsetDefinition::Union(const SubsetDefinition& other) {
   codepoints.union_set(other.codepoints);
   gids.union_set(other.gids);
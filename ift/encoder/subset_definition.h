@@ -10,6 +10,7 @@
 #include "absl/container/flat_hash_set.h"
 #include "hb-subset.h"
 #include "ift/common/axis_range.h"
+#include "ift/common/fingerprint.h"
 #include "ift/common/int_set.h"
 #include "ift/proto/patch_encoding.h"
 #include "ift/proto/patch_map.h"
@@ -92,6 +93,10 @@ struct SubsetDefinition {
                       s.design_space);
   }
 
+  // A 128 bit fingerprint of the full definition, suitable for use as a cache
+  // key in place of the definition (see ift::common::FingerprintMap).
+  ift::common::Fingerprint fingerprint() const;
+
   void Union(const SubsetDefinition& other);
 
   void Subtract(const SubsetDefinition& other);
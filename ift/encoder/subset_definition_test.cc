@@ -330,4 +330,40 @@ TEST_F(SubsetDefinitionTest, UnionDesignSpace) {
   TestUnion(a, b, ab);
 }
 
+TEST_F(SubsetDefinitionTest, Fingerprint) {
+  SubsetDefinition a{1, 2, 3};
+  a.gids = {7, 8};
+  a.feature_tags = {HB_TAG('s', 'm', 'c', 'p')};
+  a.design_space = {
+      {HB_TAG('w', 'g', 'h', 't'), *AxisRange::Range(300, 700)},
+      {HB_TAG('w', 'd', 't', 'h'), AxisRange::Point(100)},
+  };
+
+  SubsetDefinition b;
+  b.design_space[HB_TAG('w', 'd', 't', 'h')] = AxisRange::Point(100);
+  b.design_space[HB_TAG('w', 'g', 'h', 't')] = *AxisRange::Range(300, 700);
+  b.feature_tags.insert(HB_TAG('s', 'm', 'c', 'p'));
+  b.gids.insert_range(7, 8);
+  b.codepoints.union_set(common::CodepointSet{3, 2, 1});
+  ASSERT_EQ(a, b);
+  ASSERT_EQ(a.fingerprint(), b.fingerprint());
+
+  // Codepoints and glyphs are not interchangeable.
+  SubsetDefinition c{7, 8};
+  c.gids = {1, 2, 3};
+  c.feature_tags = a.feature_tags;
+  c.design_space = a.design_space;
+  ASSERT_NE(a.fingerprint(), c.fingerprint());
+
+  b.design_space[HB_TAG('w', 'd', 't', 'h')] = AxisRange::Point(101);
+  ASSERT_NE(a.fingerprint(), b.fingerprint());
+
+  b = a;
+  b.feature_tags.clear();
+  ASSERT_NE(a.fingerprint(), b.fingerprint());
+
+  ASSERT_EQ(SubsetDefinition().fingerprint(), SubsetDefinition().fingerprint());
+  ASSERT_NE(SubsetDefinition().fingerprint(), a.fingerprint());
+}
+
 }  // namespace ift::encoder
\ No newline at end of file
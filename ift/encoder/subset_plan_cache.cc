@@ -0,0 +1,181 @@
+#include "ift/encoder/subset_plan_cache.h"
+
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "hb.h"
+#include "ift/common/fingerprint.h"
+#include "ift/common/font_data.h"
+#include "ift/common/int_set.h"
+#include "ift/common/try.h"
+
+using absl::flat_hash_map;
+using absl::FunctionRef;
+using absl::StatusOr;
+using ift::common::Fingerprint;
+using ift::common::FontData;
+using ift::common::GlyphSet;
+
+namespace ift::encoder {
+
+bool SubsetPlanCache::DesignSpaceOnly(hb_tag_t tag) {
+  switch (tag) {
+    // Axis variations, instanced to the design space. fvar and STAT are not
+    // included since the subset plan collects the name ids they reference
+    // only when they aren't dropped, so dropping them changes the name table.
+    case HB_TAG('a', 'v', 'a', 'r'):
+    // Hinting programs and control values, the control values are instanced
+    // to the design space.
+    case HB_TAG('c', 'v', 't', ' '):
+    case HB_TAG('f', 'p', 'g', 'm'):
+    case HB_TAG('p', 'r', 'e', 'p'):
+    case HB_TAG('g', 'a', 's', 'p'):
+      return true;
+    default:
+      return false;
+  }
+}
+
+StatusOr<GlyphSet> SubsetPlanCache::RetainedGlyphs(
+    const SubsetDefinition& def, FunctionRef<StatusOr<GlyphSet>()> compute) {
+  Fingerprint fingerprint = def.fingerprint();
+  {
+    absl::MutexLock lock(&mutex_);
+    const GlyphSet* glyphs = retained_glyphs_.find(fingerprint, def);
+    if (glyphs != nullptr) {
+      hits_++;
+      return *glyphs;
+    }
+    misses_++;
+  }
+
+  // Computed without holding the lock so that plans for other definitions can
+  // be created concurrently.
+  GlyphSet glyphs = TRY(compute());
+
+  absl::MutexLock lock(&mutex_);
+  if (retained_glyphs_.find(fingerprint, def) == nullptr) {
+    retained_glyphs_.insert_or_assign(fingerprint, def, glyphs);
+  }
+  return glyphs;
+}
+
+template <typename Key>
+StatusOr<FontData> SubsetPlanCache::GetOrCompute(
+    flat_hash_map<Key, FontData>& values, Key key,
+    FunctionRef<StatusOr<FontData>()> compute, bool* inserted) {
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = values.find(key);
+    if (it != values.end()) {
+      hits_++;
+      FontData value;
+      value.shallow_copy(it->second);
+      return value;
+    }
+    misses_++;
+  }
+
+  FontData value = TRY(compute());
+
+  absl::MutexLock lock(&mutex_);
+  auto [it, was_inserted] = values.try_emplace(std::move(key));
+  if (was_inserted) {
+    it->second.shallow_copy(value);
+  }
+  if (inserted != nullptr) {
+    *inserted = was_inserted;
+  }
+  return value;
+}
+
+StatusOr<FontData> SubsetPlanCache::GlyphKeyedBaseTable(
+    hb_tag_t tag, const design_space_t& design_space,
+    FunctionRef<StatusOr<FontData>()> compute) {
+  bool inserted = false;
+  FontData table = TRY(GetOrCompute(glyph_keyed_base_tables_,
+                                    TableKey(tag, design_space), compute,
+                                    &inserted));
+  if (inserted) {
+    ReleaseInstance(design_space);
+  }
+  return table;
+}
+
+StatusOr<FontData> SubsetPlanCache::Instance(
+    const design_space_t& design_space,
+    FunctionRef<StatusOr<FontData>()> compute) {
+  bool inserted = false;
+  FontData instance =
+      TRY(GetOrCompute(instances_, design_space, compute, &inserted));
+  if (inserted) {
+    absl::MutexLock lock(&mutex_);
+    auto uses = instance_uses_.find(design_space);
+    if (uses != instance_uses_.end() && uses->second == 0) {
+      // Recomputed after all uses were released, don't hold on to it again.
+      instances_.erase(design_space);
+    }
+  }
+  return instance;
+}
+
+void SubsetPlanCache::SetInstanceUses(const design_space_t& design_space,
+                                      uint32_t uses) {
+  absl::MutexLock lock(&mutex_);
+  instance_uses_[design_space] = uses;
+  if (uses == 0) {
+    instances_.erase(design_space);
+  }
+}
+
+void SubsetPlanCache::ReleaseInstance(const design_space_t& design_space) {
+  absl::MutexLock lock(&mutex_);
+  auto uses = instance_uses_.find(design_space);
+  if (uses == instance_uses_.end() || uses->second == 0) {
+    return;
+  }
+  if (--uses->second == 0) {
+    // References held by callers keep the data alive until they're done.
+    instances_.erase(design_space);
+  }
+}
+
+bool SubsetPlanCache::GetDesignSpaceTable(hb_tag_t tag,
+                                          const design_space_t& design_space,
+                                          FontData& table) {
+  absl::MutexLock lock(&mutex_);
+  auto it = design_space_tables_.find(TableKey(tag, design_space));
+  if (it == design_space_tables_.end()) {
+    misses_++;
+    return false;
+  }
+  hits_++;
+  table.shallow_copy(it->second);
+  return true;
+}
+
+void SubsetPlanCache::InsertDesignSpaceTable(hb_tag_t tag,
+                                             const design_space_t& design_space,
+                                             const FontData& table) {
+  absl::MutexLock lock(&mutex_);
+  // Concurrent callers may race to insert the same table, serialization is
+  // deterministic so the existing one can be kept.
+  auto [it, inserted] =
+      design_space_tables_.try_emplace(TableKey(tag, design_space));
+  if (inserted) {
+    it->second.shallow_copy(table);
+  }
+}
+
+SubsetPlanCache::Stats SubsetPlanCache::GetStats() const {
+  absl::MutexLock lock(&mutex_);
+  return Stats{
+      .hits = hits_,
+      .misses = misses_,
+  };
+}
+
+}  // namespace ift::encoder
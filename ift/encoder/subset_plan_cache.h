@@ -0,0 +1,130 @@
+#ifndef IFT_ENCODER_SUBSET_PLAN_CACHE_H_
+#define IFT_ENCODER_SUBSET_PLAN_CACHE_H_
+
+#include <cstdint>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "hb.h"
+#include "ift/common/fingerprint_map.h"
+#include "ift/common/font_data.h"
+#include "ift/common/int_set.h"
+#include "ift/encoder/subset_definition.h"
+
+namespace ift::encoder {
+
+/*
+ * Caches the parts of subsetting which are shared between nodes of the
+ * compiled patch graph, so that they are computed only once per compilation:
+ *
+ * - The glyphs retained by the subset plan of a subset definition, keyed by
+ *   the definition. These are recorded for each node subset as it's cut.
+ * - Serialized tables which only depend on the design space of a node (see
+ *   DesignSpaceOnly()). Nodes with the same design space reuse these instead
+ *   of having harfbuzz re-serialize them.
+ * - The glyph keyed base tables (gvar and CFF2) generated for each design
+ *   space in mixed mode.
+ * - In mixed mode the fully expanded font instanced to each design space,
+ *   which glyph keyed patches and the glyph keyed base tables are cut from.
+ *   Instances are large, so once all of their expected uses have been
+ *   released (see SetInstanceUses()) they are dropped.
+ *
+ * A cache is only valid for a single source font and init subset. Safe for
+ * concurrent use from multiple threads. If two threads miss on the same key
+ * at once both compute the value, and the first one stored is kept.
+ */
+class SubsetPlanCache {
+ public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+  };
+
+  SubsetPlanCache() = default;
+
+  SubsetPlanCache(const SubsetPlanCache&) = delete;
+  SubsetPlanCache& operator=(const SubsetPlanCache&) = delete;
+
+  // True if the subsetted form of table tag depends only on the design space
+  // being subsetted to, and not on the codepoints, glyphs, or features.
+  //
+  // Additionally dropping the table from a subset plan must not change any
+  // other table. Tables such as name, OS/2, and post are not included: which
+  // name records are retained depends on the layout features that survive
+  // glyph closure, OS/2 records the retained unicode ranges, and post records
+  // glyph names. fvar and STAT are not included since the name records they
+  // reference are only retained when they aren't dropped.
+  static bool DesignSpaceOnly(hb_tag_t tag);
+
+  // Returns the glyphs retained by the subset plan for def, calling compute to
+  // produce them on a miss.
+  absl::StatusOr<ift::common::GlyphSet> RetainedGlyphs(
+      const SubsetDefinition& def,
+      absl::FunctionRef<absl::StatusOr<ift::common::GlyphSet>()> compute);
+
+  // Returns the glyph keyed base table tag for design_space, calling compute
+  // to produce it on a miss. Storing a newly computed table releases one use
+  // of design_space's instance.
+  absl::StatusOr<ift::common::FontData> GlyphKeyedBaseTable(
+      hb_tag_t tag, const design_space_t& design_space,
+      absl::FunctionRef<absl::StatusOr<ift::common::FontData>()> compute);
+
+  // Returns the fully expanded font instanced to design_space, calling compute
+  // to produce it on a miss.
+  absl::StatusOr<ift::common::FontData> Instance(
+      const design_space_t& design_space,
+      absl::FunctionRef<absl::StatusOr<ift::common::FontData>()> compute);
+
+  // Sets the number of times design_space's instance will still be needed.
+  // Once that many uses have been released (see ReleaseInstance()) the
+  // instance is dropped and is no longer stored by Instance(). Instances
+  // without a use count are kept for the lifetime of the cache.
+  void SetInstanceUses(const design_space_t& design_space, uint32_t uses);
+
+  // Marks one use of design_space's instance as finished.
+  void ReleaseInstance(const design_space_t& design_space);
+
+  // If a serialized copy of the design space only table tag is present for
+  // design_space sets table to it and returns true.
+  bool GetDesignSpaceTable(hb_tag_t tag, const design_space_t& design_space,
+                           ift::common::FontData& table);
+
+  void InsertDesignSpaceTable(hb_tag_t tag, const design_space_t& design_space,
+                              const ift::common::FontData& table);
+
+  Stats GetStats() const;
+
+ private:
+  using TableKey = std::pair<hb_tag_t, design_space_t>;
+  using TableMap = absl::flat_hash_map<TableKey, ift::common::FontData>;
+
+  // If inserted is non null it's set to true when the value was computed and
+  // stored by this call.
+  template <typename Key>
+  absl::StatusOr<ift::common::FontData> GetOrCompute(
+      absl::flat_hash_map<Key, ift::common::FontData>& values, Key key,
+      absl::FunctionRef<absl::StatusOr<ift::common::FontData>()> compute,
+      bool* inserted = nullptr);
+
+  mutable absl::Mutex mutex_;
+  ift::common::FingerprintMap<SubsetDefinition, ift::common::GlyphSet>
+      retained_glyphs_ ABSL_GUARDED_BY(mutex_);
+  TableMap glyph_keyed_base_tables_ ABSL_GUARDED_BY(mutex_);
+  TableMap design_space_tables_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<design_space_t, ift::common::FontData> instances_
+      ABSL_GUARDED_BY(mutex_);
+  // Remaining uses of each instance, a count of zero means the instance has
+  // been dropped.
+  absl::flat_hash_map<design_space_t, uint32_t> instance_uses_
+      ABSL_GUARDED_BY(mutex_);
+  uint64_t hits_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t misses_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+}  // namespace ift::encoder
+
+#endif  // IFT_ENCODER_SUBSET_PLAN_CACHE_H_
@@ -0,0 +1,192 @@
+#include "ift/encoder/subset_plan_cache.h"
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "gtest/gtest.h"
+#include "hb.h"
+#include "ift/common/axis_range.h"
+#include "ift/common/font_data.h"
+#include "ift/common/int_set.h"
+#include "ift/encoder/subset_definition.h"
+
+using absl::StatusOr;
+using ift::common::AxisRange;
+using ift::common::FontData;
+using ift::common::GlyphSet;
+
+namespace ift::encoder {
+
+static constexpr hb_tag_t kCvt = HB_TAG('c', 'v', 't', ' ');
+static constexpr hb_tag_t kFvar = HB_TAG('f', 'v', 'a', 'r');
+static constexpr hb_tag_t kGvar = HB_TAG('g', 'v', 'a', 'r');
+static constexpr hb_tag_t kWght = HB_TAG('w', 'g', 'h', 't');
+
+TEST(SubsetPlanCacheTest, DesignSpaceOnly) {
+  EXPECT_TRUE(SubsetPlanCache::DesignSpaceOnly(kCvt));
+  EXPECT_TRUE(SubsetPlanCache::DesignSpaceOnly(HB_TAG('p', 'r', 'e', 'p')));
+  EXPECT_FALSE(SubsetPlanCache::DesignSpaceOnly(kGvar));
+  // These reference name records, see DesignSpaceOnly().
+  EXPECT_FALSE(SubsetPlanCache::DesignSpaceOnly(kFvar));
+  EXPECT_FALSE(SubsetPlanCache::DesignSpaceOnly(HB_TAG('S', 'T', 'A', 'T')));
+  EXPECT_FALSE(SubsetPlanCache::DesignSpaceOnly(HB_TAG('n', 'a', 'm', 'e')));
+  EXPECT_FALSE(SubsetPlanCache::DesignSpaceOnly(HB_TAG('O', 'S', '/', '2')));
+  EXPECT_FALSE(SubsetPlanCache::DesignSpaceOnly(HB_TAG('p', 'o', 's', 't')));
+}
+
+TEST(SubsetPlanCacheTest, RetainedGlyphs) {
+  SubsetPlanCache cache;
+  SubsetDefinition def{0x41, 0x42};
+  int calls = 0;
+  auto compute = [&]() -> StatusOr<GlyphSet> {
+    calls++;
+    return GlyphSet{0, 5, 6};
+  };
+
+  auto glyphs = cache.RetainedGlyphs(def, compute);
+  ASSERT_TRUE(glyphs.ok()) << glyphs.status();
+  EXPECT_EQ(*glyphs, (GlyphSet{0, 5, 6}));
+
+  glyphs = cache.RetainedGlyphs(def, compute);
+  ASSERT_TRUE(glyphs.ok()) << glyphs.status();
+  EXPECT_EQ(*glyphs, (GlyphSet{0, 5, 6}));
+  EXPECT_EQ(calls, 1);
+
+  glyphs = cache.RetainedGlyphs(SubsetDefinition{0x43}, compute);
+  ASSERT_TRUE(glyphs.ok()) << glyphs.status();
+  EXPECT_EQ(calls, 2);
+
+  EXPECT_EQ(cache.GetStats().hits, 1);
+  EXPECT_EQ(cache.GetStats().misses, 2);
+}
+
+TEST(SubsetPlanCacheTest, RetainedGlyphs_ErrorsAreNotCached) {
+  SubsetPlanCache cache;
+  SubsetDefinition def{0x41};
+
+  auto glyphs = cache.RetainedGlyphs(
+      def, []() -> StatusOr<GlyphSet> { return absl::InternalError("fail"); });
+  ASSERT_FALSE(glyphs.ok());
+
+  glyphs = cache.RetainedGlyphs(
+      def, []() -> StatusOr<GlyphSet> { return GlyphSet{}; });
+  ASSERT_TRUE(glyphs.ok()) << glyphs.status();
+}
+
+TEST(SubsetPlanCacheTest, GlyphKeyedBaseTable_KeyedByDesignSpace) {
+  SubsetPlanCache cache;
+  design_space_t light = {{kWght, AxisRange::Point(300)}};
+  design_space_t bold = {{kWght, AxisRange::Point(700)}};
+
+  int calls = 0;
+  auto compute = [&](absl::string_view data) {
+    return [&calls, data]() -> StatusOr<FontData> {
+      calls++;
+      return FontData(data);
+    };
+  };
+
+  auto table = cache.GlyphKeyedBaseTable(kGvar, light, compute("light"));
+  ASSERT_TRUE(table.ok()) << table.status();
+  EXPECT_EQ(table->str(), "light");
+
+  table = cache.GlyphKeyedBaseTable(kGvar, light, compute("other"));
+  ASSERT_TRUE(table.ok()) << table.status();
+  EXPECT_EQ(table->str(), "light");
+
+  table = cache.GlyphKeyedBaseTable(kGvar, bold, compute("bold"));
+  ASSERT_TRUE(table.ok()) << table.status();
+  EXPECT_EQ(table->str(), "bold");
+
+  EXPECT_EQ(calls, 2);
+}
+
+TEST(SubsetPlanCacheTest, Instance_KeyedByDesignSpace) {
+  SubsetPlanCache cache;
+  design_space_t light = {{kWght, AxisRange::Point(300)}};
+  design_space_t bold = {{kWght, AxisRange::Point(700)}};
+
+  int calls = 0;
+  auto compute = [&](absl::string_view data) {
+    return [&calls, data]() -> StatusOr<FontData> {
+      calls++;
+      return FontData(data);
+    };
+  };
+
+  auto instance = cache.Instance(light, compute("light"));
+  ASSERT_TRUE(instance.ok()) << instance.status();
+  EXPECT_EQ(instance->str(), "light");
+
+  instance = cache.Instance(light, compute("other"));
+  ASSERT_TRUE(instance.ok()) << instance.status();
+  EXPECT_EQ(instance->str(), "light");
+
+  // Instances are stored separately from the glyph keyed base tables.
+  auto table = cache.GlyphKeyedBaseTable(kGvar, bold, compute("gvar"));
+  ASSERT_TRUE(table.ok()) << table.status();
+  instance = cache.Instance(bold, compute("bold"));
+  ASSERT_TRUE(instance.ok()) << instance.status();
+  EXPECT_EQ(instance->str(), "bold");
+
+  EXPECT_EQ(calls, 3);
+  EXPECT_EQ(cache.GetStats().hits, 1);
+}
+
+TEST(SubsetPlanCacheTest, Instance_ReleasedAfterLastUse) {
+  SubsetPlanCache cache;
+  design_space_t light = {{kWght, AxisRange::Point(300)}};
+
+  int calls = 0;
+  auto compute = [&](absl::string_view data) {
+    return [&calls, data]() -> StatusOr<FontData> {
+      calls++;
+      return FontData(data);
+    };
+  };
+
+  // Two uses: the glyph keyed base table and one explicit release.
+  cache.SetInstanceUses(light, 2);
+  auto instance = cache.Instance(light, compute("light"));
+  ASSERT_TRUE(instance.ok()) << instance.status();
+
+  auto table = cache.GlyphKeyedBaseTable(kGvar, light, compute("gvar"));
+  ASSERT_TRUE(table.ok()) << table.status();
+  // Cache hits don't count as another use.
+  table = cache.GlyphKeyedBaseTable(kGvar, light, compute("gvar"));
+  ASSERT_TRUE(table.ok()) << table.status();
+
+  instance = cache.Instance(light, compute("other"));
+  ASSERT_TRUE(instance.ok()) << instance.status();
+  EXPECT_EQ(instance->str(), "light");
+  EXPECT_EQ(calls, 2);
+
+  // After the last use the instance is dropped, and isn't kept if it's needed
+  // again.
+  cache.ReleaseInstance(light);
+  instance = cache.Instance(light, compute("again"));
+  ASSERT_TRUE(instance.ok()) << instance.status();
+  EXPECT_EQ(instance->str(), "again");
+  instance = cache.Instance(light, compute("again"));
+  ASSERT_TRUE(instance.ok()) << instance.status();
+  EXPECT_EQ(calls, 4);
+}
+
+TEST(SubsetPlanCacheTest, DesignSpaceTables) {
+  SubsetPlanCache cache;
+  design_space_t light = {{kWght, AxisRange::Point(300)}};
+  design_space_t bold = {{kWght, AxisRange::Point(700)}};
+
+  FontData table;
+  EXPECT_FALSE(cache.GetDesignSpaceTable(kCvt, light, table));
+
+  cache.InsertDesignSpaceTable(kCvt, light, FontData("light"));
+  // The first inserted table is kept.
+  cache.InsertDesignSpaceTable(kCvt, light, FontData("other"));
+
+  ASSERT_TRUE(cache.GetDesignSpaceTable(kCvt, light, table));
+  EXPECT_EQ(table.str(), "light");
+  EXPECT_FALSE(cache.GetDesignSpaceTable(kCvt, bold, table));
+}
+
+}  // namespace ift::encoder
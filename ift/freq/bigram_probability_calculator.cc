@@ -1,13 +1,21 @@
 #include "ift/freq/bigram_probability_calculator.h"
 
 #include <algorithm>
+#include <memory>
 
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "ift/common/fingerprint.h"
+#include "ift/common/fingerprint_map.h"
 #include "ift/common/int_set.h"
 #include "ift/encoder/segment.h"
 #include "ift/encoder/subset_definition.h"
 #include "ift/freq/probability_bound.h"
 
+using absl::StrCat;
 using ift::common::CodepointSet;
+using ift::common::Fingerprint;
+using ift::common::FingerprintKeyCheck;
 using ift::encoder::Segment;
 using ift::encoder::SubsetDefinition;
 
@@ -16,17 +24,34 @@ namespace ift::freq {
 BigramProbabilityCalculator::BigramProbabilityCalculator(
     UnicodeFrequencies frequencies, size_t max_cache_size)
     : frequencies_(std::move(frequencies)),
+      cache_mutex_(std::make_unique<absl::Mutex>()),
       cache_("bigram probability", max_cache_size) {}
 
 ProbabilityBound BigramProbabilityCalculator::BigramProbabilityBound(
     const CodepointSet& codepoints, double best_lower) const {
-  std::optional<ProbabilityBound>& cached_bound = cache_[codepoints];
-  if (cached_bound.has_value()) {
-    double lower = std::max(cached_bound->Min(), best_lower);
-    double upper = std::max(cached_bound->Max(), lower);
-    return ProbabilityBound(lower, upper);
+  Fingerprint key = codepoints.fingerprint();
+  std::optional<ProbabilityBound> raw_bound;
+  {
+    absl::MutexLock lock(cache_mutex_.get());
+    const CachedBound& cached = cache_[key];
+    cached.codepoints.Check(codepoints);
+    raw_bound = cached.bound;
   }
 
+  if (!raw_bound.has_value()) {
+    // Computed outside of the lock so other threads aren't blocked on it.
+    raw_bound = RawBigramProbabilityBound(codepoints);
+    absl::MutexLock lock(cache_mutex_.get());
+    cache_[key] = CachedBound{raw_bound, FingerprintKeyCheck(codepoints)};
+  }
+
+  double lower = std::max(raw_bound->Min(), best_lower);
+  double upper = std::max(raw_bound->Max(), lower);
+  return ProbabilityBound(lower, upper);
+}
+
+ProbabilityBound BigramProbabilityCalculator::RawBigramProbabilityBound(
+    const CodepointSet& codepoints) const {
   unsigned n = codepoints.size();
   std::vector<unsigned> cps;
   std::vector<double> P;
@@ -47,9 +72,7 @@ ProbabilityBound BigramProbabilityCalculator::BigramProbabilityBound(
 
   if (max_single_bound >= 1.0) {
     // Bounds can't be lower than [1, 1] stop checking.
-    ProbabilityBound bound(1.0, 1.0);
-    cached_bound = bound;
-    return bound;
+    return ProbabilityBound(1.0, 1.0);
   }
 
   double bigram_total = 0.0;
@@ -64,9 +87,7 @@ ProbabilityBound BigramProbabilityCalculator::BigramProbabilityBound(
       max_pair_bound = std::max(P[i] + P[j] - Pij, max_pair_bound);
       if (max_pair_bound >= 1.0) {
         // Bounds can't be lower than [1, 1] stop checking.
-        ProbabilityBound bound(1.0, 1.0);
-        cached_bound = bound;
-        return bound;
+        return ProbabilityBound(1.0, 1.0);
       }
     }
   }
@@ -94,13 +115,7 @@ ProbabilityBound BigramProbabilityCalculator::BigramProbabilityBound(
   double raw_upper = std::max(
       std::min(unigram_total - max_partial_bigram_total, 1.0), raw_lower);
 
-  ProbabilityBound raw_bound(raw_lower, raw_upper);
-  cached_bound = raw_bound;
-
-  double final_lower = std::max(raw_lower, best_lower);
-  double final_upper = std::max(raw_upper, final_lower);
-
-  return ProbabilityBound(final_lower, final_upper);
+  return ProbabilityBound(raw_lower, raw_upper);
 }
 
 ProbabilityBound BigramProbabilityCalculator::ComputeProbability(
@@ -204,4 +219,9 @@ ProbabilityBound BigramProbabilityCalculator::ComputeConjunctiveProbability(
   return ProbabilityBound(std::max(0.0, min_prob), min_of_maxes);
 }
 
+Fingerprint BigramProbabilityCalculator::DataFingerprint() const {
+  Fingerprint data = frequencies_.fingerprint();
+  return Fingerprint::Of(StrCat("bigram:", data.high, ":", data.low));
+}
+
 }  // namespace ift::freq
@@ -1,8 +1,13 @@
 #ifndef IFT_FREQ_BIGRAM_PROBABILITY_CALCULATOR_H_
 #define IFT_FREQ_BIGRAM_PROBABILITY_CALCULATOR_H_
 
+#include <memory>
 #include <optional>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "ift/common/fingerprint.h"
+#include "ift/common/fingerprint_map.h"
 #include "ift/common/int_set.h"
 #include "ift/freq/lru_cache.h"
 #include "ift/freq/probability_bound.h"
@@ -19,6 +24,8 @@ constexpr size_t BIGRAM_PROBABILITY_CACHE_SIZE = 300000;
 // As a result it will return a range of probability instead of a single value
 // since we only have unigram and bigram frequency data which is not sufficient
 // to compute the true probability.
+//
+// Safe to use from multiple threads concurrently.
 class BigramProbabilityCalculator : public ProbabilityCalculator {
  public:
   explicit BigramProbabilityCalculator(
@@ -34,18 +41,34 @@ class BigramProbabilityCalculator : public ProbabilityCalculator {
   ProbabilityBound ComputeConjunctiveProbability(
       const std::vector<ProbabilityBound>& bounds) const override;
 
+  ift::common::Fingerprint DataFingerprint() const override;
+
  private:
   ProbabilityBound BigramProbabilityBound(
       const ift::common::CodepointSet& codepoints,
       double current_best_lower) const;
 
+  // Computes the bound for codepoints without using the cache.
+  ProbabilityBound RawBigramProbabilityBound(
+      const ift::common::CodepointSet& codepoints) const;
+
   ProbabilityBound ComputeProbabilityInternal(
       const ift::encoder::SubsetDefinition& definition,
       double best_lower) const;
 
+  struct CachedBound {
+    std::optional<ProbabilityBound> bound;
+    [[no_unique_address]] ift::common::FingerprintKeyCheck<
+        ift::common::CodepointSet>
+        codepoints;
+  };
+
   UnicodeFrequencies frequencies_;
-  mutable LruCache<ift::common::CodepointSet, std::optional<ProbabilityBound>>
-      cache_;
+  // Heap allocated so that the calculator remains movable.
+  std::unique_ptr<absl::Mutex> cache_mutex_;
+  // Keyed by the fingerprint of the codepoint set.
+  mutable LruCache<ift::common::Fingerprint, CachedBound> cache_
+      ABSL_GUARDED_BY(*cache_mutex_);
 };
 
 }  // namespace ift::freq
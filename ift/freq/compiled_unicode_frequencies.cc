@@ -0,0 +1,236 @@
+#include "ift/freq/compiled_unicode_frequencies.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "ift/common/font_data.h"
+#include "ift/common/font_helper.h"
+#include "ift/freq/unicode_frequencies.h"
+
+using absl::FunctionRef;
+using absl::StatusOr;
+using absl::string_view;
+using ift::common::FontData;
+using ift::common::FontHelper;
+
+namespace ift::freq {
+
+static constexpr uint32_t kVersion = 1;
+
+// Magic number and version, max count, then the three array lengths.
+static constexpr size_t kHeaderSize = 4 + 4 + 8 + 3 * 4;
+
+static std::string FileHeader() {
+  std::string header = "iftf";
+  FontHelper::WriteUInt32(kVersion, header);
+  return header;
+}
+
+static void WriteUInt64(uint64_t value, std::string& out) {
+  FontHelper::WriteUInt32(value >> 32, out);
+  FontHelper::WriteUInt32(value & 0xFFFFFFFF, out);
+}
+
+static void WriteDouble(double value, std::string& out) {
+  WriteUInt64(std::bit_cast<uint64_t>(value), out);
+}
+
+std::string CompiledUnicodeFrequencies::Serialize(
+    const UnicodeFrequencies& frequencies) {
+  std::vector<std::pair<uint32_t, double>> unigrams;
+  // Keyed by (smaller cp << 32 | larger cp) so that sorting groups each row.
+  std::vector<std::pair<uint64_t, double>> bigrams;
+  frequencies.ForEachEntry([&](uint32_t cp1, uint32_t cp2, double p) {
+    if (cp1 == cp2) {
+      unigrams.push_back({cp1, p});
+      return;
+    }
+    uint64_t key = (((uint64_t)std::min(cp1, cp2)) << 32) | std::max(cp1, cp2);
+    bigrams.push_back({key, p});
+  });
+  std::sort(unigrams.begin(), unigrams.end());
+  std::sort(bigrams.begin(), bigrams.end());
+
+  std::vector<uint32_t> row_codepoints;
+  std::vector<uint32_t> row_offsets;
+  for (size_t i = 0; i < bigrams.size(); i++) {
+    uint32_t cp1 = bigrams[i].first >> 32;
+    if (row_codepoints.empty() || row_codepoints.back() != cp1) {
+      row_codepoints.push_back(cp1);
+      row_offsets.push_back(i);
+    }
+  }
+  row_offsets.push_back(bigrams.size());
+
+  std::string out = FileHeader();
+  WriteUInt64(frequencies.max_count_, out);
+  FontHelper::WriteUInt32(unigrams.size(), out);
+  FontHelper::WriteUInt32(row_codepoints.size(), out);
+  FontHelper::WriteUInt32(bigrams.size(), out);
+
+  for (const auto& [cp, _] : unigrams) {
+    FontHelper::WriteUInt32(cp, out);
+  }
+  for (const auto& [_, p] : unigrams) {
+    WriteDouble(p, out);
+  }
+  for (uint32_t cp : row_codepoints) {
+    FontHelper::WriteUInt32(cp, out);
+  }
+  for (uint32_t offset : row_offsets) {
+    FontHelper::WriteUInt32(offset, out);
+  }
+  for (const auto& [key, _] : bigrams) {
+    FontHelper::WriteUInt32(key & 0xFFFFFFFF, out);
+  }
+  for (const auto& [_, p] : bigrams) {
+    WriteDouble(p, out);
+  }
+  return out;
+}
+
+bool CompiledUnicodeFrequencies::IsCompiled(string_view data) {
+  return data.substr(0, 4) == "iftf";
+}
+
+StatusOr<CompiledUnicodeFrequencies> CompiledUnicodeFrequencies::Create(
+    FontData data) {
+  if (data.str().substr(0, 8) != FileHeader()) {
+    return absl::InvalidArgumentError(
+        "Not compiled frequency data (or is an incompatible version).");
+  }
+  if (data.size() < kHeaderSize) {
+    return absl::InvalidArgumentError("Compiled frequency data is truncated.");
+  }
+
+  CompiledUnicodeFrequencies result(std::move(data));
+  result.max_count_ =
+      (((uint64_t)result.UInt32At(8, 0)) << 32) | result.UInt32At(8, 1);
+  result.num_unigrams_ = result.UInt32At(16, 0);
+  result.num_rows_ = result.UInt32At(16, 1);
+  result.num_bigrams_ = result.UInt32At(16, 2);
+
+  // Counts are 32 bit so none of these can overflow.
+  result.unigram_codepoints_ = kHeaderSize;
+  result.unigram_probabilities_ =
+      result.unigram_codepoints_ + 4 * (size_t)result.num_unigrams_;
+  result.row_codepoints_ =
+      result.unigram_probabilities_ + 8 * (size_t)result.num_unigrams_;
+  result.row_offsets_ = result.row_codepoints_ + 4 * (size_t)result.num_rows_;
+  result.bigram_codepoints_ =
+      result.row_offsets_ + 4 * ((size_t)result.num_rows_ + 1);
+  result.bigram_probabilities_ =
+      result.bigram_codepoints_ + 4 * (size_t)result.num_bigrams_;
+  size_t end = result.bigram_probabilities_ + 8 * (size_t)result.num_bigrams_;
+  if (end != result.data_.size()) {
+    return absl::InvalidArgumentError(
+        "Compiled frequency data has the wrong size.");
+  }
+
+  // Lookups trust the row offsets, so make sure they stay in bounds.
+  uint32_t previous = 0;
+  for (uint32_t row = 0; row <= result.num_rows_; row++) {
+    uint32_t offset = result.UInt32At(result.row_offsets_, row);
+    if (offset < previous || offset > result.num_bigrams_ ||
+        (row == 0 && offset != 0)) {
+      return absl::InvalidArgumentError(
+          "Compiled frequency data has invalid row offsets.");
+    }
+    previous = offset;
+  }
+  if (previous != result.num_bigrams_) {
+    return absl::InvalidArgumentError(
+        "Compiled frequency data has invalid row offsets.");
+  }
+
+  return result;
+}
+
+uint32_t CompiledUnicodeFrequencies::UInt32At(size_t offset,
+                                              uint32_t index) const {
+  // Bounds are checked once in Create() rather than on every access.
+  const uint8_t* p =
+      reinterpret_cast<const uint8_t*>(data_.data()) + offset + 4 * index;
+  return (((uint32_t)p[0]) << 24) | (((uint32_t)p[1]) << 16) |
+         (((uint32_t)p[2]) << 8) | ((uint32_t)p[3]);
+}
+
+double CompiledUnicodeFrequencies::DoubleAt(size_t offset,
+                                            uint32_t index) const {
+  uint64_t bits = (((uint64_t)UInt32At(offset, 2 * index)) << 32) |
+                  UInt32At(offset, 2 * index + 1);
+  return std::bit_cast<double>(bits);
+}
+
+uint32_t CompiledUnicodeFrequencies::LowerBound(size_t offset, uint32_t begin,
+                                                uint32_t end,
+                                                uint32_t value) const {
+  while (begin < end) {
+    uint32_t mid = begin + (end - begin) / 2;
+    if (UInt32At(offset, mid) < value) {
+      begin = mid + 1;
+    } else {
+      end = mid;
+    }
+  }
+  return begin;
+}
+
+std::optional<double> CompiledUnicodeFrequencies::Find(uint32_t cp1,
+                                                       uint32_t cp2) const {
+  if (cp1 > cp2) {
+    std::swap(cp1, cp2);
+  }
+
+  if (cp1 == cp2) {
+    uint32_t i = LowerBound(unigram_codepoints_, 0, num_unigrams_, cp1);
+    if (i == num_unigrams_ || UInt32At(unigram_codepoints_, i) != cp1) {
+      return std::nullopt;
+    }
+    return DoubleAt(unigram_probabilities_, i);
+  }
+
+  uint32_t row = LowerBound(row_codepoints_, 0, num_rows_, cp1);
+  if (row == num_rows_ || UInt32At(row_codepoints_, row) != cp1) {
+    return std::nullopt;
+  }
+  uint32_t end = UInt32At(row_offsets_, row + 1);
+  uint32_t i =
+      LowerBound(bigram_codepoints_, UInt32At(row_offsets_, row), end, cp2);
+  if (i == end || UInt32At(bigram_codepoints_, i) != cp2) {
+    return std::nullopt;
+  }
+  return DoubleAt(bigram_probabilities_, i);
+}
+
+void CompiledUnicodeFrequencies::ForEachUnigram(
+    FunctionRef<void(uint32_t, double)> callback) const {
+  for (uint32_t i = 0; i < num_unigrams_; i++) {
+    callback(UInt32At(unigram_codepoints_, i),
+             DoubleAt(unigram_probabilities_, i));
+  }
+}
+
+void CompiledUnicodeFrequencies::ForEachBigram(
+    FunctionRef<void(uint32_t, uint32_t, double)> callback) const {
+  for (uint32_t row = 0; row < num_rows_; row++) {
+    uint32_t cp1 = UInt32At(row_codepoints_, row);
+    uint32_t end = UInt32At(row_offsets_, row + 1);
+    for (uint32_t i = UInt32At(row_offsets_, row); i < end; i++) {
+      callback(cp1, UInt32At(bigram_codepoints_, i),
+               DoubleAt(bigram_probabilities_, i));
+    }
+  }
+}
+
+}  // namespace ift::freq
@@ -0,0 +1,107 @@
+#ifndef IFT_FREQ_COMPILED_UNICODE_FREQUENCIES_H_
+#define IFT_FREQ_COMPILED_UNICODE_FREQUENCIES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "absl/functional/function_ref.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "ift/common/font_data.h"
+
+namespace ift::freq {
+
+class UnicodeFrequencies;
+
+/*
+ * A read only, compiled form of unicode frequency data which is used in place
+ * from its serialized bytes. Loading is just a memory map plus a bounds check,
+ * instead of parsing records and building a hash map of every codepoint pair.
+ *
+ * Lookups binary search sorted arrays. The bigrams are stored in compressed
+ * sparse row (CSR) form: one row per first codepoint, with the second
+ * codepoints of the row sorted.
+ *
+ * Format, all integers are big endian and probabilities are IEEE 754 doubles
+ * stored as uint64:
+ *
+ *   Tag     magic ("iftf")
+ *   uint32  version
+ *   uint64  max count
+ *   uint32  unigram count (U)
+ *   uint32  row count (R)
+ *   uint32  bigram count (B)
+ *   uint32  unigram codepoints[U], sorted
+ *   uint64  unigram probabilities[U]
+ *   uint32  row codepoints[R], sorted, the smaller codepoint of each pair
+ *   uint32  row offsets[R + 1], into the bigram arrays
+ *   uint32  bigram codepoints[B], the larger codepoint of each pair
+ *   uint64  bigram probabilities[B]
+ */
+class CompiledUnicodeFrequencies {
+ public:
+  CompiledUnicodeFrequencies(CompiledUnicodeFrequencies&& other) = default;
+  CompiledUnicodeFrequencies& operator=(CompiledUnicodeFrequencies&& other) =
+      default;
+
+  CompiledUnicodeFrequencies(const CompiledUnicodeFrequencies&) = delete;
+  CompiledUnicodeFrequencies& operator=(const CompiledUnicodeFrequencies&) =
+      delete;
+
+  // Returns the compiled form of frequencies.
+  static std::string Serialize(const UnicodeFrequencies& frequencies);
+
+  // True if data starts with the magic number of the compiled format.
+  static bool IsCompiled(absl::string_view data);
+
+  // Checks that data is well formed and wraps it, data is not copied.
+  static absl::StatusOr<CompiledUnicodeFrequencies> Create(
+      ift::common::FontData data);
+
+  uint64_t MaxCount() const { return max_count_; }
+
+  // Returns the probability of the codepoint pair (cp1, cp2), or of cp1 alone
+  // when cp1 == cp2. Returns nullopt if there is no data for the pair.
+  std::optional<double> Find(uint32_t cp1, uint32_t cp2) const;
+
+  // Calls callback for each unigram with (cp, probability).
+  void ForEachUnigram(
+      absl::FunctionRef<void(uint32_t, double)> callback) const;
+
+  // Calls callback for each bigram with (cp1, cp2, probability), cp1 < cp2.
+  void ForEachBigram(
+      absl::FunctionRef<void(uint32_t, uint32_t, double)> callback) const;
+
+ private:
+  explicit CompiledUnicodeFrequencies(ift::common::FontData data)
+      : data_(std::move(data)) {}
+
+  uint32_t UInt32At(size_t offset, uint32_t index) const;
+  double DoubleAt(size_t offset, uint32_t index) const;
+
+  // Returns the first index in [begin, end) of the uint32 array at offset with
+  // a value >= value.
+  uint32_t LowerBound(size_t offset, uint32_t begin, uint32_t end,
+                      uint32_t value) const;
+
+  ift::common::FontData data_;
+  uint64_t max_count_ = 0;
+  uint32_t num_unigrams_ = 0;
+  uint32_t num_rows_ = 0;
+  uint32_t num_bigrams_ = 0;
+
+  // Byte offsets of each array in data_.
+  size_t unigram_codepoints_ = 0;
+  size_t unigram_probabilities_ = 0;
+  size_t row_codepoints_ = 0;
+  size_t row_offsets_ = 0;
+  size_t bigram_codepoints_ = 0;
+  size_t bigram_probabilities_ = 0;
+};
+
+}  // namespace ift::freq
+
+#endif  // IFT_FREQ_COMPILED_UNICODE_FREQUENCIES_H_
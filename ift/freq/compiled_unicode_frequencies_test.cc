@@ -0,0 +1,115 @@
+#include "ift/freq/compiled_unicode_frequencies.h"
+
+#include <string>
+
+#include "absl/status/status.h"
+#include "gtest/gtest.h"
+#include "ift/common/font_data.h"
+#include "ift/common/int_set.h"
+#include "ift/freq/unicode_frequencies.h"
+
+using ift::common::CodepointSet;
+using ift::common::FontData;
+
+namespace ift::freq {
+
+class CompiledUnicodeFrequenciesTest : public ::testing::Test {
+ protected:
+  CompiledUnicodeFrequenciesTest()
+      : frequencies{
+            {{1, 2}, 10}, {{3, 2}, 20}, {{1, 1}, 5},
+            {{2, 2}, 8},  {{4, 1}, 2},  {{0x10FFFF, 3}, 4},
+        } {}
+
+  UnicodeFrequencies frequencies;
+};
+
+TEST_F(CompiledUnicodeFrequenciesTest, MatchesSource) {
+  auto compiled = UnicodeFrequencies::FromCompiled(
+      FontData(CompiledUnicodeFrequencies::Serialize(frequencies)));
+  ASSERT_TRUE(compiled.ok()) << compiled.status();
+  ASSERT_TRUE(compiled->HasData());
+
+  for (uint32_t cp1 : {0u, 1u, 2u, 3u, 4u, 5u, 0x10FFFFu}) {
+    EXPECT_EQ(compiled->ProbabilityFor(cp1), frequencies.ProbabilityFor(cp1))
+        << cp1;
+    for (uint32_t cp2 : {0u, 1u, 2u, 3u, 4u, 5u, 0x10FFFFu}) {
+      EXPECT_EQ(compiled->ProbabilityFor(cp1, cp2),
+                frequencies.ProbabilityFor(cp1, cp2))
+          << cp1 << ", " << cp2;
+    }
+  }
+
+  EXPECT_EQ(compiled->CoveredCodepoints(), frequencies.CoveredCodepoints());
+}
+
+TEST_F(CompiledUnicodeFrequenciesTest, Filter) {
+  CodepointSet filter{1, 2};
+  UnicodeFrequenciesBuilder builder(filter);
+  builder.Add(1, 2, 10);
+  builder.Add(3, 2, 20);
+  builder.Add(1, 1, 5);
+  builder.Add(2, 2, 8);
+  builder.Add(4, 1, 2);
+  builder.Add(0x10FFFF, 3, 4);
+  UnicodeFrequencies filtered = builder.Build();
+
+  auto compiled = UnicodeFrequencies::FromCompiled(
+      FontData(CompiledUnicodeFrequencies::Serialize(frequencies)), filter);
+  ASSERT_TRUE(compiled.ok()) << compiled.status();
+
+  for (uint32_t cp1 : {1u, 2u, 3u, 4u}) {
+    EXPECT_EQ(compiled->ProbabilityFor(cp1), filtered.ProbabilityFor(cp1));
+    for (uint32_t cp2 : {1u, 2u, 3u, 4u}) {
+      EXPECT_EQ(compiled->ProbabilityFor(cp1, cp2),
+                filtered.ProbabilityFor(cp1, cp2));
+    }
+  }
+  EXPECT_EQ(compiled->CoveredCodepoints(), filtered.CoveredCodepoints());
+
+  // Re-serializing applies the filter.
+  auto recompiled = UnicodeFrequencies::FromCompiled(
+      FontData(CompiledUnicodeFrequencies::Serialize(*compiled)));
+  ASSERT_TRUE(recompiled.ok()) << recompiled.status();
+  EXPECT_EQ(recompiled->ProbabilityFor(2, 3), filtered.ProbabilityFor(2, 3));
+  EXPECT_EQ(recompiled->CoveredCodepoints(), filtered.CoveredCodepoints());
+}
+
+TEST_F(CompiledUnicodeFrequenciesTest, Empty) {
+  UnicodeFrequencies empty;
+  std::string data = CompiledUnicodeFrequencies::Serialize(empty);
+  ASSERT_TRUE(CompiledUnicodeFrequencies::IsCompiled(data));
+
+  auto compiled = UnicodeFrequencies::FromCompiled(FontData(data));
+  ASSERT_TRUE(compiled.ok()) << compiled.status();
+  EXPECT_FALSE(compiled->HasData());
+  EXPECT_EQ(compiled->ProbabilityFor(1, 2), 0.0);
+}
+
+TEST_F(CompiledUnicodeFrequenciesTest, RejectsCorruptData) {
+  std::string data = CompiledUnicodeFrequencies::Serialize(frequencies);
+
+  ASSERT_FALSE(CompiledUnicodeFrequencies::IsCompiled("riegeli"));
+  ASSERT_TRUE(absl::IsInvalidArgument(
+      CompiledUnicodeFrequencies::Create(FontData("")).status()));
+
+  // Truncated at every length.
+  for (size_t i = 0; i < data.size(); i++) {
+    ASSERT_FALSE(
+        CompiledUnicodeFrequencies::Create(FontData(data.substr(0, i))).ok())
+        << "length " << i;
+  }
+
+  // Trailing data.
+  ASSERT_FALSE(CompiledUnicodeFrequencies::Create(FontData(data + "x")).ok());
+
+  // Row offsets which point past the end of the bigrams. The row offsets are
+  // immediately before the bigram codepoints (4 bigrams) and probabilities.
+  std::string bad_offsets = data;
+  size_t last_offset = data.size() - 4 * 12 - 4;
+  bad_offsets[last_offset + 3] = 5;
+  ASSERT_FALSE(
+      CompiledUnicodeFrequencies::Create(FontData(bad_offsets)).ok());
+}
+
+}  // namespace ift::freq
@@ -1,6 +1,7 @@
 #ifndef IFT_FREQ_PROBABILITY_CALCULATOR_H_
 #define IFT_FREQ_PROBABILITY_CALCULATOR_H_
 
+#include "ift/common/fingerprint.h"
 #include "ift/encoder/segment.h"
 #include "ift/encoder/subset_definition.h"
 #include "ift/freq/probability_bound.h"
@@ -31,6 +32,11 @@ class ProbabilityCalculator {
   // to speed up the computation.
   virtual ProbabilityBound ComputeConjunctiveProbability(
       const std::vector<ProbabilityBound>& bounds) const = 0;
+
+  // Fingerprint of the calculation method and the data it uses. Calculators
+  // with equal fingerprints compute the same probabilities. Calculators that
+  // don't use any data may leave this as the default.
+  virtual ift::common::Fingerprint DataFingerprint() const { return {}; }
 };
 
 }  // namespace ift::freq
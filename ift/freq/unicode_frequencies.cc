@@ -1,11 +1,27 @@
 #include "ift/freq/unicode_frequencies.h"
 
+#include <algorithm>
+#include <bit>
 #include <cstdint>
+#include <optional>
+#include <string>
 #include <utility>
 
+#include "absl/functional/function_ref.h"
+#include "absl/status/statusor.h"
+#include "ift/common/fingerprint.h"
+#include "ift/common/font_data.h"
+#include "ift/common/font_helper.h"
 #include "ift/common/int_set.h"
+#include "ift/common/try.h"
+#include "ift/freq/compiled_unicode_frequencies.h"
 
+using absl::FunctionRef;
+using absl::StatusOr;
 using ift::common::CodepointSet;
+using ift::common::Fingerprint;
+using ift::common::FontData;
+using ift::common::FontHelper;
 
 namespace ift::freq {
 
@@ -56,15 +72,65 @@ UnicodeFrequencies::UnicodeFrequencies(
   *this = builder.Build();
 }
 
+StatusOr<UnicodeFrequencies> UnicodeFrequencies::FromCompiled(
+    FontData data, std::optional<CodepointSet> filter) {
+  UnicodeFrequencies result;
+  result.compiled_ = TRY(CompiledUnicodeFrequencies::Create(std::move(data)));
+  result.filter_ = std::move(filter);
+  result.max_count_ = result.compiled_->MaxCount();
+  if (result.max_count_ > 0) {
+    result.unknown_probability_ = 1.0 / (double)result.max_count_;
+  }
+  return result;
+}
+
+std::optional<double> UnicodeFrequencies::Find(uint32_t cp1,
+                                               uint32_t cp2) const {
+  if (compiled_.has_value()) {
+    if (filter_.has_value() &&
+        (!filter_->contains(cp1) || !filter_->contains(cp2))) {
+      return std::nullopt;
+    }
+    return compiled_->Find(cp1, cp2);
+  }
+
+  auto it = probabilities_.find(ToKey(cp1, cp2));
+  if (it == probabilities_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+void UnicodeFrequencies::ForEachEntry(
+    FunctionRef<void(uint32_t, uint32_t, double)> callback) const {
+  if (!compiled_.has_value()) {
+    for (const auto& [key, probability] : probabilities_) {
+      callback(key >> 32, key & (uint64_t)0x00000000FFFFFFFF, probability);
+    }
+    return;
+  }
+
+  auto in_filter = [&](uint32_t cp) {
+    return !filter_.has_value() || filter_->contains(cp);
+  };
+  compiled_->ForEachUnigram([&](uint32_t cp, double probability) {
+    if (in_filter(cp)) {
+      callback(cp, cp, probability);
+    }
+  });
+  compiled_->ForEachBigram(
+      [&](uint32_t cp1, uint32_t cp2, double probability) {
+        if (in_filter(cp1) && in_filter(cp2)) {
+          callback(cp1, cp2, probability);
+        }
+      });
+}
+
 double UnicodeFrequencies::ProbabilityFor(uint32_t cp) const {
   if (max_count_ == 0) {
     return 0.0;
   }
-  auto it = probabilities_.find(ToKey(cp, cp));
-  if (it != probabilities_.end()) {
-    return it->second;
-  }
-  return unknown_probability_;
+  return Find(cp, cp).value_or(unknown_probability_);
 }
 
 double UnicodeFrequencies::ProbabilityFor(uint32_t cp1, uint32_t cp2) const {
@@ -81,9 +147,9 @@ double UnicodeFrequencies::ProbabilityFor(uint32_t cp1, uint32_t cp2, double p1,
     return p1;
   }
 
-  auto it = probabilities_.find(ToKey(cp1, cp2));
-  if (it != probabilities_.end()) {
-    return it->second;
+  std::optional<double> probability = Find(cp1, cp2);
+  if (probability.has_value()) {
+    return *probability;
   }
 
   // Since we don't have data on P(cp1 n cp2), just assume the probabilities
@@ -93,6 +159,16 @@ double UnicodeFrequencies::ProbabilityFor(uint32_t cp1, uint32_t cp2, double p1,
 
 CodepointSet UnicodeFrequencies::CoveredCodepoints() const {
   CodepointSet out;
+  if (compiled_.has_value()) {
+    // Avoid walking the (much larger) bigram data.
+    compiled_->ForEachUnigram([&](uint32_t cp, double) {
+      if (!filter_.has_value() || filter_->contains(cp)) {
+        out.insert(cp);
+      }
+    });
+    return out;
+  }
+
   for (const auto& [key, _] : probabilities_) {
     uint32_t cp1 = key >> 32;
     uint32_t cp2 = key & (uint64_t)0x00000000FFFFFFFF;
@@ -103,4 +179,31 @@ CodepointSet UnicodeFrequencies::CoveredCodepoints() const {
   return out;
 }
 
-}  // namespace ift::freq
\ No newline at end of file
+static void WriteUInt64(uint64_t value, std::string& out) {
+  FontHelper::WriteUInt32(value >> 32, out);
+  FontHelper::WriteUInt32(value & 0xFFFFFFFF, out);
+}
+
+Fingerprint UnicodeFrequencies::fingerprint() const {
+  // Entries are visited in no particular order so they're combined with an
+  // order independent sum.
+  Fingerprint sum;
+  std::string entry;
+  ForEachEntry([&](uint32_t cp1, uint32_t cp2, double probability) {
+    entry.clear();
+    FontHelper::WriteUInt32(std::min(cp1, cp2), entry);
+    FontHelper::WriteUInt32(std::max(cp1, cp2), entry);
+    WriteUInt64(std::bit_cast<uint64_t>(probability), entry);
+    Fingerprint f = Fingerprint::Of(entry);
+    sum.high += f.high;
+    sum.low += f.low;
+  });
+
+  std::string data;
+  WriteUInt64(max_count_, data);
+  WriteUInt64(sum.high, data);
+  WriteUInt64(sum.low, data);
+  return Fingerprint::Of(data);
+}
+
+}  // namespace ift::freq
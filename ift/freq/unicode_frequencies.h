@@ -5,8 +5,13 @@
 #include <optional>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/statusor.h"
 #include "hb.h"
+#include "ift/common/fingerprint.h"
+#include "ift/common/font_data.h"
 #include "ift/common/int_set.h"
+#include "ift/freq/compiled_unicode_frequencies.h"
 
 namespace ift::freq {
 
@@ -23,6 +28,15 @@ class UnicodeFrequencies {
   UnicodeFrequencies(const UnicodeFrequencies&) = delete;
   UnicodeFrequencies& operator=(const UnicodeFrequencies&) = delete;
 
+  // Creates frequencies which are looked up directly in data, which is in the
+  // compiled format (see compiled_unicode_frequencies.h). data is not copied.
+  //
+  // If filter is set only pairs where both codepoints are in the filter are
+  // used, matching UnicodeFrequenciesBuilder.
+  static absl::StatusOr<UnicodeFrequencies> FromCompiled(
+      ift::common::FontData data,
+      std::optional<ift::common::CodepointSet> filter = std::nullopt);
+
   bool HasData() const { return max_count_ > 0; }
 
   // Add frequency data for the codepoint pair (cp1, cp2).
@@ -51,9 +65,26 @@ class UnicodeFrequencies {
   // Returns the set of codepoints that frequency data is available for.
   ift::common::CodepointSet CoveredCodepoints() const;
 
+  // A fingerprint of the probabilities, the same for equal data regardless of
+  // whether it was compiled or built. O(n) in the number of entries.
+  ift::common::Fingerprint fingerprint() const;
+
  private:
+  friend class CompiledUnicodeFrequencies;
   friend class UnicodeFrequenciesBuilder;
+
+  // Returns the probability of the pair (cp1, cp2), or nullopt if there's no
+  // data for it.
+  std::optional<double> Find(uint32_t cp1, uint32_t cp2) const;
+
+  // Calls callback with (cp1, cp2, probability) for every pair with data.
+  void ForEachEntry(
+      absl::FunctionRef<void(uint32_t, uint32_t, double)> callback) const;
+
+  // Either probabilities_ or compiled_ holds the data.
   absl::flat_hash_map<uint64_t, double> probabilities_;
+  std::optional<CompiledUnicodeFrequencies> compiled_;
+  std::optional<ift::common::CodepointSet> filter_;
   uint64_t max_count_ = 0;
   double unknown_probability_ = 1.0;
 };
@@ -1,8 +1,12 @@
 #include "ift/freq/unigram_probability_calculator.h"
 
+#include "absl/strings/str_cat.h"
 #include "hb.h"
+#include "ift/common/fingerprint.h"
 #include "ift/encoder/segment.h"
 
+using absl::StrCat;
+using ift::common::Fingerprint;
 using ift::encoder::Segment;
 using ift::encoder::SubsetDefinition;
 
@@ -48,4 +52,9 @@ ProbabilityBound UnigramProbabilityCalculator::ComputeConjunctiveProbability(
   return {probability, probability};
 }
 
+Fingerprint UnigramProbabilityCalculator::DataFingerprint() const {
+  Fingerprint data = frequencies_.fingerprint();
+  return Fingerprint::Of(StrCat("unigram:", data.high, ":", data.low));
+}
+
 }  // namespace ift::freq
@@ -24,6 +24,8 @@ class UnigramProbabilityCalculator : public ProbabilityCalculator {
   ProbabilityBound ComputeConjunctiveProbability(
       const std::vector<ProbabilityBound>& bounds) const override;
 
+  ift::common::Fingerprint DataFingerprint() const override;
+
   BigramProbabilityCalculator ToBigramCalculator() && {
     return BigramProbabilityCalculator(std::move(frequencies_));
   }
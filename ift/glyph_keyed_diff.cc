@@ -9,6 +9,7 @@
 #include "absl/strings/str_cat.h"
 #include "ift/common/brotli_binary_diff.h"
 #include "ift/common/compat_id.h"
+#include "ift/common/fingerprint.h"
 #include "ift/common/font_data.h"
 #include "ift/common/font_helper.h"
 #include "ift/common/font_helper_macros.h"
@@ -25,6 +26,7 @@ using absl::StrCat;
 using absl::string_view;
 using ift::common::BrotliBinaryDiff;
 using ift::common::CompatId;
+using ift::common::Fingerprint;
 using ift::common::FontData;
 using ift::common::FontHelper;
 using ift::common::hb_blob_unique_ptr;
@@ -37,11 +39,7 @@ using ift::proto::PatchMap;
 
 namespace ift {
 
-StatusOr<FontData> GlyphKeyedDiff::CreatePatch(const IntSet& gids) const {
-  std::string patch;
-  FontHelper::WriteUInt32(HB_TAG('i', 'f', 'g', 'k'), patch);  // Format Tag
-  FontHelper::WriteUInt32(0, patch);                           // Reserved.
-
+StatusOr<bool> GlyphKeyedDiff::UseU16Gids(const IntSet& gids) {
   if (gids.empty()) {
     return absl::InvalidArgumentError(
         "There must be at least one gid in the requested patch.");
@@ -52,10 +50,15 @@ StatusOr<FontData> GlyphKeyedDiff::CreatePatch(const IntSet& gids) const {
     return absl::InvalidArgumentError("Larger then 24 bit gid requested.");
   }
 
-  bool u16_gids = true;
-  if (max_gid > (1 << 16) - 1) {
-    u16_gids = false;
-  }
+  return max_gid <= (1 << 16) - 1;
+}
+
+StatusOr<FontData> GlyphKeyedDiff::CreatePatch(const IntSet& gids) const {
+  std::string patch;
+  FontHelper::WriteUInt32(HB_TAG('i', 'f', 'g', 'k'), patch);  // Format Tag
+  FontHelper::WriteUInt32(0, patch);                           // Reserved.
+
+  bool u16_gids = TRY(UseU16Gids(gids));
 
   // Flags
   FontHelper::WriteUInt8(u16_gids ? 0b00000000 : 0b00000001, patch);
@@ -85,6 +88,18 @@ StatusOr<FontData> GlyphKeyedDiff::CreatePatch(const IntSet& gids) const {
   return result;
 }
 
+StatusOr<Fingerprint> GlyphKeyedDiff::PatchFingerprint(
+    const IntSet& gids) const {
+  bool u16_gids = TRY(UseU16Gids(gids));
+
+  std::string inputs;
+  FontHelper::WriteUInt8(u16_gids ? 0b00000000 : 0b00000001, inputs);
+  base_compat_id_.WriteTo(inputs);
+  FontHelper::WriteUInt32(quality_, inputs);
+  inputs += TRY(CreateDataStream(gids, u16_gids)).str();
+  return Fingerprint::Of(inputs);
+}
+
 struct GlyfDataOperator {
   GlyfDataOperator(hb_face_t* face) : face_(face) {}
   hb_face_t* face_;
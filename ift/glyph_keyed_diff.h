@@ -5,12 +5,20 @@
 #include "absl/status/statusor.h"
 #include "ift/common/brotli_binary_diff.h"
 #include "ift/common/compat_id.h"
+#include "ift/common/fingerprint.h"
 #include "ift/common/font_data.h"
 #include "ift/common/int_set.h"
 
 namespace ift {
 
-/* Generates glyph keyed patches. */
+/*
+ * Generates glyph keyed patches.
+ *
+ * All methods are const and keep no per call state in the object: each call
+ * creates its own harfbuzz face for font (faces are safe for concurrent
+ * reads) and its own brotli encoder. So a single instance can be used from
+ * multiple threads at once, as long as font outlives it.
+ */
 class GlyphKeyedDiff {
  public:
   GlyphKeyedDiff(const ift::common::FontData& font,
@@ -20,18 +28,29 @@ class GlyphKeyedDiff {
       : font_(font),
         base_compat_id_(base_compat_id),
         tags_(included_tags),
+        quality_(quality),
         brotli_diff_(quality) {}
 
   absl::StatusOr<ift::common::FontData> CreatePatch(
       const ift::common::IntSet& gids) const;
 
+  // Returns a fingerprint of everything which determines the patch that
+  // CreatePatch(gids) produces. This skips compression so is much cheaper
+  // than creating the patch.
+  absl::StatusOr<ift::common::Fingerprint> PatchFingerprint(
+      const ift::common::IntSet& gids) const;
+
  private:
+  // Returns true if gids can be encoded in the patch as 16 bit values.
+  static absl::StatusOr<bool> UseU16Gids(const ift::common::IntSet& gids);
+
   absl::StatusOr<ift::common::FontData> CreateDataStream(
       const ift::common::IntSet& gids, bool u16_gids) const;
 
   const ift::common::FontData& font_;
   ift::common::CompatId base_compat_id_;
   absl::flat_hash_set<hb_tag_t> tags_;
+  unsigned quality_;
   ift::common::BrotliBinaryDiff brotli_diff_;
 };
 
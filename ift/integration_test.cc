@@ -341,6 +341,35 @@ TEST_F(IntegrationTest, TableKeyedOnly) {
   GlyphDataMatches(original_face.get(), extended_face.get(), 0x49);
 }
 
+TEST_F(IntegrationTest, TableKeyedOnly_GlyphTableDiff) {
+  Compiler compiler;
+  auto sc = InitEncoderForTableKeyed(compiler);
+  ASSERT_TRUE(sc.ok()) << sc;
+  compiler.SetUseGlyphTableDiff(true);
+
+  sc = compiler.SetInitSubset(IntSet{0x41, 0x42, 0x43});
+  compiler.AddNonGlyphDataSegment(IntSet{0x45, 0x46, 0x47});
+  compiler.AddNonGlyphDataSegment(IntSet{0x48, 0x49, 0x4A});
+  ASSERT_TRUE(sc.ok()) << sc;
+
+  auto encoding = compiler.Compile();
+  ASSERT_TRUE(encoding.ok()) << encoding.status();
+
+  auto extended = Extend(*encoding, {0x45, 0x49});
+  ASSERT_TRUE(extended.ok()) << extended.status();
+
+  auto extended_face = extended->face();
+  auto codepoints = FontHelper::ToCodepointsSet(extended_face.get());
+  ASSERT_TRUE(codepoints.contains(0x41));
+  ASSERT_TRUE(codepoints.contains(0x45));
+  ASSERT_TRUE(codepoints.contains(0x49));
+
+  auto original_face = noto_sans_jp_.face();
+  GlyphDataMatches(original_face.get(), extended_face.get(), 0x41);
+  GlyphDataMatches(original_face.get(), extended_face.get(), 0x45);
+  GlyphDataMatches(original_face.get(), extended_face.get(), 0x49);
+}
+
 TEST_F(IntegrationTest, TableKeyed_CodepointsAndFeatureSegment) {
   Compiler compiler;
   auto sc = InitEncoderForVf(compiler);
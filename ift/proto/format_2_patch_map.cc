@@ -186,6 +186,180 @@ StatusOr<size_t> Format2PatchMap::EstimateEncodingCost(
   return out.size();
 }
 
+// Helpers for reading sequentially from data, each consumes the bytes read.
+static StatusOr<uint8_t> ConsumeUInt8(string_view& data) {
+  uint8_t value = TRY(FontHelper::ReadUInt8(data));
+  data.remove_prefix(1);
+  return value;
+}
+
+static StatusOr<uint16_t> ConsumeUInt16(string_view& data) {
+  uint16_t value = TRY(FontHelper::ReadUInt16(data));
+  data.remove_prefix(2);
+  return value;
+}
+
+static StatusOr<uint32_t> ConsumeUInt24(string_view& data) {
+  uint32_t value = TRY(FontHelper::ReadUInt24(data));
+  data.remove_prefix(3);
+  return value;
+}
+
+static StatusOr<uint32_t> ConsumeUInt32(string_view& data) {
+  uint32_t value = TRY(FontHelper::ReadUInt32(data));
+  data.remove_prefix(4);
+  return value;
+}
+
+static StatusOr<PatchEncoding> IntToEncoding(uint8_t value) {
+  switch (value) {
+    case 1:
+      return TABLE_KEYED_FULL;
+    case 2:
+      return TABLE_KEYED_PARTIAL;
+    case 3:
+      return GLYPH_KEYED;
+    default:
+      return absl::InvalidArgumentError(
+          StrCat("Unknown patch encoding, ", value));
+  }
+}
+
+Status DecodeAxisSegment(absl::string_view data, hb_tag_t& tag,
+                         AxisRange& range);
+
+static Status DecodeEntry(string_view& data, uint32_t& last_entry_index,
+                          PatchEncoding default_encoding,
+                          PatchMap::Entry& entry);
+
+StatusOr<IFTTable> Format2PatchMap::Deserialize(string_view data) {
+  string_view header = data;
+  uint8_t format = TRY(ConsumeUInt8(header));
+  if (format != 0x02) {
+    return absl::InvalidArgumentError(
+        StrCat("Unsupported patch map format ", format));
+  }
+  TRYV(ConsumeUInt24(header).status());  // Reserved
+  // Flags only signal the presence of the CFF/CFF2 charstrings offsets, which
+  // aren't needed to read the mappings.
+  TRYV(ConsumeUInt8(header).status());
+
+  uint32_t id[4];
+  for (uint32_t& v : id) {
+    v = TRY(ConsumeUInt32(header));
+  }
+
+  PatchEncoding default_encoding =
+      TRY(IntToEncoding(TRY(ConsumeUInt8(header))));
+  uint32_t entry_count = TRY(ConsumeUInt24(header));
+  uint32_t entries_offset = TRY(ConsumeUInt32(header));
+  uint32_t id_strings_offset = TRY(ConsumeUInt32(header));
+  if (id_strings_offset != 0) {
+    return absl::UnimplementedError("String entry ids are not supported.");
+  }
+
+  uint16_t url_template_length = TRY(ConsumeUInt16(header));
+  if (header.size() < url_template_length) {
+    return absl::InvalidArgumentError("Not enough input data.");
+  }
+  string_view url_template = header.substr(0, url_template_length);
+
+  IFTTable table;
+  table.SetId(CompatId(id));
+  table.SetUrlTemplate(
+      Span<const uint8_t>((const uint8_t*)url_template.data(),
+                          url_template.size()));
+
+  if (entries_offset > data.size()) {
+    return absl::InvalidArgumentError("Entries offset is out of bounds.");
+  }
+  string_view entries = data.substr(entries_offset);
+  uint32_t last_entry_index = 0;
+  for (uint32_t i = 0; i < entry_count; i++) {
+    PatchMap::Entry entry;
+    TRYV(DecodeEntry(entries, last_entry_index, default_encoding, entry));
+    TRYV(table.GetPatchMap().AddEntry(entry));
+  }
+
+  return table;
+}
+
+Status DecodeEntry(string_view& data, uint32_t& last_entry_index,
+                   PatchEncoding default_encoding, PatchMap::Entry& entry) {
+  uint8_t format = TRY(ConsumeUInt8(data));
+  PatchMap::Coverage& coverage = entry.coverage;
+
+  if (format & features_and_design_space_bit_mask) {
+    uint8_t feature_count = TRY(ConsumeUInt8(data));
+    for (uint8_t i = 0; i < feature_count; i++) {
+      coverage.features.insert(TRY(ConsumeUInt32(data)));
+    }
+
+    uint16_t segment_count = TRY(ConsumeUInt16(data));
+    for (uint16_t i = 0; i < segment_count; i++) {
+      hb_tag_t tag;
+      AxisRange range = AxisRange::Point(0);
+      TRYV(DecodeAxisSegment(data, tag, range));
+      data.remove_prefix(12);
+      coverage.design_space[tag] = range;
+    }
+  }
+
+  if (format & child_indices_bit_mask) {
+    uint8_t count = TRY(ConsumeUInt8(data));
+    coverage.conjunctive = count & 0b10000000;
+    count &= 0b01111111;
+    for (uint8_t i = 0; i < count; i++) {
+      coverage.child_indices.insert(TRY(ConsumeUInt24(data)));
+    }
+  }
+
+  if (format & index_delta_bit_mask) {
+    // See EncodeEntryIds(), the lsb of each delta marks if another follows.
+    bool has_more = true;
+    while (has_more) {
+      uint32_t value = TRY(ConsumeUInt24(data));
+      // Sign extend the int24.
+      int32_t delta = (value & 0x800000) ? (int32_t)(value | 0xFF000000)
+                                         : (int32_t)value;
+      has_more = delta & 1;
+      int64_t entry_index = (int64_t)last_entry_index + 1 + delta / 2;
+      if (entry_index < 0 || entry_index > 0xFFFFFFFF) {
+        return absl::InvalidArgumentError(
+            StrCat("Entry index out of range: ", entry_index));
+      }
+      entry.patch_indices.push_back(entry_index);
+      last_entry_index = entry_index;
+    }
+  } else {
+    entry.patch_indices.push_back(++last_entry_index);
+  }
+
+  entry.encoding = default_encoding;
+  if (format & encoding_bit_mask) {
+    entry.encoding = TRY(IntToEncoding(TRY(ConsumeUInt8(data))));
+  }
+
+  uint8_t codepoint_format = format & codepoint_bit_mask;
+  if (codepoint_format) {
+    uint32_t bias = 0;
+    if (codepoint_format == two_byte_bias) {
+      bias = TRY(ConsumeUInt16(data));
+    } else if (codepoint_format == three_byte_bias) {
+      bias = TRY(ConsumeUInt24(data));
+    }
+
+    IntSet biased;
+    data = TRY(SparseBitSet::Decode(data, biased));
+    for (uint32_t cp : biased) {
+      coverage.codepoints.insert(cp + bias);
+    }
+  }
+
+  entry.ignored = format & ignore_bit_mask;
+  return absl::OkStatus();
+}
+
 Status DecodeAxisSegment(absl::string_view data, hb_tag_t& tag,
                          AxisRange& range) {
   READ_UINT32(tag_v, data, 0);
@@ -4,6 +4,7 @@
 #include <optional>
 
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
 #include "ift/proto/ift_table.h"
 
 namespace ift::proto {
@@ -14,6 +15,10 @@ class Format2PatchMap {
       const IFTTable& ift_table, std::optional<uint32_t> cff_charstrings_offset,
       std::optional<uint32_t> cff2_charstrings_offset);
 
+  // Parses a format 2 patch map table (as produced by Serialize()) into an
+  // IFTTable. Entries which use string ids are not supported.
+  static absl::StatusOr<IFTTable> Deserialize(absl::string_view data);
+
   // Generate an estimated encoding cost, ignores the impact of last patch index
   // and the default format selection on final encoding size.
   static absl::StatusOr<size_t> EstimateEncodingCost(
@@ -5,6 +5,7 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "ift/common/axis_range.h"
+#include "ift/common/int_set.h"
 #include "ift/proto/ift_table.h"
 #include "ift/proto/patch_encoding.h"
 #include "ift/proto/patch_map.h"
@@ -12,6 +13,7 @@
 using testing::UnorderedElementsAre;
 
 using ift::common::AxisRange;
+using ift::common::IntSet;
 
 namespace ift::proto {
 
@@ -539,4 +541,60 @@ TEST_F(Format2PatchMapTest, EstimateEncodingCost) {
   EXPECT_EQ(*cost, 3);
 }
 
+static IFTTable ComplexTable() {
+  IFTTable table;
+  PatchMap& map = table.GetPatchMap();
+
+  PatchMap::Coverage coverage1{1, 2, 3};
+  EXPECT_TRUE(map.AddEntry(coverage1, {7, 5, 6, 12}, TABLE_KEYED_FULL).ok());
+
+  PatchMap::Coverage coverage2{0x10000, 0x10005, 0x20000};
+  coverage2.features = {HB_TAG('s', 'm', 'c', 'p'), HB_TAG('l', 'i', 'g', 'a')};
+  coverage2.design_space[HB_TAG('w', 'g', 'h', 't')] =
+      *AxisRange::Range(300, 700);
+  EXPECT_TRUE(map.AddEntry(coverage2, 2, GLYPH_KEYED).ok());
+
+  PatchMap::Entry ignored({0x300, 0x301}, 3, TABLE_KEYED_PARTIAL);
+  ignored.ignored = true;
+  EXPECT_TRUE(map.AddEntry(ignored).ok());
+
+  PatchMap::Entry children;
+  children.coverage.child_indices = {0, 2};
+  children.coverage.conjunctive = true;
+  children.patch_indices = {20};
+  children.encoding = TABLE_KEYED_FULL;
+  EXPECT_TRUE(map.AddEntry(children).ok());
+
+  table.SetUrlTemplate(std::vector<uint8_t>{4, 'f', 'o', 'o', '/', 129});
+  table.SetId({1, 2, 3, 4});
+  return table;
+}
+
+TEST_F(Format2PatchMapTest, Deserialize_RoundTrip) {
+  IFTTable table = ComplexTable();
+  for (auto cff_offset : {std::optional<uint32_t>(), std::optional(100u)}) {
+    auto encoded = Format2PatchMap::Serialize(table, cff_offset, std::nullopt);
+    ASSERT_TRUE(encoded.ok()) << encoded.status();
+
+    auto decoded = Format2PatchMap::Deserialize(*encoded);
+    ASSERT_TRUE(decoded.ok()) << decoded.status();
+    ASSERT_EQ(*decoded, table);
+
+    const auto& entry = decoded->GetPatchMap().GetEntries()[3];
+    ASSERT_TRUE(entry.coverage.conjunctive);
+    ASSERT_EQ(entry.coverage.child_indices, (IntSet{0, 2}));
+  }
+}
+
+TEST_F(Format2PatchMapTest, Deserialize_RejectsTruncated) {
+  auto encoded =
+      Format2PatchMap::Serialize(ComplexTable(), std::nullopt, std::nullopt);
+  ASSERT_TRUE(encoded.ok()) << encoded.status();
+
+  for (size_t i = 0; i < encoded->size(); i++) {
+    ASSERT_FALSE(Format2PatchMap::Deserialize(encoded->substr(0, i)).ok())
+        << "length " << i;
+  }
+}
+
 }  // namespace ift::proto
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <string>
 
 #include "absl/container/flat_hash_set.h"
+#include "brotli/glyph_table_diff.h"
 #include "hb.h"
 #include "ift/common/font_data.h"
 #include "ift/common/font_helper.h"
@@ -19,6 +20,59 @@ using ift::common::hb_face_unique_ptr;
 
 namespace ift {
 
+bool TableDiffCache::Get(const TableDiffKey& key, FontData& patch) {
+  absl::MutexLock lock(&mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    misses_++;
+    return false;
+  }
+  hits_++;
+  lru_.splice(lru_.begin(), lru_, it->second);
+  patch.shallow_copy(it->second->second);
+  return true;
+}
+
+void TableDiffCache::Insert(const TableDiffKey& key, const FontData& patch) {
+  size_t cost = Cost(patch);
+  if (cost > max_bytes_) {
+    return;
+  }
+
+  absl::MutexLock lock(&mutex_);
+  if (index_.contains(key)) {
+    // Concurrent callers may race to insert the same entry, diffs are
+    // deterministic so the existing one can be kept.
+    return;
+  }
+
+  while (!lru_.empty() && bytes_ + cost > max_bytes_) {
+    const Entry& last = lru_.back();
+    bytes_ -= Cost(last.second);
+    index_.erase(last.first);
+    lru_.pop_back();
+    evictions_++;
+  }
+
+  lru_.emplace_front();
+  lru_.front().first = key;
+  lru_.front().second.shallow_copy(patch);
+  index_[key] = lru_.begin();
+  bytes_ += cost;
+}
+
+TableDiffCache::Stats TableDiffCache::GetStats() const {
+  absl::MutexLock lock(&mutex_);
+  return Stats{
+      .hits = hits_,
+      .misses = misses_,
+      .evictions = evictions_,
+      .entries = index_.size(),
+      .bytes = bytes_,
+      .max_bytes = max_bytes_,
+  };
+}
+
 Status TableKeyedDiff::Diff(const FontData& font_base,
                             const FontData& font_derived,
                             FontData* patch /* OUT */) const {
@@ -60,17 +114,16 @@ Status TableKeyedDiff::Diff(const FontData& font_base,
 
     FontData table_patch;
     if (cache_ == nullptr) {
-      TRYV(binary_diff_.Diff(base_table, derived_table, &table_patch));
+      TRYV(DiffTable(face_base.get(), face_derived.get(), t, base_table,
+                     derived_table, &table_patch));
     } else {
       TableDiffKey key(base_table, derived_table);
-      std::optional<FontData>& cache_value = (*cache_)[key];
-      if (cache_value.has_value()) {
-        table_patch.shallow_copy(*cache_value);
-      } else {
-        TRYV(binary_diff_.Diff(base_table, derived_table, &table_patch));
-        FontData cached_patch;
-        cached_patch.shallow_copy(table_patch);
-        cache_value = std::move(cached_patch);
+      if (!cache_->Get(key, table_patch)) {
+        // Concurrent callers may race to compute the same entry, that's fine
+        // since the diff is deterministic.
+        TRYV(DiffTable(face_base.get(), face_derived.get(), t, base_table,
+                       derived_table, &table_patch));
+        cache_->Insert(key, table_patch);
       }
     }
 
@@ -143,6 +196,22 @@ Status TableKeyedDiff::Diff(const FontData& font_base,
   return absl::OkStatus();
 }
 
+Status TableKeyedDiff::DiffTable(hb_face_t* face_base, hb_face_t* face_derived,
+                                 hb_tag_t tag, const FontData& base_table,
+                                 const FontData& derived_table,
+                                 FontData* table_patch) const {
+  // base_table is left empty for new and replaced tables, in which case there's
+  // nothing to match glyph records against.
+  if (use_glyph_table_diff_ && brotli::GlyphTableDiff::Supports(tag) &&
+      !base_table.empty() && !derived_table.empty() &&
+      brotli::GlyphTableDiff::FitsInWindow(base_table.size(),
+                                           derived_table.size())) {
+    return brotli::GlyphTableDiff::Diff(face_base, face_derived, tag,
+                                        table_patch);
+  }
+  return binary_diff_.Diff(base_table, derived_table, table_patch);
+}
+
 void TableKeyedDiff::AddAllMatching(const flat_hash_set<hb_tag_t>& tags,
                                     btree_set<std::string>& result) const {
   for (const uint32_t& t : tags) {
@@ -1,45 +1,38 @@
 #ifndef IFT_TABLE_KEYED_DIFF_H_
 #define IFT_TABLE_KEYED_DIFF_H_
 
+#include <cstdint>
 #include <initializer_list>
+#include <list>
+#include <utility>
 
 #include "absl/container/btree_set.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "hb.h"
 #include "ift/common/binary_diff.h"
 #include "ift/common/brotli_binary_diff.h"
 #include "ift/common/compat_id.h"
+#include "ift/common/fingerprint.h"
 #include "ift/common/font_data.h"
 
 namespace ift {
 
+/*
+ * Identifies a table diff by fingerprints of the base and derived table
+ * contents, so that cache keys don't hold on to the tables themselves.
+ */
 struct TableDiffKey {
-  ift::common::FontData base;
-  ift::common::FontData derived;
+  ift::common::Fingerprint base;
+  ift::common::Fingerprint derived;
 
   TableDiffKey() = default;
 
-  TableDiffKey(const ift::common::FontData& b, const ift::common::FontData& d) {
-    base.shallow_copy(b);
-    derived.shallow_copy(d);
-  }
-
-  TableDiffKey(const TableDiffKey& other) {
-    base.shallow_copy(other.base);
-    derived.shallow_copy(other.derived);
-  }
-
-  TableDiffKey& operator=(const TableDiffKey& other) {
-    if (this != &other) {
-      base.shallow_copy(other.base);
-      derived.shallow_copy(other.derived);
-    }
-    return *this;
-  }
-
-  TableDiffKey(TableDiffKey&&) = default;
-  TableDiffKey& operator=(TableDiffKey&&) = default;
+  TableDiffKey(const ift::common::FontData& b, const ift::common::FontData& d)
+      : base(ift::common::Fingerprint::Of(b.str())),
+        derived(ift::common::Fingerprint::Of(d.str())) {}
 
   bool operator==(const TableDiffKey& other) const {
     return base == other.base && derived == other.derived;
@@ -47,12 +40,75 @@ struct TableDiffKey {
 
   template <typename H>
   friend H AbslHashValue(H h, const TableDiffKey& key) {
-    return H::combine(std::move(h), key.base.str(), key.derived.str());
+    return H::combine(std::move(h), key.base, key.derived);
   }
 };
 
-using TableDiffCache =
-    absl::flat_hash_map<TableDiffKey, std::optional<ift::common::FontData>>;
+/*
+ * Caches the per table patches produced by TableKeyedDiff. Safe for concurrent
+ * use from multiple threads.
+ *
+ * Memory use is bounded: the total size of the cached patches plus a fixed per
+ * entry overhead is kept under max_bytes by evicting the least recently used
+ * entries.
+ */
+class TableDiffCache {
+ public:
+  static constexpr size_t kDefaultMaxBytes = 1024 * 1024 * 1024;
+
+  // Approximate bookkeeping cost of each entry (key, list node, and index
+  // slot), counted against the budget in addition to the patch bytes.
+  static constexpr size_t kEntryOverheadBytes = 128;
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t max_bytes = 0;
+  };
+
+  explicit TableDiffCache(size_t max_bytes = kDefaultMaxBytes)
+      : max_bytes_(max_bytes) {}
+
+  TableDiffCache(const TableDiffCache&) = delete;
+  TableDiffCache& operator=(const TableDiffCache&) = delete;
+
+  // If a patch for key is present, sets patch to it, marks it as most recently
+  // used, and returns true.
+  bool Get(const TableDiffKey& key, ift::common::FontData& patch);
+
+  // Adds patch to the cache, evicting older entries as needed. Patches larger
+  // than the entire budget are not cached.
+  void Insert(const TableDiffKey& key, const ift::common::FontData& patch);
+
+  bool empty() const {
+    absl::MutexLock lock(&mutex_);
+    return index_.empty();
+  }
+
+  Stats GetStats() const;
+
+ private:
+  using Entry = std::pair<TableDiffKey, ift::common::FontData>;
+
+  static size_t Cost(const ift::common::FontData& patch) {
+    return patch.size() + kEntryOverheadBytes;
+  }
+
+  const size_t max_bytes_;
+
+  mutable absl::Mutex mutex_;
+  // Most recently used entries are at the front.
+  std::list<Entry> lru_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<TableDiffKey, std::list<Entry>::iterator> index_
+      ABSL_GUARDED_BY(mutex_);
+  size_t bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t hits_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t misses_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t evictions_ ABSL_GUARDED_BY(mutex_) = 0;
+};
 
 /* Creates a per table brotli binary diff of two fonts. */
 class TableKeyedDiff : public ift::common::BinaryDiff {
@@ -86,11 +142,22 @@ class TableKeyedDiff : public ift::common::BinaryDiff {
   void SetCache(TableDiffCache* cache) { cache_ = cache; }
   TableDiffCache* cache() const { return cache_; }
 
+  // When enabled glyf, loca, hmtx, and vmtx are diffed with
+  // brotli::GlyphTableDiff which copies unchanged glyph records directly from
+  // the base table and only compresses the new bytes. This is much faster than
+  // a full brotli diff of the table at the cost of slightly larger patches.
+  void SetUseGlyphTableDiff(bool value) { use_glyph_table_diff_ = value; }
+
   absl::Status Diff(const ift::common::FontData& font_base,
                     const ift::common::FontData& font_derived,
                     ift::common::FontData* patch /* OUT */) const override;
 
  private:
+  absl::Status DiffTable(hb_face_t* face_base, hb_face_t* face_derived,
+                         hb_tag_t tag, const ift::common::FontData& base_table,
+                         const ift::common::FontData& derived_table,
+                         ift::common::FontData* table_patch) const;
+
   void AddAllMatching(const absl::flat_hash_set<hb_tag_t>& tags,
                       absl::btree_set<std::string>& result) const;
   absl::btree_set<std::string> TagsToDiff(
@@ -102,6 +169,7 @@ class TableKeyedDiff : public ift::common::BinaryDiff {
   absl::btree_set<std::string> excluded_tags_;
   absl::btree_set<std::string> replaced_tags_;
   TableDiffCache* cache_ = nullptr;
+  bool use_glyph_table_diff_ = false;
 };
 
 }  // namespace ift
@@ -1,5 +1,7 @@
 #include "ift/table_keyed_diff.h"
 
+#include <string>
+
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
 #include "gtest/gtest.h"
@@ -253,6 +255,57 @@ TEST_F(TableKeyedDiffTest, CachedDiff) {
   ASSERT_EQ(patch1.string(), patch2.string());
 }
 
+TEST_F(TableKeyedDiffTest, CacheKeyedByContent) {
+  FontData a1("aaaa");
+  FontData a2("aaaa");
+  FontData b("bbbb");
+
+  ASSERT_EQ(TableDiffKey(a1, b), TableDiffKey(a2, b));
+  ASSERT_NE(TableDiffKey(a1, b), TableDiffKey(b, a1));
+  ASSERT_NE(TableDiffKey(a1, b), TableDiffKey(a1, a2));
+}
+
+TEST_F(TableKeyedDiffTest, CacheEvictsLeastRecentlyUsed) {
+  // Room for exactly two 100 byte patches.
+  TableDiffCache cache(2 * (100 + TableDiffCache::kEntryOverheadBytes));
+  FontData base("base");
+  TableDiffKey key_a(base, FontData("a"));
+  TableDiffKey key_b(base, FontData("b"));
+  TableDiffKey key_c(base, FontData("c"));
+
+  cache.Insert(key_a, FontData(std::string(100, 'a')));
+  cache.Insert(key_b, FontData(std::string(100, 'b')));
+
+  // Touch a so that b is the least recently used.
+  FontData patch;
+  ASSERT_TRUE(cache.Get(key_a, patch));
+  ASSERT_EQ(patch.str(), std::string(100, 'a'));
+
+  cache.Insert(key_c, FontData(std::string(100, 'c')));
+  ASSERT_TRUE(cache.Get(key_a, patch));
+  ASSERT_FALSE(cache.Get(key_b, patch));
+  ASSERT_TRUE(cache.Get(key_c, patch));
+  ASSERT_EQ(patch.str(), std::string(100, 'c'));
+
+  TableDiffCache::Stats stats = cache.GetStats();
+  ASSERT_EQ(stats.hits, 3);
+  ASSERT_EQ(stats.misses, 1);
+  ASSERT_EQ(stats.evictions, 1);
+  ASSERT_EQ(stats.entries, 2);
+  ASSERT_EQ(stats.bytes, 2 * (100 + TableDiffCache::kEntryOverheadBytes));
+  ASSERT_EQ(stats.max_bytes, stats.bytes);
+}
+
+TEST_F(TableKeyedDiffTest, CacheSkipsOversizedPatch) {
+  TableDiffCache cache(50 + TableDiffCache::kEntryOverheadBytes);
+  TableDiffKey key(FontData("base"), FontData("derived"));
+  cache.Insert(key, FontData(std::string(51, 'x')));
+  ASSERT_TRUE(cache.empty());
+
+  FontData patch;
+  ASSERT_FALSE(cache.Get(key, patch));
+}
+
 /*
 TEST_F(TableKeyedDiffTest, FilteredDiff) {
   FontData before = FontHelper::BuildFont({
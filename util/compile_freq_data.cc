@@ -0,0 +1,63 @@
+#include <iostream>
+#include <string>
+
+#include "absl/flags/parse.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "ift/common/font_data.h"
+#include "ift/config/load_codepoints.h"
+#include "ift/freq/compiled_unicode_frequencies.h"
+#include "ift/freq/unicode_frequencies.h"
+#include "util/file_patch_sink.h"
+
+using absl::Status;
+using absl::StatusOr;
+using ift::common::FontData;
+using ift::freq::CompiledUnicodeFrequencies;
+using ift::freq::UnicodeFrequencies;
+
+/*
+ * Converts a Riegeli unicode frequency data file into the compiled frequency
+ * format (see ift/freq/compiled_unicode_frequencies.h). Compiled files can be
+ * used anywhere frequency data is loaded, and are memory mapped instead of
+ * parsed so load much faster.
+ *
+ * When compiling sharded data ("<path>@*") write the output to "<path>.iftf"
+ * and it will be picked up automatically wherever "<path>@*" is loaded,
+ * including for built-in frequency data.
+ */
+
+int main(int argc, char** argv) {
+  auto args = absl::ParseCommandLine(argc, argv);
+
+  if (args.size() != 3) {
+    std::cerr << "Usage:" << std::endl
+              << "compile_freq_data <riegeli_file> <output_file>" << std::endl
+              << std::endl
+              << "Append @* to the file name to load sharded data files. "
+              << "For example \"<path>@*\" will load all files of the form "
+                 "<path>-?????-of-?????"
+              << std::endl;
+    return -1;
+  }
+
+  const char* riegeli_file = args[1];
+  StatusOr<UnicodeFrequencies> frequencies =
+      ift::config::LoadFrequenciesFromRiegeli(riegeli_file);
+  if (!frequencies.ok()) {
+    std::cerr << "Failed to load frequencies from " << riegeli_file << ": "
+              << frequencies.status() << std::endl;
+    return -1;
+  }
+
+  FontData compiled(CompiledUnicodeFrequencies::Serialize(*frequencies));
+  Status sc = ift::util::WriteFile(args[2], compiled);
+  if (!sc.ok()) {
+    std::cerr << "Failed to write " << args[2] << ": " << sc << std::endl;
+    return -1;
+  }
+
+  std::cout << "Wrote " << compiled.size() << " bytes to " << args[2]
+            << std::endl;
+  return 0;
+}
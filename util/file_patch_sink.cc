@@ -0,0 +1,109 @@
+#include "util/file_patch_sink.h"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "ift/common/try.h"
+#include "util/path_util.h"
+
+using absl::Status;
+using absl::StatusOr;
+using absl::StrCat;
+using ift::common::FontData;
+
+namespace ift::util {
+
+Status WriteFile(const std::string& path, const FontData& data) {
+  std::ofstream output(path,
+                       std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!output.is_open()) {
+    return absl::NotFoundError(StrCat("File ", path, " was not found."));
+  }
+  output.write(data.data(), data.size());
+  if (output.bad()) {
+    output.close();
+    return absl::InternalError(StrCat("Failed to write to ", path, "."));
+  }
+
+  output.close();
+  return absl::OkStatus();
+}
+
+StatusOr<FontData> ReadFile(const std::string& path) {
+  std::ifstream input(path, std::ios::in | std::ios::binary);
+  if (!input.is_open()) {
+    return absl::NotFoundError(StrCat("File ", path, " was not found."));
+  }
+  std::string data((std::istreambuf_iterator<char>(input)),
+                   std::istreambuf_iterator<char>());
+  if (input.bad()) {
+    return absl::InternalError(StrCat("Failed to read from ", path, "."));
+  }
+  return FontData(data);
+}
+
+// The calling (compiler) thread never runs writes itself so the pool is sized
+// to give num_threads dedicated writers. With zero threads writes happen
+// inline in Accept().
+FilePatchSink::FilePatchSink(std::string output_path, uint32_t num_threads,
+                             size_t max_pending)
+    : output_path_(std::move(output_path)),
+      max_pending_(max_pending > 0 ? max_pending : 1),
+      pool_(num_threads > 0 ? num_threads + 1 : 1) {}
+
+FilePatchSink::~FilePatchSink() { Finish().IgnoreError(); }
+
+Status FilePatchSink::Accept(const std::string& url, const FontData& patch) {
+  std::string full_path = TRY(JoinAndValidatePath(output_path_, url));
+
+  {
+    absl::MutexLock lock(&mutex_);
+    mutex_.Await(absl::Condition(
+        +[](FilePatchSink* sink) ABSL_EXCLUSIVE_LOCKS_REQUIRED(sink->mutex_) {
+          return sink->num_pending_ < sink->max_pending_ || !sink->status_.ok();
+        },
+        this));
+    if (!status_.ok()) {
+      return status_;
+    }
+    num_pending_++;
+  }
+
+  FontData data;
+  data.shallow_copy(patch);
+  pool_.Schedule([this, full_path = std::move(full_path),
+                  data = std::move(data)]() {
+    WriteDone(WriteFile(full_path, data));
+  });
+  return absl::OkStatus();
+}
+
+void FilePatchSink::WriteDone(Status status) {
+  absl::MutexLock lock(&mutex_);
+  num_pending_--;
+  if (status.ok()) {
+    num_written_++;
+  } else if (status_.ok()) {
+    status_ = std::move(status);
+  }
+}
+
+Status FilePatchSink::Finish() {
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(
+      +[](FilePatchSink* sink) ABSL_EXCLUSIVE_LOCKS_REQUIRED(sink->mutex_) {
+        return sink->num_pending_ == 0;
+      },
+      this));
+  return status_;
+}
+
+StatusOr<FontData> FilePatchSource::Load(const std::string& url) const {
+  std::string full_path = TRY(JoinAndValidatePath(input_path_, url));
+  return ReadFile(full_path);
+}
+
+}  // namespace ift::util
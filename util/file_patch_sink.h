@@ -0,0 +1,95 @@
+#ifndef UTIL_FILE_PATCH_SINK_H_
+#define UTIL_FILE_PATCH_SINK_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "ift/common/font_data.h"
+#include "ift/common/thread_pool.h"
+#include "ift/encoder/patch_sink.h"
+
+namespace ift::util {
+
+// Writes data to the file at path, replacing any existing contents.
+absl::Status WriteFile(const std::string& path,
+                       const ift::common::FontData& data);
+
+// Reads the entire contents of the file at path.
+absl::StatusOr<ift::common::FontData> ReadFile(const std::string& path);
+
+/*
+ * A PatchSink which writes each patch to a file under output_path, named by
+ * the patch url.
+ *
+ * Writes happen on a pool of background threads so that file I/O overlaps
+ * with patch generation. At most max_pending patches are held in memory
+ * waiting to be written, Accept() blocks once that limit is reached.
+ *
+ * Once compilation has completed Finish() must be called to wait for all
+ * outstanding writes.
+ */
+class FilePatchSink : public ift::encoder::PatchSink {
+ public:
+  static constexpr size_t kDefaultMaxPending = 64;
+
+  FilePatchSink(std::string output_path, uint32_t num_threads,
+                size_t max_pending = kDefaultMaxPending);
+
+  ~FilePatchSink() override;
+
+  FilePatchSink(const FilePatchSink&) = delete;
+  FilePatchSink& operator=(const FilePatchSink&) = delete;
+
+  absl::Status Accept(const std::string& url,
+                      const ift::common::FontData& patch) override;
+
+  // Blocks until all accepted patches have been written. Returns the first
+  // error encountered by any write.
+  absl::Status Finish();
+
+  // Number of patches successfully written so far.
+  size_t NumWritten() const {
+    absl::MutexLock lock(&mutex_);
+    return num_written_;
+  }
+
+ private:
+  void WriteDone(absl::Status status);
+
+  const std::string output_path_;
+  const size_t max_pending_;
+
+  mutable absl::Mutex mutex_;
+  size_t num_pending_ ABSL_GUARDED_BY(mutex_) = 0;
+  size_t num_written_ ABSL_GUARDED_BY(mutex_) = 0;
+  absl::Status status_ ABSL_GUARDED_BY(mutex_);
+
+  // Declared last so that it is destroyed (joining the writer threads) before
+  // any of the state the writers use.
+  ift::common::ThreadPool pool_;
+};
+
+/*
+ * A PatchSource which reads the patches previously written by a FilePatchSink
+ * to input_path.
+ */
+class FilePatchSource : public ift::encoder::PatchSource {
+ public:
+  explicit FilePatchSource(std::string input_path)
+      : input_path_(std::move(input_path)) {}
+
+  absl::StatusOr<ift::common::FontData> Load(
+      const std::string& url) const override;
+
+ private:
+  const std::string input_path_;
+};
+
+}  // namespace ift::util
+
+#endif  // UTIL_FILE_PATCH_SINK_H_
@@ -0,0 +1,103 @@
+#include "util/file_patch_sink.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "absl/status/status.h"
+#include "gtest/gtest.h"
+#include "ift/common/font_data.h"
+
+using ift::common::FontData;
+
+namespace ift::util {
+
+static std::filesystem::path TestDir(const std::string& name) {
+  const char* test_tmpdir = std::getenv("TEST_TMPDIR");
+  if (test_tmpdir == nullptr || test_tmpdir[0] == '\0') {
+    std::cerr << "Failed to get temp directory for test." << std::endl;
+    assert(false);
+  }
+  auto dir = std::filesystem::path(test_tmpdir) / name;
+  std::filesystem::create_directories(dir);
+  return dir;
+}
+
+static std::string ReadFile(const std::filesystem::path& path) {
+  std::ifstream input(path, std::ios::binary);
+  std::stringstream buffer;
+  buffer << input.rdbuf();
+  return buffer.str();
+}
+
+TEST(FilePatchSinkTest, WritesAllPatches) {
+  auto dir = TestDir("WritesAllPatches");
+  FilePatchSink sink(dir.string(), 4, 2);
+
+  for (int i = 0; i < 20; i++) {
+    FontData patch(std::to_string(i * 1000));
+    ASSERT_EQ(sink.Accept("p" + std::to_string(i) + ".ift_tk", patch),
+              absl::OkStatus());
+  }
+  ASSERT_EQ(sink.Finish(), absl::OkStatus());
+  ASSERT_EQ(sink.NumWritten(), 20);
+
+  for (int i = 0; i < 20; i++) {
+    ASSERT_EQ(ReadFile(dir / ("p" + std::to_string(i) + ".ift_tk")),
+              std::to_string(i * 1000));
+  }
+}
+
+TEST(FilePatchSinkTest, InlineWrites) {
+  auto dir = TestDir("InlineWrites");
+  FilePatchSink sink(dir.string(), 0);
+
+  FontData patch("abc");
+  ASSERT_EQ(sink.Accept("a.ift_gk", patch), absl::OkStatus());
+  // No writer threads so the write is already done.
+  ASSERT_EQ(sink.NumWritten(), 1);
+  ASSERT_EQ(sink.Finish(), absl::OkStatus());
+  ASSERT_EQ(ReadFile(dir / "a.ift_gk"), "abc");
+}
+
+TEST(FilePatchSinkTest, RejectsPathTraversal) {
+  auto dir = TestDir("RejectsPathTraversal");
+  FilePatchSink sink(dir.string(), 2);
+
+  FontData patch("abc");
+  ASSERT_TRUE(absl::IsPermissionDenied(sink.Accept("../a.ift_gk", patch)));
+  ASSERT_EQ(sink.Finish(), absl::OkStatus());
+  ASSERT_EQ(sink.NumWritten(), 0);
+}
+
+TEST(FilePatchSinkTest, WriteErrorIsReported) {
+  auto dir = TestDir("WriteErrorIsReported");
+  FilePatchSink sink(dir.string(), 2);
+
+  FontData patch("abc");
+  // Parent directory doesn't exist so the write fails.
+  ASSERT_EQ(sink.Accept("missing/a.ift_gk", patch), absl::OkStatus());
+  ASSERT_TRUE(absl::IsNotFound(sink.Finish()));
+
+  // Subsequent patches are rejected.
+  ASSERT_TRUE(absl::IsNotFound(sink.Accept("b.ift_gk", patch)));
+}
+
+TEST(FilePatchSinkTest, SourceReadsWrittenPatches) {
+  auto dir = TestDir("SourceReadsWrittenPatches");
+  FilePatchSink sink(dir.string(), 0);
+  ASSERT_EQ(sink.Accept("a.ift_gk", FontData("abc")), absl::OkStatus());
+  ASSERT_EQ(sink.Finish(), absl::OkStatus());
+
+  FilePatchSource source(dir.string());
+  auto patch = source.Load("a.ift_gk");
+  ASSERT_TRUE(patch.ok()) << patch.status();
+  ASSERT_EQ(patch->str(), "abc");
+
+  ASSERT_TRUE(absl::IsNotFound(source.Load("b.ift_gk").status()));
+  ASSERT_TRUE(absl::IsPermissionDenied(source.Load("../a.ift_gk").status()));
+}
+
+}  // namespace ift::util
@@ -2,8 +2,8 @@
 
 #include <cstdint>
 #include <cstdio>
-#include <fstream>
 #include <iostream>
+#include <memory>
 
 #include "absl/container/btree_set.h"
 #include "absl/container/flat_hash_map.h"
@@ -14,6 +14,7 @@
 #include "absl/log/initialize.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
 #include "hb.h"
 #include "ift/common/axis_range.h"
 #include "ift/common/bazel_data_file_resolver.h"
@@ -29,10 +30,12 @@
 #include "ift/config/segmenter_config.pb.h"
 #include "ift/config/segmenter_config_util.h"
 #include "ift/encoder/activation_condition.h"
+#include "ift/encoder/compilation_manifest.h"
 #include "ift/encoder/compiler.h"
 #include "ift/encoder/glyph_segmentation.h"
 #include "ift/encoder/subset_definition.h"
 #include "util/auto_config_flags.h"
+#include "util/file_patch_sink.h"
 #include "util/path_util.h"
 
 using ift::common::BazelDataFileResolver;
@@ -41,7 +44,11 @@ using ift::config::ActivationConditionProto;
 using ift::config::ConfigCompiler;
 using ift::config::DesignSpace;
 using ift::config::SegmentationPlan;
+using ift::encoder::CompilationManifest;
+using ift::util::FilePatchSink;
+using ift::util::FilePatchSource;
 using ift::util::JoinAndValidatePath;
+using ift::util::WriteFile;
 
 /*
  * Utility that converts a standard font file into an IFT font file optionally
@@ -72,6 +79,64 @@ ABSL_FLAG(bool, woff2_encode, true,
           "in woff2 will be disabled when necessary to keep the woff2 encoding "
           "compatible with IFT.");
 
+ABSL_FLAG(uint32_t, num_threads, 1,
+          "Number of threads used to generate subsets and patches during "
+          "compilation, to write patch files, and to assess candidate merges "
+          "when segmenting. The output is identical for any thread count.");
+
+ABSL_FLAG(bool, glyph_table_diff, false,
+          "If enabled, table keyed patches diff glyf, loca, hmtx, and vmtx by "
+          "copying unchanged glyph records from the base table and only "
+          "compressing new bytes. Much faster for large fonts, but produces "
+          "slightly larger patches.");
+
+ABSL_FLAG(bool, incremental_subsetting, false,
+          "If enabled, font tables which only depend on the design space "
+          "(such as avar, cvt, and the hinting programs) are serialized once "
+          "per design space and reused by all other subsets, instead of being "
+          "re-serialized for every node. The output is unchanged.");
+
+ABSL_FLAG(uint32_t, table_diff_cache_max_mb, 1024,
+          "Memory budget, in megabytes, for the cache of per table diffs that "
+          "are reused across table keyed patches. Least recently used diffs "
+          "are evicted once exceeded.");
+
+ABSL_FLAG(uint32_t, max_jump_ahead_edges, 0,
+          "If non-zero, limits the number of multi segment patches generated "
+          "from each node of the table keyed patch graph when the plan uses "
+          "jump_ahead > 1. Patches for smaller jumps and earlier segments are "
+          "kept. Keeps compile time manageable with many segments.");
+
+ABSL_FLAG(std::string, checkpoint_path, "",
+          "If set, the state of segmentation merging is periodically saved to "
+          "this file. An interrupted run can be continued from it with "
+          "--resume_from. When set, independent merge groups are merged "
+          "serially rather than in parallel (--num_threads still applies to "
+          "candidate merge assessment).");
+
+ABSL_FLAG(uint32_t, checkpoint_interval_minutes, 10,
+          "Minimum number of minutes between segmentation checkpoints saved "
+          "to --checkpoint_path.");
+
+ABSL_FLAG(std::string, resume_from, "",
+          "If set, segmentation merging resumes from the checkpoint saved at "
+          "this path (see --checkpoint_path) instead of starting over. The "
+          "font and segmenter config must match the checkpointed run.");
+
+ABSL_FLAG(std::string, manifest, "",
+          "If set, a manifest describing the produced encoding is written to "
+          "this path. It can be given to a later run with --previous_manifest "
+          "to incrementally re-encode a modified font.");
+
+ABSL_FLAG(std::string, previous_manifest, "",
+          "If set, the manifest (see --manifest) of a previous encoding. "
+          "Patches whose inputs are unchanged since that encoding are copied "
+          "from --previous_output_path instead of being regenerated.");
+
+ABSL_FLAG(std::string, previous_output_path, "",
+          "Directory holding the patches of the encoding described by "
+          "--previous_manifest. Defaults to --output_path.");
+
 ABSL_FLAG(
     int, verbosity, 0,
     "Log verbosity level from. 0 is least verbose, higher values are more.");
@@ -108,45 +173,6 @@ StatusOr<hb_face_unique_ptr> load_font(const char* filename) {
   return TRY(ift::config::LoadFile(filename)).face();
 }
 
-Status write_file(const std::string& name, const FontData& data) {
-  std::ofstream output(name,
-                       std::ios::out | std::ios::binary | std::ios::trunc);
-  if (!output.is_open()) {
-    return absl::NotFoundError(StrCat("File ", name, " was not found."));
-  }
-  output.write(data.data(), data.size());
-  if (output.bad()) {
-    output.close();
-    return absl::InternalError(StrCat("Failed to write to ", name, "."));
-  }
-
-  output.close();
-  return absl::OkStatus();
-}
-
-Status write_patch(const std::string& url, const FontData& patch) {
-  std::string output_path = absl::GetFlag(FLAGS_output_path);
-  std::string full_path = TRY(JoinAndValidatePath(output_path, url));
-  std::cerr << "  Writing patch: " << full_path << std::endl;
-  return write_file(full_path, patch);
-}
-
-Status write_output(const Compiler::Encoding& encoding) {
-  std::string output_path = absl::GetFlag(FLAGS_output_path);
-  std::string output_font = absl::GetFlag(FLAGS_output_font);
-
-  std::string full_path = TRY(JoinAndValidatePath(output_path, output_font));
-
-  std::cerr << "  Writing init font: " << full_path << std::endl;
-  TRYV(write_file(full_path, encoding.init_font));
-
-  for (const auto& p : encoding.patches) {
-    TRYV(write_patch(p.first, p.second));
-  }
-
-  return absl::OkStatus();
-}
-
 StatusOr<SegmentationPlan> CreateSegmentationPlan(
     hb_face_t* font, std::shared_ptr<DataFileResolver> resolver) {
   SegmentationPlan plan;
@@ -165,6 +191,15 @@ StatusOr<SegmentationPlan> CreateSegmentationPlan(
           StrCat("Failed to generate config: ", config.status().message()));
     }
     ift::config::SegmenterConfigUtil config_util("", resolver);
+    config_util.SetNumThreads(absl::GetFlag(FLAGS_num_threads));
+    if (!absl::GetFlag(FLAGS_checkpoint_path).empty()) {
+      config_util.SetCheckpointing(
+          absl::GetFlag(FLAGS_checkpoint_path),
+          absl::Minutes(absl::GetFlag(FLAGS_checkpoint_interval_minutes)));
+    }
+    if (!absl::GetFlag(FLAGS_resume_from).empty()) {
+      config_util.SetResumeFrom(absl::GetFlag(FLAGS_resume_from));
+    }
     auto result = config_util.RunSegmenter(font, *config);
     if (!result.ok()) {
       return absl::InternalError(
@@ -223,6 +258,15 @@ int main(int argc, char** argv) {
   Compiler compiler;
   compiler.SetFace(font->get());
   compiler.SetWoff2Encode(absl::GetFlag(FLAGS_woff2_encode));
+  compiler.SetNumThreads(absl::GetFlag(FLAGS_num_threads));
+  compiler.SetUseGlyphTableDiff(absl::GetFlag(FLAGS_glyph_table_diff));
+  compiler.SetIncrementalSubsetting(
+      absl::GetFlag(FLAGS_incremental_subsetting));
+  compiler.SetTableDiffCacheMaxBytes(
+      (size_t)absl::GetFlag(FLAGS_table_diff_cache_max_mb) * 1024 * 1024);
+  compiler.SetJumpAheadPruning({
+      .max_multi_segment_edges = absl::GetFlag(FLAGS_max_jump_ahead_edges),
+  });
 
   auto sc = ConfigCompiler::Configure(*plan, compiler);
   if (!sc.ok()) {
@@ -231,15 +275,79 @@ int main(int argc, char** argv) {
     return -1;
   }
 
-  std::cout << ">> encoding:" << std::endl;
-  auto encoding = compiler.Compile();
+  std::string output_path = absl::GetFlag(FLAGS_output_path);
+  if (!absl::GetFlag(FLAGS_previous_manifest).empty()) {
+    auto previous_manifest =
+        CompilationManifest::Load(absl::GetFlag(FLAGS_previous_manifest));
+    if (!previous_manifest.ok()) {
+      std::cerr << "Failed to load the previous manifest: "
+                << previous_manifest.status() << std::endl;
+      return -1;
+    }
+    std::string previous_output_path =
+        absl::GetFlag(FLAGS_previous_output_path);
+    if (previous_output_path.empty()) {
+      previous_output_path = output_path;
+    }
+    compiler.SetPreviousEncoding(
+        std::move(*previous_manifest),
+        std::make_shared<FilePatchSource>(previous_output_path));
+  }
+
+  FilePatchSink sink(output_path, absl::GetFlag(FLAGS_num_threads));
+
+  // Patches are written out as they are produced so the full set of patches
+  // never needs to be held in memory.
+  std::cout << ">> encoding and writing patches:" << std::endl;
+  auto encoding = compiler.Compile(sink);
+  auto sink_status = sink.Finish();
   if (!encoding.ok()) {
     std::cerr << "Encoding failed: " << encoding.status() << std::endl;
     return -1;
   }
+  if (!sink_status.ok()) {
+    std::cerr << "Writing patches failed: " << sink_status << std::endl;
+    return -1;
+  }
+  std::cout << "  Wrote " << sink.NumWritten() << " patches to "
+            << output_path << std::endl;
+
+  const auto& stats = encoding->table_diff_cache_stats;
+  std::cout << ">> table diff cache: " << stats.hits << " hits, "
+            << stats.misses << " misses, " << stats.evictions
+            << " evictions, " << stats.entries << " entries using "
+            << stats.bytes << " of " << stats.max_bytes << " bytes"
+            << std::endl;
+
+  const auto& plan_stats = encoding->subset_plan_cache_stats;
+  std::cout << ">> subset plan cache: " << plan_stats.hits << " hits, "
+            << plan_stats.misses << " misses" << std::endl;
+
+  const auto& incremental_stats = encoding->incremental_stats;
+  std::cout << ">> incremental: " << incremental_stats.reused_patches
+            << " patches reused, " << incremental_stats.generated_patches
+            << " generated, " << incremental_stats.changed_nodes
+            << " changed graph nodes" << std::endl;
+
+  if (!absl::GetFlag(FLAGS_manifest).empty()) {
+    std::cerr << "  Writing manifest: " << absl::GetFlag(FLAGS_manifest)
+              << std::endl;
+    auto manifest_status =
+        encoding->manifest.Save(absl::GetFlag(FLAGS_manifest));
+    if (!manifest_status.ok()) {
+      std::cerr << manifest_status.message() << std::endl;
+      return -1;
+    }
+  }
 
-  std::cout << ">> generating output patches:" << std::endl;
-  auto status = write_output(*encoding);
+  auto init_font_path =
+      JoinAndValidatePath(output_path, absl::GetFlag(FLAGS_output_font));
+  if (!init_font_path.ok()) {
+    std::cerr << init_font_path.status().message() << std::endl;
+    return -1;
+  }
+  std::cerr << "  Writing init font: " << *init_font_path << std::endl;
+  auto status = WriteFile(*init_font_path, encoding->init_font);
   if (!status.ok()) {
     std::cerr << status.message() << std::endl;
     return -1;
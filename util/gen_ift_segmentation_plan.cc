@@ -14,6 +14,7 @@
 #include "absl/log/initialize.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
 #include "hb.h"
 #include "ift/common/bazel_data_file_resolver.h"
 #include "ift/common/data_file_resolver.h"
@@ -75,6 +76,26 @@ ABSL_FLAG(
     bool, output_fallback_glyph_count, false,
     "If set the number of fallback glyphs in the segmentation will be output.");
 
+ABSL_FLAG(uint32_t, num_threads, 1,
+          "Number of threads used to assess candidate merges. The produced "
+          "segmentation is identical for any thread count.");
+
+ABSL_FLAG(std::string, checkpoint_path, "",
+          "If set, the state of segmentation merging is periodically saved to "
+          "this file. An interrupted run can be continued from it with "
+          "--resume_from. When set, independent merge groups are merged "
+          "serially rather than in parallel (--num_threads still applies to "
+          "candidate merge assessment).");
+
+ABSL_FLAG(uint32_t, checkpoint_interval_minutes, 10,
+          "Minimum number of minutes between segmentation checkpoints saved "
+          "to --checkpoint_path.");
+
+ABSL_FLAG(std::string, resume_from, "",
+          "If set, segmentation merging resumes from the checkpoint saved at "
+          "this path (see --checkpoint_path) instead of starting over. The "
+          "font and segmenter config must match the checkpointed run.");
+
 ABSL_FLAG(
     int, verbosity, 0,
     "Log verbosity level from. 0 is least verbose, higher values are more.");
@@ -244,6 +265,15 @@ static Status Main(const std::vector<char*> args) {
                                       ? ""
                                       : absl::GetFlag(FLAGS_config),
                                   resolver);
+  config_util.SetNumThreads(absl::GetFlag(FLAGS_num_threads));
+  if (!absl::GetFlag(FLAGS_checkpoint_path).empty()) {
+    config_util.SetCheckpointing(
+        absl::GetFlag(FLAGS_checkpoint_path),
+        absl::Minutes(absl::GetFlag(FLAGS_checkpoint_interval_minutes)));
+  }
+  if (!absl::GetFlag(FLAGS_resume_from).empty()) {
+    config_util.SetResumeFrom(absl::GetFlag(FLAGS_resume_from));
+  }
 
   auto start_time = std::chrono::high_resolution_clock::now();
   auto result = TRY(config_util.RunSegmenter(font.get(), config));